@@ -0,0 +1,78 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <utility>
+#include <new>
+#include <cstddef>
+#include <type_traits>
+using namespace std;
+
+// Bump allocator for AST nodes. Nodes are carved out of large blocks and are
+// never freed one by one: the arena runs their destructors and drops every
+// block at once when it is destroyed. Nodes point at each other with plain
+// pointers, which stay valid for as long as the arena lives.
+class AstArena
+{
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Destructor
+    {
+        void (*destroy)(void*);
+        void* object;
+    };
+
+    vector<unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    size_t left = 0;
+    vector<Destructor> destructors;     // only for nodes that own memory (strings, vectors)
+
+    void* allocate(size_t size, size_t align)
+    {
+        size_t pad = (align - (size_t)cursor % align) % align;
+        if (pad + size > left)
+        {
+            size_t blockSize = size + align > BLOCK_SIZE ? size + align : BLOCK_SIZE;
+            blocks.emplace_back(new char[blockSize]);
+            cursor = blocks.back().get();
+            left = blockSize;
+            pad = (align - (size_t)cursor % align) % align;
+        }
+        void* p = cursor + pad;
+        cursor += pad + size;
+        left -= pad + size;
+        return p;
+    }
+
+public:
+    AstArena() = default;
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+
+    ~AstArena()
+    {
+        for (size_t i = destructors.size(); i-- > 0;)
+            destructors[i].destroy(destructors[i].object);
+    }
+
+    template <class T, class... Args>
+    T* make(Args&&... args)
+    {
+        T* node = new (allocate(sizeof(T), alignof(T))) T(forward<Args>(args)...);
+        if (!is_trivially_destructible<T>::value)
+            destructors.push_back({ [](void* p) { static_cast<T*>(p)->~T(); }, node });
+        return node;
+    }
+
+    // Takes over every node of other (for example an arena filled by another
+    // thread), leaving other empty. The nodes keep their addresses.
+    void Adopt(AstArena& other)
+    {
+        for (auto& block : other.blocks)
+            blocks.push_back(move(block));
+        destructors.insert(destructors.end(), other.destructors.begin(), other.destructors.end());
+        other.blocks.clear();
+        other.destructors.clear();
+        other.cursor = nullptr;
+        other.left = 0;
+    }
+};
@@ -0,0 +1,279 @@
+// Throughput benchmarks of the front end on generated programs.
+//
+// A separate program with its own main, so it is not part of the compiler's
+// build. Build it from the other sources without Source.cpp and main.cpp:
+//     g++ -std=c++17 -O2 -pthread -o benchmark Benchmark.cpp DFA.cpp Parser.cpp SourceBuffer.cpp
+//         SimdScan.cpp StringInterner.cpp Without_regex_Lexer.cpp with_regex_Lexer.cpp
+//
+// Every stage runs on the same generated file until it has taken --min-time
+// seconds and at least --repeat runs. The fastest run gives MB/s of source
+// and tokens/s. Results print as a table, and with --json FILE also as JSON,
+// to compare runs across commits. The file goes to the system's temporary
+// directory unless --keep names it.
+//
+// Each stage reads the file itself. ScopeAnalizer parses it in parallel and
+// analyzes it, without printing the AST as the compiler's driver does.
+//
+//     benchmark [--functions N] [--depth N] [--churn P] [--comments P] [--seed N]
+//               [--repeat N] [--min-time S] [--json FILE] [--label TEXT] [--keep FILE]
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <filesystem>
+#include "Without_regex_Lexer.h"
+#include "with_regex_Lexer.h"
+#include "Parser2.h"
+#include "ScopeAnalysis_A_.h"
+#include "SourceGenerator.h"
+
+using namespace std;
+
+struct BenchmarkOptions
+{
+    GeneratorOptions generator;
+    int repeat = 5;
+    double minTime = 0.5;       // seconds per stage
+    string json;                // file for the JSON report, - for stdout
+    string label;               // free text for the report, such as a commit id
+    string keep;                // where to write the generated program; a temporary file if empty
+};
+
+struct BenchmarkResult
+{
+    string name;
+    size_t tokens = 0;
+    int runs = 0;
+    double best = 0;            // seconds
+    double mean = 0;
+};
+
+// Discards what goes to cout and cerr while it exists; the scope analysis
+// prints its diagnostics.
+class Silence
+{
+    struct NullBuffer : streambuf
+    {
+        int overflow(int c) override { return c; }
+    } null;
+    streambuf* out;
+    streambuf* err;
+
+public:
+    Silence() : out(cout.rdbuf(&null)), err(cerr.rdbuf(&null)) {}
+    ~Silence()
+    {
+        cout.rdbuf(out);
+        cerr.rdbuf(err);
+    }
+};
+
+// Runs stage until it has taken minTime and run repeat times. stage returns
+// the number of tokens it handled.
+static BenchmarkResult Measure(const string& name, const BenchmarkOptions& options, const function<size_t()>& stage)
+{
+    typedef chrono::steady_clock Clock;
+    BenchmarkResult r;
+    r.name = name;
+    double total = 0;
+    while (r.runs < options.repeat || total < options.minTime)
+    {
+        auto start = Clock::now();
+        size_t tokens = stage();
+        double seconds = chrono::duration<double>(Clock::now() - start).count();
+        if (r.runs == 0 || seconds < r.best)
+            r.best = seconds;
+        r.tokens = tokens;
+        total += seconds;
+        r.runs++;
+    }
+    r.mean = total / r.runs;
+    return r;
+}
+
+static string JsonString(const string& s)
+{
+    ostringstream o;
+    o << '"';
+    for (unsigned char c : s)
+    {
+        if (c == '"' || c == '\\')
+            o << '\\' << c;
+        else if (c < 32)
+            o << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec << setfill(' ');
+        else
+            o << c;
+    }
+    o << '"';
+    return o.str();
+}
+
+static void WriteJson(ostream& o, const BenchmarkOptions& options, size_t bytes, size_t lines, const vector<BenchmarkResult>& results)
+{
+    const GeneratorOptions& g = options.generator;
+    o << setprecision(6);
+    o << "{\n";
+    o << "  \"label\": " << JsonString(options.label) << ",\n";
+    o << "  \"time\": " << (long long)time(nullptr) << ",\n";
+    o << "  \"input\": { \"functions\": " << g.functions << ", \"depth\": " << g.depth << ", \"churn\": " << g.churn
+        << ", \"comments\": " << g.comments << ", \"seed\": " << g.seed << ", \"bytes\": " << bytes << ", \"lines\": " << lines << " },\n";
+    o << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& r = results[i];
+        o << "    { \"name\": " << JsonString(r.name) << ", \"runs\": " << r.runs << ", \"tokens\": " << r.tokens
+            << ", \"best_seconds\": " << r.best << ", \"mean_seconds\": " << r.mean
+            << ", \"mb_per_second\": " << bytes / r.best / 1e6 << ", \"tokens_per_second\": " << r.tokens / r.best << " }"
+            << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    o << "  ]\n}\n";
+}
+
+static void Usage()
+{
+    cerr << "usage: benchmark [--functions N] [--depth N] [--churn P] [--comments P] [--seed N]\n"
+            "                 [--repeat N] [--min-time S] [--json FILE] [--label TEXT] [--keep FILE]\n";
+}
+
+static bool ParseArgs(int argc, char** argv, BenchmarkOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (i + 1 >= argc)
+            return false;
+        string value = argv[++i];
+        try
+        {
+            if (arg == "--functions")
+                options.generator.functions = stoi(value);
+            else if (arg == "--depth")
+                options.generator.depth = stoi(value);
+            else if (arg == "--churn")
+                options.generator.churn = stod(value);
+            else if (arg == "--comments")
+                options.generator.comments = stod(value);
+            else if (arg == "--seed")
+                options.generator.seed = (unsigned)stoul(value);
+            else if (arg == "--repeat")
+                options.repeat = stoi(value);
+            else if (arg == "--min-time")
+                options.minTime = stod(value);
+            else if (arg == "--json")
+                options.json = value;
+            else if (arg == "--label")
+                options.label = value;
+            else if (arg == "--keep")
+                options.keep = value;
+            else
+                return false;
+        }
+        catch (const exception&)
+        {
+            return false;
+        }
+    }
+    return options.generator.functions >= 1 && options.generator.depth >= 0 && options.repeat >= 1;
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!ParseArgs(argc, argv, options))
+    {
+        Usage();
+        return 2;
+    }
+
+    string source = SourceGenerator::Generate(options.generator);
+    string file = options.keep;
+    if (file.empty())
+        file = (filesystem::temp_directory_path() / ("benchmark_" + to_string(random_device()()) + ".txt")).string();
+    {
+        ofstream f(file, ios::binary);
+        f << source;
+        if (!f)
+        {
+            cerr << "cannot write " << file << "\n";
+            return 1;
+        }
+    }
+    size_t lines = count(source.begin(), source.end(), '\n');
+
+    vector<BenchmarkResult> results;
+    try
+    {
+        results.push_back(Measure("Lexer_regex", options, [&]() {
+            Lexer_regex lexer;
+            return lexer.GenerateTokens(file).size();
+        }));
+        results.push_back(Measure("Lexer_regex/parallel", options, [&]() {
+            Lexer_regex lexer;
+            return lexer.GenerateTokensParallel(file).size();
+        }));
+        results.push_back(Measure("Without_regex_Lexer", options, [&]() {
+            Without_regex_Lexer lexer;
+            return lexer.CreateTokens(file).size();
+        }));
+        results.push_back(Measure("Without_regex_Lexer/parallel", options, [&]() {
+            Without_regex_Lexer lexer;
+            return lexer.CreateTokensParallel(file).size();
+        }));
+        for (size_t k : { 1, 3 })
+            if (results[k].tokens != results[k - 1].tokens)
+                throw runtime_error("[Benchmark] " + results[k].name + " made " + to_string(results[k].tokens) + " tokens, the sequential lexer " + to_string(results[k - 1].tokens));
+        // the parser and the analysis handle the tokens Lexer_regex makes
+        size_t tokens = results[0].tokens;
+        results.push_back(Measure("Parser", options, [&]() {
+            Parser parser(file);
+            parser.parseProgram();
+            return tokens;
+        }));
+        results.push_back(Measure("ScopeAnalizer", options, [&]() {
+            Silence silence;
+            ScopeAnalizer analyzer(file);
+            analyzer.analyzeProgram(false);
+            return tokens;
+        }));
+    }
+    catch (const exception& e)
+    {
+        cerr << "Exception: " << e.what() << endl;
+        if (options.keep.empty())
+            remove(file.c_str());
+        return 1;
+    }
+    if (options.keep.empty())
+        remove(file.c_str());
+
+    cout << "input: " << source.size() << " bytes, " << lines << " lines, " << options.generator.functions << " functions\n";
+    cout << left << setw(30) << "stage" << right << setw(8) << "runs" << setw(12) << "best ms" << setw(12) << "MB/s" << setw(16) << "tokens/s" << "\n";
+    for (const BenchmarkResult& r : results)
+        cout << left << setw(30) << r.name << right << setw(8) << r.runs << fixed << setprecision(3) << setw(12) << r.best * 1e3
+            << setprecision(1) << setw(12) << source.size() / r.best / 1e6 << setprecision(0) << setw(16) << r.tokens / r.best << "\n"
+            << defaultfloat;
+
+    if (!options.json.empty())
+    {
+        if (options.json == "-")
+            WriteJson(cout, options, source.size(), lines, results);
+        else
+        {
+            ofstream f(options.json);
+            WriteJson(f, options, source.size(), lines, results);
+            if (!f)
+            {
+                cerr << "cannot write " << options.json << "\n";
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include "Bytecode.h"
+#include <sstream>
+#include <cmath>
+#include <stdexcept>
+
+string ValueToString(const Value& v)
+{
+    switch (v.type)
+    {
+    case V_INT:
+        return to_string(v.i);
+    case V_FLOAT:
+    {
+        ostringstream o;
+        o << v.f;
+        return o.str();
+    }
+    case V_BOOL:
+        return v.b ? "true" : "false";
+    case V_STRING:
+        return *v.s;
+    default:
+        return "void";
+    }
+}
+
+string BytecodeModule::Disassemble() const
+{
+    ostringstream o;
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        const FunctionCode& fn = functions[f];
+        o << "function " << f << " " << SymbolName(fn.name) << " (arity " << fn.arity
+          << ", slots " << fn.slotCount << ", stack " << fn.maxStack << ")\n";
+        for (size_t ip = 0; ip < fn.code.size();)
+        {
+            OpCode op = (OpCode)fn.code[ip];
+            o << "  " << ip << "\t" << OpCodeName(op);
+            ip++;
+            if (OpHasOperand(op) && ip < fn.code.size())
+            {
+                uint32_t a = fn.code[ip++];
+                o << " " << a;
+                if (op == OP_CONST && a < constants.size())
+                    o << "\t; " << ValueToString(constants[a]);
+                else if (op == OP_CALL && a < functions.size())
+                    o << "\t; " << SymbolName(functions[a].name);
+            }
+            o << "\n";
+        }
+    }
+    return o.str();
+}
+
+[[noreturn]] void RuntimeError(const string& message)
+{
+    throw runtime_error("[RuntimeError] " + message);
+}
+
+const char* ValueTypeName(ValueType t)
+{
+    switch (t)
+    {
+    case V_INT: return "int";
+    case V_FLOAT: return "float";
+    case V_BOOL: return "bool";
+    case V_STRING: return "string";
+    default: return "void";
+    }
+}
+
+bool Truthy(const Value& v)
+{
+    switch (v.type)
+    {
+    case V_BOOL: return v.b;
+    case V_INT: return v.i != 0;
+    case V_FLOAT: return v.f != 0;
+    default: RuntimeError(string("a ") + ValueTypeName(v.type) + " value cannot be used as a condition");
+    }
+}
+
+// Everything but int op int, which the dispatch loop handles inline.
+// Integer arithmetic wraps around instead of overflowing.
+Value Arith(OpCode op, const Value& a, const Value& b, deque<string>& strings)
+{
+    if (op == OP_ADD && a.type == V_STRING && b.type == V_STRING)
+    {
+        strings.push_back(*a.s + *b.s);
+        return Value::String(&strings.back());
+    }
+    if (!IsNumber(a) || !IsNumber(b))
+        RuntimeError(string("invalid operands to ") + OpCodeName(op) + ": " + ValueTypeName(a.type) + " and " + ValueTypeName(b.type));
+
+    if (a.type == V_FLOAT || b.type == V_FLOAT)
+    {
+        double x = AsFloat(a), y = AsFloat(b);
+        switch (op)
+        {
+        case OP_ADD: return Value::Float(x + y);
+        case OP_SUB: return Value::Float(x - y);
+        case OP_MUL: return Value::Float(x * y);
+        case OP_DIV: return Value::Float(x / y);
+        default: return Value::Float(fmod(x, y));
+        }
+    }
+    uint64_t x = (uint64_t)AsInt(a), y = (uint64_t)AsInt(b);
+    switch (op)
+    {
+    case OP_ADD: return Value::Int((int64_t)(x + y));
+    case OP_SUB: return Value::Int((int64_t)(x - y));
+    case OP_MUL: return Value::Int((int64_t)(x * y));
+    default:
+        if (y == 0)
+            RuntimeError("division by zero");
+        if ((int64_t)y == -1)   // INT64_MIN / -1 overflows
+            return Value::Int(op == OP_DIV ? (int64_t)(0 - x) : 0);
+        return Value::Int(op == OP_DIV ? (int64_t)x / (int64_t)y : (int64_t)x % (int64_t)y);
+    }
+}
+
+Value Compare(OpCode op, const Value& a, const Value& b)
+{
+    int c;
+    if (a.type == V_STRING && b.type == V_STRING)
+        c = a.s->compare(*b.s);
+    else if (IsNumber(a) && IsNumber(b))
+    {
+        if (a.type == V_FLOAT || b.type == V_FLOAT)
+        {
+            double x = AsFloat(a), y = AsFloat(b);
+            switch (op)
+            {
+            case OP_EQ: return Value::Bool(x == y);
+            case OP_NE: return Value::Bool(x != y);
+            case OP_LT: return Value::Bool(x < y);
+            case OP_GT: return Value::Bool(x > y);
+            case OP_LE: return Value::Bool(x <= y);
+            default: return Value::Bool(x >= y);
+            }
+        }
+        int64_t x = AsInt(a), y = AsInt(b);
+        c = x < y ? -1 : x > y ? 1 : 0;
+    }
+    else
+        RuntimeError(string("cannot compare ") + ValueTypeName(a.type) + " and " + ValueTypeName(b.type));
+
+    switch (op)
+    {
+    case OP_EQ: return Value::Bool(c == 0);
+    case OP_NE: return Value::Bool(c != 0);
+    case OP_LT: return Value::Bool(c < 0);
+    case OP_GT: return Value::Bool(c > 0);
+    case OP_LE: return Value::Bool(c <= 0);
+    default: return Value::Bool(c >= 0);
+    }
+}
+
+// value stored into a variable, argument or return value of the given type
+Value Convert(ValueType to, const Value& v)
+{
+    if (v.type == to)
+        return v;
+    if (to != V_STRING && IsNumber(v))
+    {
+        switch (to)
+        {
+        case V_INT:
+            if (v.type == V_FLOAT && !(v.f > -9.2e18 && v.f < 9.2e18))
+                RuntimeError("float value out of range for int");
+            return Value::Int(v.type == V_FLOAT ? (int64_t)v.f : AsInt(v));
+        case V_FLOAT:
+            return Value::Float(AsFloat(v));
+        default:
+            return Value::Bool(Truthy(v));
+        }
+    }
+    RuntimeError(string("cannot convert ") + ValueTypeName(v.type) + " to " + ValueTypeName(to));
+}
+
+Value DefaultValue(ValueType type)
+{
+    static const string empty;
+    switch (type)
+    {
+    case V_INT: return Value::Int(0);
+    case V_FLOAT: return Value::Float(0.0);
+    case V_BOOL: return Value::Bool(false);
+    case V_STRING: return Value::String(&empty);
+    default: return Value();
+    }
+}
@@ -0,0 +1,155 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include "StringInterner.h"
+using namespace std;
+
+// Instruction set of the stack VM. Every instruction is one 32-bit word for the
+// opcode, followed by one word of operand for the ones marked (a).
+#define OP_CODES(X) \
+    X(OP_CONST)         /* (a) push constants[a] */ \
+    X(OP_LOAD_LOCAL)    /* (a) push frame slot a */ \
+    X(OP_STORE_LOCAL)   /* (a) pop into frame slot a */ \
+    X(OP_LOAD_GLOBAL)   /* (a) push global a */ \
+    X(OP_STORE_GLOBAL)  /* (a) pop into global a */ \
+    X(OP_POP) \
+    X(OP_DUP) \
+    X(OP_ADD) \
+    X(OP_SUB) \
+    X(OP_MUL) \
+    X(OP_DIV) \
+    X(OP_MOD) \
+    X(OP_NEG) \
+    X(OP_NOT) \
+    X(OP_EQ) \
+    X(OP_NE) \
+    X(OP_LT) \
+    X(OP_GT) \
+    X(OP_LE) \
+    X(OP_GE) \
+    X(OP_TO_INT)        /* convert the top for a store into an int, float, bool or string variable */ \
+    X(OP_TO_FLOAT) \
+    X(OP_TO_BOOL) \
+    X(OP_TO_STRING) \
+    X(OP_JUMP)          /* (a) ip = a */ \
+    X(OP_JUMP_IF_FALSE) /* (a) pop, ip = a if it is false */ \
+    X(OP_CALL)          /* (a) call functions[a], its arguments are on the stack */ \
+    X(OP_RETURN)        /* return the top of the stack */
+
+enum OpCode : uint32_t
+{
+#define OP_CODE_ENUM(op) op,
+    OP_CODES(OP_CODE_ENUM)
+#undef OP_CODE_ENUM
+    OP_COUNT
+};
+
+inline const char* OpCodeName(OpCode op)
+{
+    static const char* const names[] = {
+#define OP_CODE_NAME(op) #op,
+        OP_CODES(OP_CODE_NAME)
+#undef OP_CODE_NAME
+    };
+    return op < OP_COUNT ? names[op] : "?";
+}
+
+inline bool OpHasOperand(OpCode op)
+{
+    switch (op)
+    {
+    case OP_CONST: case OP_LOAD_LOCAL: case OP_STORE_LOCAL: case OP_LOAD_GLOBAL: case OP_STORE_GLOBAL:
+    case OP_JUMP: case OP_JUMP_IF_FALSE: case OP_CALL:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Runtime value. float and double variables both hold a double.
+enum ValueType : unsigned char
+{
+    V_VOID,
+    V_INT,
+    V_FLOAT,
+    V_BOOL,
+    V_STRING,
+};
+
+struct Value
+{
+    ValueType type = V_VOID;
+    union
+    {
+        int64_t i;
+        double f;
+        bool b;
+        const string* s;    // owned by the module (constants) or the VM (results)
+    };
+    Value() : i(0) {}
+    static Value Int(int64_t v) { Value r; r.type = V_INT; r.i = v; return r; }
+    static Value Float(double v) { Value r; r.type = V_FLOAT; r.f = v; return r; }
+    static Value Bool(bool v) { Value r; r.type = V_BOOL; r.i = 0; r.b = v; return r; }
+    static Value String(const string* v) { Value r; r.type = V_STRING; r.s = v; return r; }
+};
+
+string ValueToString(const Value& v);
+const char* ValueTypeName(ValueType t);
+Value DefaultValue(ValueType type);
+
+// bool takes part in arithmetic as 0 or 1, as in C
+inline bool IsNumber(const Value& v)
+{
+    return v.type == V_INT || v.type == V_FLOAT || v.type == V_BOOL;
+}
+inline int64_t AsInt(const Value& v)
+{
+    return v.type == V_BOOL ? (int64_t)v.b : v.i;
+}
+inline double AsFloat(const Value& v)
+{
+    return v.type == V_FLOAT ? v.f : (double)AsInt(v);
+}
+
+// Operations shared by the virtual machines. op is OP_ADD .. OP_MOD for Arith
+// and OP_EQ .. OP_GE for Compare; strings built by + are kept in strings.
+// All of them throw runtime_error on operands of the wrong type.
+[[noreturn]] void RuntimeError(const string& message);
+bool Truthy(const Value& v);
+Value Arith(OpCode op, const Value& a, const Value& b, deque<string>& strings);
+Value Compare(OpCode op, const Value& a, const Value& b);
+// value stored into a variable, argument or return value of the given type
+Value Convert(ValueType to, const Value& v);
+
+// One compiled function. Slots 0 .. arity-1 hold the arguments, the rest the locals.
+struct FunctionCode
+{
+    SymbolId name = NO_SYMBOL;
+    ValueType retType = V_VOID;
+    int arity = 0;
+    int slotCount = 0;
+    int maxStack = 0;               // deepest the operand stack above the slots gets
+    vector<uint32_t> code;
+};
+
+struct BytecodeModule
+{
+    vector<FunctionCode> functions;
+    vector<Value> constants;
+    deque<string> strings;          // text of the string constants
+    vector<ValueType> globalTypes;
+    int globalInit = -1;            // function that initializes the globals, in source order
+
+    int FindFunction(SymbolId name) const
+    {
+        for (size_t i = 0; i < functions.size(); i++)
+            if (functions[i].name == name && (int)i != globalInit)
+                return (int)i;
+        return -1;
+    }
+
+    // Listing of every function, for debugging.
+    string Disassemble() const;
+};
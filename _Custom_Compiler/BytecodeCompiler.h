@@ -0,0 +1,614 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <cstring>
+#include <stdexcept>
+#include "Parser2.h"
+#include "Bytecode.h"
+
+using namespace std;
+
+inline ValueType valueTypeOf(TokenKind typeTok)
+{
+    switch (typeTok)
+    {
+    case T_INT: return V_INT;
+    case T_FLOAT: case T_DOUBLE: return V_FLOAT;
+    case T_BOOL: return V_BOOL;
+    case T_STRING: return V_STRING;
+    default: return V_VOID;
+    }
+}
+
+// run-time type of a value of a checked static type; a char is its code
+inline ValueType valueTypeOf(TypeKind type)
+{
+    switch (type)
+    {
+    case TY_INT: case TY_CHAR: return V_INT;
+    case TY_FLOAT: case TY_DOUBLE: return V_FLOAT;
+    case TY_BOOL: return V_BOOL;
+    case TY_STRING: return V_STRING;
+    default: return V_VOID;
+    }
+}
+
+// Compiles a parsed Program into a BytecodeModule for the StackVM.
+//
+// Names are resolved here, so the VM only sees slot, global and function
+// indices. Every function signature is registered before any body is compiled
+// (functions may call functions defined further down); other names follow the
+// scope rules in ScopeStack.h. Errors the scope analysis only reports (undeclared
+// names, redefinitions) stop compilation with a runtime_error, as do wrong
+// argument counts.
+class BytecodeCompiler : AstVisitor<BytecodeCompiler>
+{
+    struct Local
+    {
+        SymbolId name;
+        int slot;
+        ValueType type;
+    };
+
+    BytecodeModule module;
+    unordered_map<SymbolId, int> functionIndex;
+    vector<vector<ValueType>> paramTypes;       // by function index
+    unordered_map<SymbolId, int> globalIndex;   // globals declared so far
+    map<pair<int, int64_t>, uint32_t> numberConstants;
+    unordered_map<string, uint32_t> stringConstants;
+
+    FunctionCode* fn = nullptr;     // function being compiled
+    vector<Local> locals;           // every local in scope, innermost last
+    vector<size_t> marks;           // locals.size() when each block was opened
+    int nextSlot = 0;
+    int depth = 0;                  // operand stack depth at the current instruction
+
+public:
+    static BytecodeModule Compile(const Program* program)
+    {
+        BytecodeCompiler c;
+        c.compileProgram(program);
+        return move(c.module);
+    }
+
+private:
+    void compileProgram(const Program* program)
+    {
+        for (const ASTPtr item : program->globalItems)
+        {
+            if (auto func = nodeCast<FuncDecl>(item))
+            {
+                if (functionIndex.count(func->name))
+                    error("function redefined", func->name);
+                functionIndex[func->name] = (int)module.functions.size();
+                module.functions.emplace_back();
+                FunctionCode& code = module.functions.back();
+                code.name = func->name;
+                code.retType = valueTypeOf(func->retType);
+                code.arity = (int)func->params.size();
+                paramTypes.emplace_back();
+                for (const Param& p : func->params)
+                    paramTypes.back().push_back(valueTypeOf(p.typeTok));
+            }
+        }
+        module.globalInit = (int)module.functions.size();
+        module.functions.emplace_back();
+        module.functions.back().name = Intern("<globals>");
+
+        for (const ASTPtr item : program->globalItems)
+        {
+            if (auto func = nodeCast<FuncDecl>(item))
+                compileFunction(func);
+            else if (auto var = nodeCast<VarDeclStmt>(item))
+                compileGlobal(var);
+        }
+        beginFunction(module.globalInit);
+        emitConst(Value());
+        emit(OP_RETURN);
+        endFunction();
+    }
+
+    // Global initializers are appended in source order to one function that the
+    // VM runs before anything else.
+    void compileGlobal(const VarDeclStmt* var)
+    {
+        ValueType type = valueTypeOf(var->typeTok);
+        if (type == V_VOID)
+            error("variable declared void", var->name);
+        if (globalIndex.count(var->name))
+            error("global variable redefined", var->name);
+
+        beginFunction(module.globalInit);
+        int index = (int)module.globalTypes.size();
+        if (var->init)
+        {
+            compileExpr(var->init);
+            emitConvert(type);
+        }
+        else
+            emitConst(DefaultValue(type));
+        // the global is only visible once its initializer is compiled
+        module.globalTypes.push_back(type);
+        globalIndex[var->name] = index;
+        emit(OP_STORE_GLOBAL, index);
+        endFunction();
+    }
+
+    void compileFunction(const FuncDecl* func)
+    {
+        beginFunction(functionIndex[func->name]);
+        // parameters share the scope of the outermost block of the body
+        pushScope();
+        for (const Param& p : func->params)
+        {
+            ValueType type = valueTypeOf(p.typeTok);
+            if (type == V_VOID)
+                error("parameter declared void", p.name);
+            declareLocal(p.name, type);
+        }
+        if (func->body)
+            for (const auto& stmt : func->body->stmts)
+                compileStmt(stmt);
+        popScope();
+        // falling off the end returns the default value of the return type
+        emitConst(DefaultValue(fn->retType));
+        emit(OP_RETURN);
+        endFunction();
+    }
+
+    void beginFunction(int index)
+    {
+        fn = &module.functions[index];
+        locals.clear();
+        marks.clear();
+        nextSlot = 0;
+        depth = 0;
+    }
+
+    void endFunction()
+    {
+        fn = nullptr;
+    }
+
+    // ---- locals ----
+
+    void pushScope()
+    {
+        marks.push_back(locals.size());
+    }
+
+    // slots of the popped block are reused by the next one
+    void popScope()
+    {
+        locals.resize(marks.back());
+        marks.pop_back();
+        nextSlot = locals.empty() ? 0 : locals.back().slot + 1;
+    }
+
+    int declareLocal(SymbolId name, ValueType type)
+    {
+        size_t scopeStart = marks.empty() ? 0 : marks.back();
+        for (size_t i = scopeStart; i < locals.size(); i++)
+            if (locals[i].name == name)
+                error("variable redefined", name);
+        int slot = nextSlot++;
+        locals.push_back({ name, slot, type });
+        if (nextSlot > fn->slotCount)
+            fn->slotCount = nextSlot;
+        return slot;
+    }
+
+    const Local* findLocal(SymbolId name) const
+    {
+        for (size_t i = locals.size(); i-- > 0;)
+            if (locals[i].name == name)
+                return &locals[i];
+        return nullptr;
+    }
+
+    // load or store a variable by name
+    void emitLoad(SymbolId name)
+    {
+        if (const Local* l = findLocal(name))
+            emit(OP_LOAD_LOCAL, l->slot);
+        else
+            emit(OP_LOAD_GLOBAL, globalOf(name));
+    }
+    void emitStore(SymbolId name)
+    {
+        if (const Local* l = findLocal(name))
+            emit(OP_STORE_LOCAL, l->slot);
+        else
+            emit(OP_STORE_GLOBAL, globalOf(name));
+    }
+    ValueType typeOfVariable(SymbolId name)
+    {
+        if (const Local* l = findLocal(name))
+            return l->type;
+        return module.globalTypes[globalOf(name)];
+    }
+    int globalOf(SymbolId name)
+    {
+        auto it = globalIndex.find(name);
+        if (it == globalIndex.end())
+            error("undeclared variable", name);
+        return it->second;
+    }
+
+    // ---- emission ----
+
+    int stackEffect(OpCode op, uint32_t operand) const
+    {
+        switch (op)
+        {
+        case OP_CONST: case OP_LOAD_LOCAL: case OP_LOAD_GLOBAL: case OP_DUP:
+            return 1;
+        case OP_STORE_LOCAL: case OP_STORE_GLOBAL: case OP_POP: case OP_JUMP_IF_FALSE: case OP_RETURN:
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_EQ: case OP_NE: case OP_LT: case OP_GT: case OP_LE: case OP_GE:
+            return -1;
+        case OP_CALL:
+            return 1 - module.functions[operand].arity;
+        default:
+            return 0;
+        }
+    }
+
+    size_t emit(OpCode op)
+    {
+        fn->code.push_back(op);
+        adjustDepth(stackEffect(op, 0));
+        return fn->code.size() - 1;
+    }
+    // returns the position of the operand, for patching jumps
+    size_t emit(OpCode op, int operand)
+    {
+        fn->code.push_back(op);
+        fn->code.push_back((uint32_t)operand);
+        adjustDepth(stackEffect(op, (uint32_t)operand));
+        return fn->code.size() - 1;
+    }
+    void adjustDepth(int delta)
+    {
+        depth += delta;
+        if (depth > fn->maxStack)
+            fn->maxStack = depth;
+    }
+
+    size_t here() const { return fn->code.size(); }
+    void patch(size_t operand, size_t target) { fn->code[operand] = (uint32_t)target; }
+
+    void emitConst(const Value& v)
+    {
+        emit(OP_CONST, constant(v));
+    }
+
+    void emitConvert(ValueType type)
+    {
+        switch (type)
+        {
+        case V_INT: emit(OP_TO_INT); break;
+        case V_FLOAT: emit(OP_TO_FLOAT); break;
+        case V_BOOL: emit(OP_TO_BOOL); break;
+        case V_STRING: emit(OP_TO_STRING); break;
+        default: break;
+        }
+    }
+
+    uint32_t constant(const Value& v)
+    {
+        if (v.type == V_STRING)
+        {
+            auto it = stringConstants.find(*v.s);
+            if (it != stringConstants.end())
+                return it->second;
+            module.strings.push_back(*v.s);
+            uint32_t k = (uint32_t)module.constants.size();
+            module.constants.push_back(Value::String(&module.strings.back()));
+            stringConstants[module.strings.back()] = k;
+            return k;
+        }
+        int64_t bits = 0;
+        if (v.type == V_FLOAT)
+            memcpy(&bits, &v.f, sizeof bits);
+        else if (v.type == V_BOOL)
+            bits = v.b;
+        else if (v.type == V_INT)
+            bits = v.i;
+        auto key = make_pair((int)v.type, bits);
+        auto it = numberConstants.find(key);
+        if (it != numberConstants.end())
+            return it->second;
+        uint32_t k = (uint32_t)module.constants.size();
+        module.constants.push_back(v);
+        numberConstants[key] = k;
+        return k;
+    }
+
+    [[noreturn]] void error(const string& message, SymbolId name = NO_SYMBOL)
+    {
+        string text = "[CompileError] " + message;
+        if (name != NO_SYMBOL)
+            text += ": " + string(SymbolName(name));
+        throw runtime_error(text);
+    }
+
+    // ---- statements ----
+
+    void compileBlock(const BlockStmt* block)
+    {
+        pushScope();
+        for (const auto& stmt : block->stmts)
+            compileStmt(stmt);
+        popScope();
+    }
+
+    void compileStmt(const Stmt* stmt)
+    {
+        if (stmt)
+            visit(stmt);
+    }
+
+    // leaves exactly one value on the stack
+    void compileExpr(const Expr* e)
+    {
+        visit(e);
+    }
+
+    // jumps to the returned operand when e is false
+    size_t compileCondition(const Expr* e)
+    {
+        compileExpr(e);
+        return emit(OP_JUMP_IF_FALSE, 0);
+    }
+
+    friend struct AstVisitor<BytecodeCompiler>;
+
+    void visitDefault(const ASTNode*)
+    {
+        error("construct not supported by the bytecode compiler");
+    }
+
+    void visitBlock(const BlockStmt* bs)
+    {
+        compileBlock(bs);
+    }
+    void visitVarDecl(const VarDeclStmt* vd)
+    {
+        ValueType type = valueTypeOf(vd->typeTok);
+        if (type == V_VOID)
+            error("variable declared void", vd->name);
+        // the initializer does not see the variable it initializes
+        if (vd->init)
+        {
+            compileExpr(vd->init);
+            emitConvert(type);
+        }
+        else
+            emitConst(DefaultValue(type));
+        emit(OP_STORE_LOCAL, declareLocal(vd->name, type));
+    }
+    void visitReturn(const ReturnStmt* rs)
+    {
+        compileExpr(rs->expr);
+        if (fn->retType == V_VOID)
+        {
+            emit(OP_POP);
+            emitConst(Value());
+        }
+        else
+            emitConvert(fn->retType);
+        emit(OP_RETURN);
+    }
+    void visitExprStmt(const ExprStmt* es)
+    {
+        if (!es->expr)
+            return;
+        compileExpr(es->expr);
+        emit(OP_POP);
+    }
+    void visitIf(const IfStmt* ifs)
+    {
+        size_t toElse = compileCondition(ifs->cond);
+        compileStmt(ifs->thenStmt);
+        if (ifs->elseStmt)
+        {
+            size_t toEnd = emit(OP_JUMP, 0);
+            patch(toElse, here());
+            compileStmt(ifs->elseStmt);
+            patch(toEnd, here());
+        }
+        else
+            patch(toElse, here());
+    }
+    void visitWhile(const WhileStmt* ws)
+    {
+        size_t top = here();
+        size_t toEnd = compileCondition(ws->cond);
+        compileStmt(ws->body);
+        emit(OP_JUMP, (int)top);
+        patch(toEnd, here());
+    }
+    void visitFor(const ForStmt* fs)
+    {
+        // a variable declared in the init clause lives until the end of the loop
+        pushScope();
+        compileStmt(fs->init);
+        size_t top = here();
+        size_t toEnd = 0;
+        const ExprStmt* cond = nodeCast<ExprStmt>(fs->condStmt);
+        bool hasCond = cond && cond->expr;
+        if (hasCond)
+            toEnd = compileCondition(cond->expr);
+        compileStmt(fs->body);
+        if (fs->iterExpr)
+        {
+            compileExpr(fs->iterExpr);
+            emit(OP_POP);
+        }
+        emit(OP_JUMP, (int)top);
+        if (hasCond)
+            patch(toEnd, here());
+        popScope();
+    }
+
+    // ---- expressions ----
+
+    void visitIdentifier(const IdentifierExpr* id)
+    {
+        emitLoad(id->name);
+    }
+    void visitIntLiteral(const IntLiteral* lit)
+    {
+        if (!lit->inRange)
+            error("integer literal out of range: " + lit->val);
+        emitConst(Value::Int(lit->value));
+    }
+    void visitFloatLiteral(const FloatLiteral* lit)
+    {
+        emitConst(Value::Float(lit->value));
+    }
+    void visitBoolLiteral(const BoolLiteral* lit)
+    {
+        emitConst(Value::Bool(lit->value));
+    }
+    void visitCharLiteral(const CharLiteral* lit)
+    {
+        emitConst(Value::Int(lit->value));
+    }
+    void visitStringLiteral(const StringLiteral* lit)
+    {
+        emitConst(Value::String(&lit->text));
+    }
+
+    void visitUnary(const UnaryExpr* unary)
+    {
+        switch (unary->op)
+        {
+        case T_PLUS:
+            compileExpr(unary->rhs);
+            break;
+        case T_MINUS:
+            compileExpr(unary->rhs);
+            emit(OP_NEG);
+            break;
+        case T_NOT:
+            compileExpr(unary->rhs);
+            emit(OP_NOT);
+            break;
+        case T_INC:
+        case T_DEC:
+            // ++x: the new value is the result
+            {
+                SymbolId name = variableOperand(unary->rhs);
+                emitLoad(name);
+                emitConst(Value::Int(1));
+                emit(unary->op == T_INC ? OP_ADD : OP_SUB);
+                emitConvert(typeOfVariable(name));
+                emit(OP_DUP);
+                emitStore(name);
+            }
+            break;
+        default:
+            error(string("unsupported unary operator ") + TokenKindName(unary->op));
+        }
+    }
+    void visitPostfix(const PostfixExpr* post)
+    {
+        // x++: the old value is the result
+        SymbolId name = variableOperand(post->base);
+        emitLoad(name);
+        emit(OP_DUP);
+        emitConst(Value::Int(1));
+        emit(post->op == T_INC ? OP_ADD : OP_SUB);
+        emitConvert(typeOfVariable(name));
+        emitStore(name);
+    }
+    SymbolId variableOperand(const Expr* e)
+    {
+        auto id = nodeCast<IdentifierExpr>(e);
+        if (!id)
+            error("++ and -- need a variable");
+        return id->name;
+    }
+
+    void visitBinary(const BinaryExpr* binary)
+    {
+        switch (binary->op)
+        {
+        case T_ASSIGN:
+            {
+                SymbolId name = variableOperand(binary->left);
+                compileExpr(binary->right);
+                emitConvert(typeOfVariable(name));
+                emit(OP_DUP);
+                emitStore(name);
+            }
+            return;
+        case T_AND:
+        case T_OR:
+            {
+                // short circuit: the right side only runs when it decides the result
+                compileExpr(binary->left);
+                if (binary->op == T_OR)
+                    emit(OP_NOT);
+                size_t toShort = emit(OP_JUMP_IF_FALSE, 0);
+                compileExpr(binary->right);
+                emit(OP_TO_BOOL);
+                size_t toEnd = emit(OP_JUMP, 0);
+                depth--;    // the two paths meet with one value
+                patch(toShort, here());
+                emitConst(Value::Bool(binary->op == T_OR));
+                patch(toEnd, here());
+            }
+            return;
+        default:
+            break;
+        }
+
+        OpCode op;
+        switch (binary->op)
+        {
+        case T_PLUS: op = OP_ADD; break;
+        case T_MINUS: op = OP_SUB; break;
+        case T_MULT: op = OP_MUL; break;
+        case T_DIV: op = OP_DIV; break;
+        case T_MOD: op = OP_MOD; break;
+        case T_EQ: op = OP_EQ; break;
+        case T_NEQ: op = OP_NE; break;
+        case T_LT: op = OP_LT; break;
+        case T_GT: op = OP_GT; break;
+        case T_LEQ: op = OP_LE; break;
+        case T_GEQ: op = OP_GE; break;
+        default:
+            error(string("unsupported binary operator ") + TokenKindName(binary->op));
+        }
+        compileExpr(binary->left);
+        compileExpr(binary->right);
+        emit(op);
+    }
+
+    void visitCall(const CallExpr* call)
+    {
+        auto calleeId = nodeCast<IdentifierExpr>(call->callee);
+        if (!calleeId)
+            error("only named functions can be called");
+        if (findLocal(calleeId->name) || globalIndex.count(calleeId->name))
+            error("called object is not a function", calleeId->name);
+        auto it = functionIndex.find(calleeId->name);
+        if (it == functionIndex.end())
+            error("undefined function", calleeId->name);
+        const FunctionCode& callee = module.functions[it->second];
+        if ((int)call->args.size() != callee.arity)
+            error("wrong number of arguments to", calleeId->name);
+
+        for (size_t i = 0; i < call->args.size(); i++)
+        {
+            compileExpr(call->args[i]);
+            emitConvert(paramTypes[it->second][i]);
+        }
+        emit(OP_CALL, it->second);
+    }
+};
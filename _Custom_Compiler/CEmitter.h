@@ -0,0 +1,686 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <unordered_map>
+#include <stdexcept>
+#include "Parser2.h"
+#include "ScopeStack.h"
+#include "TypeChecker.h"
+
+using namespace std;
+
+// Translates a type-checked Program into one C99 translation unit, for the
+// system C compiler.
+//
+// Every FuncDecl becomes a C function and every global VarDeclStmt a C global.
+// The globals are initialized in source order by cc_init(), before main runs.
+// The generated main calls the program's main and prints
+// "main returned <value>", as --run does. A run-time error prints
+// "Exception: [RuntimeError] ..." to stderr and exits with status 0, as the
+// driver does.
+//
+// Types map to int64_t (int and char), double (float and double), bool, and
+// const char* (string); Expr::type picks every operation. The code keeps the
+// VMs' semantics, not C's:
+// - int arithmetic wraps; / and % check for zero and for -1;
+// - a float converts to int only when in range;
+// - strings built by + are never freed;
+// - a call deeper than 1 << 16 frames is a stack overflow.
+// C leaves the order of operand and argument evaluation unspecified. Where
+// that could be seen (an operand with side effects), the operands are
+// evaluated left to right into temporaries with the comma operator.
+//
+// Source names are prefixed: f_ for functions, g_ for globals and v_ for
+// locals. The Inliner's names (base$n, n unique) become tn_base. A local name
+// declared again in the same function, shadowing or not, gets a C name of its
+// own, s<k>_name for its k-th declaration, so that an initializer that reads
+// the outer variable (int x = x * 6;) still reads it in C.
+class CEmitter
+{
+    const Program* program;
+    unordered_map<SymbolId, const FuncDecl*> functions;
+    ScopeStack scopes;                          // Symbol::slot numbers the declarations of a name
+    unordered_map<SymbolId, int> declarations;  // of each local name in the function so far
+    unordered_map<const VarDeclStmt*, int> branchVariables;
+    // the function being emitted
+    ostringstream body;
+    int indent = 0;
+    vector<TypeKind> temps;     // types of cc_t0, cc_t1, ...
+    TypeKind retType = TY_VOID;
+
+    explicit CEmitter(const Program* program) : program(program) {}
+
+public:
+    // The C source of program, which must have been through TypeChecker::Check.
+    static string Emit(const Program* program)
+    {
+        CEmitter c(program);
+        return c.emitProgram();
+    }
+
+private:
+    [[noreturn]] static void error(const string& message)
+    {
+        throw runtime_error("[CompileError] " + message);
+    }
+
+    static const char* prelude()
+    {
+        return
+            "#include <stdint.h>\n"
+            "#include <inttypes.h>\n"
+            "#include <stdbool.h>\n"
+            "#include <stdio.h>\n"
+            "#include <stdlib.h>\n"
+            "#include <string.h>\n"
+            "#include <math.h>\n"
+            "\n"
+            "#define CC_MAX_DEPTH (1 << 16)\n"
+            "static int cc_depth;\n"
+            "\n"
+            "static void cc_error(const char* message)\n"
+            "{\n"
+            "    fflush(stdout);\n"
+            "    fprintf(stderr, \"Exception: [RuntimeError] %s\\n\", message);\n"
+            "    exit(0);\n"
+            "}\n"
+            "\n"
+            "static inline int64_t cc_add(int64_t x, int64_t y) { return (int64_t)((uint64_t)x + (uint64_t)y); }\n"
+            "static inline int64_t cc_sub(int64_t x, int64_t y) { return (int64_t)((uint64_t)x - (uint64_t)y); }\n"
+            "static inline int64_t cc_mul(int64_t x, int64_t y) { return (int64_t)((uint64_t)x * (uint64_t)y); }\n"
+            "static inline int64_t cc_neg(int64_t x) { return (int64_t)(0 - (uint64_t)x); }\n"
+            "static inline int64_t cc_div(int64_t x, int64_t y)\n"
+            "{\n"
+            "    if (y == 0)\n"
+            "        cc_error(\"division by zero\");\n"
+            "    return y == -1 ? cc_neg(x) : x / y;\n"
+            "}\n"
+            "static inline int64_t cc_mod(int64_t x, int64_t y)\n"
+            "{\n"
+            "    if (y == 0)\n"
+            "        cc_error(\"division by zero\");\n"
+            "    return y == -1 ? 0 : x % y;\n"
+            "}\n"
+            "static inline int64_t cc_to_int(double x)\n"
+            "{\n"
+            "    if (!(x > -9.2e18 && x < 9.2e18))\n"
+            "        cc_error(\"float value out of range for int\");\n"
+            "    return (int64_t)x;\n"
+            "}\n"
+            "static inline const char* cc_concat(const char* a, const char* b)\n"
+            "{\n"
+            "    size_t n = strlen(a), m = strlen(b);\n"
+            "    char* s = (char*)malloc(n + m + 1);\n"
+            "    if (!s)\n"
+            "        cc_error(\"out of memory\");\n"
+            "    memcpy(s, a, n);\n"
+            "    memcpy(s + n, b, m + 1);\n"
+            "    return s;\n"
+            "}\n"
+            "\n"
+            "/* ++ and -- store the converted result, as every store does */\n"
+            "#define CC_STEP(name, T, next) \\\n"
+            "    static inline T cc_pre##name(T* p) { *p = next; return *p; } \\\n"
+            "    static inline T cc_post##name(T* p) { T old = *p; *p = next; return old; }\n"
+            "CC_STEP(inc_i, int64_t, cc_add(*p, 1))\n"
+            "CC_STEP(dec_i, int64_t, cc_sub(*p, 1))\n"
+            "CC_STEP(inc_f, double, *p + 1)\n"
+            "CC_STEP(dec_f, double, *p - 1)\n"
+            "CC_STEP(inc_b, bool, (int64_t)*p + 1 != 0)\n"
+            "CC_STEP(dec_b, bool, (int64_t)*p - 1 != 0)\n";
+    }
+
+    static bool isFloat(TypeKind t)
+    {
+        return t == TY_FLOAT || t == TY_DOUBLE;
+    }
+
+    static const char* ctype(TypeKind t)
+    {
+        switch (t)
+        {
+        case TY_INT: case TY_CHAR: return "int64_t";
+        case TY_FLOAT: case TY_DOUBLE: return "double";
+        case TY_BOOL: return "bool";
+        case TY_STRING: return "const char*";
+        default: return "void";
+        }
+    }
+
+    static const char* zero(TypeKind t)
+    {
+        switch (t)
+        {
+        case TY_FLOAT: case TY_DOUBLE: return "0.0";
+        case TY_BOOL: return "false";
+        case TY_STRING: return "\"\"";
+        default: return "0";
+        }
+    }
+
+    // name with its prefix; the Inliner's base$...$n becomes tn_base
+    static string mangle(SymbolId id, const char* prefix)
+    {
+        string name(SymbolName(id));
+        size_t first = name.find('$');
+        if (first == string::npos)
+            return prefix + name;
+        return "t" + name.substr(name.rfind('$') + 1) + "_" + name.substr(0, first);
+    }
+
+    // C name of the k-th declaration of a local in its function
+    static string localName(SymbolId id, int k)
+    {
+        return k ? "s" + to_string(k) + "_" + mangle(id, "") : mangle(id, "v_");
+    }
+
+    string nameOf(SymbolId id)
+    {
+        const Symbol* local = scopes.lookup(id);
+        return local ? localName(id, local->slot) : mangle(id, "g_");
+    }
+
+    // numbers a new declaration of name, which is not visible yet
+    int newLocal(SymbolId name)
+    {
+        return declarations[name]++;
+    }
+
+    // makes the k-th declaration of name visible and returns its C name
+    string declareLocal(SymbolId name, TokenKind typeTok, int k)
+    {
+        scopes.declareSym(Symbol(name, typeTok, false, k));
+        return localName(name, k);
+    }
+
+    ostream& line()
+    {
+        return body << string(indent * 4, ' ');
+    }
+
+    // ---- program ----
+
+    string emitProgram()
+    {
+        ostringstream out;
+        out << "/* generated from the source program; compile with a C99 compiler */\n" << prelude() << "\n";
+
+        vector<const FuncDecl*> funcs;
+        vector<const VarDeclStmt*> globals;
+        for (ASTPtr item : program->globalItems)
+        {
+            if (auto func = nodeCast<FuncDecl>(item))
+            {
+                functions[func->name] = func;
+                funcs.push_back(func);
+            }
+            else if (auto var = nodeCast<VarDeclStmt>(item))
+                globals.push_back(var);
+        }
+
+        for (const VarDeclStmt* var : globals)
+        {
+            TypeKind t = TypeChecker::TypeOf(var->typeTok);
+            out << "static " << ctype(t) << " " << mangle(var->name, "g_") << " = " << zero(t) << ";\n";
+        }
+        if (!globals.empty())
+            out << "\n";
+        for (const FuncDecl* func : funcs)
+            out << signature(func) << ";\n";
+        out << "\n";
+
+        for (const FuncDecl* func : funcs)
+            out << emitFunction(func) << "\n";
+        out << emitInit(globals) << "\n" << emitMain();
+        return out.str();
+    }
+
+    string signature(const FuncDecl* func)
+    {
+        string s = string("static ") + ctype(TypeChecker::TypeOf(func->retType)) + " " + mangle(func->name, "f_") + "(";
+        for (size_t i = 0; i < func->params.size(); i++)
+            s += (i ? ", " : "") + string(ctype(TypeChecker::TypeOf(func->params[i].typeTok))) + " " + localName(func->params[i].name, 0);
+        return s + (func->params.empty() ? "void)" : ")");
+    }
+
+    void beginBody()
+    {
+        body.str("");
+        temps.clear();
+        declarations.clear();
+        branchVariables.clear();
+        indent = 1;
+    }
+
+    // the body emitted since beginBody, with its temporaries declared first
+    string endBody(const string& header)
+    {
+        ostringstream o;
+        o << header << "\n{\n";
+        for (size_t i = 0; i < temps.size(); i++)
+            o << "    " << ctype(temps[i]) << " cc_t" << i << ";\n";
+        o << body.str() << "}\n";
+        return o.str();
+    }
+
+    string emitFunction(const FuncDecl* func)
+    {
+        retType = TypeChecker::TypeOf(func->retType);
+        beginBody();
+        scopes = ScopeStack();
+        // parameters share the scope of the outermost block of the body
+        scopes.pushScope();
+        for (const Param& p : func->params)
+            declareLocal(p.name, p.typeTok, newLocal(p.name));
+        line() << "if (++cc_depth > CC_MAX_DEPTH)\n";
+        line() << "    cc_error(\"stack overflow\");\n";
+        if (func->body)
+            for (const Stmt* stmt : func->body->stmts)
+                emitStmt(stmt);
+        // falling off the end returns the zero of the return type
+        line() << "cc_depth--;\n";
+        if (retType != TY_VOID)
+            line() << "return " << zero(retType) << ";\n";
+        scopes.popScope();
+        return endBody(signature(func));
+    }
+
+    string emitInit(const vector<const VarDeclStmt*>& globals)
+    {
+        beginBody();
+        scopes = ScopeStack();
+        for (const VarDeclStmt* var : globals)
+            if (var->init)
+                line() << mangle(var->name, "g_") << " = " << converted(var->init, TypeChecker::TypeOf(var->typeTok)) << ";\n";
+        return endBody("static void cc_init(void)");
+    }
+
+    string emitMain()
+    {
+        ostringstream o;
+        o << "int main(void)\n{\n    cc_init();\n";
+        auto it = functions.find(Intern("main"));
+        if (it == functions.end())
+            o << "    cc_error(\"no function named main\");\n    return 0;\n";
+        else if (!it->second->params.empty())
+            o << "    cc_error(\"wrong number of arguments to main\");\n    return 0;\n";
+        else
+        {
+            TypeKind t = TypeChecker::TypeOf(it->second->retType);
+            if (t == TY_VOID)
+                o << "    f_main();\n    printf(\"main returned void\\n\");\n    return 0;\n";
+            else
+            {
+                o << "    " << ctype(t) << " r = f_main();\n";
+                switch (t)
+                {
+                case TY_INT: o << "    printf(\"main returned %\" PRId64 \"\\n\", r);\n    return (int)r;\n"; break;
+                case TY_FLOAT: case TY_DOUBLE: o << "    printf(\"main returned %g\\n\", r);\n    return 0;\n"; break;
+                case TY_BOOL: o << "    printf(\"main returned %s\\n\", r ? \"true\" : \"false\");\n    return 0;\n"; break;
+                default: o << "    printf(\"main returned %s\\n\", r);\n    return 0;\n"; break;
+                }
+            }
+        }
+        o << "}\n";
+        return o.str();
+    }
+
+    // ---- statements ----
+
+    void emitStmt(const Stmt* stmt)
+    {
+        if (!stmt)
+            return;
+        switch (stmt->kind)
+        {
+        case NK_EXPR_STMT:
+        {
+            auto es = static_cast<const ExprStmt*>(stmt);
+            if (es->expr)
+                line() << "(void)" << expr(es->expr) << ";\n";
+            break;
+        }
+        case NK_RETURN:
+        {
+            // the depth is restored after the value is computed
+            auto rs = static_cast<const ReturnStmt*>(stmt);
+            if (retType == TY_VOID)
+                line() << "{ (void)" << expr(rs->expr) << "; cc_depth--; return; }\n";
+            else
+                line() << "{ " << ctype(retType) << " cc_r = " << converted(rs->expr, retType) << "; cc_depth--; return cc_r; }\n";
+            break;
+        }
+        case NK_VAR_DECL:
+        {
+            // the initializer does not see the variable it initializes
+            auto vd = static_cast<const VarDeclStmt*>(stmt);
+            TypeKind t = TypeChecker::TypeOf(vd->typeTok);
+            string init = vd->init ? converted(vd->init, t) : zero(t);
+            string name = declareLocal(vd->name, vd->typeTok, newLocal(vd->name));
+            line() << ctype(t) << " " << name << " = " << init << ";\n";
+            break;
+        }
+        case NK_IF:
+        {
+            auto ifs = static_cast<const IfStmt*>(stmt);
+            declareBranchVariable(ifs->thenStmt);
+            declareBranchVariable(ifs->elseStmt);
+            line() << "if (" << expr(ifs->cond) << ")\n";
+            emitBody(ifs->thenStmt);
+            if (ifs->elseStmt)
+            {
+                line() << "else\n";
+                emitBody(ifs->elseStmt);
+            }
+            break;
+        }
+        case NK_WHILE:
+        {
+            auto ws = static_cast<const WhileStmt*>(stmt);
+            declareBranchVariable(ws->body);
+            line() << "while (" << expr(ws->cond) << ")\n";
+            emitBody(ws->body);
+            break;
+        }
+        case NK_FOR:
+        {
+            // a variable declared in the init clause lives until the end of the loop
+            auto fs = static_cast<const ForStmt*>(stmt);
+            scopes.pushScope();
+            line() << "{\n";
+            indent++;
+            emitStmt(fs->init);
+            auto cond = nodeCast<ExprStmt>(fs->condStmt);
+            declareBranchVariable(fs->body);
+            string iter = fs->iterExpr ? "(void)" + expr(fs->iterExpr) : "";
+            line() << "for (; " << (cond && cond->expr ? expr(cond->expr) : "") << "; " << iter << ")\n";
+            emitBody(fs->body);
+            indent--;
+            line() << "}\n";
+            scopes.popScope();
+            break;
+        }
+        case NK_BLOCK:
+            scopes.pushScope();
+            line() << "{\n";
+            indent++;
+            for (const Stmt* s : static_cast<const BlockStmt*>(stmt)->stmts)
+                emitStmt(s);
+            indent--;
+            line() << "}\n";
+            scopes.popScope();
+            break;
+        default:
+            error("construct not supported by the C emitter");
+        }
+    }
+
+    // A declaration that is a whole branch or loop body belongs to the
+    // enclosing scope; C needs it declared there, and assigned in the body.
+    // It only becomes visible in the body, after its initializer.
+    void declareBranchVariable(const Stmt* body)
+    {
+        auto vd = nodeCast<VarDeclStmt>(body);
+        if (!vd)
+            return;
+        TypeKind t = TypeChecker::TypeOf(vd->typeTok);
+        int k = newLocal(vd->name);
+        branchVariables[vd] = k;
+        line() << ctype(t) << " " << localName(vd->name, k) << " = " << zero(t) << ";\n";
+    }
+
+    void emitBody(const Stmt* body)
+    {
+        if (auto vd = nodeCast<VarDeclStmt>(body))
+        {
+            TypeKind t = TypeChecker::TypeOf(vd->typeTok);
+            string init = vd->init ? converted(vd->init, t) : zero(t);
+            string name = declareLocal(vd->name, vd->typeTok, branchVariables[vd]);
+            line() << "    " << name << " = " << init << ";\n";
+            return;
+        }
+        if (body->kind == NK_BLOCK)
+        {
+            emitStmt(body);
+            return;
+        }
+        line() << "{\n";
+        indent++;
+        emitStmt(body);
+        indent--;
+        line() << "}\n";
+    }
+
+    // ---- expressions ----
+
+    static bool hasEffects(const Expr* e)
+    {
+        switch (e->kind)
+        {
+        case NK_CALL:
+        case NK_POSTFIX:
+            return true;
+        case NK_UNARY:
+        {
+            auto u = static_cast<const UnaryExpr*>(e);
+            return u->op == T_INC || u->op == T_DEC || hasEffects(u->rhs);
+        }
+        case NK_BINARY:
+        {
+            auto b = static_cast<const BinaryExpr*>(e);
+            return b->op == T_ASSIGN || hasEffects(b->left) || hasEffects(b->right);
+        }
+        default:
+            return false;
+        }
+    }
+
+    int newTemp(TypeKind t)
+    {
+        temps.push_back(t);
+        return (int)temps.size() - 1;
+    }
+
+    // code for the value of e converted to type to, as a store converts it
+    string converted(const Expr* e, TypeKind to)
+    {
+        return convert(expr(e), e->type, to);
+    }
+
+    static string convert(const string& code, TypeKind from, TypeKind to)
+    {
+        if (valueTypeOf(from) == valueTypeOf(to))
+            return code;
+        switch (to)
+        {
+        case TY_INT: return isFloat(from) ? "cc_to_int(" + code + ")" : "((int64_t)" + code + ")";
+        case TY_FLOAT: case TY_DOUBLE: return "((double)" + code + ")";
+        case TY_BOOL: return "(" + code + " != 0)";
+        default: return code;
+        }
+    }
+
+    static string intLiteral(int64_t v)
+    {
+        if (v == INT64_MIN)
+            return "INT64_MIN";
+        return "INT64_C(" + to_string(v) + ")";
+    }
+
+    static string floatLiteral(double v)
+    {
+        if (std::isnan(v))
+            return "NAN";
+        if (std::isinf(v))
+            return v < 0 ? "(-HUGE_VAL)" : "HUGE_VAL";
+        ostringstream o;
+        o << setprecision(17) << v;
+        string s = o.str();
+        if (s.find_first_of(".e") == string::npos)
+            s += ".0";
+        return v < 0 || (v == 0 && signbit(v)) ? "(" + s + ")" : s;
+    }
+
+    static string stringLiteral(const string& text)
+    {
+        ostringstream o;
+        o << '"';
+        for (unsigned char c : text)
+        {
+            switch (c)
+            {
+            case '\n': o << "\\n"; break;
+            case '\t': o << "\\t"; break;
+            case '\r': o << "\\r"; break;
+            case '"': o << "\\\""; break;
+            case '\\': o << "\\\\"; break;
+            case '?': o << "\\?"; break;    // no trigraphs
+            default:
+                if (c < 32 || c >= 127)
+                    o << '\\' << oct << setw(3) << setfill('0') << (int)c << dec;
+                else
+                    o << c;
+            }
+        }
+        o << '"';
+        return o.str();
+    }
+
+    string expr(const Expr* e)
+    {
+        if (e->type == TY_UNKNOWN)
+            error("the C emitter needs a type-checked program");
+        switch (e->kind)
+        {
+        case NK_INT_LITERAL:
+        {
+            auto lit = static_cast<const IntLiteral*>(e);
+            if (!lit->inRange)
+                error("integer literal out of range: " + lit->val);
+            return intLiteral(lit->value);
+        }
+        case NK_CHAR_LITERAL: return intLiteral(static_cast<const CharLiteral*>(e)->value);
+        case NK_FLOAT_LITERAL: return floatLiteral(static_cast<const FloatLiteral*>(e)->value);
+        case NK_BOOL_LITERAL: return static_cast<const BoolLiteral*>(e)->value ? "true" : "false";
+        case NK_STRING_LITERAL: return stringLiteral(static_cast<const StringLiteral*>(e)->text);
+        case NK_IDENTIFIER: return nameOf(static_cast<const IdentifierExpr*>(e)->name);
+        case NK_UNARY:
+        {
+            auto u = static_cast<const UnaryExpr*>(e);
+            if (u->op == T_INC || u->op == T_DEC)
+                return step(u->rhs, u->op == T_INC ? "cc_preinc" : "cc_predec");
+            string operand = expr(u->rhs);
+            switch (u->op)
+            {
+            case T_NOT: return "(!" + operand + ")";
+            case T_MINUS: return isFloat(u->rhs->type) ? "(-" + operand + ")" : "cc_neg(" + operand + ")";
+            default: return operand;
+            }
+        }
+        case NK_POSTFIX:
+        {
+            auto p = static_cast<const PostfixExpr*>(e);
+            return step(p->base, p->op == T_INC ? "cc_postinc" : "cc_postdec");
+        }
+        case NK_BINARY:
+            return binary(static_cast<const BinaryExpr*>(e));
+        case NK_CALL:
+            return call(static_cast<const CallExpr*>(e));
+        default:
+            error("construct not supported by the C emitter");
+        }
+    }
+
+    string step(const Expr* variable, const char* helper)
+    {
+        TypeKind t = variable->type;
+        const char* suffix = isFloat(t) ? "_f(&" : t == TY_BOOL ? "_b(&" : "_i(&";
+        return helper + string(suffix) + expr(variable) + ")";
+    }
+
+    string binary(const BinaryExpr* b)
+    {
+        if (b->op == T_ASSIGN)
+            return "(" + expr(b->left) + " = " + converted(b->right, b->left->type) + ")";
+        if (b->op == T_AND || b->op == T_OR)
+            return "(" + expr(b->left) + (b->op == T_AND ? " && " : " || ") + expr(b->right) + ")";
+
+        TypeKind lt = b->left->type, rt = b->right->type;
+        string l = expr(b->left), r = expr(b->right), prefix;
+        if (hasEffects(b->left) || hasEffects(b->right))
+        {
+            int tl = newTemp(lt), tr = newTemp(rt);
+            prefix = "cc_t" + to_string(tl) + " = " + l + ", cc_t" + to_string(tr) + " = " + r + ", ";
+            l = "cc_t" + to_string(tl);
+            r = "cc_t" + to_string(tr);
+        }
+
+        string code;
+        const char* cmp = nullptr;
+        switch (b->op)
+        {
+        case T_EQ: cmp = "=="; break;
+        case T_NEQ: cmp = "!="; break;
+        case T_LT: cmp = "<"; break;
+        case T_GT: cmp = ">"; break;
+        case T_LEQ: cmp = "<="; break;
+        case T_GEQ: cmp = ">="; break;
+        default: break;
+        }
+        if (cmp)
+        {
+            if (lt == TY_STRING)
+                code = "strcmp(" + l + ", " + r + ") " + cmp + " 0";
+            else if (isFloat(lt) || isFloat(rt))
+                code = "(double)" + l + " " + cmp + " (double)" + r;
+            else
+                code = "(int64_t)" + l + " " + cmp + " (int64_t)" + r;
+        }
+        else if (b->type == TY_STRING)
+            code = "cc_concat(" + l + ", " + r + ")";
+        else if (isFloat(b->type))
+        {
+            const char* op = b->op == T_PLUS ? " + " : b->op == T_MINUS ? " - " : b->op == T_MULT ? " * " : " / ";
+            code = b->op == T_MOD ? "fmod(" + l + ", " + r + ")" : "(double)" + l + op + "(double)" + r;
+        }
+        else
+        {
+            const char* helper = b->op == T_PLUS ? "cc_add(" : b->op == T_MINUS ? "cc_sub(" : b->op == T_MULT ? "cc_mul("
+                : b->op == T_DIV ? "cc_div(" : "cc_mod(";
+            code = helper + l + ", " + r + ")";
+        }
+        return "(" + prefix + code + ")";
+    }
+
+    string call(const CallExpr* c)
+    {
+        SymbolId name = static_cast<const IdentifierExpr*>(c->callee)->name;
+        const FuncDecl* func = functions.at(name);
+        vector<string> args;
+        size_t effects = 0;
+        for (size_t i = 0; i < c->args.size(); i++)
+        {
+            args.push_back(converted(c->args[i], TypeChecker::TypeOf(func->params[i].typeTok)));
+            effects += hasEffects(c->args[i]);
+        }
+        // each argument is converted before the next is evaluated
+        string prefix;
+        if (effects > 0 && args.size() > 1)
+        {
+            for (size_t i = 0; i < args.size(); i++)
+            {
+                int t = newTemp(TypeChecker::TypeOf(func->params[i].typeTok));
+                prefix += "cc_t" + to_string(t) + " = " + args[i] + ", ";
+                args[i] = "cc_t" + to_string(t);
+            }
+        }
+        string code = mangle(name, "f_") + "(";
+        for (size_t i = 0; i < args.size(); i++)
+            code += (i ? ", " : "") + args[i];
+        code += ")";
+        return prefix.empty() ? code : "(" + prefix + code + ")";
+    }
+};
@@ -0,0 +1,175 @@
+// Regression tests of the C backend. Every program runs on the register VM
+// and as C built by the system's C compiler, with and without the AST
+// optimizations, and each run must print the expected result.
+//
+// A separate program with its own main, like Benchmark.cpp, so it is not part
+// of the compiler's build. Build it from the other sources without Source.cpp,
+// main.cpp and Benchmark.cpp:
+//     g++ -std=c++17 -O2 -pthread -o cemitter_test CEmitterTest.cpp Bytecode.cpp DFA.cpp Parser.cpp
+//         RegisterVM.cpp SimdScan.cpp SourceBuffer.cpp SsaIR.cpp StackVM.cpp StringInterner.cpp
+//         Without_regex_Lexer.cpp X64Asm.cpp X64Jit.cpp with_regex_Lexer.cpp
+// The C compiler is cc, or the command in the CC environment variable.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include "Parser2.h"
+#include "TypeChecker.h"
+#include "Inliner.h"
+#include "ConstantFolder.h"
+#include "DeadCodeEliminator.h"
+#include "RegisterCompiler.h"
+#include "RegisterVM.h"
+#include "CEmitter.h"
+
+#ifdef _MSC_VER
+#define popen _popen
+#define pclose _pclose
+#endif
+
+using namespace std;
+
+struct TestCase
+{
+    const char* name;
+    const char* source;
+    const char* expected;       // what the program prints
+};
+
+static const TestCase cases[] = {
+    // a local shadows another one and its initializer reads the outer one
+    { "shadowing initializer",
+      "int main()\n"
+      "{\n"
+      "    int x = 10;\n"
+      "    {\n"
+      "        int x = x * 6;\n"
+      "        return x;\n"
+      "    }\n"
+      "}\n",
+      "main returned 60" },
+    { "shadowing parameter",
+      "int f(int a)\n"
+      "{\n"
+      "    {\n"
+      "        int a = a + 1;\n"
+      "        return a;\n"
+      "    }\n"
+      "}\n"
+      "int main() { return f(4); }\n",
+      "main returned 5" },
+    { "shadowing for variable",
+      "int main()\n"
+      "{\n"
+      "    int i = 4;\n"
+      "    int s = 0;\n"
+      "    for (int i = i * 2; i < 12; i++)\n"
+      "    {\n"
+      "        s = s + i;\n"
+      "    }\n"
+      "    return s + i;\n"
+      "}\n",
+      "main returned 42" },
+    // a declaration that is a whole branch, and the same name again in a sibling block
+    { "shadowing branch variable",
+      "int main()\n"
+      "{\n"
+      "    int x = 10;\n"
+      "    int r = 0;\n"
+      "    {\n"
+      "        if (x > 5) int x = x * 6;\n"
+      "        r = x;\n"
+      "    }\n"
+      "    {\n"
+      "        int x = 1;\n"
+      "        r = r + x;\n"
+      "    }\n"
+      "    return r;\n"
+      "}\n",
+      "main returned 61" },
+};
+
+static string WriteFile(const filesystem::path& path, const string& text)
+{
+    ofstream f(path, ios::binary);
+    f << text;
+    if (!f)
+        throw runtime_error("[Test] cannot write " + path.string());
+    return path.string();
+}
+
+// the first line the command prints
+static string Run(const string& command)
+{
+    FILE* p = popen(command.c_str(), "r");
+    if (!p)
+        throw runtime_error("[Test] cannot run " + command);
+    string out;
+    char buffer[256];
+    while (fgets(buffer, sizeof buffer, p))
+        out += buffer;
+    pclose(p);
+    return out.substr(0, out.find('\n'));
+}
+
+static shared_ptr<Program> Prepare(const string& file, bool optimize)
+{
+    Parser parser(file);
+    shared_ptr<Program> program = parser.parseProgram();
+    TypeChecker::Check(program.get());
+    if (optimize)
+    {
+        Inliner::Run(program.get());
+        ConstantFolder::Run(program.get());
+        DeadCodeEliminator::Run(program.get());
+        TypeChecker::Check(program.get());
+    }
+    return program;
+}
+
+static string RunOnVM(const string& file, bool optimize)
+{
+    shared_ptr<Program> program = Prepare(file, optimize);
+    RegisterModule module = RegisterCompiler::Compile(program.get());
+    RegisterVM vm(module);
+    return "main returned " + ValueToString(vm.Call("main"));
+}
+
+static string RunAsC(const string& file, bool optimize, const filesystem::path& dir)
+{
+    string c = WriteFile(dir / "cemitter_test.c", CEmitter::Emit(Prepare(file, optimize).get()));
+    string exe = (dir / "cemitter_test.out").string();
+    const char* cc = getenv("CC");
+    string build = string(cc ? cc : "cc") + " -std=c99 -O1 -w -o \"" + exe + "\" \"" + c + "\" -lm";
+    if (system(build.c_str()) != 0)
+        return "C compiler failed: " + build;
+    return Run("\"" + exe + "\"");
+}
+
+int main()
+{
+    filesystem::path dir = filesystem::temp_directory_path();
+    int failed = 0;
+    for (const TestCase& t : cases)
+    {
+        string file = WriteFile(dir / "cemitter_test.txt", t.source);
+        for (bool optimize : { false, true })
+        {
+            string vm = RunOnVM(file, optimize);
+            string c = RunAsC(file, optimize, dir);
+            bool ok = vm == t.expected && c == t.expected;
+            if (!ok)
+                failed++;
+            cout << (ok ? "ok     " : "FAILED ") << t.name << (optimize ? " (optimized)" : "");
+            if (!ok)
+                cout << ": expected \"" << t.expected << "\", the VM printed \"" << vm << "\", C printed \"" << c << "\"";
+            cout << "\n";
+        }
+    }
+    for (const char* f : { "cemitter_test.txt", "cemitter_test.c", "cemitter_test.out" })
+        filesystem::remove(dir / f);
+    cout << (failed ? to_string(failed) + " failed\n" : "all passed\n");
+    return failed ? 1 : 0;
+}
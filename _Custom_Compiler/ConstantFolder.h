@@ -0,0 +1,463 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <stdexcept>
+#include "Parser2.h"
+#include "ScopeStack.h"
+#include "BytecodeCompiler.h"
+
+using namespace std;
+
+// Folds constant int, float, bool and char subexpressions of a Program in
+// place, and propagates the values of locals that hold a known constant
+// (int y = 1; z = z + y; becomes z = z + 1;).
+//
+// Values are computed with the VMs' own Arith, Compare and Convert, so a folded
+// expression has exactly the value and type the VM would have produced. An
+// operation that would fail at run time (division by zero, a bad operand) is
+// left alone to fail there.
+//
+// Propagation follows the statements of a function in order. Where control
+// flow joins, only the values the paths agree on are kept. A loop first forgets
+// every variable assigned anywhere inside it. Globals are never propagated,
+// since any call may change them.
+class ConstantFolder
+{
+    Program* program;
+    ScopeStack scopes;                  // Symbol::slot numbers each local
+    vector<SymbolId> localNames;        // by number
+    vector<ValueType> localTypes;
+    unordered_map<int, Value> known;    // locals whose current value is a constant
+    size_t folded = 0;
+
+    explicit ConstantFolder(Program* program) : program(program) {}
+
+public:
+    // Rewrites the functions and global initializers of program; returns the
+    // number of expressions replaced by a literal.
+    static size_t Run(Program* program)
+    {
+        ConstantFolder f(program);
+        for (ASTPtr item : program->globalItems)
+        {
+            if (auto func = nodeCast<FuncDecl>(item))
+                f.foldFunction(func);
+            else if (auto var = nodeCast<VarDeclStmt>(item))
+            {
+                if (var->init)
+                    f.fold(var->init);
+            }
+        }
+        return f.folded;
+    }
+
+    // the value of e if it is an int, float, bool or char literal
+    static bool ConstantOf(const Expr* e, Value& v)
+    {
+        switch (e->kind)
+        {
+        case NK_INT_LITERAL:
+        {
+            auto lit = static_cast<const IntLiteral*>(e);
+            v = Value::Int(lit->value);
+            return lit->inRange;
+        }
+        case NK_CHAR_LITERAL: v = Value::Int(static_cast<const CharLiteral*>(e)->value); return true;
+        case NK_FLOAT_LITERAL: v = Value::Float(static_cast<const FloatLiteral*>(e)->value); return true;
+        case NK_BOOL_LITERAL: v = Value::Bool(static_cast<const BoolLiteral*>(e)->value); return true;
+        default: return false;
+        }
+    }
+
+private:
+    void foldFunction(FuncDecl* func)
+    {
+        scopes = ScopeStack();
+        localNames.clear();
+        localTypes.clear();
+        known.clear();
+        // parameters share the scope of the outermost block of the body
+        scopes.pushScope();
+        for (const Param& p : func->params)
+            declare(p.name, p.typeTok);
+        if (func->body)
+            for (StmtPtr stmt : func->body->stmts)
+                foldStmt(stmt);
+        scopes.popScope();
+    }
+
+    int declare(SymbolId name, TokenKind typeTok)
+    {
+        int id = (int)localNames.size();
+        localNames.push_back(name);
+        localTypes.push_back(valueTypeOf(typeTok));
+        scopes.declareSym(Symbol(name, typeTok, false, id));
+        return id;
+    }
+
+    // number of the local name refers to here, -1 for a global
+    int localOf(SymbolId name)
+    {
+        const Symbol* s = scopes.lookup(name);
+        return s ? s->slot : -1;
+    }
+
+    // records that local id now holds v, converted as a store would
+    void setKnown(int id, const Value* v)
+    {
+        known.erase(id);
+        ValueType type = localTypes[id];
+        if (!v || (type != V_INT && type != V_FLOAT && type != V_BOOL))
+            return;
+        try
+        {
+            known[id] = Convert(type, *v);
+        }
+        catch (const runtime_error&)
+        {
+            // the store fails at run time
+        }
+    }
+
+    static bool sameValue(const Value& a, const Value& b)
+    {
+        if (a.type != b.type)
+            return false;
+        switch (a.type)
+        {
+        case V_INT: return a.i == b.i;
+        case V_FLOAT: return memcmp(&a.f, &b.f, sizeof a.f) == 0;
+        case V_BOOL: return a.b == b.b;
+        default: return false;
+        }
+    }
+
+    // what is still known after either of two paths: the values they agree on
+    static unordered_map<int, Value> merge(const unordered_map<int, Value>& a, const unordered_map<int, Value>& b)
+    {
+        unordered_map<int, Value> both;
+        for (auto& entry : a)
+        {
+            auto it = b.find(entry.first);
+            if (it != b.end() && sameValue(entry.second, it->second))
+                both.insert(entry);
+        }
+        return both;
+    }
+
+    // forgets every local (in any scope) named in names
+    void forget(const unordered_set<SymbolId>& names)
+    {
+        for (auto it = known.begin(); it != known.end();)
+        {
+            if (names.count(localNames[it->first]))
+                it = known.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    // names assigned, incremented or decremented anywhere in n
+    static void assignedNames(const ASTNode* n, unordered_set<SymbolId>& names)
+    {
+        if (!n)
+            return;
+        switch (n->kind)
+        {
+        case NK_UNARY:
+        {
+            auto u = static_cast<const UnaryExpr*>(n);
+            if ((u->op == T_INC || u->op == T_DEC) && u->rhs->kind == NK_IDENTIFIER)
+                names.insert(static_cast<const IdentifierExpr*>(u->rhs)->name);
+            assignedNames(u->rhs, names);
+            break;
+        }
+        case NK_POSTFIX:
+        {
+            auto p = static_cast<const PostfixExpr*>(n);
+            if (p->base->kind == NK_IDENTIFIER)
+                names.insert(static_cast<const IdentifierExpr*>(p->base)->name);
+            break;
+        }
+        case NK_BINARY:
+        {
+            auto b = static_cast<const BinaryExpr*>(n);
+            if (b->op == T_ASSIGN && b->left->kind == NK_IDENTIFIER)
+                names.insert(static_cast<const IdentifierExpr*>(b->left)->name);
+            assignedNames(b->left, names);
+            assignedNames(b->right, names);
+            break;
+        }
+        case NK_CALL:
+            for (const Expr* arg : static_cast<const CallExpr*>(n)->args)
+                assignedNames(arg, names);
+            break;
+        case NK_EXPR_STMT: assignedNames(static_cast<const ExprStmt*>(n)->expr, names); break;
+        case NK_RETURN: assignedNames(static_cast<const ReturnStmt*>(n)->expr, names); break;
+        case NK_VAR_DECL: assignedNames(static_cast<const VarDeclStmt*>(n)->init, names); break;
+        case NK_IF:
+        {
+            auto i = static_cast<const IfStmt*>(n);
+            assignedNames(i->cond, names);
+            assignedNames(i->thenStmt, names);
+            assignedNames(i->elseStmt, names);
+            break;
+        }
+        case NK_WHILE:
+            assignedNames(static_cast<const WhileStmt*>(n)->cond, names);
+            assignedNames(static_cast<const WhileStmt*>(n)->body, names);
+            break;
+        case NK_FOR:
+        {
+            auto f = static_cast<const ForStmt*>(n);
+            assignedNames(f->init, names);
+            assignedNames(f->condStmt, names);
+            assignedNames(f->iterExpr, names);
+            assignedNames(f->body, names);
+            break;
+        }
+        case NK_BLOCK:
+            for (const Stmt* s : static_cast<const BlockStmt*>(n)->stmts)
+                assignedNames(s, names);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // ---- statements ----
+
+    void foldStmt(StmtPtr stmt)
+    {
+        if (!stmt)
+            return;
+        switch (stmt->kind)
+        {
+        case NK_EXPR_STMT:
+        {
+            auto es = static_cast<ExprStmt*>(stmt);
+            if (es->expr)
+                fold(es->expr);
+            break;
+        }
+        case NK_RETURN:
+        {
+            auto rs = static_cast<ReturnStmt*>(stmt);
+            if (rs->expr)
+                fold(rs->expr);
+            break;
+        }
+        case NK_VAR_DECL:
+        {
+            // the initializer does not see the variable it initializes
+            auto vd = static_cast<VarDeclStmt*>(stmt);
+            if (vd->init)
+                fold(vd->init);
+            int id = declare(vd->name, vd->typeTok);
+            Value v;
+            if (!vd->init)
+                v = DefaultValue(localTypes[id]);
+            setKnown(id, !vd->init || ConstantOf(vd->init, v) ? &v : nullptr);
+            break;
+        }
+        case NK_IF:
+        {
+            auto ifs = static_cast<IfStmt*>(stmt);
+            fold(ifs->cond);
+            auto before = known;
+            foldStmt(ifs->thenStmt);
+            auto afterThen = move(known);
+            known = move(before);
+            foldStmt(ifs->elseStmt);
+            known = merge(afterThen, known);
+            break;
+        }
+        case NK_WHILE:
+        {
+            auto ws = static_cast<WhileStmt*>(stmt);
+            unordered_set<SymbolId> names;
+            assignedNames(ws, names);
+            forget(names);
+            fold(ws->cond);
+            // what holds before the first test holds after the last one
+            auto loop = known;
+            foldStmt(ws->body);
+            known = move(loop);
+            break;
+        }
+        case NK_FOR:
+        {
+            auto fs = static_cast<ForStmt*>(stmt);
+            scopes.pushScope();
+            foldStmt(fs->init);
+            unordered_set<SymbolId> names;
+            assignedNames(fs->condStmt, names);
+            assignedNames(fs->iterExpr, names);
+            assignedNames(fs->body, names);
+            forget(names);
+            foldStmt(fs->condStmt);
+            auto loop = known;
+            foldStmt(fs->body);
+            if (fs->iterExpr)
+                fold(fs->iterExpr);
+            known = move(loop);
+            scopes.popScope();
+            break;
+        }
+        case NK_BLOCK:
+            scopes.pushScope();
+            for (StmtPtr s : static_cast<BlockStmt*>(stmt)->stmts)
+                foldStmt(s);
+            scopes.popScope();
+            break;
+        default:
+            break;
+        }
+    }
+
+    // ---- expressions ----
+
+    void replace(ExprPtr& e, const Value& v)
+    {
+        switch (v.type)
+        {
+        case V_INT: e = program->arena.make<IntLiteral>((int64_t)v.i); break;
+        case V_FLOAT: e = program->arena.make<FloatLiteral>(v.f); break;
+        case V_BOOL: e = program->arena.make<BoolLiteral>(v.b); break;
+        default: return;
+        }
+        folded++;
+    }
+
+    static OpCode opOf(TokenKind op)
+    {
+        switch (op)
+        {
+        case T_PLUS: return OP_ADD;
+        case T_MINUS: return OP_SUB;
+        case T_MULT: return OP_MUL;
+        case T_DIV: return OP_DIV;
+        case T_MOD: return OP_MOD;
+        case T_EQ: return OP_EQ;
+        case T_NEQ: return OP_NE;
+        case T_LT: return OP_LT;
+        case T_GT: return OP_GT;
+        case T_LEQ: return OP_LE;
+        case T_GEQ: return OP_GE;
+        default: return OP_COUNT;
+        }
+    }
+
+    // folds e in place, replacing it by a literal if its value is known
+    void fold(ExprPtr& e)
+    {
+        switch (e->kind)
+        {
+        case NK_IDENTIFIER:
+        {
+            int id = localOf(static_cast<IdentifierExpr*>(e)->name);
+            auto it = id >= 0 ? known.find(id) : known.end();
+            if (it != known.end())
+                replace(e, it->second);
+            break;
+        }
+        case NK_UNARY:
+        {
+            auto u = static_cast<UnaryExpr*>(e);
+            if (u->op == T_INC || u->op == T_DEC)
+            {
+                assigned(u->rhs, nullptr);
+                break;
+            }
+            fold(u->rhs);
+            Value v;
+            if (!ConstantOf(u->rhs, v))
+                break;
+            if (u->op == T_PLUS)
+                e = u->rhs;
+            else if (u->op == T_NOT)
+                replace(e, Value::Bool(!Truthy(v)));
+            else if (u->op == T_MINUS)
+                replace(e, v.type == V_FLOAT ? Value::Float(-v.f) : Value::Int((int64_t)(0 - (uint64_t)AsInt(v))));
+            break;
+        }
+        case NK_POSTFIX:
+            assigned(static_cast<PostfixExpr*>(e)->base, nullptr);
+            break;
+        case NK_BINARY:
+            foldBinary(e, static_cast<BinaryExpr*>(e));
+            break;
+        case NK_CALL:
+            for (ExprPtr& arg : static_cast<CallExpr*>(e)->args)
+                fold(arg);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // target is stored v (nullptr: an unknown value)
+    void assigned(const Expr* target, const Value* v)
+    {
+        if (target->kind != NK_IDENTIFIER)
+            return;
+        int id = localOf(static_cast<const IdentifierExpr*>(target)->name);
+        if (id >= 0)
+            setKnown(id, v);
+    }
+
+    void foldBinary(ExprPtr& e, BinaryExpr* b)
+    {
+        Value l, r;
+        if (b->op == T_ASSIGN)
+        {
+            fold(b->right);
+            bool isConstant = ConstantOf(b->right, r);
+            assigned(b->left, isConstant ? &r : nullptr);
+            return;
+        }
+        if (b->op == T_AND || b->op == T_OR)
+        {
+            fold(b->left);
+            if (ConstantOf(b->left, l))
+            {
+                // the left side decides alone when it is false for && or true for ||
+                if (Truthy(l) == (b->op == T_OR))
+                {
+                    replace(e, Value::Bool(b->op == T_OR));
+                    return;
+                }
+                fold(b->right);
+                if (ConstantOf(b->right, r))
+                    replace(e, Value::Bool(Truthy(r)));
+                return;
+            }
+            // the right side may not run
+            auto before = known;
+            fold(b->right);
+            known = merge(before, known);
+            return;
+        }
+
+        fold(b->left);
+        fold(b->right);
+        OpCode op = opOf(b->op);
+        if (op == OP_COUNT || !ConstantOf(b->left, l) || !ConstantOf(b->right, r))
+            return;
+        try
+        {
+            if (op == OP_ADD || op == OP_SUB || op == OP_MUL || op == OP_DIV || op == OP_MOD)
+            {
+                deque<string> strings;
+                replace(e, Arith(op, l, r, strings));
+            }
+            else
+                replace(e, Compare(op, l, r));
+        }
+        catch (const runtime_error&)
+        {
+            // fails at run time, as it should
+        }
+    }
+};
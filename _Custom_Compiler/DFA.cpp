@@ -0,0 +1,375 @@
+#include "DFA.h"
+#include <bitset>
+#include <map>
+#include <algorithm>
+#include <stdexcept>
+using namespace std;
+
+// The token spec is compiled in three steps:
+//   1. every rule pattern is parsed into a Thompson NFA fragment tagged with its rule index
+//   2. subset construction turns the combined NFA into a DFA
+//   3. Moore partition refinement minimizes the DFA
+//
+// Only the regex subset used by the lexer is supported: literals, escapes, '.',
+// bracket classes with ranges and '^', groups, '|', '*', '+' and '?'.
+// The lexer never feeds '\n' into the DFA (lexemes do not span lines), so '.'
+// and negated classes leave it out, just like ECMAScript '.' does.
+
+namespace
+{
+    struct NfaState
+    {
+        vector<int> eps;
+        bitset<256> chars;
+        int next = -1;      // target of the chars edge
+        int rule = -1;      // rule this state belongs to
+        bool accept = false;
+    };
+
+    struct Fragment
+    {
+        int start;
+        int end;
+    };
+
+    class RegexCompiler
+    {
+        vector<NfaState>& nfa;
+        const string& pattern;
+        size_t pos;
+        int rule;
+
+        int newState()
+        {
+            nfa.push_back(NfaState());
+            nfa.back().rule = rule;
+            return (int)nfa.size() - 1;
+        }
+
+        [[noreturn]] void fail(const string& what)
+        {
+            throw runtime_error("Bad token pattern '" + pattern + "': " + what);
+        }
+
+        bool atEnd() const { return pos >= pattern.size(); }
+        char peek() const { return pattern[pos]; }
+
+        unsigned char escaped(char c)
+        {
+            switch (c)
+            {
+            case 'n': return '\n';
+            case 't': return '\t';
+            case 'r': return '\r';
+            default: return (unsigned char)c;
+            }
+        }
+
+        Fragment charSet(const bitset<256>& set)
+        {
+            Fragment f{ newState(), newState() };
+            nfa[f.start].chars = set;
+            nfa[f.start].next = f.end;
+            return f;
+        }
+
+        bitset<256> parseClass()
+        {
+            bitset<256> set;
+            bool negate = false;
+            if (!atEnd() && peek() == '^')
+            {
+                negate = true;
+                pos++;
+            }
+            while (!atEnd() && peek() != ']')
+            {
+                unsigned char lo = (unsigned char)pattern[pos++];
+                if (lo == '\\')
+                {
+                    if (atEnd()) fail("dangling escape");
+                    lo = escaped(pattern[pos++]);
+                }
+                unsigned char hi = lo;
+                if (pos + 1 < pattern.size() && peek() == '-' && pattern[pos + 1] != ']')
+                {
+                    pos++;
+                    hi = (unsigned char)pattern[pos++];
+                    if (hi == '\\')
+                    {
+                        if (atEnd()) fail("dangling escape");
+                        hi = escaped(pattern[pos++]);
+                    }
+                }
+                for (int c = lo; c <= hi; c++)
+                    set.set(c);
+            }
+            if (atEnd()) fail("missing ']'");
+            pos++;
+            if (negate)
+            {
+                set.flip();
+                set.reset('\n');
+            }
+            return set;
+        }
+
+        Fragment parseAtom()
+        {
+            char c = pattern[pos++];
+            if (c == '(')
+            {
+                Fragment f = parseAlt();
+                if (atEnd() || peek() != ')') fail("missing ')'");
+                pos++;
+                return f;
+            }
+            if (c == '[')
+                return charSet(parseClass());
+            bitset<256> set;
+            if (c == '.')
+            {
+                set.set();
+                set.reset('\n');
+                set.reset('\r');
+            }
+            else if (c == '\\')
+            {
+                if (atEnd()) fail("dangling escape");
+                set.set(escaped(pattern[pos++]));
+            }
+            else
+            {
+                set.set((unsigned char)c);
+            }
+            return charSet(set);
+        }
+
+        Fragment parseRepeat()
+        {
+            Fragment f = parseAtom();
+            while (!atEnd() && (peek() == '*' || peek() == '+' || peek() == '?'))
+            {
+                char op = pattern[pos++];
+                int s = newState();
+                int e = newState();
+                nfa[s].eps.push_back(f.start);
+                nfa[f.end].eps.push_back(e);
+                if (op != '+')
+                    nfa[s].eps.push_back(e);
+                if (op != '?')
+                    nfa[f.end].eps.push_back(f.start);
+                f = Fragment{ s, e };
+            }
+            return f;
+        }
+
+        Fragment parseConcat()
+        {
+            int s = newState();
+            Fragment f{ s, s };
+            while (!atEnd() && peek() != '|' && peek() != ')')
+            {
+                Fragment next = parseRepeat();
+                nfa[f.end].eps.push_back(next.start);
+                f.end = next.end;
+            }
+            return f;
+        }
+
+        Fragment parseAlt()
+        {
+            Fragment f = parseConcat();
+            if (atEnd() || peek() != '|')
+                return f;
+            int s = newState();
+            int e = newState();
+            nfa[s].eps.push_back(f.start);
+            nfa[f.end].eps.push_back(e);
+            while (!atEnd() && peek() == '|')
+            {
+                pos++;
+                Fragment next = parseConcat();
+                nfa[s].eps.push_back(next.start);
+                nfa[next.end].eps.push_back(e);
+            }
+            return Fragment{ s, e };
+        }
+
+    public:
+        RegexCompiler(vector<NfaState>& n, const string& p, int r) : nfa(n), pattern(p), pos(0), rule(r) {}
+
+        Fragment compile()
+        {
+            Fragment f = parseAlt();
+            if (!atEnd()) fail("unexpected ')'");
+            nfa[f.end].accept = true;
+            return f;
+        }
+    };
+
+    void closure(const vector<NfaState>& nfa, vector<int>& set)
+    {
+        vector<bool> seen(nfa.size(), false);
+        vector<int> stack(set.begin(), set.end());
+        for (int s : set) seen[s] = true;
+        while (!stack.empty())
+        {
+            int s = stack.back();
+            stack.pop_back();
+            for (int t : nfa[s].eps)
+            {
+                if (!seen[t])
+                {
+                    seen[t] = true;
+                    set.push_back(t);
+                    stack.push_back(t);
+                }
+            }
+        }
+        sort(set.begin(), set.end());
+    }
+
+    // Once a rule accepts, rules after it can no longer win, so their states are dropped.
+    // This gives first-rule-wins semantics to an ordinary maximal munch DFA.
+    int prune(const vector<NfaState>& nfa, vector<int>& set)
+    {
+        int best = -1;
+        for (int s : set)
+            if (nfa[s].accept && (best < 0 || nfa[s].rule < best))
+                best = nfa[s].rule;
+        if (best >= 0)
+            set.erase(remove_if(set.begin(), set.end(), [&](int s) { return nfa[s].rule > best; }), set.end());
+        return best;
+    }
+}
+
+TokenDFA::TokenDFA(const vector<TokenRule>& rules) : class_count(0), start(1)
+{
+    vector<NfaState> nfa(1);
+    for (int i = 0; i < (int)rules.size(); i++)
+    {
+        Fragment f = RegexCompiler(nfa, rules[i].pattern, i).compile();
+        nfa[0].eps.push_back(f.start);
+    }
+
+    // byte equivalence classes: two bytes share a class if no char edge tells them apart
+    int cls[256] = {};
+    int count = 1;
+    for (const NfaState& s : nfa)
+    {
+        if (s.next < 0)
+            continue;
+        map<pair<int, bool>, int> split;
+        for (int c = 0; c < 256; c++)
+        {
+            auto key = make_pair(cls[c], (bool)s.chars[c]);
+            auto it = split.find(key);
+            if (it == split.end())
+                it = split.insert(make_pair(key, (int)split.size())).first;
+            cls[c] = it->second;
+        }
+        count = (int)split.size();
+    }
+    class_count = count;
+    vector<int> representative(class_count, -1);
+    for (int c = 0; c < 256; c++)
+    {
+        byte_class[c] = (unsigned char)cls[c];
+        if (representative[cls[c]] < 0)
+            representative[cls[c]] = c;
+    }
+
+    // subset construction, state 0 is the dead (empty) set
+    map<vector<int>, int> ids;
+    vector<vector<int>> sets(1);
+    vector<int> table(class_count, 0);
+    vector<int> accept(1, -1);
+    ids[vector<int>()] = 0;
+
+    vector<int> init(1, 0);
+    closure(nfa, init);
+    int initRule = prune(nfa, init);
+    ids[init] = 1;
+    sets.push_back(init);
+    accept.push_back(initRule);
+    table.resize(2 * class_count, 0);
+
+    for (size_t d = 1; d < sets.size(); d++)
+    {
+        for (int c = 0; c < class_count; c++)
+        {
+            vector<int> moved;
+            for (int s : sets[d])
+                if (nfa[s].next >= 0 && nfa[s].chars[representative[c]])
+                    moved.push_back(nfa[s].next);
+            if (moved.empty())
+                continue;
+            closure(nfa, moved);
+            int rule = prune(nfa, moved);
+            auto it = ids.find(moved);
+            if (it == ids.end())
+            {
+                it = ids.insert(make_pair(moved, (int)sets.size())).first;
+                sets.push_back(moved);
+                accept.push_back(rule);
+                table.resize(sets.size() * class_count, 0);
+            }
+            table[d * class_count + c] = it->second;
+        }
+    }
+
+    // Moore minimization, starting from states grouped by accepted rule
+    int n = (int)sets.size();
+    vector<int> part(n);
+    {
+        map<int, int> byRule;
+        byRule[-1] = 0;
+        for (int s = 0; s < n; s++)
+        {
+            auto it = byRule.find(accept[s]);
+            if (it == byRule.end())
+                it = byRule.insert(make_pair(accept[s], (int)byRule.size())).first;
+            part[s] = it->second;
+        }
+    }
+    int parts = 0;
+    while (true)
+    {
+        map<vector<int>, int> sig;
+        vector<int> next(n);
+        for (int s = 0; s < n; s++)
+        {
+            vector<int> key(1, part[s]);
+            for (int c = 0; c < class_count; c++)
+                key.push_back(part[table[s * class_count + c]]);
+            auto it = sig.find(key);
+            if (it == sig.end())
+                it = sig.insert(make_pair(key, (int)sig.size())).first;
+            next[s] = it->second;
+        }
+        part = next;
+        if ((int)sig.size() == parts)
+            break;
+        parts = (int)sig.size();
+    }
+
+    // renumber so the dead state's block stays 0
+    vector<int> order(parts, -1);
+    int used = 0;
+    order[part[0]] = used++;
+    for (int s = 1; s < n; s++)
+        if (order[part[s]] < 0)
+            order[part[s]] = used++;
+
+    transitions.assign(parts * class_count, 0);
+    accepting.assign(parts, -1);
+    for (int s = 0; s < n; s++)
+    {
+        int m = order[part[s]];
+        accepting[m] = accept[s];
+        for (int c = 0; c < class_count; c++)
+            transitions[m * class_count + c] = order[part[table[s * class_count + c]]];
+    }
+    start = order[part[1]];
+}
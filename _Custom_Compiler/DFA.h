@@ -0,0 +1,50 @@
+#pragma once
+#include<vector>
+#include<string>
+#include"TokenKind.h"
+using namespace std;
+
+// One alternative of the lexer's token spec. Rules behave like the branches of
+// the old master regex: at a given position the first rule that matches wins
+// and takes its own longest match.
+struct TokenRule
+{
+    string pattern;
+    TokenKind type;
+};
+
+// Minimized DFA compiled from an ordered list of TokenRules.
+// Bytes are folded into equivalence classes so the transition table is
+// states * classes instead of states * 256.
+class TokenDFA
+{
+    unsigned char byte_class[256];
+    int class_count;
+    vector<int> transitions;   // state * class_count + class -> next state, 0 is the dead state
+    vector<int> accepting;     // state -> rule index, -1 if not accepting
+    int start;
+
+public:
+    TokenDFA(const vector<TokenRule>& rules);
+
+    // Length of the match at [begin, end), 0 if no rule matches. rule is set to the winning rule.
+    size_t Match(const char* begin, const char* end, int& rule) const
+    {
+        int state = start;
+        size_t best = 0;
+        for (const char* p = begin; p < end; p++)
+        {
+            state = transitions[state * class_count + byte_class[(unsigned char)*p]];
+            if (state == 0)
+                break;
+            if (accepting[state] >= 0)
+            {
+                rule = accepting[state];
+                best = p - begin + 1;
+            }
+        }
+        return best;
+    }
+
+    int StateCount() const { return (int)accepting.size(); }
+};
@@ -0,0 +1,867 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "Parser2.h"
+#include "ScopeStack.h"
+#include "BytecodeCompiler.h"
+#include "ConstantFolder.h"
+
+using namespace std;
+
+// Removes dead code from the functions of a Program, in place. Run it after
+// ConstantFolder, which turns constant conditions into literals.
+//
+// Control flow first. Code after a return is dropped, and so is code after a
+// loop that never exits (while (true), or a for with no condition). An if with
+// a literal condition is replaced by the branch it takes. A while loop whose
+// condition is false is dropped, and so is a for loop, apart from its init.
+//
+// Then dead locals: a local whose value is never read. The only reads that
+// do not count are in a store to the same variable (z = z + y;). Dead locals
+// lose their declaration and their stores. An initializer or stored value
+// that has side effects, or could fail at run time, stays as an expression
+// statement. A local stays if removing it could hide an error: a redefinition,
+// a void variable, or a store that may fail to convert.
+//
+// Then dead stores to the locals that are read: a backward liveness analysis
+// over the statements finds the stores (=, ++, --, an initializer) after which
+// the variable is overwritten or goes out of scope before any read. Loops are
+// iterated until their live sets stop growing. A dead store is dropped like a
+// store to a dead local; a dead initializer only if it is pure, and then the
+// variable starts from its default value instead. Stores nested in a larger
+// expression are left alone.
+//
+// This repeats until nothing changes, since removing a store can leave another
+// local unread.
+class DeadCodeEliminator
+{
+    Program* program;
+    unordered_map<SymbolId, ValueType> globals;     // declared so far
+    unordered_map<SymbolId, ValueType> functions;   // return types
+
+    // locals of the function being swept, numbered by Symbol::slot
+    struct Local
+    {
+        const VarDeclStmt* decl;    // nullptr for a parameter
+        ValueType type;
+        size_t reads = 0;
+        bool keep = false;          // stays even if never read
+    };
+    ScopeStack scopes;
+    vector<Local> locals;
+    unordered_set<const VarDeclStmt*> dead;
+
+    // liveness: the local every identifier resolved to while counting, the
+    // stores that may go if they are dead, and whether the variable was live
+    // after each of them. A loop visits its body until its live set is stable;
+    // the last visit of a store is made with the final set and wins.
+    typedef vector<uint64_t> LiveSet;
+    unordered_map<const Expr*, int> resolved;
+    unordered_map<const VarDeclStmt*, int> declared;
+    unordered_set<const ASTNode*> removable;
+    unordered_map<const ASTNode*, bool> liveAfter;
+    unordered_set<const ASTNode*> deadStores;
+    bool changed = false;
+    size_t removed = 0;
+
+    explicit DeadCodeEliminator(Program* program) : program(program) {}
+
+public:
+    // Rewrites the functions of program; returns the number of statements
+    // and expressions removed.
+    static size_t Run(Program* program)
+    {
+        DeadCodeEliminator d(program);
+        for (ASTPtr item : program->globalItems)
+            if (auto func = nodeCast<FuncDecl>(item))
+                d.functions[func->name] = valueTypeOf(func->retType);
+        // globals are visible from their declaration on
+        for (ASTPtr item : program->globalItems)
+        {
+            if (auto func = nodeCast<FuncDecl>(item))
+                d.eliminate(func);
+            else if (auto var = nodeCast<VarDeclStmt>(item))
+                d.globals[var->name] = valueTypeOf(var->typeTok);
+        }
+        return d.removed;
+    }
+
+private:
+    void eliminate(FuncDecl* func)
+    {
+        if (!func->body)
+            return;
+        pruneList(func->body->stmts);
+        do
+        {
+            changed = false;
+            countReads(func);
+            findDeadStores(func);
+            sweep(func);
+        } while (changed);
+    }
+
+    StmtPtr emptyBlock()
+    {
+        return program->arena.make<BlockStmt>();
+    }
+
+    // ---- control flow ----
+
+    // prunes stmts; returns true if control never reaches the end of the list
+    bool pruneList(vector<StmtPtr>& stmts)
+    {
+        size_t n = 0;
+        bool ends = false;
+        for (size_t i = 0; i < stmts.size(); i++)
+        {
+            if (ends)
+            {
+                removed++;
+                continue;
+            }
+            ends = prune(stmts[i]);
+            if (stmts[i])
+                stmts[n++] = stmts[i];
+        }
+        stmts.resize(n);
+        return ends;
+    }
+
+    // prunes stmt, setting it to nullptr if nothing is left; returns true if
+    // control never goes on past it
+    bool prune(StmtPtr& stmt)
+    {
+        Value v;
+        switch (stmt->kind)
+        {
+        case NK_RETURN:
+            return true;
+        case NK_BLOCK:
+            return pruneList(static_cast<BlockStmt*>(stmt)->stmts);
+        case NK_IF:
+        {
+            auto ifs = static_cast<IfStmt*>(stmt);
+            if (ConstantFolder::ConstantOf(ifs->cond, v))
+            {
+                removed++;
+                stmt = Truthy(v) ? ifs->thenStmt : ifs->elseStmt;
+                return stmt ? prune(stmt) : false;
+            }
+            bool thenEnds = pruneBody(ifs->thenStmt);
+            bool elseEnds = ifs->elseStmt && pruneBody(ifs->elseStmt);
+            return thenEnds && elseEnds;
+        }
+        case NK_WHILE:
+        {
+            auto ws = static_cast<WhileStmt*>(stmt);
+            bool constant = ConstantFolder::ConstantOf(ws->cond, v);
+            if (constant && !Truthy(v))
+            {
+                removed++;
+                stmt = nullptr;
+                return false;
+            }
+            pruneBody(ws->body);
+            return constant;
+        }
+        case NK_FOR:
+        {
+            auto fs = static_cast<ForStmt*>(stmt);
+            auto cond = nodeCast<ExprStmt>(fs->condStmt);
+            bool forever = !cond || !cond->expr;
+            if (!forever && ConstantFolder::ConstantOf(cond->expr, v))
+            {
+                if (!Truthy(v))
+                {
+                    // the init still runs once, in a scope of its own
+                    removed++;
+                    stmt = nullptr;
+                    if (fs->init)
+                    {
+                        auto block = program->arena.make<BlockStmt>();
+                        block->stmts.push_back(fs->init);
+                        stmt = block;
+                    }
+                    return false;
+                }
+                forever = true;
+            }
+            pruneBody(fs->body);
+            return forever;
+        }
+        default:
+            return false;
+        }
+    }
+
+    bool pruneBody(StmtPtr& body)
+    {
+        bool ends = prune(body);
+        if (!body)
+            body = emptyBlock();
+        return ends;
+    }
+
+    // ---- locals ----
+
+    int declare(const VarDeclStmt* decl, SymbolId name, TokenKind typeTok)
+    {
+        int id = (int)locals.size();
+        locals.push_back(Local{ decl, valueTypeOf(typeTok) });
+        if (decl)
+            declared[decl] = id;
+        if (!scopes.declareSym(Symbol(name, typeTok, false, id)) || locals.back().type == V_VOID)
+            locals.back().keep = true;
+        return id;
+    }
+
+    // the local an expression names, -1 if it is not a local variable
+    int localOf(const Expr* e)
+    {
+        if (e->kind != NK_IDENTIFIER)
+            return -1;
+        const Symbol* s = scopes.lookup(static_cast<const IdentifierExpr*>(e)->name);
+        int id = s ? s->slot : -1;
+        resolved[e] = id;
+        return id;
+    }
+
+    void beginFunction(const FuncDecl* func)
+    {
+        scopes = ScopeStack();
+        locals.clear();
+        // parameters share the scope of the outermost block of the body
+        scopes.pushScope();
+        for (const Param& p : func->params)
+            declare(nullptr, p.name, p.typeTok);
+    }
+
+    static bool isNumber(ValueType type)
+    {
+        return type == V_INT || type == V_FLOAT || type == V_BOOL;
+    }
+
+    // static type of e, V_VOID if it is not known here
+    ValueType typeOf(const Expr* e)
+    {
+        switch (e->kind)
+        {
+        case NK_INT_LITERAL:
+        case NK_CHAR_LITERAL: return V_INT;
+        case NK_FLOAT_LITERAL: return V_FLOAT;
+        case NK_BOOL_LITERAL: return V_BOOL;
+        case NK_STRING_LITERAL: return V_STRING;
+        case NK_IDENTIFIER:
+        {
+            int id = localOf(e);
+            if (id >= 0)
+                return locals[id].type;
+            auto it = globals.find(static_cast<const IdentifierExpr*>(e)->name);
+            return it != globals.end() ? it->second : V_VOID;
+        }
+        case NK_UNARY:
+        {
+            auto u = static_cast<const UnaryExpr*>(e);
+            ValueType t = typeOf(u->rhs);
+            if (u->op == T_NOT)
+                return V_BOOL;
+            if (u->op == T_MINUS)
+                return isNumber(t) ? (t == V_FLOAT ? V_FLOAT : V_INT) : V_VOID;
+            return t;
+        }
+        case NK_POSTFIX:
+            return typeOf(static_cast<const PostfixExpr*>(e)->base);
+        case NK_BINARY:
+        {
+            auto b = static_cast<const BinaryExpr*>(e);
+            ValueType l = typeOf(b->left), r = typeOf(b->right);
+            switch (b->op)
+            {
+            case T_ASSIGN: return l;
+            case T_AND: case T_OR:
+            case T_EQ: case T_NEQ: case T_LT: case T_GT: case T_LEQ: case T_GEQ: return V_BOOL;
+            default:
+                if (!isNumber(l) || !isNumber(r))
+                    return V_VOID;
+                return l == V_FLOAT || r == V_FLOAT ? V_FLOAT : V_INT;
+            }
+        }
+        case NK_CALL:
+        {
+            auto callee = static_cast<const CallExpr*>(e)->callee;
+            if (callee->kind != NK_IDENTIFIER || localOf(callee) >= 0)
+                return V_VOID;
+            auto it = functions.find(static_cast<const IdentifierExpr*>(callee)->name);
+            return it != functions.end() ? it->second : V_VOID;
+        }
+        default:
+            return V_VOID;
+        }
+    }
+
+    // true if evaluating e has no side effects and cannot fail
+    bool pure(const Expr* e)
+    {
+        switch (e->kind)
+        {
+        case NK_INT_LITERAL:
+            return static_cast<const IntLiteral*>(e)->inRange;
+        case NK_FLOAT_LITERAL:
+        case NK_BOOL_LITERAL:
+        case NK_CHAR_LITERAL:
+        case NK_STRING_LITERAL:
+            return true;
+        case NK_IDENTIFIER:
+            return typeOf(e) != V_VOID;
+        case NK_UNARY:
+        {
+            auto u = static_cast<const UnaryExpr*>(e);
+            return u->op != T_INC && u->op != T_DEC && pure(u->rhs) && isNumber(typeOf(u->rhs));
+        }
+        case NK_BINARY:
+        {
+            auto b = static_cast<const BinaryExpr*>(e);
+            if (b->op == T_ASSIGN || b->op == T_DIV || b->op == T_MOD)
+                return false;
+            return pure(b->left) && pure(b->right) && isNumber(typeOf(b->left)) && isNumber(typeOf(b->right));
+        }
+        default:
+            return false;
+        }
+    }
+
+    // true if storing the value of e into a variable of the given type cannot fail
+    bool safeStore(ValueType to, const Expr* e)
+    {
+        ValueType from = typeOf(e);
+        if (from == V_VOID || to == V_VOID)
+            return false;
+        if (to == V_STRING || from == V_STRING)
+            return to == from;
+        // a float only converts to int when it is in range
+        Value v;
+        if (to == V_INT && from == V_FLOAT)
+            return ConstantFolder::ConstantOf(e, v) && v.f > -9.2e18 && v.f < 9.2e18;
+        return true;
+    }
+
+    // ---- counting reads ----
+
+    void countReads(const FuncDecl* func)
+    {
+        resolved.clear();
+        declared.clear();
+        removable.clear();
+        beginFunction(func);
+        for (const Stmt* stmt : func->body->stmts)
+            countStmt(stmt);
+        dead.clear();
+        for (const Local& local : locals)
+            if (local.decl && !local.reads && !local.keep)
+                dead.insert(local.decl);
+    }
+
+    void countStmt(const Stmt* stmt)
+    {
+        if (!stmt)
+            return;
+        switch (stmt->kind)
+        {
+        case NK_EXPR_STMT:
+        {
+            auto es = static_cast<const ExprStmt*>(stmt);
+            if (es->expr)
+                countEffect(es->expr);
+            break;
+        }
+        case NK_RETURN:
+        {
+            auto rs = static_cast<const ReturnStmt*>(stmt);
+            if (rs->expr)
+                countExpr(rs->expr);
+            break;
+        }
+        case NK_VAR_DECL:
+        {
+            // the initializer does not see the variable it initializes
+            auto vd = static_cast<const VarDeclStmt*>(stmt);
+            bool safe = !vd->init || safeStore(valueTypeOf(vd->typeTok), vd->init);
+            if (vd->init)
+                countExpr(vd->init);
+            if (vd->init && safe && pure(vd->init))
+                removable.insert(vd);
+            int id = declare(vd, vd->name, vd->typeTok);
+            if (!safe)
+                locals[id].keep = true;
+            break;
+        }
+        case NK_IF:
+        {
+            auto ifs = static_cast<const IfStmt*>(stmt);
+            countExpr(ifs->cond);
+            countStmt(ifs->thenStmt);
+            countStmt(ifs->elseStmt);
+            break;
+        }
+        case NK_WHILE:
+        {
+            auto ws = static_cast<const WhileStmt*>(stmt);
+            countExpr(ws->cond);
+            countStmt(ws->body);
+            break;
+        }
+        case NK_FOR:
+        {
+            auto fs = static_cast<const ForStmt*>(stmt);
+            scopes.pushScope();
+            countStmt(fs->init);
+            countStmt(fs->condStmt);
+            countStmt(fs->body);
+            if (fs->iterExpr)
+                countEffect(fs->iterExpr);
+            scopes.popScope();
+            break;
+        }
+        case NK_BLOCK:
+            scopes.pushScope();
+            for (const Stmt* s : static_cast<const BlockStmt*>(stmt)->stmts)
+                countStmt(s);
+            scopes.popScope();
+            break;
+        default:
+            break;
+        }
+    }
+
+    // e is evaluated for its side effects only
+    void countEffect(const Expr* e)
+    {
+        if (e->kind == NK_BINARY && static_cast<const BinaryExpr*>(e)->op == T_ASSIGN)
+        {
+            auto b = static_cast<const BinaryExpr*>(e);
+            int id = localOf(b->left);
+            if (id >= 0)
+            {
+                if (!safeStore(locals[id].type, b->right))
+                    locals[id].keep = true;
+                else
+                    removable.insert(b);
+                // a pure value is dropped with the store, so its reads of the
+                // variable itself do not keep it alive
+                countExpr(b->right, pure(b->right) ? id : -1);
+                return;
+            }
+        }
+        const Expr* operand = e->kind == NK_POSTFIX ? static_cast<const PostfixExpr*>(e)->base
+            : e->kind == NK_UNARY && (static_cast<const UnaryExpr*>(e)->op == T_INC || static_cast<const UnaryExpr*>(e)->op == T_DEC)
+            ? static_cast<const UnaryExpr*>(e)->rhs : nullptr;
+        int id = operand ? localOf(operand) : -1;
+        if (id >= 0)
+        {
+            if (!isNumber(locals[id].type))
+                locals[id].keep = true;
+            else
+                removable.insert(e);
+            return;
+        }
+        countExpr(e);
+    }
+
+    void countExpr(const Expr* e, int storing = -1)
+    {
+        switch (e->kind)
+        {
+        case NK_IDENTIFIER:
+        {
+            int id = localOf(e);
+            if (id >= 0 && id != storing)
+                locals[id].reads++;
+            break;
+        }
+        case NK_UNARY:
+            countExpr(static_cast<const UnaryExpr*>(e)->rhs, storing);
+            break;
+        case NK_POSTFIX:
+            countExpr(static_cast<const PostfixExpr*>(e)->base, storing);
+            break;
+        case NK_BINARY:
+            countExpr(static_cast<const BinaryExpr*>(e)->left, storing);
+            countExpr(static_cast<const BinaryExpr*>(e)->right, storing);
+            break;
+        case NK_CALL:
+            countExpr(static_cast<const CallExpr*>(e)->callee, storing);
+            for (const Expr* arg : static_cast<const CallExpr*>(e)->args)
+                countExpr(arg, storing);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // ---- dead stores ----
+
+    void findDeadStores(const FuncDecl* func)
+    {
+        liveAfter.clear();
+        deadStores.clear();
+        LiveSet live(words(), 0);
+        liveList(func->body->stmts, live);
+        for (const auto& store : liveAfter)
+            if (!store.second)
+                deadStores.insert(store.first);
+    }
+
+    size_t words() const
+    {
+        return (locals.size() + 63) / 64;
+    }
+
+    static bool unite(LiveSet& into, const LiveSet& from)
+    {
+        bool grew = false;
+        for (size_t i = 0; i < into.size(); i++)
+        {
+            grew |= (from[i] & ~into[i]) != 0;
+            into[i] |= from[i];
+        }
+        return grew;
+    }
+
+    static bool isLive(const LiveSet& live, int id)
+    {
+        return (live[id >> 6] >> (id & 63)) & 1;
+    }
+
+    static void setLive(LiveSet& live, int id, bool on)
+    {
+        if (on)
+            live[id >> 6] |= 1ull << (id & 63);
+        else
+            live[id >> 6] &= ~(1ull << (id & 63));
+    }
+
+    // the store at `at` overwrites local id
+    void store(const ASTNode* at, int id, LiveSet& live)
+    {
+        if (removable.count(at))
+            liveAfter[at] = isLive(live, id);
+        setLive(live, id, false);
+    }
+
+    // live is what is live after stmts; it becomes what is live before them
+    void liveList(const vector<StmtPtr>& stmts, LiveSet& live)
+    {
+        for (size_t i = stmts.size(); i-- > 0;)
+            liveStmt(stmts[i], live);
+    }
+
+    void liveStmt(const Stmt* stmt, LiveSet& live)
+    {
+        if (!stmt)
+            return;
+        switch (stmt->kind)
+        {
+        case NK_EXPR_STMT:
+        {
+            auto es = static_cast<const ExprStmt*>(stmt);
+            if (es->expr)
+                liveEffect(es->expr, live);
+            break;
+        }
+        case NK_RETURN:
+        {
+            // nothing local is read after a return
+            auto rs = static_cast<const ReturnStmt*>(stmt);
+            fill(live.begin(), live.end(), 0);
+            if (rs->expr)
+                liveExpr(rs->expr, live);
+            break;
+        }
+        case NK_VAR_DECL:
+        {
+            auto vd = static_cast<const VarDeclStmt*>(stmt);
+            auto it = declared.find(vd);
+            if (it != declared.end())
+                store(vd, it->second, live);
+            if (vd->init)
+                liveExpr(vd->init, live);
+            break;
+        }
+        case NK_IF:
+        {
+            auto ifs = static_cast<const IfStmt*>(stmt);
+            LiveSet otherwise = live;
+            liveStmt(ifs->elseStmt, otherwise);
+            liveStmt(ifs->thenStmt, live);
+            unite(live, otherwise);
+            liveExpr(ifs->cond, live);
+            break;
+        }
+        case NK_WHILE:
+        {
+            // before the condition: what it reads, and what is live after the
+            // loop or before the body
+            auto ws = static_cast<const WhileStmt*>(stmt);
+            liveExpr(ws->cond, live);
+            for (;;)
+            {
+                LiveSet body = live;
+                liveStmt(ws->body, body);
+                if (!unite(live, body))
+                    break;
+            }
+            break;
+        }
+        case NK_FOR:
+        {
+            // condition, body, iteration, and back to the condition
+            auto fs = static_cast<const ForStmt*>(stmt);
+            auto cond = nodeCast<ExprStmt>(fs->condStmt);
+            // a loop without a condition is never left
+            if (!cond || !cond->expr)
+                fill(live.begin(), live.end(), 0);
+            for (;;)
+            {
+                LiveSet body = live;
+                if (fs->iterExpr)
+                    liveEffect(fs->iterExpr, body);
+                liveStmt(fs->body, body);
+                if (cond && cond->expr)
+                    liveExpr(cond->expr, body);
+                else
+                    liveStmt(fs->condStmt, body);
+                if (!unite(live, body))
+                    break;
+            }
+            liveStmt(fs->init, live);
+            break;
+        }
+        case NK_BLOCK:
+            liveList(static_cast<const BlockStmt*>(stmt)->stmts, live);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // e is evaluated for its side effects only
+    void liveEffect(const Expr* e, LiveSet& live)
+    {
+        if (e->kind == NK_BINARY && static_cast<const BinaryExpr*>(e)->op == T_ASSIGN)
+        {
+            auto b = static_cast<const BinaryExpr*>(e);
+            int id = localId(b->left);
+            if (id >= 0)
+            {
+                store(b, id, live);
+                liveExpr(b->right, live);
+                return;
+            }
+        }
+        const Expr* operand = e->kind == NK_POSTFIX ? static_cast<const PostfixExpr*>(e)->base
+            : e->kind == NK_UNARY && (static_cast<const UnaryExpr*>(e)->op == T_INC || static_cast<const UnaryExpr*>(e)->op == T_DEC)
+            ? static_cast<const UnaryExpr*>(e)->rhs : nullptr;
+        int id = operand ? localId(operand) : -1;
+        if (id >= 0)
+        {
+            // x++ reads x as well
+            store(e, id, live);
+            setLive(live, id, true);
+            return;
+        }
+        liveExpr(e, live);
+    }
+
+    // every local e reads becomes live; stores inside e only count as reads
+    void liveExpr(const Expr* e, LiveSet& live)
+    {
+        switch (e->kind)
+        {
+        case NK_IDENTIFIER:
+        {
+            int id = localId(e);
+            if (id >= 0)
+                setLive(live, id, true);
+            break;
+        }
+        case NK_UNARY:
+            liveExpr(static_cast<const UnaryExpr*>(e)->rhs, live);
+            break;
+        case NK_POSTFIX:
+            liveExpr(static_cast<const PostfixExpr*>(e)->base, live);
+            break;
+        case NK_BINARY:
+            liveExpr(static_cast<const BinaryExpr*>(e)->left, live);
+            liveExpr(static_cast<const BinaryExpr*>(e)->right, live);
+            break;
+        case NK_CALL:
+            liveExpr(static_cast<const CallExpr*>(e)->callee, live);
+            for (const Expr* arg : static_cast<const CallExpr*>(e)->args)
+                liveExpr(arg, live);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // the local an identifier resolved to while counting, -1 if none
+    int localId(const Expr* e) const
+    {
+        auto it = resolved.find(e);
+        return it != resolved.end() ? it->second : -1;
+    }
+
+    // ---- sweeping dead locals ----
+
+    void sweep(const FuncDecl* func)
+    {
+        beginFunction(func);
+        sweepList(func->body->stmts);
+    }
+
+    void sweepList(vector<StmtPtr>& stmts)
+    {
+        size_t n = 0;
+        for (StmtPtr stmt : stmts)
+        {
+            if (StmtPtr s = sweepStmt(stmt))
+                stmts[n++] = s;
+            else
+            {
+                removed++;
+                changed = true;
+            }
+        }
+        stmts.resize(n);
+    }
+
+    // what is left of a statement that cannot be removed: an if, while or for body
+    StmtPtr sweepBody(StmtPtr body)
+    {
+        if (StmtPtr s = sweepStmt(body))
+            return s;
+        if (isEmpty(body))
+            return body;
+        removed++;
+        changed = true;
+        return emptyBlock();
+    }
+
+    // what is left of stmt, nullptr if nothing
+    StmtPtr sweepStmt(StmtPtr stmt)
+    {
+        if (!stmt)
+            return nullptr;
+        switch (stmt->kind)
+        {
+        case NK_EXPR_STMT:
+        {
+            auto es = static_cast<ExprStmt*>(stmt);
+            if (es->expr)
+                es->expr = sweepEffect(es->expr);
+            return es->expr && !pure(es->expr) ? stmt : nullptr;
+        }
+        case NK_VAR_DECL:
+        {
+            // dead locals are still declared, so that names resolve as before
+            auto vd = static_cast<VarDeclStmt*>(stmt);
+            bool keepInit = vd->init && !pure(vd->init);
+            declare(vd, vd->name, vd->typeTok);
+            if (!dead.count(vd))
+            {
+                // a dead initializer is pure; the default value does as well
+                if (deadStores.count(vd))
+                {
+                    vd->init = nullptr;
+                    removed++;
+                    changed = true;
+                }
+                return stmt;
+            }
+            return keepInit ? program->arena.make<ExprStmt>(vd->init) : nullptr;
+        }
+        case NK_IF:
+        {
+            auto ifs = static_cast<IfStmt*>(stmt);
+            ifs->thenStmt = sweepBody(ifs->thenStmt);
+            if (ifs->elseStmt)
+            {
+                ifs->elseStmt = sweepBody(ifs->elseStmt);
+                if (isEmpty(ifs->elseStmt))
+                    ifs->elseStmt = nullptr;
+            }
+            if (!ifs->elseStmt && isEmpty(ifs->thenStmt) && pure(ifs->cond))
+                return nullptr;
+            return stmt;
+        }
+        case NK_WHILE:
+        {
+            auto ws = static_cast<WhileStmt*>(stmt);
+            ws->body = sweepBody(ws->body);
+            return stmt;
+        }
+        case NK_FOR:
+        {
+            auto fs = static_cast<ForStmt*>(stmt);
+            scopes.pushScope();
+            if (fs->init && !(fs->init = sweepStmt(fs->init)))
+            {
+                removed++;
+                changed = true;
+            }
+            fs->body = sweepBody(fs->body);
+            if (fs->iterExpr)
+            {
+                fs->iterExpr = sweepEffect(fs->iterExpr);
+                if (fs->iterExpr && pure(fs->iterExpr))
+                    fs->iterExpr = nullptr;
+            }
+            scopes.popScope();
+            return stmt;
+        }
+        case NK_BLOCK:
+        {
+            auto block = static_cast<BlockStmt*>(stmt);
+            scopes.pushScope();
+            sweepList(block->stmts);
+            scopes.popScope();
+            return block->stmts.empty() ? nullptr : stmt;
+        }
+        default:
+            return stmt;
+        }
+    }
+
+    static bool isEmpty(const Stmt* stmt)
+    {
+        return stmt->kind == NK_BLOCK && static_cast<const BlockStmt*>(stmt)->stmts.empty();
+    }
+
+    // what is left of e, evaluated for its side effects only; nullptr if nothing
+    ExprPtr sweepEffect(ExprPtr e)
+    {
+        if (e->kind == NK_BINARY && static_cast<BinaryExpr*>(e)->op == T_ASSIGN)
+        {
+            auto b = static_cast<BinaryExpr*>(e);
+            int id = localOf(b->left);
+            if (id >= 0 && (dead.count(locals[id].decl) || deadStores.count(b)))
+            {
+                changed = true;
+                return sweepEffect(b->right);
+            }
+            return e;
+        }
+        ExprPtr operand = e->kind == NK_POSTFIX ? static_cast<PostfixExpr*>(e)->base
+            : e->kind == NK_UNARY && (static_cast<UnaryExpr*>(e)->op == T_INC || static_cast<UnaryExpr*>(e)->op == T_DEC)
+            ? static_cast<UnaryExpr*>(e)->rhs : nullptr;
+        int id = operand ? localOf(operand) : -1;
+        if (id >= 0 && (dead.count(locals[id].decl) || deadStores.count(e)))
+        {
+            changed = true;
+            return nullptr;
+        }
+        return e;
+    }
+};
@@ -0,0 +1,816 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include "Parser2.h"
+#include "ScopeStack.h"
+#include "BytecodeCompiler.h"
+
+using namespace std;
+
+// Inlines calls to small functions into their callers, on the AST, before the
+// other passes.
+//
+// A call can only be replaced by statements, so an inlined call is hoisted
+// out of its statement. int x = a(1, 2) + 1; becomes
+//     int a$1;
+//     { int x$2 = 1; int y$3 = 2; <body of a>; a$1 = x + y; }
+//     int x = a$1 + 1;
+// The callee's parameters and locals are renamed through a ScopeStack. Each
+// gets a fresh name containing '$', which no source identifier can spell,
+// so inlined bodies never collide. Arguments and the result are stored into
+// variables of the parameter and return types, so they are converted exactly
+// as a call would convert them. Hoisting must not change the order of
+// evaluation. A call is only hoisted if everything its statement evaluates
+// before it is free of side effects, cannot fail and reads no global. It must
+// also not sit in the right operand of && or ||. Calls in if conditions are
+// hoisted, but not those in loop conditions.
+//
+// A function is inlined when:
+// - it is not recursive (directly or through other functions);
+// - it returns only from its last statement;
+// - its body is at most MAX_SIZE nodes, or MAX_SIZE_ONCE if it has a single
+//   call site.
+// Functions are processed callees first, so an inlined body has already had
+// its own calls inlined. A caller grows by at most MAX_GROWTH nodes. Calls that
+// would not compile (wrong argument count, a shadowed name) are left alone, so
+// they still fail.
+class Inliner
+{
+    static const size_t MAX_SIZE = 40;
+    static const size_t MAX_SIZE_ONCE = 400;
+    static const size_t MAX_GROWTH = 4000;
+
+    struct Function
+    {
+        FuncDecl* func;
+        size_t item;                    // index in Program::globalItems
+        vector<int> callees;
+        size_t calls = 0;               // call sites in the program
+        bool recursive = false;
+        bool inlinable = false;
+        size_t size = 0;                // nodes in the body
+        vector<SymbolId> freeNames;     // globals and functions the body names
+        size_t lastGlobal = 0;          // item of the last global it reads, +1
+        // Tarjan's strongly connected components
+        int index = -1, low = 0;
+        bool onStack = false;
+
+        Function(FuncDecl* func, size_t item) : func(func), item(item) {}
+    };
+
+    Program* program;
+    vector<Function> functions;
+    unordered_map<SymbolId, int> functionIndex;     // -1 if defined more than once
+    unordered_map<SymbolId, size_t> globalItem;     // SIZE_MAX if declared more than once
+    size_t inlined = 0;
+    int fresh = 0;
+
+    // the caller being rewritten
+    Function* caller = nullptr;
+    ScopeStack scopes;
+    size_t growth = 0;
+    bool ordered = false;       // everything evaluated so far may run after a hoisted call
+    bool prefixEmpty = false;   // nothing has been evaluated so far
+
+    explicit Inliner(Program* program) : program(program) {}
+
+public:
+    // Rewrites the functions of program; returns the number of calls inlined.
+    static size_t Run(Program* program)
+    {
+        Inliner in(program);
+        in.collect();
+        vector<int> order;
+        vector<int> stack;
+        for (size_t f = 0; f < in.functions.size(); f++)
+            if (in.functions[f].index < 0)
+                in.components((int)f, stack, order);
+        for (int f : order)
+        {
+            in.inlineInto(in.functions[f]);
+            in.analyze(in.functions[f]);
+        }
+        return in.inlined;
+    }
+
+private:
+    // ---- call graph ----
+
+    void collect()
+    {
+        for (size_t i = 0; i < program->globalItems.size(); i++)
+        {
+            ASTPtr item = program->globalItems[i];
+            if (auto func = nodeCast<FuncDecl>(item))
+            {
+                auto it = functionIndex.find(func->name);
+                if (it != functionIndex.end())
+                    it->second = -1;
+                else
+                    functionIndex[func->name] = (int)functions.size();
+                functions.emplace_back(func, i);
+            }
+            else if (auto var = nodeCast<VarDeclStmt>(item))
+            {
+                auto it = globalItem.find(var->name);
+                if (it != globalItem.end())
+                    it->second = SIZE_MAX;
+                else
+                    globalItem[var->name] = i;
+            }
+        }
+        for (Function& f : functions)
+            if (f.func->body)
+                callsIn(f.func->body, f);
+    }
+
+    void callsIn(const ASTNode* n, Function& f)
+    {
+        if (!n)
+            return;
+        switch (n->kind)
+        {
+        case NK_CALL:
+        {
+            auto call = static_cast<const CallExpr*>(n);
+            if (auto id = nodeCast<IdentifierExpr>(call->callee))
+            {
+                auto it = functionIndex.find(id->name);
+                if (it != functionIndex.end() && it->second >= 0)
+                {
+                    functions[it->second].calls++;
+                    f.callees.push_back(it->second);
+                }
+            }
+            for (const Expr* arg : call->args)
+                callsIn(arg, f);
+            break;
+        }
+        case NK_UNARY: callsIn(static_cast<const UnaryExpr*>(n)->rhs, f); break;
+        case NK_BINARY:
+            callsIn(static_cast<const BinaryExpr*>(n)->left, f);
+            callsIn(static_cast<const BinaryExpr*>(n)->right, f);
+            break;
+        case NK_EXPR_STMT: callsIn(static_cast<const ExprStmt*>(n)->expr, f); break;
+        case NK_RETURN: callsIn(static_cast<const ReturnStmt*>(n)->expr, f); break;
+        case NK_VAR_DECL: callsIn(static_cast<const VarDeclStmt*>(n)->init, f); break;
+        case NK_IF:
+            callsIn(static_cast<const IfStmt*>(n)->cond, f);
+            callsIn(static_cast<const IfStmt*>(n)->thenStmt, f);
+            callsIn(static_cast<const IfStmt*>(n)->elseStmt, f);
+            break;
+        case NK_WHILE:
+            callsIn(static_cast<const WhileStmt*>(n)->cond, f);
+            callsIn(static_cast<const WhileStmt*>(n)->body, f);
+            break;
+        case NK_FOR:
+            callsIn(static_cast<const ForStmt*>(n)->init, f);
+            callsIn(static_cast<const ForStmt*>(n)->condStmt, f);
+            callsIn(static_cast<const ForStmt*>(n)->iterExpr, f);
+            callsIn(static_cast<const ForStmt*>(n)->body, f);
+            break;
+        case NK_BLOCK:
+            for (const Stmt* s : static_cast<const BlockStmt*>(n)->stmts)
+                callsIn(s, f);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Tarjan's algorithm; appends the functions to order callees first and
+    // marks the ones on a cycle as recursive
+    void components(int v, vector<int>& stack, vector<int>& order)
+    {
+        int counter = (int)order.size() + (int)stack.size();
+        Function& f = functions[v];
+        f.index = f.low = counter;
+        stack.push_back(v);
+        f.onStack = true;
+        for (int w : f.callees)
+        {
+            if (w == v)
+                f.recursive = true;
+            if (functions[w].index < 0)
+            {
+                components(w, stack, order);
+                f.low = min(f.low, functions[w].low);
+            }
+            else if (functions[w].onStack)
+                f.low = min(f.low, functions[w].index);
+        }
+        if (f.low != f.index)
+            return;
+        size_t start = find(stack.begin(), stack.end(), v) - stack.begin();
+        for (size_t i = start; i < stack.size(); i++)
+        {
+            functions[stack[i]].onStack = false;
+            if (stack.size() - start > 1)
+                functions[stack[i]].recursive = true;
+            order.push_back(stack[i]);
+        }
+        stack.resize(start);
+    }
+
+    // ---- which functions can be inlined ----
+
+    void analyze(Function& f)
+    {
+        FuncDecl* func = f.func;
+        if (f.recursive || !func->body || functionIndex[func->name] < 0 || globalItem.count(func->name))
+            return;
+        const vector<StmtPtr>& body = func->body->stmts;
+        bool isVoid = valueTypeOf(func->retType) == V_VOID;
+        // the only return is the last statement, with a value unless the function is void
+        size_t returns = 0;
+        for (const Stmt* s : body)
+            returns += countReturns(s);
+        auto last = body.empty() ? nullptr : nodeCast<ReturnStmt>(body.back());
+        if (isVoid ? returns > 1 || (returns == 1 && (!last || last->expr)) : returns != 1 || !last || !last->expr)
+            return;
+
+        // every parameter and local is declared once in its scope, with a type
+        // a variable can have; the free names are known globals and functions
+        ScopeStack locals;
+        locals.pushScope();
+        bool ok = true;
+        for (const Param& p : func->params)
+            ok &= declareOnce(locals, p.name, p.typeTok);
+        for (const Stmt* s : body)
+            ok &= freeNames(s, locals, f);
+        if (!ok)
+            return;
+        f.size = 0;
+        for (const Stmt* s : body)
+            f.size += countNodes(s);
+        f.inlinable = true;
+    }
+
+    static bool declareOnce(ScopeStack& locals, SymbolId name, TokenKind typeTok)
+    {
+        ValueType type = valueTypeOf(typeTok);
+        return locals.declareSym(Symbol(name, typeTok, false)) && type != V_VOID;
+    }
+
+    static size_t countReturns(const ASTNode* n)
+    {
+        if (!n)
+            return 0;
+        switch (n->kind)
+        {
+        case NK_RETURN: return 1;
+        case NK_IF: return countReturns(static_cast<const IfStmt*>(n)->thenStmt) + countReturns(static_cast<const IfStmt*>(n)->elseStmt);
+        case NK_WHILE: return countReturns(static_cast<const WhileStmt*>(n)->body);
+        case NK_FOR: return countReturns(static_cast<const ForStmt*>(n)->body);
+        case NK_BLOCK:
+        {
+            size_t count = 0;
+            for (const Stmt* s : static_cast<const BlockStmt*>(n)->stmts)
+                count += countReturns(s);
+            return count;
+        }
+        default: return 0;
+        }
+    }
+
+    static size_t countNodes(const ASTNode* n)
+    {
+        if (!n)
+            return 0;
+        switch (n->kind)
+        {
+        case NK_UNARY: return 1 + countNodes(static_cast<const UnaryExpr*>(n)->rhs);
+        case NK_POSTFIX: return 1 + countNodes(static_cast<const PostfixExpr*>(n)->base);
+        case NK_BINARY: return 1 + countNodes(static_cast<const BinaryExpr*>(n)->left) + countNodes(static_cast<const BinaryExpr*>(n)->right);
+        case NK_CALL:
+        {
+            size_t count = 1;
+            for (const Expr* arg : static_cast<const CallExpr*>(n)->args)
+                count += countNodes(arg);
+            return count;
+        }
+        case NK_EXPR_STMT: return 1 + countNodes(static_cast<const ExprStmt*>(n)->expr);
+        case NK_RETURN: return 1 + countNodes(static_cast<const ReturnStmt*>(n)->expr);
+        case NK_VAR_DECL: return 1 + countNodes(static_cast<const VarDeclStmt*>(n)->init);
+        case NK_IF:
+        {
+            auto ifs = static_cast<const IfStmt*>(n);
+            return 1 + countNodes(ifs->cond) + countNodes(ifs->thenStmt) + countNodes(ifs->elseStmt);
+        }
+        case NK_WHILE: return 1 + countNodes(static_cast<const WhileStmt*>(n)->cond) + countNodes(static_cast<const WhileStmt*>(n)->body);
+        case NK_FOR:
+        {
+            auto fs = static_cast<const ForStmt*>(n);
+            return 1 + countNodes(fs->init) + countNodes(fs->condStmt) + countNodes(fs->iterExpr) + countNodes(fs->body);
+        }
+        case NK_BLOCK:
+        {
+            size_t count = 1;
+            for (const Stmt* s : static_cast<const BlockStmt*>(n)->stmts)
+                count += countNodes(s);
+            return count;
+        }
+        default: return 1;
+        }
+    }
+
+    // records the names n uses that are not locals; false if one is neither a
+    // global declared once before f nor a function, or a local is redeclared
+    bool freeNames(const ASTNode* n, ScopeStack& locals, Function& f)
+    {
+        if (!n)
+            return true;
+        switch (n->kind)
+        {
+        case NK_IDENTIFIER:
+        {
+            SymbolId name = static_cast<const IdentifierExpr*>(n)->name;
+            if (locals.lookup(name))
+                return true;
+            auto it = globalItem.find(name);
+            if (it == globalItem.end() || it->second > f.item || functionIndex.count(name))
+                return false;
+            f.freeNames.push_back(name);
+            f.lastGlobal = max(f.lastGlobal, it->second + 1);
+            return true;
+        }
+        case NK_CALL:
+        {
+            auto call = static_cast<const CallExpr*>(n);
+            auto id = nodeCast<IdentifierExpr>(call->callee);
+            if (!id || locals.lookup(id->name))
+                return false;
+            auto it = functionIndex.find(id->name);
+            if (it == functionIndex.end() || it->second < 0 || functions[it->second].func->params.size() != call->args.size())
+                return false;
+            f.freeNames.push_back(id->name);
+            bool ok = true;
+            for (const Expr* arg : call->args)
+                ok &= freeNames(arg, locals, f);
+            return ok;
+        }
+        case NK_UNARY: return freeNames(static_cast<const UnaryExpr*>(n)->rhs, locals, f);
+        case NK_POSTFIX: return freeNames(static_cast<const PostfixExpr*>(n)->base, locals, f);
+        case NK_BINARY:
+            return freeNames(static_cast<const BinaryExpr*>(n)->left, locals, f)
+                & freeNames(static_cast<const BinaryExpr*>(n)->right, locals, f);
+        case NK_EXPR_STMT: return freeNames(static_cast<const ExprStmt*>(n)->expr, locals, f);
+        case NK_RETURN: return freeNames(static_cast<const ReturnStmt*>(n)->expr, locals, f);
+        case NK_VAR_DECL:
+        {
+            auto vd = static_cast<const VarDeclStmt*>(n);
+            bool ok = freeNames(vd->init, locals, f);
+            return declareOnce(locals, vd->name, vd->typeTok) && ok;
+        }
+        case NK_IF:
+        {
+            // a declaration that is a branch by itself would not be in a scope of its own
+            auto ifs = static_cast<const IfStmt*>(n);
+            if (nodeCast<VarDeclStmt>(ifs->thenStmt) || nodeCast<VarDeclStmt>(ifs->elseStmt))
+                return false;
+            return freeNames(ifs->cond, locals, f) & freeNames(ifs->thenStmt, locals, f) & freeNames(ifs->elseStmt, locals, f);
+        }
+        case NK_WHILE:
+        {
+            auto ws = static_cast<const WhileStmt*>(n);
+            return !nodeCast<VarDeclStmt>(ws->body) && freeNames(ws->cond, locals, f) & freeNames(ws->body, locals, f);
+        }
+        case NK_FOR:
+        {
+            auto fs = static_cast<const ForStmt*>(n);
+            if (nodeCast<VarDeclStmt>(fs->body))
+                return false;
+            locals.pushScope();
+            bool ok = freeNames(fs->init, locals, f) & freeNames(fs->condStmt, locals, f)
+                & freeNames(fs->iterExpr, locals, f) & freeNames(fs->body, locals, f);
+            locals.popScope();
+            return ok;
+        }
+        case NK_BLOCK:
+        {
+            locals.pushScope();
+            bool ok = true;
+            for (const Stmt* s : static_cast<const BlockStmt*>(n)->stmts)
+                ok &= freeNames(s, locals, f);
+            locals.popScope();
+            return ok;
+        }
+        default:
+            return true;
+        }
+    }
+
+    // ---- rewriting a caller ----
+
+    void inlineInto(Function& f)
+    {
+        if (!f.func->body)
+            return;
+        caller = &f;
+        growth = 0;
+        scopes = ScopeStack();
+        scopes.pushScope();
+        for (const Param& p : f.func->params)
+            scopes.declareSym(Symbol(p.name, p.typeTok, false));
+        inlineList(f.func->body->stmts);
+        scopes.popScope();
+    }
+
+    void inlineList(vector<StmtPtr>& stmts)
+    {
+        vector<StmtPtr> out;
+        out.reserve(stmts.size());
+        for (StmtPtr stmt : stmts)
+            inlineStmt(stmt, out);
+        stmts.swap(out);
+    }
+
+    // appends stmt, with the calls hoisted out of it, to out
+    void inlineStmt(StmtPtr stmt, vector<StmtPtr>& out)
+    {
+        switch (stmt->kind)
+        {
+        case NK_EXPR_STMT:
+        {
+            auto es = static_cast<ExprStmt*>(stmt);
+            if (es->expr)
+            {
+                // a void function is only called as a statement
+                auto call = nodeCast<CallExpr>(es->expr);
+                Function* callee = call ? inlinableCallee(call) : nullptr;
+                if (callee && valueTypeOf(callee->func->retType) == V_VOID)
+                {
+                    ordered = prefixEmpty = true;
+                    for (ExprPtr& arg : call->args)
+                        hoist(arg, out);
+                    expand(call, *callee, out);
+                    return;
+                }
+                hoistFrom(es->expr, out);
+            }
+            break;
+        }
+        case NK_RETURN:
+        {
+            auto rs = static_cast<ReturnStmt*>(stmt);
+            if (rs->expr)
+                hoistFrom(rs->expr, out);
+            break;
+        }
+        case NK_VAR_DECL:
+        {
+            auto vd = static_cast<VarDeclStmt*>(stmt);
+            if (vd->init)
+                hoistFrom(vd->init, out);
+            scopes.declareSym(Symbol(vd->name, vd->typeTok, false));
+            break;
+        }
+        case NK_IF:
+        {
+            auto ifs = static_cast<IfStmt*>(stmt);
+            hoistFrom(ifs->cond, out);
+            ifs->thenStmt = inlineBody(ifs->thenStmt);
+            if (ifs->elseStmt)
+                ifs->elseStmt = inlineBody(ifs->elseStmt);
+            break;
+        }
+        case NK_WHILE:
+        {
+            auto ws = static_cast<WhileStmt*>(stmt);
+            ws->body = inlineBody(ws->body);
+            break;
+        }
+        case NK_FOR:
+        {
+            auto fs = static_cast<ForStmt*>(stmt);
+            scopes.pushScope();
+            if (auto init = nodeCast<VarDeclStmt>(fs->init))
+                scopes.declareSym(Symbol(init->name, init->typeTok, false));
+            fs->body = inlineBody(fs->body);
+            scopes.popScope();
+            break;
+        }
+        case NK_BLOCK:
+            scopes.pushScope();
+            inlineList(static_cast<BlockStmt*>(stmt)->stmts);
+            scopes.popScope();
+            break;
+        default:
+            break;
+        }
+        out.push_back(stmt);
+    }
+
+    // an if, while or for body; it becomes a block if calls are hoisted out of it
+    StmtPtr inlineBody(StmtPtr body)
+    {
+        if (!body || body->kind == NK_VAR_DECL)
+            return body;
+        vector<StmtPtr> out;
+        if (body->kind == NK_BLOCK)
+        {
+            inlineStmt(body, out);
+            return body;
+        }
+        scopes.pushScope();
+        inlineStmt(body, out);
+        scopes.popScope();
+        if (out.size() == 1)
+            return out[0];
+        auto block = program->arena.make<BlockStmt>();
+        block->stmts = move(out);
+        return block;
+    }
+
+    // hoists the calls that can be inlined out of e, the whole expression of a statement
+    void hoistFrom(ExprPtr& e, vector<StmtPtr>& out)
+    {
+        ordered = true;
+        prefixEmpty = true;
+        hoist(e, out);
+    }
+
+    static bool isNumber(ValueType type)
+    {
+        return type == V_INT || type == V_FLOAT || type == V_BOOL;
+    }
+
+    // walks e in evaluation order, hoisting calls; returns its static type,
+    // V_VOID if not known
+    ValueType hoist(ExprPtr& e, vector<StmtPtr>& out)
+    {
+        switch (e->kind)
+        {
+        case NK_INT_LITERAL:
+        case NK_CHAR_LITERAL: return V_INT;
+        case NK_FLOAT_LITERAL: return V_FLOAT;
+        case NK_BOOL_LITERAL: return V_BOOL;
+        case NK_STRING_LITERAL: return V_STRING;
+        case NK_IDENTIFIER:
+        {
+            // a hoisted call may change a global, never a local of the caller
+            const Symbol* local = scopes.lookup(static_cast<IdentifierExpr*>(e)->name);
+            prefixEmpty = false;
+            if (!local)
+            {
+                ordered = false;
+                return V_VOID;
+            }
+            return valueTypeOf(local->type);
+        }
+        case NK_UNARY:
+        {
+            auto u = static_cast<UnaryExpr*>(e);
+            if (u->op == T_INC || u->op == T_DEC)
+            {
+                ordered = prefixEmpty = false;
+                return V_VOID;
+            }
+            ValueType t = hoist(u->rhs, out);
+            if (!isNumber(t))
+            {
+                ordered = false;
+                return V_VOID;
+            }
+            return u->op == T_NOT ? V_BOOL : u->op == T_MINUS && t != V_FLOAT ? V_INT : t;
+        }
+        case NK_BINARY:
+        {
+            auto b = static_cast<BinaryExpr*>(e);
+            if (b->op == T_ASSIGN)
+            {
+                hoist(b->right, out);
+                ordered = prefixEmpty = false;
+                return V_VOID;
+            }
+            ValueType l = hoist(b->left, out);
+            // the right operand of && and || may not run
+            if (b->op == T_AND || b->op == T_OR)
+            {
+                ordered = prefixEmpty = false;
+                return V_BOOL;
+            }
+            ValueType r = hoist(b->right, out);
+            // division can fail; so can anything on a string
+            if (b->op == T_DIV || b->op == T_MOD || !isNumber(l) || !isNumber(r))
+            {
+                ordered = false;
+                return V_VOID;
+            }
+            switch (b->op)
+            {
+            case T_EQ: case T_NEQ: case T_LT: case T_GT: case T_LEQ: case T_GEQ: return V_BOOL;
+            default: return l == V_FLOAT || r == V_FLOAT ? V_FLOAT : V_INT;
+            }
+        }
+        case NK_CALL:
+        {
+            auto call = static_cast<CallExpr*>(e);
+            bool before = ordered, emptyBefore = prefixEmpty;
+            for (ExprPtr& arg : call->args)
+                hoist(arg, out);
+            // the arguments move with the call, ahead of what was evaluated
+            // before them; that is only safe if neither has side effects, or
+            // nothing was evaluated before them
+            Function* callee = ordered || emptyBefore ? inlinableCallee(call) : nullptr;
+            if (!callee || valueTypeOf(callee->func->retType) == V_VOID)
+            {
+                ordered = prefixEmpty = false;
+                return V_VOID;
+            }
+            e = expand(call, *callee, out);
+            ordered = before;
+            prefixEmpty = emptyBefore;
+            return valueTypeOf(callee->func->retType);
+        }
+        default:
+            ordered = prefixEmpty = false;
+            return V_VOID;
+        }
+    }
+
+    // the function call would run, if it may be inlined here
+    Function* inlinableCallee(const CallExpr* call)
+    {
+        auto id = nodeCast<IdentifierExpr>(call->callee);
+        if (!id || scopes.lookup(id->name))
+            return nullptr;
+        auto it = functionIndex.find(id->name);
+        if (it == functionIndex.end() || it->second < 0)
+            return nullptr;
+        Function& f = functions[it->second];
+        if (!f.inlinable || &f == caller || f.func->params.size() != call->args.size())
+            return nullptr;
+        if (f.size > (f.calls == 1 ? MAX_SIZE_ONCE : MAX_SIZE) || growth + f.size > MAX_GROWTH)
+            return nullptr;
+        // the globals it reads are declared before the caller, and a local of
+        // the caller hides none of its names
+        if (f.lastGlobal > caller->item)
+            return nullptr;
+        for (SymbolId name : f.freeNames)
+            if (scopes.lookup(name))
+                return nullptr;
+        return &f;
+    }
+
+    // ---- expanding a call ----
+
+    SymbolId freshName(SymbolId name)
+    {
+        return Intern(string(SymbolName(name)) + "$" + to_string(++fresh));
+    }
+
+    // appends the body of callee, with call's arguments, to out; returns the
+    // variable holding the result, nullptr for a void function
+    ExprPtr expand(CallExpr* call, Function& callee, vector<StmtPtr>& out)
+    {
+        FuncDecl* func = callee.func;
+        inlined++;
+        growth += callee.size;
+
+        SymbolId result = NO_SYMBOL;
+        if (valueTypeOf(func->retType) != V_VOID)
+        {
+            result = freshName(func->name);
+            out.push_back(program->arena.make<VarDeclStmt>(func->retType, result, nullptr));
+        }
+
+        // parameters share the scope of the outermost block of the body
+        ScopeStack renames;
+        vector<SymbolId> newNames;
+        renames.pushScope();
+        auto block = program->arena.make<BlockStmt>();
+        for (size_t i = 0; i < func->params.size(); i++)
+        {
+            const Param& p = func->params[i];
+            block->stmts.push_back(program->arena.make<VarDeclStmt>(p.typeTok, rename(p.name, p.typeTok, renames, newNames), call->args[i]));
+        }
+        for (const Stmt* s : func->body->stmts)
+        {
+            if (auto rs = nodeCast<ReturnStmt>(s))
+            {
+                // the last statement
+                if (rs->expr)
+                {
+                    ExprPtr target = program->arena.make<IdentifierExpr>(result);
+                    ExprPtr value = clone(rs->expr, renames, newNames);
+                    block->stmts.push_back(program->arena.make<ExprStmt>(program->arena.make<BinaryExpr>(target, T_ASSIGN, value)));
+                }
+                break;
+            }
+            block->stmts.push_back(clone(s, renames, newNames));
+        }
+        out.push_back(block);
+        return result == NO_SYMBOL ? nullptr : program->arena.make<IdentifierExpr>(result);
+    }
+
+    SymbolId rename(SymbolId name, TokenKind typeTok, ScopeStack& renames, vector<SymbolId>& newNames)
+    {
+        SymbolId newName = freshName(name);
+        renames.declareSym(Symbol(name, typeTok, false, (int)newNames.size()));
+        newNames.push_back(newName);
+        return newName;
+    }
+
+    // copies of the callee's nodes, with its locals renamed; literals are
+    // never changed in place and are shared
+    ExprPtr clone(const Expr* e, ScopeStack& renames, vector<SymbolId>& newNames)
+    {
+        AstArena& arena = program->arena;
+        switch (e->kind)
+        {
+        case NK_IDENTIFIER:
+        {
+            SymbolId name = static_cast<const IdentifierExpr*>(e)->name;
+            const Symbol* local = renames.lookup(name);
+            return arena.make<IdentifierExpr>(local ? newNames[local->slot] : name);
+        }
+        case NK_UNARY:
+        {
+            auto u = static_cast<const UnaryExpr*>(e);
+            return arena.make<UnaryExpr>(u->op, clone(u->rhs, renames, newNames));
+        }
+        case NK_POSTFIX:
+        {
+            auto p = static_cast<const PostfixExpr*>(e);
+            return arena.make<PostfixExpr>(clone(p->base, renames, newNames), p->op);
+        }
+        case NK_BINARY:
+        {
+            auto b = static_cast<const BinaryExpr*>(e);
+            ExprPtr left = clone(b->left, renames, newNames);
+            return arena.make<BinaryExpr>(left, b->op, clone(b->right, renames, newNames));
+        }
+        case NK_CALL:
+        {
+            auto c = static_cast<const CallExpr*>(e);
+            auto call = arena.make<CallExpr>(clone(c->callee, renames, newNames));
+            for (const Expr* arg : c->args)
+                call->args.push_back(clone(arg, renames, newNames));
+            return call;
+        }
+        default:
+            return const_cast<Expr*>(e);
+        }
+    }
+
+    StmtPtr clone(const Stmt* s, ScopeStack& renames, vector<SymbolId>& newNames)
+    {
+        if (!s)
+            return nullptr;
+        AstArena& arena = program->arena;
+        switch (s->kind)
+        {
+        case NK_EXPR_STMT:
+        {
+            auto es = static_cast<const ExprStmt*>(s);
+            return arena.make<ExprStmt>(es->expr ? clone(es->expr, renames, newNames) : nullptr);
+        }
+        case NK_VAR_DECL:
+        {
+            // the initializer does not see the variable it initializes
+            auto vd = static_cast<const VarDeclStmt*>(s);
+            ExprPtr init = vd->init ? clone(vd->init, renames, newNames) : nullptr;
+            return arena.make<VarDeclStmt>(vd->typeTok, rename(vd->name, vd->typeTok, renames, newNames), init);
+        }
+        case NK_IF:
+        {
+            auto ifs = static_cast<const IfStmt*>(s);
+            ExprPtr cond = clone(ifs->cond, renames, newNames);
+            StmtPtr thenStmt = clone(ifs->thenStmt, renames, newNames);
+            return arena.make<IfStmt>(cond, thenStmt, clone(ifs->elseStmt, renames, newNames));
+        }
+        case NK_WHILE:
+        {
+            auto ws = static_cast<const WhileStmt*>(s);
+            ExprPtr cond = clone(ws->cond, renames, newNames);
+            return arena.make<WhileStmt>(cond, clone(ws->body, renames, newNames));
+        }
+        case NK_FOR:
+        {
+            auto fs = static_cast<const ForStmt*>(s);
+            renames.pushScope();
+            StmtPtr init = clone(fs->init, renames, newNames);
+            StmtPtr cond = clone(fs->condStmt, renames, newNames);
+            ExprPtr iter = fs->iterExpr ? clone(fs->iterExpr, renames, newNames) : nullptr;
+            StmtPtr body = clone(fs->body, renames, newNames);
+            renames.popScope();
+            return arena.make<ForStmt>(init, cond, iter, body);
+        }
+        case NK_BLOCK:
+        {
+            auto block = arena.make<BlockStmt>();
+            renames.pushScope();
+            for (const Stmt* stmt : static_cast<const BlockStmt*>(s)->stmts)
+                block->stmts.push_back(clone(stmt, renames, newNames));
+            renames.popScope();
+            return block;
+        }
+        default:
+            return const_cast<Stmt*>(s);
+        }
+    }
+};
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "TokenKind.h"
+using namespace std;
+
+struct KeywordEntry
+{
+    string_view word;
+    TokenKind kind = T_NONE;
+};
+
+constexpr uint32_t KeywordHash(string_view s, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : s)
+    {
+        h ^= (unsigned char)c;
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+// Perfect hash over a fixed keyword list, built entirely at compile time.
+// The constructor searches for a seed under which every keyword lands in its own
+// slot, so a lookup is one hash, one table load and one string compare.
+template <size_t N>
+class KeywordTable
+{
+    static constexpr size_t SLOTS = 256;     // power of two, several times N so a seed turns up quickly
+    static constexpr unsigned char EMPTY = 0xFF;
+    static_assert(N < EMPTY, "too many keywords for a byte-indexed table");
+
+    KeywordEntry entries[N];
+    unsigned char slot[SLOTS];
+    uint32_t seed;
+    size_t min_len;
+    size_t max_len;
+
+    constexpr bool TrySeed(uint32_t s)
+    {
+        for (size_t i = 0; i < SLOTS; i++)
+            slot[i] = EMPTY;
+        for (size_t i = 0; i < N; i++)
+        {
+            size_t h = KeywordHash(entries[i].word, s) & (SLOTS - 1);
+            if (slot[h] != EMPTY)
+                return false;
+            slot[h] = (unsigned char)i;
+        }
+        return true;
+    }
+
+public:
+    constexpr KeywordTable(const KeywordEntry (&words)[N]) : entries{}, slot{}, seed(0), min_len(~(size_t)0), max_len(0)
+    {
+        for (size_t i = 0; i < N; i++)
+        {
+            entries[i] = words[i];
+            if (words[i].word.size() < min_len) min_len = words[i].word.size();
+            if (words[i].word.size() > max_len) max_len = words[i].word.size();
+        }
+        for (uint32_t s = 1; s < 4096; s++)
+        {
+            if (TrySeed(s))
+            {
+                seed = s;
+                return;
+            }
+        }
+        throw "no perfect hash seed for this keyword set";
+    }
+
+    // Keyword kind of word, or T_IDENTIFIER if it is not a keyword.
+    constexpr TokenKind Lookup(string_view word) const
+    {
+        if (word.size() < min_len || word.size() > max_len)
+            return T_IDENTIFIER;
+        unsigned char i = slot[KeywordHash(word, seed) & (SLOTS - 1)];
+        if (i != EMPTY && entries[i].word == word)
+            return entries[i].kind;
+        return T_IDENTIFIER;
+    }
+};
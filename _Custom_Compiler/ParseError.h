@@ -18,7 +18,7 @@ public:
     }
     static ParseError FailedToFindToken(const token& t)
     {
-        return ParseError("Failed to find token near: " + t.val);
+        return ParseError("Failed to find token near: " + string(t.val));
     }
     static ParseError ExpectedTypeToken()
     {
@@ -30,7 +30,7 @@ public:
     }
     static ParseError UnexpectedToken(const token& t)
     {
-        return ParseError("Unexpected token: " + t.type + " (" + t.val + ")");
+        return ParseError("Unexpected token: " + string(TokenKindName(t.type)) + " (" + string(t.val) + ")");
     }
     static ParseError ExpectedFloatLit()
     {
@@ -7,7 +7,13 @@
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
+#include <string_view>
+#include <charconv>
+#include <cstdlib>
+#include <iomanip>
 #include "with_regex_Lexer.h" 
+#include "AstArena.h"
+#include "ThreadPool.h"
 
 using namespace std;
 
@@ -26,272 +32,271 @@ enum ParseError
 };
 
 
+// Tag stored in every node. Passes switch on it (see AstVisitor below) instead of
+// probing the node with casts.
+enum NodeKind : unsigned char
+{
+    NK_IDENTIFIER,
+    NK_INT_LITERAL,
+    NK_FLOAT_LITERAL,
+    NK_STRING_LITERAL,
+    NK_BOOL_LITERAL,
+    NK_CHAR_LITERAL,
+    NK_UNARY,
+    NK_BINARY,
+    NK_CALL,
+    NK_POSTFIX,
+    NK_EXPR_STMT,
+    NK_RETURN,
+    NK_VAR_DECL,
+    NK_IF,
+    NK_WHILE,
+    NK_FOR,
+    NK_BLOCK,
+    NK_FUNC_DECL,
+    NK_PROGRAM,
+};
+
 struct ASTNode
 {
-    virtual ~ASTNode() = default;
-    virtual void print(int indent = 0) const = 0;
-protected:
-    static void printIndent(int n) 
-    {
-        for (int i = 0; i < n; ++i) 
-            cout << "  ";
-    }
+    const NodeKind kind;
+    ASTNode(NodeKind k) : kind(k) {}
+    void print(int indent = 0) const;   // defined after AstPrinter
 };
 
-using ASTPtr = shared_ptr<ASTNode>;
+// Nodes live in the Program's AstArena and link to each other with raw pointers.
+using ASTPtr = ASTNode*;
+
+// Static type of an expression, filled in by the TypeChecker.
+enum TypeKind : unsigned char
+{
+    TY_UNKNOWN,     // not checked
+    TY_VOID,
+    TY_INT,
+    TY_FLOAT,
+    TY_DOUBLE,
+    TY_BOOL,
+    TY_STRING,
+    TY_CHAR,
+};
 
 struct Expr : ASTNode
 {
+    TypeKind type = TY_UNKNOWN;
+    Expr(NodeKind k) : ASTNode(k) {}
 };
-using ExprPtr = shared_ptr<Expr>;
+using ExprPtr = Expr*;
 
 struct Stmt : ASTNode
 {
+    Stmt(NodeKind k) : ASTNode(k) {}
 };
-using StmtPtr = shared_ptr<Stmt>;
+using StmtPtr = Stmt*;
+
+// Checked downcast: the node if it is a T, nullptr otherwise (or if n is null).
+template <class T>
+T* nodeCast(ASTNode* n)
+{
+    return n && n->kind == T::KIND ? static_cast<T*>(n) : nullptr;
+}
+template <class T>
+const T* nodeCast(const ASTNode* n)
+{
+    return n && n->kind == T::KIND ? static_cast<const T*>(n) : nullptr;
+}
 
 
 struct IdentifierExpr : Expr
 {
-    string name;
-    IdentifierExpr(string n) : name(n) {}
-    void print(int indent = 0) const override 
-    {
-        printIndent(indent);
-        cout << "Identifier(" << name << ")\n";
-    }
+    static const NodeKind KIND = NK_IDENTIFIER;
+    SymbolId name;
+    IdentifierExpr(SymbolId n) : Expr(KIND), name(n) {}
 };
 
+// Literals keep their source spelling (val) for printing and carry their value,
+// parsed once when the node is made. The value constructors are for passes
+// that compute new literals.
 struct IntLiteral : Expr
 {
+    static const NodeKind KIND = NK_INT_LITERAL;
     string val;
-    IntLiteral(string v) : val(v) {}
-    void print(int indent = 0) const override 
+    int64_t value = 0;
+    bool inRange = true;    // false if the spelling does not fit in 64 bits
+    IntLiteral(string v) : Expr(KIND), val(v)
     {
-        printIndent(indent);
-        cout << "Int(" << val << ")\n";
+        inRange = from_chars(val.data(), val.data() + val.size(), value).ec == errc();
     }
+    explicit IntLiteral(int64_t v) : Expr(KIND), val(to_string(v)), value(v) {}
 };
 
 struct FloatLiteral : Expr
 {
+    static const NodeKind KIND = NK_FLOAT_LITERAL;
     string val;
-    FloatLiteral(const string& v) : val(v) {}
-    void print(int indent = 0) const override {
-        printIndent(indent);
-        cout << "Float(" << val << ")\n";
+    double value = 0;
+    FloatLiteral(const string& v) : Expr(KIND), val(v), value(strtod(v.c_str(), nullptr)) {}
+    explicit FloatLiteral(double v) : Expr(KIND), value(v)
+    {
+        ostringstream o;
+        o << setprecision(17) << v;
+        val = o.str();
     }
 };
 
 struct StringLiteral : Expr
 {
-    string val;
-    StringLiteral(const string& v) : val(v) {}
-    void print(int indent = 0) const override {
-        printIndent(indent);
-        cout << "String(" << val << ")\n";
+    static const NodeKind KIND = NK_STRING_LITERAL;
+    string val;     // with the quotes and escapes
+    string text;    // the characters it stands for
+    StringLiteral(const string& v) : Expr(KIND), val(v)
+    {
+        for (size_t i = 1; i + 1 < v.size(); i++)
+        {
+            char c = v[i];
+            if (c == '\\' && i + 2 < v.size())
+            {
+                c = v[++i];
+                switch (c)
+                {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case '0': c = '\0'; break;
+                default: break;     // \\ \" \' and unknown escapes keep the character
+                }
+            }
+            text += c;
+        }
     }
 };
 
 struct BoolLiteral : Expr
 {
+    static const NodeKind KIND = NK_BOOL_LITERAL;
     string val;
-    BoolLiteral(const string& v) : val(v) {}
-    void print(int indent = 0) const override {
-        printIndent(indent);
-        cout << "Bool(" << val << ")\n";
-    }
+    bool value;
+    BoolLiteral(const string& v) : Expr(KIND), val(v), value(v == "true") {}
+    explicit BoolLiteral(bool v) : Expr(KIND), val(v ? "true" : "false"), value(v) {}
 };
 
 struct CharLiteral : Expr
 {
+    static const NodeKind KIND = NK_CHAR_LITERAL;
     string val;
-    CharLiteral(const string& v) : val(v) {}
-    void print(int indent = 0) const override {
-        printIndent(indent);
-        cout << "Char(" << val << ")\n";
-    }
+    int64_t value;  // 'c', a char is its code as in C
+    CharLiteral(const string& v) : Expr(KIND), val(v), value(v.size() >= 3 ? (unsigned char)v[1] : 0) {}
 };
 
 struct UnaryExpr : Expr
 {
-    string op;
+    static const NodeKind KIND = NK_UNARY;
+    TokenKind op;
     ExprPtr rhs;
-    UnaryExpr(const string& o, ExprPtr r) : op(o), rhs(r) {}
-    void print(int indent = 0) const override {
-        printIndent(indent);
-        cout << "UnaryOp(" << op << ")\n";
-        if (rhs) rhs->print(indent + 1);
-    }
+    UnaryExpr(TokenKind o, ExprPtr r) : Expr(KIND), op(o), rhs(r) {}
 };
 
 struct BinaryExpr : Expr
 {
-    string op;
+    static const NodeKind KIND = NK_BINARY;
     ExprPtr left;
+    TokenKind op;
     ExprPtr right;
-    BinaryExpr(ExprPtr l, const string& o, ExprPtr r) : left(l), op(o), right(r) {}
-    void print(int indent = 0) const override
-    {
-        printIndent(indent);
-        cout << "BinaryOp(" << op << ")\n";
-        if (left) left->print(indent + 1);
-        if (right) right->print(indent + 1);
-    }
+    BinaryExpr(ExprPtr l, TokenKind o, ExprPtr r) : Expr(KIND), left(l), op(o), right(r) {}
 };
 
 
 struct CallExpr : Expr
 {
+    static const NodeKind KIND = NK_CALL;
     ExprPtr callee;
     vector<ExprPtr> args;
-    CallExpr(ExprPtr c) : callee(c) {}
-    void print(int indent = 0) const override
-    {
-        printIndent(indent);
-        cout << "Call\n";
-        callee->print(indent + 1);
-        printIndent(indent + 1);
-        cout << "Args:\n";
-        for (auto& a : args) a->print(indent + 2);
-    }
+    CallExpr(ExprPtr c) : Expr(KIND), callee(c) {}
 };
 
 
 struct PostfixExpr : Expr
 {
+    static const NodeKind KIND = NK_POSTFIX;
     ExprPtr base;
-    string op;
-    PostfixExpr(ExprPtr b, const string& o) : base(b), op(o) {}
-    void print(int indent = 0) const override
-    {
-        printIndent(indent);
-        cout << "Postfix(" << op << ")\n";
-        base->print(indent + 1);
-    }
+    TokenKind op;
+    PostfixExpr(ExprPtr b, TokenKind o) : Expr(KIND), base(b), op(o) {}
 };
 
 // Statements
 struct ExprStmt : Stmt
 {
+    static const NodeKind KIND = NK_EXPR_STMT;
     ExprPtr expr;
-    ExprStmt(ExprPtr e) : expr(e) {}
-    void print(int indent = 0) const override {
-        printIndent(indent); cout << "ExprStmt\n"; if (expr) expr->print(indent + 1);
-    }
+    ExprStmt(ExprPtr e) : Stmt(KIND), expr(e) {}
 };
 
 struct ReturnStmt : Stmt
 {
+    static const NodeKind KIND = NK_RETURN;
     ExprPtr expr;
-    ReturnStmt(ExprPtr e) : expr(e) {}
-    void print(int indent = 0) const override {
-        printIndent(indent); cout << "Return\n"; if (expr) expr->print(indent + 1);
-    }
+    ReturnStmt(ExprPtr e) : Stmt(KIND), expr(e) {}
 };
 
 struct VarDeclStmt : Stmt
 {
-    string typeTok;
-    string name;
+    static const NodeKind KIND = NK_VAR_DECL;
+    TokenKind typeTok;
+    SymbolId name;
     ExprPtr init;
-    VarDeclStmt(const string& t, const string& n, ExprPtr i) : typeTok(t), name(n), init(i) {}
-    void print(int indent = 0) const override {
-        printIndent(indent); cout << "VarDecl (" << typeTok << " " << name << ")\n";
-        if (init) { printIndent(indent + 1); cout << "Init:\n"; init->print(indent + 2); }
-    }
+    VarDeclStmt(TokenKind t, SymbolId n, ExprPtr i) : Stmt(KIND), typeTok(t), name(n), init(i) {}
 };
 
 struct IfStmt : Stmt
 {
+    static const NodeKind KIND = NK_IF;
     ExprPtr cond;
     StmtPtr thenStmt;
     StmtPtr elseStmt;
-    IfStmt(ExprPtr c, StmtPtr t, StmtPtr e = nullptr) : cond(c), thenStmt(t), elseStmt(e)
+    IfStmt(ExprPtr c, StmtPtr t, StmtPtr e = nullptr) : Stmt(KIND), cond(c), thenStmt(t), elseStmt(e)
     {}
-    void print(int indent = 0) const override
-    {
-        printIndent(indent); cout << "If\n";
-        printIndent(indent + 1); cout << "Cond:\n"; if (cond) cond->print(indent + 2);
-        printIndent(indent + 1); cout << "Then:\n"; if (thenStmt) thenStmt->print(indent + 2);
-        if (elseStmt)
-        {
-            printIndent(indent + 1); cout << "Else:\n"; elseStmt->print(indent + 2);
-        }
-    }
 };
 
 struct WhileStmt : Stmt
 {
+    static const NodeKind KIND = NK_WHILE;
     ExprPtr cond;
     StmtPtr body;
-    WhileStmt(ExprPtr c, StmtPtr b) : cond(c), body(b)
+    WhileStmt(ExprPtr c, StmtPtr b) : Stmt(KIND), cond(c), body(b)
     {}
-    void print(int indent = 0) const override
-    {
-        printIndent(indent); cout << "While\n";
-        printIndent(indent + 1); cout << "Cond:\n"; if (cond) cond->print(indent + 2);
-        printIndent(indent + 1); cout << "Body:\n"; if (body) body->print(indent + 2);
-    }
 };
 
 struct ForStmt : Stmt
 {
+    static const NodeKind KIND = NK_FOR;
     StmtPtr init;
     StmtPtr condStmt;
     ExprPtr iterExpr;
     StmtPtr body;
-    ForStmt(StmtPtr i, StmtPtr c, ExprPtr it, StmtPtr b) : init(i), condStmt(c), iterExpr(it), body(b) {}
-    void print(int indent = 0) const override
-    {
-        printIndent(indent); cout << "For\n";
-        printIndent(indent + 1); cout << "Init:\n"; if (init) init->print(indent + 2);
-        printIndent(indent + 1); cout << "CondStmt:\n"; if (condStmt) condStmt->print(indent + 2);
-        if (iterExpr) { printIndent(indent + 1); cout << "Iter:\n"; iterExpr->print(indent + 2); }
-        printIndent(indent + 1); cout << "Body:\n"; if (body) body->print(indent + 2);
-    }
+    ForStmt(StmtPtr i, StmtPtr c, ExprPtr it, StmtPtr b) : Stmt(KIND), init(i), condStmt(c), iterExpr(it), body(b) {}
 };
 
 struct BlockStmt : Stmt
 {
+    static const NodeKind KIND = NK_BLOCK;
     vector<StmtPtr> stmts;
-    void print(int indent = 0) const override
-    {
-        printIndent(indent); cout << "Block\n";
-        for (auto& s : stmts) if (s) s->print(indent + 1);
-    }
+    BlockStmt() : Stmt(KIND) {}
 };
 
 // Function declaration
 struct Param
 {
-    string typeTok;
-    string name;
+    TokenKind typeTok;
+    SymbolId name;
 };
 
 struct FuncDecl : ASTNode
 {
-    string retType;
-    string name;
+    static const NodeKind KIND = NK_FUNC_DECL;
+    TokenKind retType = T_NONE;
+    SymbolId name = NO_SYMBOL;
     vector<Param> params;
-    shared_ptr<BlockStmt> body;
-    FuncDecl() = default;
-    void print(int indent = 0) const override
-    {
-        printIndent(indent);
-        cout << "FuncDecl " << name << " : " << retType << "\n";
-        printIndent(indent + 1); cout << "Params:\n";
-        for (auto& p : params)
-        {
-            printIndent(indent + 2);
-            cout << p.typeTok << " " << p.name << "\n";
-        }
-        if (body)
-        {
-            printIndent(indent + 1); cout << "Body:\n";
-            body->print(indent + 2);
-        }
-    }
+    BlockStmt* body = nullptr;
+    FuncDecl() : ASTNode(KIND) {}
 };
 
 //struct Program : ASTNode
@@ -326,48 +331,308 @@ struct FuncDecl : ASTNode
 
 struct Program : ASTNode
 {
-    vector<shared_ptr<ASTNode>> globalItems; // single array for both funcs + globals
+    static const NodeKind KIND = NK_PROGRAM;
+    AstArena arena;                 // owns every node below, freed all at once with the Program
+    vector<ASTPtr> globalItems; // single array for both funcs + globals
+    Program() : ASTNode(KIND) {}
+};
+
+
+// Switch based visitor shared by every pass over the AST.
+// A pass derives from AstVisitor<Pass, Result> and defines the visitXxx members it
+// cares about; visit(n) makes one switch on n->kind and calls the right one.
+// Kinds the pass does not handle go to visitDefault, which does nothing.
+template <class Derived, class R = void>
+struct AstVisitor
+{
+    R visit(const ASTNode* n)
+    {
+        Derived& d = static_cast<Derived&>(*this);
+        switch (n->kind)
+        {
+        case NK_IDENTIFIER: return d.visitIdentifier(static_cast<const IdentifierExpr*>(n));
+        case NK_INT_LITERAL: return d.visitIntLiteral(static_cast<const IntLiteral*>(n));
+        case NK_FLOAT_LITERAL: return d.visitFloatLiteral(static_cast<const FloatLiteral*>(n));
+        case NK_STRING_LITERAL: return d.visitStringLiteral(static_cast<const StringLiteral*>(n));
+        case NK_BOOL_LITERAL: return d.visitBoolLiteral(static_cast<const BoolLiteral*>(n));
+        case NK_CHAR_LITERAL: return d.visitCharLiteral(static_cast<const CharLiteral*>(n));
+        case NK_UNARY: return d.visitUnary(static_cast<const UnaryExpr*>(n));
+        case NK_BINARY: return d.visitBinary(static_cast<const BinaryExpr*>(n));
+        case NK_CALL: return d.visitCall(static_cast<const CallExpr*>(n));
+        case NK_POSTFIX: return d.visitPostfix(static_cast<const PostfixExpr*>(n));
+        case NK_EXPR_STMT: return d.visitExprStmt(static_cast<const ExprStmt*>(n));
+        case NK_RETURN: return d.visitReturn(static_cast<const ReturnStmt*>(n));
+        case NK_VAR_DECL: return d.visitVarDecl(static_cast<const VarDeclStmt*>(n));
+        case NK_IF: return d.visitIf(static_cast<const IfStmt*>(n));
+        case NK_WHILE: return d.visitWhile(static_cast<const WhileStmt*>(n));
+        case NK_FOR: return d.visitFor(static_cast<const ForStmt*>(n));
+        case NK_BLOCK: return d.visitBlock(static_cast<const BlockStmt*>(n));
+        case NK_FUNC_DECL: return d.visitFuncDecl(static_cast<const FuncDecl*>(n));
+        case NK_PROGRAM: return d.visitProgram(static_cast<const Program*>(n));
+        }
+        return d.visitDefault(n);
+    }
+
+    R visitDefault(const ASTNode*) { return R(); }
+    R visitIdentifier(const IdentifierExpr* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitIntLiteral(const IntLiteral* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitFloatLiteral(const FloatLiteral* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitStringLiteral(const StringLiteral* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitBoolLiteral(const BoolLiteral* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitCharLiteral(const CharLiteral* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitUnary(const UnaryExpr* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitBinary(const BinaryExpr* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitCall(const CallExpr* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitPostfix(const PostfixExpr* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitExprStmt(const ExprStmt* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitReturn(const ReturnStmt* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitVarDecl(const VarDeclStmt* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitIf(const IfStmt* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitWhile(const WhileStmt* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitFor(const ForStmt* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitBlock(const BlockStmt* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitFuncDecl(const FuncDecl* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+    R visitProgram(const Program* n) { return static_cast<Derived&>(*this).visitDefault(n); }
+};
+
+// Prints the tree in the indented text format used by ASTNode::print.
+struct AstPrinter : AstVisitor<AstPrinter>
+{
+    int indent;
+    AstPrinter(int indent = 0) : indent(indent) {}
+
+    void printIndent(int n)
+    {
+        for (int i = 0; i < n; ++i)
+            cout << "  ";
+    }
+    // print a child at the given indentation
+    void child(const ASTNode* n, int at)
+    {
+        int saved = indent;
+        indent = at;
+        visit(n);
+        indent = saved;
+    }
 
-    void print(int indent = 0) const override
+    void visitIdentifier(const IdentifierExpr* n)
+    {
+        printIndent(indent);
+        cout << "Identifier(" << SymbolName(n->name) << ")\n";
+    }
+    void visitIntLiteral(const IntLiteral* n)
+    {
+        printIndent(indent);
+        cout << "Int(" << n->val << ")\n";
+    }
+    void visitFloatLiteral(const FloatLiteral* n)
+    {
+        printIndent(indent);
+        cout << "Float(" << n->val << ")\n";
+    }
+    void visitStringLiteral(const StringLiteral* n)
+    {
+        printIndent(indent);
+        cout << "String(" << n->val << ")\n";
+    }
+    void visitBoolLiteral(const BoolLiteral* n)
+    {
+        printIndent(indent);
+        cout << "Bool(" << n->val << ")\n";
+    }
+    void visitCharLiteral(const CharLiteral* n)
+    {
+        printIndent(indent);
+        cout << "Char(" << n->val << ")\n";
+    }
+    void visitUnary(const UnaryExpr* n)
+    {
+        printIndent(indent);
+        cout << "UnaryOp(" << TokenKindName(n->op) << ")\n";
+        if (n->rhs) child(n->rhs, indent + 1);
+    }
+    void visitBinary(const BinaryExpr* n)
+    {
+        printIndent(indent);
+        cout << "BinaryOp(" << TokenKindName(n->op) << ")\n";
+        if (n->left) child(n->left, indent + 1);
+        if (n->right) child(n->right, indent + 1);
+    }
+    void visitCall(const CallExpr* n)
+    {
+        printIndent(indent);
+        cout << "Call\n";
+        child(n->callee, indent + 1);
+        printIndent(indent + 1);
+        cout << "Args:\n";
+        for (auto& a : n->args) child(a, indent + 2);
+    }
+    void visitPostfix(const PostfixExpr* n)
+    {
+        printIndent(indent);
+        cout << "Postfix(" << TokenKindName(n->op) << ")\n";
+        child(n->base, indent + 1);
+    }
+    void visitExprStmt(const ExprStmt* n)
+    {
+        printIndent(indent); cout << "ExprStmt\n"; if (n->expr) child(n->expr, indent + 1);
+    }
+    void visitReturn(const ReturnStmt* n)
+    {
+        printIndent(indent); cout << "Return\n"; if (n->expr) child(n->expr, indent + 1);
+    }
+    void visitVarDecl(const VarDeclStmt* n)
+    {
+        printIndent(indent); cout << "VarDecl (" << TokenKindName(n->typeTok) << " " << SymbolName(n->name) << ")\n";
+        if (n->init) { printIndent(indent + 1); cout << "Init:\n"; child(n->init, indent + 2); }
+    }
+    void visitIf(const IfStmt* n)
+    {
+        printIndent(indent); cout << "If\n";
+        printIndent(indent + 1); cout << "Cond:\n"; if (n->cond) child(n->cond, indent + 2);
+        printIndent(indent + 1); cout << "Then:\n"; if (n->thenStmt) child(n->thenStmt, indent + 2);
+        if (n->elseStmt)
+        {
+            printIndent(indent + 1); cout << "Else:\n"; child(n->elseStmt, indent + 2);
+        }
+    }
+    void visitWhile(const WhileStmt* n)
+    {
+        printIndent(indent); cout << "While\n";
+        printIndent(indent + 1); cout << "Cond:\n"; if (n->cond) child(n->cond, indent + 2);
+        printIndent(indent + 1); cout << "Body:\n"; if (n->body) child(n->body, indent + 2);
+    }
+    void visitFor(const ForStmt* n)
+    {
+        printIndent(indent); cout << "For\n";
+        printIndent(indent + 1); cout << "Init:\n"; if (n->init) child(n->init, indent + 2);
+        printIndent(indent + 1); cout << "CondStmt:\n"; if (n->condStmt) child(n->condStmt, indent + 2);
+        if (n->iterExpr) { printIndent(indent + 1); cout << "Iter:\n"; child(n->iterExpr, indent + 2); }
+        printIndent(indent + 1); cout << "Body:\n"; if (n->body) child(n->body, indent + 2);
+    }
+    void visitBlock(const BlockStmt* n)
+    {
+        printIndent(indent); cout << "Block\n";
+        for (auto& s : n->stmts) if (s) child(s, indent + 1);
+    }
+    void visitFuncDecl(const FuncDecl* n)
+    {
+        printIndent(indent);
+        cout << "FuncDecl " << SymbolName(n->name) << " : " << TokenKindName(n->retType) << "\n";
+        printIndent(indent + 1); cout << "Params:\n";
+        for (auto& p : n->params)
+        {
+            printIndent(indent + 2);
+            cout << TokenKindName(p.typeTok) << " " << SymbolName(p.name) << "\n";
+        }
+        if (n->body)
+        {
+            printIndent(indent + 1); cout << "Body:\n";
+            child(n->body, indent + 2);
+        }
+    }
+    void visitProgram(const Program* n)
     {
         cout << "Program\n";
-        for (auto& item : globalItems)
-            item->print(indent + 1);
+        for (auto& item : n->globalItems)
+            child(item, indent + 1);
     }
 };
 
+inline void ASTNode::print(int indent) const
+{
+    AstPrinter(indent).visit(this);
+}
+
 
 class Parser
 {
-    vector<token> tokens;
-    size_t pos;
+    // Tokens are pulled from the lexer on demand into a small ring buffer.
+    // The grammar looks at most 3 tokens ahead (parseProgram's global variable check),
+    // and one more slot keeps the token last returned by advance() valid.
+    static const size_t LOOKAHEAD = 4;
+
     Lexer_regex lexer;
+    AstArena* arena;    // arena of the Program being parsed
+    token ring[LOOKAHEAD];
+    size_t head;        // slot of the current token
+    size_t buffered;    // tokens in the ring starting at head
+    int last_line;
+
+    // Parsers working on part of a file (parseProgramParallel) read an already
+    // lexed token range instead of the lexer.
+    bool from_span = false;
+    const token* span = nullptr;
+    const token* span_end = nullptr;
+    bool resume_lexer = false;  // go on with the lexer once the range is used up
+    bool past_end = false;      // set when a token past the end of the input was asked for
+
+    Parser(const token* begin, const token* end, AstArena* arena)
+        : arena(arena), head(0), buffered(0), last_line(0), from_span(true), span(begin), span_end(end)
+    {
+    }
+
+    bool nextToken(token& out)
+    {
+        if (!from_span)
+            return lexer.NextToken(out);
+        if (span != span_end)
+        {
+            out = *span++;
+            return true;
+        }
+        return resume_lexer && lexer.NextToken(out);
+    }
 
-    token peekToken() const
+    // make sure the i-th token from the current one is in the ring
+    const token& peekAt(size_t i)
+    {
+        while (buffered <= i)
+        {
+            token& slot = ring[(head + buffered) % LOOKAHEAD];
+            if (!nextToken(slot))
+            {
+                slot = token(T_EOF, "UnexpectedEOF", last_line);
+                past_end = true;
+            }
+            last_line = slot.line_no;
+            buffered++;
+        }
+        return ring[(head + i) % LOOKAHEAD];
+    }
+    const token& peekToken()
     {
-        if (pos < tokens.size()) return tokens[pos];
-        return token("eof", "UnexpectedEOF", 0);
+        return peekAt(0);
     }
-    token peekNext() const
+    const token& peekNext()
     {
-        if (pos + 1 < tokens.size()) return tokens[pos + 1];
-        return token("eof", "UnexpectedEOF", 0);
+        return peekAt(1);
     }
-    token advance()
+    const token& advance()
     {
-        if (pos < tokens.size()) return tokens[pos++];
-        return token("eof", "UnexpectedEOF", 0);
+        const token& t = peekAt(0);
+        if (t.type != T_EOF)
+        {
+            head = (head + 1) % LOOKAHEAD;
+            buffered--;
+        }
+        return t;
     }
-    bool isAtEnd() const
+    template <class T, class... Args>
+    T* make(Args&&... args)
     {
-        return pos >= tokens.size() || tokens[pos].type == "eof";
+        return arena->make<T>(forward<Args>(args)...);
     }
-    bool check(const string& type) const
+    bool isAtEnd()
+    {
+        return peekToken().type == T_EOF;
+    }
+    bool check(TokenKind type)
     {
         if (isAtEnd()) return false;
         return peekToken().type == type;
     }
-    bool match(const string& type)
+    bool match(TokenKind type)
     {
         if (check(type))
         {
@@ -377,12 +642,12 @@ class Parser
 
         return false;
     }
-    void expect(const string& type, ParseError err, string token_ = "")
+    void expect(TokenKind type, ParseError err, string_view token_ = "")
     {
         if (!check(type))
         {
-            token t = peekToken();
-            string Unexp_tok = t.val;
+            const token& t = peekToken();
+            string Unexp_tok(t.val);
             string msg = "Error: ";
 
             switch (err)
@@ -401,7 +666,7 @@ class Parser
 
 
             msg += " at line " + to_string(t.line_no) +
-                " token='" + t.val + "' type=" + t.type;
+                " token='" + Unexp_tok + "' type=" + TokenKindName(t.type);
 
             throw runtime_error(msg);
         }
@@ -411,34 +676,28 @@ class Parser
     }
 
 public:
-    Parser(const string& filename) : pos(0)
+    Parser(const string& filename) : arena(nullptr), head(0), buffered(0), last_line(0)
     {
-        tokens = lexer.GenerateTokens(filename);
-       /* for (auto i : tokens)
-            cout << i.type << " " << i.val << endl;        */
-        if (tokens.empty() || tokens.back().type != "eof")
-            tokens.push_back(token("eof", "UnexpectedEOF", tokens.back().line_no));
+        lexer.Open(filename);
     }
 
  /*   shared_ptr<Program> parseProgram()
     {
         auto program = make_shared<Program>();
-        while (!isAtEnd() && peekToken().type != "eof")
+        while (!isAtEnd() && peekToken().type != T_EOF)
         {
             program->functions.push_back(parseFunction());
         }
         return program;
     }*/
     void parseComment() {
-        token t = peekToken();
-
         // If current token is comment start
-        if (check("T_COMSTART")) {
+        if (check(T_COMSTART)) {
             advance(); // consume /*
             bool foundEnd = false;
 
             while (!isAtEnd()) {
-                if (check("T_COMEND")) {
+                if (check(T_COMEND)) {
                     foundEnd = true;
                     advance(); // consume */
                     break;
@@ -449,13 +708,13 @@ public:
             }
 
             if (!foundEnd) {
-                token tk = peekToken();
+                const token& tk = peekToken();
                 ThrowError("Expected comment end '*/' before EOF", tk.line_no, tk.val, tk.type);
             }
         }
         // If we find comment end without start
-        else if (check("T_COMEND")) {
-            token tk = peekToken();
+        else if (check(T_COMEND)) {
+            const token& tk = peekToken();
             ThrowError("Unexpected comment end '*/' without matching start", tk.line_no, tk.val, tk.type);
         }
         // Otherwise just move forward
@@ -467,63 +726,152 @@ public:
     shared_ptr<Program> parseProgram()
     {
         auto program = make_shared<Program>();
+        arena = &program->arena;
+        parseItems(program->globalItems);
+        return program;
+    }
 
-        while (!isAtEnd() && peekToken().type != "eof")
-        {
+    // Same result as parseProgram, with the file lexed and the top-level items
+    // parsed on the pool. The file is lexed up front in chunks, then cut into runs of whole items where the
+    // token stream is back at brace depth 0 after a '}' or ';'. Each run is
+    // parsed by its own Parser into its own arena, and the items and arenas are
+    // joined in source order. A run only counts if it parsed without errors and
+    // without looking past its last token; otherwise the whole token stream is
+    // parsed again in one go, so errors come out exactly as from parseProgram.
+    // Use it instead of parseProgram, on a Parser that has not parsed anything.
+    shared_ptr<Program> parseProgramParallel(ThreadPool& pool = ThreadPool::Shared())
+    {
+        vector<token> tokens;
+        // an invalid token is left in the lexer, which reports it once the parser gets that far
+        lexer.SetExitOnInvalid(false);
+        bool invalid = !lexer.TokenizeParallel(tokens, pool);
+        lexer.SetExitOnInvalid(true);
 
-            if (check("T_COMSTART") || check("T_COMEND")) {
-                parseComment();
+        auto program = make_shared<Program>();
+        const token* first = tokens.data();
+        const token* last = tokens.data() + tokens.size();
+
+        // split points, each just after an item
+        vector<size_t> splits;
+        size_t runs = pool.Size() == 1 ? 1 : pool.Size() * 4;
+        int depth = 0;
+        for (size_t i = 0; i < tokens.size() && splits.size() + 1 < runs; i++)
+        {
+            if (tokens[i].type == T_LBRACE)
+                depth++;
+            else if (tokens[i].type == T_RBRACE)
+                depth--;
+            else if (tokens[i].type != T_SEMICOLON || depth != 0)
                 continue;
-            }
-            token t = peekToken();
+            if (depth == 0 && i + 1 < tokens.size() && i + 1 >= tokens.size() * (splits.size() + 1) / runs)
+                splits.push_back(i + 1);
+        }
 
-            // Check if this could be a global variable
-            if (isTypeToken(t.type))
+        if (!invalid && !splits.empty())
+        {
+            struct Run
+            {
+                AstArena arena;
+                vector<ASTPtr> items;
+                bool ok = false;
+            };
+            vector<Run> parsed(splits.size() + 1);
+            pool.ParallelFor(parsed.size(), [&](size_t k) {
+                const token* begin = k == 0 ? first : first + splits[k - 1];
+                const token* end = k == splits.size() ? last : first + splits[k];
+                Parser sub(begin, end, &parsed[k].arena);
+                try
+                {
+                    parsed[k].ok = sub.parseItems(parsed[k].items);
+                }
+                catch (...)
+                {
+                    parsed[k].ok = false;
+                }
+            });
+            bool ok = true;
+            for (const Run& r : parsed)
+                ok = ok && r.ok;
+            if (ok)
             {
-                token next = peekNext();
-                if (next.type == "T_IDENTIFIER")
+                for (Run& r : parsed)
                 {
-                    size_t save = pos;
-                    advance(); advance();
+                    program->arena.Adopt(r.arena);
+                    program->globalItems.insert(program->globalItems.end(), r.items.begin(), r.items.end());
+                }
+                return program;
+            }
+        }
 
-                    if (check("T_ASSIGN") || check("T_SEMICOLON"))
-                    {
-                        pos = save;
+        arena = &program->arena;
+        from_span = true;
+        span = first;
+        span_end = last;
+        resume_lexer = invalid;
+        parseItems(program->globalItems);
+        return program;
+    }
 
-                        StmtPtr stmt = parseVarDeclStmt();
-                        auto varDecl = dynamic_pointer_cast<VarDeclStmt>(stmt);
-                        if (!varDecl)
-                            throw runtime_error("Expected VarDeclStmt while parsing global variable");
+private:
+    // Top-level items until the end of the input. Returns false if an item had
+    // to look past the end of the input to be parsed.
+    bool parseItems(vector<ASTPtr>& items)
+    {
+        bool complete = true;
+        while (!isAtEnd() && peekToken().type != T_EOF)
+        {
+            parseItem(items);
+            if (past_end)
+                complete = false;
+        }
+        return complete;
+    }
 
-                        program->globalItems.push_back(varDecl);
-                        continue;
-                    }
+    void parseItem(vector<ASTPtr>& items)
+    {
+        if (check(T_COMSTART) || check(T_COMEND)) {
+            parseComment();
+            return;
+        }
+        const token& t = peekToken();
+
+        // Check if this could be a global variable
+        if (isTypeToken(t.type))
+        {
+            const token& next = peekNext();
+            if (next.type == T_IDENTIFIER)
+            {
+                TokenKind after = peekAt(2).type;
 
-                    pos = save;
+                if (after == T_ASSIGN || after == T_SEMICOLON)
+                {
+                    StmtPtr stmt = parseVarDeclStmt();
+                    auto varDecl = nodeCast<VarDeclStmt>(stmt);
+                    if (!varDecl)
+                        throw runtime_error("Expected VarDeclStmt while parsing global variable");
+
+                    items.push_back(varDecl);
+                    return;
                 }
             }
-            
-            program->globalItems.push_back(parseFunction());
         }
-
-        return program;
+        
+        items.push_back(parseFunction());
     }
 
-
-private:
-    void ThrowError(string message, int line_no, string val, string type)
+    void ThrowError(string message, int line_no, string_view val, TokenKind type)
     {
-        string final_messgae = message + to_string(line_no) + "\nError Type: " + type + "\nToken Found: " + val;
+        string final_messgae = message + to_string(line_no) + "\nError Type: " + TokenKindName(type) + "\nToken Found: " + string(val);
         throw runtime_error(final_messgae);
     }
     //We have defined out grammar here
     //====================================================================================
-    // FunctionDecl → Type T_IDENTIFIER T_LPAREN Params T_RPAREN Block
-    shared_ptr<FuncDecl> parseFunction()
+    // FunctionDecl → Type (T_IDENTIFIER | T_MAIN) T_LPAREN Params T_RPAREN Block
+    FuncDecl* parseFunction()
     {
-        auto fd = make_shared<FuncDecl>();
+        auto fd = make<FuncDecl>();
 
-        token t = peekToken();
+        const token& t = peekToken();
         if (!isTypeToken(t.type))
         {
             string message = "Expected function return type at line";
@@ -534,49 +882,55 @@ private:
         advance();
 
 
-        if (!check("T_IDENTIFIER")) {
-            token tk = peekToken();
+        // main is a keyword to the lexer but an ordinary function name here
+        if (!check(T_IDENTIFIER) && !check(T_MAIN)) {
+            const token& tk = peekToken();
             string message = "Expected identifier for function name at line ";
             ThrowError(message, tk.line_no, tk.val, tk.type);
 
 
         }
-        fd->name = peekToken().val;
-        token op = advance();
+        fd->name = check(T_MAIN) ? Intern("main") : peekToken().sym;
+        string_view op = advance().val;
 
-        expect("T_LPAREN", UnexpectedToken, op.val);
+        expect(T_LPAREN, UnexpectedToken, op);
 
 
-        if (!check("T_RPAREN")) {
+        if (!check(T_RPAREN)) {
 
             while (true) {
                 Param p = parseParam();
                 fd->params.push_back(p);
-                if (check("T_COMMA")) {
+                if (check(T_COMMA)) {
                     advance();
                     continue;
                 }
                 else break;
             }
         }
-        op = peekToken();
-        expect("T_RPAREN", UnexpectedToken, op.val);
+        op = peekToken().val;
+        expect(T_RPAREN, UnexpectedToken, op);
 
 
         fd->body = parseBlockStmt();
         return fd;
     }
 
-    bool isTypeToken(const string& tt)
+    bool isTypeToken(TokenKind tt)
     {
-        static vector<string> types = { "T_INT","T_FLOAT","T_DOUBLE","T_STRING","T_BOOL","T_VOID" };
-        return find(types.begin(), types.end(), tt) != types.end();
+        switch (tt)
+        {
+        case T_INT: case T_FLOAT: case T_DOUBLE: case T_STRING: case T_BOOL: case T_VOID:
+            return true;
+        default:
+            return false;
+        }
     }
 
     // Param → Type T_IDENTIFIER
     Param parseParam()
     {
-        token t = peekToken();
+        const token& t = peekToken();
         if (!isTypeToken(t.type))
         {
             string message = "Expected type token in param at line ";
@@ -585,61 +939,61 @@ private:
         Param p;
         p.typeTok = t.type;
         advance();
-        if (!check("T_IDENTIFIER"))
+        if (!check(T_IDENTIFIER))
         {
-            token tk = peekToken();
+            const token& tk = peekToken();
             string message = "Expected identifier in param at line ";
             ThrowError(message, tk.line_no, t.val, t.type);
         }
-        p.name = peekToken().val;
+        p.name = peekToken().sym;
         advance();
         return p;
     }
 
     // Block → T_LBRACE Stmt* T_RBRACE
-    shared_ptr<BlockStmt> parseBlockStmt()
+    BlockStmt* parseBlockStmt()
     {
-        if (!check("T_LBRACE"))
+        if (!check(T_LBRACE))
         {
-            token t = peekToken();
+            const token& t = peekToken();
             string message = "Expected '{' at line ";
             ThrowError(message, t.line_no, t.val, t.type);
 
         }
         advance();
-        auto block = make_shared<BlockStmt>();
-        while (!check("T_RBRACE") && !isAtEnd())
+        auto block = make<BlockStmt>();
+        while (!check(T_RBRACE) && !isAtEnd())
         {
             block->stmts.push_back(parseStatement());
         }
-        expect("T_RBRACE", UnexpectedToken);
+        expect(T_RBRACE, UnexpectedToken);
         return block;
     }
 
     // Stmt → various
     StmtPtr parseStatement()
     {
-        token t = peekToken();
-        if (check("T_SEMICOLON")) {
+        const token& t = peekToken();
+        if (check(T_SEMICOLON)) {
             advance();
-            return make_shared<ExprStmt>(nullptr); // represent an empty statement
+            return make<ExprStmt>(nullptr); // represent an empty statement
         }
-        /*if (check("T_SEMICOLON"))
+        /*if (check(T_SEMICOLON))
         {
             advance();
             return make_shared<BlockStmt>()->stmts.empty() ? (StmtPtr)make_shared<ExprStmt>(nullptr) : nullptr;
         }*/
 
-        if (check("T_RETURN")) return parseReturnStmt();
-        if (check("T_IF")) return parseIfStmt();
-        if (check("T_WHILE")) return parseWhileStmt();
-        if (check("T_FOR")) return parseForStmt();
-        if (check("T_LBRACE")) return parseBlockStmt();
+        if (check(T_RETURN)) return parseReturnStmt();
+        if (check(T_IF)) return parseIfStmt();
+        if (check(T_WHILE)) return parseWhileStmt();
+        if (check(T_FOR)) return parseForStmt();
+        if (check(T_LBRACE)) return parseBlockStmt();
         if (isTypeToken(t.type)) return parseVarDeclStmt();
-        if (check("T_SEMICOLON")) 
+        if (check(T_SEMICOLON)) 
         { 
             advance();
-            return make_shared<ExprStmt>(nullptr); 
+            return make<ExprStmt>(nullptr); 
         }
 
         return parseExprStmt();
@@ -649,8 +1003,8 @@ private:
     StmtPtr parseExprStmt()
     {
         auto e = parseExpr();
-        expect("T_SEMICOLON", ExpectedExpr);
-        return make_shared<ExprStmt>(e);
+        expect(T_SEMICOLON, ExpectedExpr);
+        return make<ExprStmt>(e);
     }
 
     // ReturnStmt → T_RETURN Expr T_SEMICOLON
@@ -658,45 +1012,45 @@ private:
     {
         advance();
         ExprPtr e = parseExpr();
-        expect("T_SEMICOLON", ExpectedExpr);
-        return make_shared<ReturnStmt>(e);
+        expect(T_SEMICOLON, ExpectedExpr);
+        return make<ReturnStmt>(e);
     }
 
     // IfStmt → T_IF T_LPAREN Expr T_RPAREN Stmt (T_ELSE Stmt)?
     StmtPtr parseIfStmt()
     {
         advance();
-        expect("T_LPAREN", UnexpectedToken);
+        expect(T_LPAREN, UnexpectedToken);
         ExprPtr cond = parseExpr();
-        expect("T_RPAREN", UnexpectedToken);
+        expect(T_RPAREN, UnexpectedToken);
         StmtPtr thenStmt = parseStatement();
         StmtPtr elseStmt = nullptr;
-        if (check("T_ELSE")) {
+        if (check(T_ELSE)) {
             advance();
             elseStmt = parseStatement();
         }
-        return make_shared<IfStmt>(cond, thenStmt, elseStmt);
+        return make<IfStmt>(cond, thenStmt, elseStmt);
     }
 
     // WhileStmt → T_WHILE T_LPAREN Expr T_RPAREN Stmt
     StmtPtr parseWhileStmt()
     {
         advance();
-        expect("T_LPAREN", UnexpectedToken);
+        expect(T_LPAREN, UnexpectedToken);
         ExprPtr cond = parseExpr();
-        expect("T_RPAREN", UnexpectedToken);
+        expect(T_RPAREN, UnexpectedToken);
         StmtPtr body = parseStatement();
-        return make_shared<WhileStmt>(cond, body);
+        return make<WhileStmt>(cond, body);
     }
 
     // ForStmt → T_FOR T_LPAREN ExprStmt ExprStmt Expr? T_RPAREN Stmt
     StmtPtr parseForStmt()
     {
         advance();
-        expect("T_LPAREN", UnexpectedToken);
+        expect(T_LPAREN, UnexpectedToken);
 
         StmtPtr init;
-        if (check("T_SEMICOLON")) {
+        if (check(T_SEMICOLON)) {
             advance();
             init = nullptr;
         }
@@ -708,7 +1062,7 @@ private:
         }
         // cond (ExprStmt)
         StmtPtr condStmt;
-        if (check("T_SEMICOLON")) {
+        if (check(T_SEMICOLON)) {
             advance();
             condStmt = nullptr;
         }
@@ -717,37 +1071,37 @@ private:
         }
         // iter expression (optional)
         ExprPtr iter = nullptr;
-        if (!check("T_RPAREN")) {
+        if (!check(T_RPAREN)) {
             // there is an expression (not semicolon)
             iter = parseExpr();
         }
-        expect("T_RPAREN", UnexpectedToken);
+        expect(T_RPAREN, UnexpectedToken);
         StmtPtr body = parseStatement();
-        return make_shared<ForStmt>(init, condStmt, iter, body);
+        return make<ForStmt>(init, condStmt, iter, body);
     }
 
     // VarDeclStmt → Type T_IDENTIFIER (T_ASSIGN Expr)? T_SEMICOLON
     StmtPtr parseVarDeclStmt()
     {
-        token t = peekToken();
-        string typeTok = t.type;
+        const token& t = peekToken();
+        TokenKind typeTok = t.type;
         advance();
-        if (!check("T_IDENTIFIER"))
+        if (!check(T_IDENTIFIER))
         {
-            token tk = peekToken();
+            const token& tk = peekToken();
             string message = "Expected identifier after type at line ";
             ThrowError(message, tk.line_no, tk.val, tk.type);
         }
-        string name = peekToken().val;
+        SymbolId name = peekToken().sym;
         advance();
         ExprPtr init = nullptr;
-        if (check("T_ASSIGN")) 
+        if (check(T_ASSIGN)) 
         {
             advance();
             init = parseExpr();
         }
-        expect("T_SEMICOLON", UnexpectedToken);
-        return make_shared<VarDeclStmt>(typeTok, name, init);
+        expect(T_SEMICOLON, UnexpectedToken);
+        return make<VarDeclStmt>(typeTok, name, init);
     }
 
     // Expressions
@@ -759,18 +1113,19 @@ private:
     // Assignment → T_IDENTIFIER T_ASSIGN Assignment | OrExpr
     ExprPtr parseAssignment()
     {
-        if ( check("T_IDENTIFIER")) 
+        if ( check(T_IDENTIFIER)) 
         {
 
-            token id = peekToken();
-            if (peekNext().type == "T_ASSIGN") {
+            // the ring slot is reused while the rhs is parsed, keep the name
+            SymbolId id = peekToken().sym;
+            if (peekNext().type == T_ASSIGN) {
 
                 advance();
                 advance();
                 ExprPtr rhs = parseAssignment();
 
-                auto lhs = make_shared<IdentifierExpr>(id.val);
-                return make_shared<BinaryExpr>(lhs, "T_ASSIGN", rhs);
+                auto lhs = make<IdentifierExpr>(id);
+                return make<BinaryExpr>(lhs, T_ASSIGN, rhs);
             }
         }
         return parseOrExpr();
@@ -779,11 +1134,11 @@ private:
     ExprPtr parseOrExpr()
     {
         ExprPtr left = parseAndExpr();
-        while (check("T_OR")) 
+        while (check(T_OR)) 
         {
-            string op = peekToken().type; advance();
+            TokenKind op = peekToken().type; advance();
             ExprPtr right = parseAndExpr();
-            left = make_shared<BinaryExpr>(left, op, right);
+            left = make<BinaryExpr>(left, op, right);
         }
         return left;
     }
@@ -791,11 +1146,11 @@ private:
     ExprPtr parseAndExpr()
     {
         ExprPtr left = parseEquality();
-        while (check("T_AND")) 
+        while (check(T_AND)) 
         {
-            string op = peekToken().type; advance();
+            TokenKind op = peekToken().type; advance();
             ExprPtr right = parseEquality();
-            left = make_shared<BinaryExpr>(left, op, right);
+            left = make<BinaryExpr>(left, op, right);
         }
         return left;
     }
@@ -803,10 +1158,10 @@ private:
     ExprPtr parseEquality()
     {
         ExprPtr left = parseRelational();
-        while (check("T_EQ") || check("T_NEQ")) {
-            string op = peekToken().type; advance();
+        while (check(T_EQ) || check(T_NEQ)) {
+            TokenKind op = peekToken().type; advance();
             ExprPtr right = parseRelational();
-            left = make_shared<BinaryExpr>(left, op, right);
+            left = make<BinaryExpr>(left, op, right);
         }
         return left;
     }
@@ -814,11 +1169,11 @@ private:
     ExprPtr parseRelational()
     {
         ExprPtr left = parseAdd();
-        while (check("T_LT") || check("T_GT") || check("T_LEQ") || check("T_GEQ"))
+        while (check(T_LT) || check(T_GT) || check(T_LEQ) || check(T_GEQ))
         {
-            string op = peekToken().type; advance();
+            TokenKind op = peekToken().type; advance();
             ExprPtr right = parseAdd();
-            left = make_shared<BinaryExpr>(left, op, right);
+            left = make<BinaryExpr>(left, op, right);
         }
         return left;
     }
@@ -826,11 +1181,11 @@ private:
     ExprPtr parseAdd()
     {
         ExprPtr left = parseMul();
-        while (check("T_PLUS") || check("T_MINUS"))
+        while (check(T_PLUS) || check(T_MINUS))
         {
-            string op = peekToken().type; advance();
+            TokenKind op = peekToken().type; advance();
             ExprPtr right = parseMul();
-            left = make_shared<BinaryExpr>(left, op, right);
+            left = make<BinaryExpr>(left, op, right);
         }
         return left;
     }
@@ -838,11 +1193,11 @@ private:
     ExprPtr parseMul()
     {
         ExprPtr left = parseUnary();
-        while (check("T_MULT") || check("T_DIV") || check("T_MOD"))
+        while (check(T_MULT) || check(T_DIV) || check(T_MOD))
         {
-            string op = peekToken().type; advance();
+            TokenKind op = peekToken().type; advance();
             ExprPtr right = parseUnary();
-            left = make_shared<BinaryExpr>(left, op, right);
+            left = make<BinaryExpr>(left, op, right);
         }
         return left;
     }
@@ -850,11 +1205,11 @@ private:
     // Unary → (T_NOT | T_MINUS | T_PLUS | T_INC | T_DEC) Unary | Postfix
     ExprPtr parseUnary()
     {
-        if (check("T_NOT") || check("T_MINUS") || check("T_PLUS") || check("T_INC") || check("T_DEC"))
+        if (check(T_NOT) || check(T_MINUS) || check(T_PLUS) || check(T_INC) || check(T_DEC))
         {
-            string op = peekToken().type; advance();
+            TokenKind op = peekToken().type; advance();
             ExprPtr rhs = parseUnary();
-            return make_shared<UnaryExpr>(op, rhs);
+            return make<UnaryExpr>(op, rhs);
         }
         return parsePostfix();
     }
@@ -865,31 +1220,31 @@ private:
         ExprPtr left = parsePrimary();
         while (true) 
         {
-            if (check("T_LPAREN")) 
+            if (check(T_LPAREN)) 
             {
                 advance();
-                auto call = make_shared<CallExpr>(left);
-                if (!check("T_RPAREN")) 
+                auto call = make<CallExpr>(left);
+                if (!check(T_RPAREN)) 
                 {
                     while (true) 
                     {
                         ExprPtr arg = parseExpr();
                         call->args.push_back(arg);
-                        if (check("T_COMMA"))
+                        if (check(T_COMMA))
                         { advance();
                             continue; 
                         }
                         break;
                     }
                 }
-                expect("T_RPAREN", UnexpectedToken);
+                expect(T_RPAREN, UnexpectedToken);
                 left = call;
                 continue;
             }
-            else if (check("T_INC") || check("T_DEC"))
+            else if (check(T_INC) || check(T_DEC))
             {
-                string op = peekToken().type; advance();
-                left = make_shared<PostfixExpr>(left, op);
+                TokenKind op = peekToken().type; advance();
+                left = make<PostfixExpr>(left, op);
                 continue;
             }
             break;
@@ -900,42 +1255,42 @@ private:
     // Primary → T_IDENTIFIER | T_NUMBER | T_FLOATLIT | T_STRING_LITERAL | T_CHAR_LITERAL | T_TRUE | T_FALSE | T_LPAREN Expr T_RPAREN
     ExprPtr parsePrimary()
     {
-        token t = peekToken();
-        if (check("T_IDENTIFIER")) {
+        const token& t = peekToken();
+        if (check(T_IDENTIFIER)) {
             advance();
-            return make_shared<IdentifierExpr>(t.val);
+            return make<IdentifierExpr>(t.sym);
         }
-        if (check("T_NUMBER")) {
+        if (check(T_NUMBER)) {
             advance();
-            return make_shared<IntLiteral>(t.val);
+            return make<IntLiteral>(string(t.val));
         }
-        if (check("T_FLOAT_LIT")) {
+        if (check(T_FLOAT_LIT)) {
             advance();
-            return make_shared<FloatLiteral>(t.val);
+            return make<FloatLiteral>(string(t.val));
         }
-        if (check("T_STRING_LIT")) {
+        if (check(T_STRING_LIT)) {
             advance();
-            return make_shared<StringLiteral>(t.val);
+            return make<StringLiteral>(string(t.val));
         }
-        if (check("T_CHAR_LIT")) {
+        if (check(T_CHAR_LIT)) {
             advance();
-            return make_shared<CharLiteral>(t.val);
+            return make<CharLiteral>(string(t.val));
         }
-        if (check("T_TRUE") || check("T_FALSE")) {
+        if (check(T_TRUE) || check(T_FALSE)) {
             advance();
-            return make_shared<BoolLiteral>(t.val);
+            return make<BoolLiteral>(string(t.val));
         }
-        if (check("T_LPAREN")) {
+        if (check(T_LPAREN)) {
             advance();
             ExprPtr e = parseExpr();
-            expect("T_RPAREN", UnexpectedToken);
+            expect(T_RPAREN, UnexpectedToken);
             return e;
         }
         string message = "Expected primary expression at line ";
         ThrowError(message, t.line_no, t.val, t.type);
 
         ostringstream o;
-        o << "Expected primary expression at line " << t.line_no << "\n token='" << t.val << "\n type=" << t.type;
+        o << "Expected primary expression at line " << t.line_no << "\n token='" << t.val << "\n type=" << TokenKindName(t.type);
         throw runtime_error(o.str());
     }
 };
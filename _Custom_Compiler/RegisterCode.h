@@ -0,0 +1,109 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include "Bytecode.h"
+using namespace std;
+
+// Instruction set of the register VM. Every instruction has three operands:
+//   r   a frame register (slot); parameters and locals keep their slot for the
+//       whole scope, temporaries live above them
+//   rk  a register when >= 0, otherwise constants[~rk]
+//   t   an instruction index to jump to
+// The R_JUMP_IF_<cmp> and R_JUMP_IF_NOT_<cmp> superinstructions compare and
+// branch in one dispatch (loop and if conditions), R_INCR adds a small constant
+// to a register in place (++ and --).
+#define REG_OP_CODES(X) \
+    X(R_MOVE)           /* r[a] = r[b] */ \
+    X(R_LOADK)          /* r[a] = constants[b] */ \
+    X(R_GET_GLOBAL)     /* r[a] = globals[b] */ \
+    X(R_SET_GLOBAL)     /* globals[a] = rk[b] */ \
+    X(R_ADD)            /* r[a] = rk[b] + rk[c] */ \
+    X(R_SUB) \
+    X(R_MUL) \
+    X(R_DIV) \
+    X(R_MOD) \
+    X(R_EQ)             /* r[a] = rk[b] == rk[c] */ \
+    X(R_NE) \
+    X(R_LT) \
+    X(R_GT) \
+    X(R_LE) \
+    X(R_GE) \
+    X(R_NEG)            /* r[a] = -rk[b] */ \
+    X(R_NOT)            /* r[a] = !rk[b] */ \
+    X(R_TO_INT)         /* convert r[a] in place for a store into a typed variable */ \
+    X(R_TO_FLOAT) \
+    X(R_TO_BOOL) \
+    X(R_TO_STRING) \
+    X(R_INCR)           /* r[a] += b, r[a] is a variable of ValueType c */ \
+    X(R_JUMP)           /* goto t[a] */ \
+    X(R_JUMP_IF_TRUE)   /* if rk[b] goto t[a] */ \
+    X(R_JUMP_IF_FALSE)  /* if !rk[b] goto t[a] */ \
+    X(R_JUMP_IF_EQ)     /* if rk[b] == rk[c] goto t[a] */ \
+    X(R_JUMP_IF_NE) \
+    X(R_JUMP_IF_LT) \
+    X(R_JUMP_IF_GT) \
+    X(R_JUMP_IF_LE) \
+    X(R_JUMP_IF_GE) \
+    X(R_JUMP_IF_NOT_EQ) /* if !(rk[b] == rk[c]) goto t[a] */ \
+    X(R_JUMP_IF_NOT_NE) \
+    X(R_JUMP_IF_NOT_LT) \
+    X(R_JUMP_IF_NOT_GT) \
+    X(R_JUMP_IF_NOT_LE) \
+    X(R_JUMP_IF_NOT_GE) \
+    X(R_CALL)           /* r[a] = functions[b](r[c] ..), the callee's frame starts at r[c] */ \
+    X(R_RETURN)         /* return rk[a] */
+
+enum RegOpCode : uint32_t
+{
+#define REG_OP_ENUM(op) op,
+    REG_OP_CODES(REG_OP_ENUM)
+#undef REG_OP_ENUM
+    R_OP_COUNT
+};
+
+inline const char* RegOpCodeName(RegOpCode op)
+{
+    static const char* const names[] = {
+#define REG_OP_NAME(op) #op,
+        REG_OP_CODES(REG_OP_NAME)
+#undef REG_OP_NAME
+    };
+    return op < R_OP_COUNT ? names[op] : "?";
+}
+
+struct RegInstr
+{
+    RegOpCode op;
+    int32_t a, b, c;
+};
+
+struct RegisterFunction
+{
+    SymbolId name = NO_SYMBOL;
+    ValueType retType = V_VOID;
+    int arity = 0;
+    int regCount = 0;       // parameters, locals and temporaries
+    vector<RegInstr> code;
+};
+
+struct RegisterModule
+{
+    vector<RegisterFunction> functions;
+    vector<Value> constants;
+    deque<string> strings;          // text of the string constants
+    vector<ValueType> globalTypes;
+    int globalInit = -1;            // function that initializes the globals, in source order
+
+    int FindFunction(SymbolId name) const
+    {
+        for (size_t i = 0; i < functions.size(); i++)
+            if (functions[i].name == name && (int)i != globalInit)
+                return (int)i;
+        return -1;
+    }
+
+    // Listing of every function, for debugging.
+    string Disassemble() const;
+};
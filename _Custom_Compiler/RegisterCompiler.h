@@ -0,0 +1,811 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include "Parser2.h"
+#include "ScopeStack.h"
+#include "BytecodeCompiler.h"
+#include "RegisterCode.h"
+
+using namespace std;
+
+// Compiles a parsed Program into a RegisterModule for the RegisterVM.
+//
+// Parameters and locals get their frame slot when they are declared in the
+// function's ScopeStack (following the scope rules there), and an
+// expression that reads a variable uses its slot directly instead of copying it.
+// Temporaries are allocated above the locals like a stack and released after
+// each operation. Name and arity errors throw runtime_error, as in BytecodeCompiler.
+class RegisterCompiler : AstVisitor<RegisterCompiler, int>
+{
+    // where compileExpr may leave its result
+    static const int ANY = INT_MIN;             // any register
+    static const int ANY_RK = INT_MIN + 1;      // any register or a constant
+    static const int DISCARD = INT_MIN + 2;     // the value is not used
+
+    RegisterModule module;
+    unordered_map<SymbolId, int> functionIndex;
+    vector<vector<ValueType>> paramTypes;       // by function index
+    unordered_map<SymbolId, int> globalIndex;   // globals declared so far
+    map<pair<int, int64_t>, uint32_t> numberConstants;
+    unordered_map<string, uint32_t> stringConstants;
+
+    RegisterFunction* fn = nullptr;     // function being compiled
+    ScopeStack scopes;
+    vector<int> localMarks;     // nextLocal when each scope was opened
+    int nextLocal = 0;          // slot of the next local
+    int freeReg = 0;            // first free temporary, nextLocal between statements
+    int target = ANY;           // result wanted from the expression being visited
+
+public:
+    static RegisterModule Compile(const Program* program)
+    {
+        RegisterCompiler c;
+        c.compileProgram(program);
+        return move(c.module);
+    }
+
+private:
+    void compileProgram(const Program* program)
+    {
+        for (const ASTPtr item : program->globalItems)
+        {
+            if (auto func = nodeCast<FuncDecl>(item))
+            {
+                if (functionIndex.count(func->name))
+                    error("function redefined", func->name);
+                functionIndex[func->name] = (int)module.functions.size();
+                module.functions.emplace_back();
+                RegisterFunction& code = module.functions.back();
+                code.name = func->name;
+                code.retType = valueTypeOf(func->retType);
+                code.arity = (int)func->params.size();
+                paramTypes.emplace_back();
+                for (const Param& p : func->params)
+                    paramTypes.back().push_back(valueTypeOf(p.typeTok));
+            }
+        }
+        module.globalInit = (int)module.functions.size();
+        module.functions.emplace_back();
+        module.functions.back().name = Intern("<globals>");
+
+        for (const ASTPtr item : program->globalItems)
+        {
+            if (auto func = nodeCast<FuncDecl>(item))
+                compileFunction(func);
+            else if (auto var = nodeCast<VarDeclStmt>(item))
+                compileGlobal(var);
+        }
+        beginFunction(module.globalInit);
+        emit(R_RETURN, ~(int)constant(Value()));
+        endFunction();
+    }
+
+    // Global initializers are appended in source order to one function that the
+    // VM runs before anything else.
+    void compileGlobal(const VarDeclStmt* var)
+    {
+        ValueType type = valueTypeOf(var->typeTok);
+        if (type == V_VOID)
+            error("variable declared void", var->name);
+        if (globalIndex.count(var->name))
+            error("global variable redefined", var->name);
+
+        beginFunction(module.globalInit);
+        int value = var->init ? compileConverted(var->init, ANY_RK, type) : ~(int)constant(DefaultValue(type));
+        // the global is only visible once its initializer is compiled
+        int index = (int)module.globalTypes.size();
+        module.globalTypes.push_back(type);
+        globalIndex[var->name] = index;
+        emit(R_SET_GLOBAL, index, value);
+        endFunction();
+    }
+
+    void compileFunction(const FuncDecl* func)
+    {
+        beginFunction(functionIndex[func->name]);
+        // parameters share the scope of the outermost block of the body
+        pushScope();
+        for (const Param& p : func->params)
+        {
+            ValueType type = valueTypeOf(p.typeTok);
+            if (type == V_VOID)
+                error("parameter declared void", p.name);
+            declareLocal(p.name, p.typeTok);
+        }
+        if (func->body)
+            for (const auto& stmt : func->body->stmts)
+                compileStmt(stmt);
+        popScope();
+        // falling off the end returns the default value of the return type
+        emit(R_RETURN, ~(int)constant(DefaultValue(fn->retType)));
+        endFunction();
+    }
+
+    void beginFunction(int index)
+    {
+        fn = &module.functions[index];
+        scopes = ScopeStack();
+        localMarks.clear();
+        nextLocal = freeReg = 0;
+    }
+
+    void endFunction()
+    {
+        fn = nullptr;
+    }
+
+    // ---- locals and registers ----
+
+    void pushScope()
+    {
+        scopes.pushScope();
+        localMarks.push_back(nextLocal);
+    }
+
+    // slots of the popped scope are reused by the next one
+    void popScope()
+    {
+        scopes.popScope();
+        nextLocal = freeReg = localMarks.back();
+        localMarks.pop_back();
+    }
+
+    // the next free slot becomes the local's for the rest of its scope
+    int declareLocal(SymbolId name, TokenKind typeTok)
+    {
+        int slot = nextLocal;
+        if (!scopes.declareSym(Symbol(name, typeTok, false, slot)))
+            error("variable redefined", name);
+        nextLocal = freeReg = slot + 1;
+        useRegisters(nextLocal);
+        return slot;
+    }
+
+    int allocTemp()
+    {
+        useRegisters(freeReg + 1);
+        return freeReg++;
+    }
+
+    void useRegisters(int count)
+    {
+        if (count > fn->regCount)
+            fn->regCount = count;
+    }
+
+    bool isLocal(int rk) const
+    {
+        return rk >= 0 && rk < nextLocal;
+    }
+
+    const Symbol* findLocal(SymbolId name)
+    {
+        return scopes.lookup(name);
+    }
+
+    int globalOf(SymbolId name)
+    {
+        auto it = globalIndex.find(name);
+        if (it == globalIndex.end())
+            error("undeclared variable", name);
+        return it->second;
+    }
+
+    ValueType typeOfVariable(SymbolId name)
+    {
+        if (const Symbol* local = findLocal(name))
+            return valueTypeOf(local->type);
+        return module.globalTypes[globalOf(name)];
+    }
+
+    // ---- emission ----
+
+    size_t emit(RegOpCode op, int a = 0, int b = 0, int c = 0)
+    {
+        fn->code.push_back({ op, a, b, c });
+        return fn->code.size() - 1;
+    }
+
+    size_t here() const { return fn->code.size(); }
+
+    void patch(const vector<size_t>& jumps, size_t to)
+    {
+        for (size_t j : jumps)
+            fn->code[j].a = (int32_t)to;
+    }
+
+    // moves rk to where dst asks for it and returns where it ended up
+    int place(int rk, int dst)
+    {
+        if (dst == ANY_RK || dst == DISCARD)
+            return rk;
+        if (dst == ANY)
+        {
+            if (rk >= 0)
+                return rk;
+            dst = allocTemp();
+        }
+        if (rk != dst)
+        {
+            if (rk >= 0)
+                emit(R_MOVE, dst, rk);
+            else
+                emit(R_LOADK, dst, ~rk);
+        }
+        return dst;
+    }
+
+    // register for the result of an operation
+    int resultRegister(int dst)
+    {
+        return dst >= 0 ? dst : allocTemp();
+    }
+
+    int compileExpr(const Expr* e, int dst)
+    {
+        int saved = target;
+        target = dst;
+        int r = visit(e);
+        target = saved;
+        return r;
+    }
+
+    // compiles e and converts it for a variable, argument or return value of the given type
+    int compileConverted(const Expr* e, int dst, ValueType type)
+    {
+        if (staticType(e) == type)
+            return compileExpr(e, dst);
+        int r = compileExpr(e, dst >= 0 ? dst : ANY);
+        if (r != dst && isLocal(r))
+            r = place(r, allocTemp());  // never convert another variable in place
+        switch (type)
+        {
+        case V_INT: emit(R_TO_INT, r); break;
+        case V_FLOAT: emit(R_TO_FLOAT, r); break;
+        case V_BOOL: emit(R_TO_BOOL, r); break;
+        case V_STRING: emit(R_TO_STRING, r); break;
+        default: break;
+        }
+        return r;
+    }
+
+    // Type of the value e produces, V_VOID when it is only known at run time.
+    // Variables always hold their declared type (every store converts), so this
+    // is exact for the expressions it covers. The TypeChecker's annotation is
+    // used when there is one.
+    ValueType staticType(const Expr* e)
+    {
+        if (e->type != TY_UNKNOWN)
+            return valueTypeOf(e->type);
+        switch (e->kind)
+        {
+        case NK_INT_LITERAL: case NK_CHAR_LITERAL: return V_INT;
+        case NK_FLOAT_LITERAL: return V_FLOAT;
+        case NK_BOOL_LITERAL: return V_BOOL;
+        case NK_STRING_LITERAL: return V_STRING;
+        case NK_IDENTIFIER:
+        {
+            SymbolId name = static_cast<const IdentifierExpr*>(e)->name;
+            if (const Symbol* local = findLocal(name))
+                return valueTypeOf(local->type);
+            auto it = globalIndex.find(name);
+            return it == globalIndex.end() ? V_VOID : module.globalTypes[it->second];
+        }
+        case NK_UNARY:
+        {
+            auto u = static_cast<const UnaryExpr*>(e);
+            if (u->op == T_NOT)
+                return V_BOOL;
+            ValueType t = staticType(u->rhs);
+            if (u->op != T_MINUS)
+                return t;
+            return t == V_BOOL ? V_INT : t == V_INT || t == V_FLOAT ? t : V_VOID;
+        }
+        case NK_POSTFIX:
+            return staticType(static_cast<const PostfixExpr*>(e)->base);
+        case NK_BINARY:
+        {
+            auto b = static_cast<const BinaryExpr*>(e);
+            switch (b->op)
+            {
+            case T_ASSIGN:
+                return staticType(b->left);
+            case T_AND: case T_OR: case T_EQ: case T_NEQ: case T_LT: case T_GT: case T_LEQ: case T_GEQ:
+                return V_BOOL;
+            default:
+            {
+                ValueType l = staticType(b->left), r = staticType(b->right);
+                if (l == V_STRING && r == V_STRING)
+                    return b->op == T_PLUS ? V_STRING : V_VOID;
+                bool ln = l == V_INT || l == V_FLOAT || l == V_BOOL;
+                bool rn = r == V_INT || r == V_FLOAT || r == V_BOOL;
+                if (!ln || !rn)
+                    return V_VOID;
+                return l == V_FLOAT || r == V_FLOAT ? V_FLOAT : V_INT;
+            }
+            }
+        }
+        case NK_CALL:
+        {
+            auto callee = nodeCast<IdentifierExpr>(static_cast<const CallExpr*>(e)->callee);
+            auto it = callee ? functionIndex.find(callee->name) : functionIndex.end();
+            return it == functionIndex.end() ? V_VOID : module.functions[it->second].retType;
+        }
+        default:
+            return V_VOID;
+        }
+    }
+
+    // true if evaluating e can change a local variable
+    static bool writesLocals(const Expr* e)
+    {
+        switch (e->kind)
+        {
+        case NK_POSTFIX:
+            return true;
+        case NK_UNARY:
+        {
+            auto u = static_cast<const UnaryExpr*>(e);
+            return u->op == T_INC || u->op == T_DEC || writesLocals(u->rhs);
+        }
+        case NK_BINARY:
+        {
+            auto b = static_cast<const BinaryExpr*>(e);
+            return b->op == T_ASSIGN || writesLocals(b->left) || writesLocals(b->right);
+        }
+        case NK_CALL:
+            for (const Expr* arg : static_cast<const CallExpr*>(e)->args)
+                if (writesLocals(arg))
+                    return true;
+            return false;
+        default:
+            return false;
+        }
+    }
+
+    // both operands of a binary operation; the left one is copied when the right
+    // one could change the variable it reads
+    void compileOperands(const Expr* left, const Expr* right, int& l, int& r)
+    {
+        l = compileExpr(left, ANY_RK);
+        if (isLocal(l) && writesLocals(right))
+            l = place(l, allocTemp());
+        r = compileExpr(right, ANY_RK);
+    }
+
+    uint32_t constant(const Value& v)
+    {
+        if (v.type == V_STRING)
+        {
+            auto it = stringConstants.find(*v.s);
+            if (it != stringConstants.end())
+                return it->second;
+            module.strings.push_back(*v.s);
+            uint32_t k = (uint32_t)module.constants.size();
+            module.constants.push_back(Value::String(&module.strings.back()));
+            stringConstants[module.strings.back()] = k;
+            return k;
+        }
+        int64_t bits = 0;
+        if (v.type == V_FLOAT)
+            memcpy(&bits, &v.f, sizeof bits);
+        else if (v.type == V_BOOL)
+            bits = v.b;
+        else if (v.type == V_INT)
+            bits = v.i;
+        auto key = make_pair((int)v.type, bits);
+        auto it = numberConstants.find(key);
+        if (it != numberConstants.end())
+            return it->second;
+        uint32_t k = (uint32_t)module.constants.size();
+        module.constants.push_back(v);
+        numberConstants[key] = k;
+        return k;
+    }
+
+    int constantOperand(const Value& v)
+    {
+        return place(~(int)constant(v), target);
+    }
+
+    [[noreturn]] void error(const string& message, SymbolId name = NO_SYMBOL)
+    {
+        string text = "[CompileError] " + message;
+        if (name != NO_SYMBOL)
+            text += ": " + string(SymbolName(name));
+        throw runtime_error(text);
+    }
+
+    // ---- conditions ----
+
+    static bool fuseComparison(TokenKind op, bool when, RegOpCode& out)
+    {
+        switch (op)
+        {
+        case T_EQ: out = when ? R_JUMP_IF_EQ : R_JUMP_IF_NOT_EQ; return true;
+        case T_NEQ: out = when ? R_JUMP_IF_NE : R_JUMP_IF_NOT_NE; return true;
+        case T_LT: out = when ? R_JUMP_IF_LT : R_JUMP_IF_NOT_LT; return true;
+        case T_GT: out = when ? R_JUMP_IF_GT : R_JUMP_IF_NOT_GT; return true;
+        case T_LEQ: out = when ? R_JUMP_IF_LE : R_JUMP_IF_NOT_LE; return true;
+        case T_GEQ: out = when ? R_JUMP_IF_GE : R_JUMP_IF_NOT_GE; return true;
+        default: return false;
+        }
+    }
+
+    // Jumps (added to jumps, patched by the caller) when e is `when`, falls
+    // through otherwise. Comparisons become one compare-and-branch, && || and !
+    // become control flow without materializing a bool.
+    void compileCondJump(const Expr* e, bool when, vector<size_t>& jumps)
+    {
+        int mark = freeReg;
+        if (auto u = nodeCast<UnaryExpr>(e))
+        {
+            if (u->op == T_NOT)
+            {
+                compileCondJump(u->rhs, !when, jumps);
+                return;
+            }
+        }
+        else if (auto b = nodeCast<BinaryExpr>(e))
+        {
+            if (b->op == T_AND || b->op == T_OR)
+            {
+                // the left side decides alone when it is false for && or true for ||
+                bool decides = b->op == T_OR;
+                if (when == decides)
+                {
+                    compileCondJump(b->left, when, jumps);
+                    compileCondJump(b->right, when, jumps);
+                }
+                else
+                {
+                    vector<size_t> skip;
+                    compileCondJump(b->left, !when, skip);
+                    compileCondJump(b->right, when, jumps);
+                    patch(skip, here());
+                }
+                return;
+            }
+            RegOpCode op;
+            if (fuseComparison(b->op, when, op))
+            {
+                int l, r;
+                compileOperands(b->left, b->right, l, r);
+                freeReg = mark;
+                jumps.push_back(emit(op, 0, l, r));
+                return;
+            }
+        }
+        else if (auto lit = nodeCast<BoolLiteral>(e))
+        {
+            if (lit->value == when)
+                jumps.push_back(emit(R_JUMP));
+            return;
+        }
+        int r = compileExpr(e, ANY_RK);
+        freeReg = mark;
+        jumps.push_back(emit(when ? R_JUMP_IF_TRUE : R_JUMP_IF_FALSE, 0, r));
+    }
+
+    // ---- statements ----
+
+    void compileBlock(const BlockStmt* block)
+    {
+        pushScope();
+        for (const auto& stmt : block->stmts)
+            compileStmt(stmt);
+        popScope();
+    }
+
+    void compileStmt(const Stmt* stmt)
+    {
+        if (stmt)
+            visit(stmt);
+        freeReg = nextLocal;
+    }
+
+    friend struct AstVisitor<RegisterCompiler, int>;
+
+    int visitDefault(const ASTNode*)
+    {
+        error("construct not supported by the register compiler");
+    }
+
+    int visitBlock(const BlockStmt* bs)
+    {
+        compileBlock(bs);
+        return 0;
+    }
+    int visitVarDecl(const VarDeclStmt* vd)
+    {
+        ValueType type = valueTypeOf(vd->typeTok);
+        if (type == V_VOID)
+            error("variable declared void", vd->name);
+        // the initializer is compiled straight into the new slot, before the
+        // variable is declared so that it does not see itself
+        int slot = nextLocal;
+        freeReg = slot + 1;
+        useRegisters(freeReg);
+        if (vd->init)
+            place(compileConverted(vd->init, slot, type), slot);
+        else
+            emit(R_LOADK, slot, constant(DefaultValue(type)));
+        declareLocal(vd->name, vd->typeTok);
+        return 0;
+    }
+    int visitReturn(const ReturnStmt* rs)
+    {
+        if (fn->retType == V_VOID)
+        {
+            compileExpr(rs->expr, DISCARD);
+            emit(R_RETURN, ~(int)constant(Value()));
+        }
+        else
+            emit(R_RETURN, compileConverted(rs->expr, ANY_RK, fn->retType));
+        return 0;
+    }
+    int visitExprStmt(const ExprStmt* es)
+    {
+        if (es->expr)
+            compileExpr(es->expr, DISCARD);
+        return 0;
+    }
+    int visitIf(const IfStmt* ifs)
+    {
+        vector<size_t> toElse;
+        compileCondJump(ifs->cond, false, toElse);
+        compileStmt(ifs->thenStmt);
+        if (ifs->elseStmt)
+        {
+            vector<size_t> toEnd{ emit(R_JUMP) };
+            patch(toElse, here());
+            compileStmt(ifs->elseStmt);
+            patch(toEnd, here());
+        }
+        else
+            patch(toElse, here());
+        return 0;
+    }
+    // Loops are laid out with the condition at the bottom, so an iteration
+    // costs one compare-and-branch instead of a test at the top and a jump back.
+    int visitWhile(const WhileStmt* ws)
+    {
+        vector<size_t> toCond{ emit(R_JUMP) };
+        size_t body = here();
+        compileStmt(ws->body);
+        patch(toCond, here());
+        vector<size_t> loop;
+        compileCondJump(ws->cond, true, loop);
+        patch(loop, body);
+        return 0;
+    }
+    int visitFor(const ForStmt* fs)
+    {
+        // a variable declared in the init clause lives until the end of the loop
+        pushScope();
+        compileStmt(fs->init);
+        vector<size_t> toCond{ emit(R_JUMP) };
+        size_t body = here();
+        compileStmt(fs->body);
+        if (fs->iterExpr)
+        {
+            compileExpr(fs->iterExpr, DISCARD);
+            freeReg = nextLocal;
+        }
+        patch(toCond, here());
+        vector<size_t> loop;
+        const ExprStmt* cond = nodeCast<ExprStmt>(fs->condStmt);
+        if (cond && cond->expr)
+            compileCondJump(cond->expr, true, loop);
+        else
+            loop.push_back(emit(R_JUMP));
+        patch(loop, body);
+        popScope();
+        return 0;
+    }
+
+    // ---- expressions ----
+    // Each returns where it left its value, as allowed by target.
+
+    int visitIdentifier(const IdentifierExpr* id)
+    {
+        if (const Symbol* local = findLocal(id->name))
+            return place(local->slot, target);
+        int r = resultRegister(target);
+        emit(R_GET_GLOBAL, r, globalOf(id->name));
+        return r;
+    }
+    int visitIntLiteral(const IntLiteral* lit)
+    {
+        if (!lit->inRange)
+            error("integer literal out of range: " + lit->val);
+        return constantOperand(Value::Int(lit->value));
+    }
+    int visitFloatLiteral(const FloatLiteral* lit)
+    {
+        return constantOperand(Value::Float(lit->value));
+    }
+    int visitBoolLiteral(const BoolLiteral* lit)
+    {
+        return constantOperand(Value::Bool(lit->value));
+    }
+    int visitCharLiteral(const CharLiteral* lit)
+    {
+        return constantOperand(Value::Int(lit->value));
+    }
+    int visitStringLiteral(const StringLiteral* lit)
+    {
+        return constantOperand(Value::String(&lit->text));
+    }
+
+    SymbolId variableOperand(const Expr* e)
+    {
+        auto id = nodeCast<IdentifierExpr>(e);
+        if (!id)
+            error("++ and -- need a variable");
+        return id->name;
+    }
+
+    // ++x / --x, or x++ / x-- when postfix (the old value is the result)
+    int compileIncrement(const Expr* operand, int delta, bool postfix)
+    {
+        int dst = target;
+        SymbolId name = variableOperand(operand);
+        ValueType type = typeOfVariable(name);
+        if (const Symbol* local = findLocal(name))
+        {
+            int slot = local->slot;
+            if (!postfix || dst == DISCARD)
+            {
+                emit(R_INCR, slot, delta, type);
+                return place(slot, dst);
+            }
+            int r = dst >= 0 && dst != slot ? dst : allocTemp();
+            emit(R_MOVE, r, slot);
+            emit(R_INCR, slot, delta, type);
+            return r;
+        }
+        int g = globalOf(name);
+        int r = dst >= 0 ? dst : allocTemp();
+        emit(R_GET_GLOBAL, r, g);
+        if (!postfix || dst == DISCARD)
+        {
+            emit(R_INCR, r, delta, type);
+            emit(R_SET_GLOBAL, g, r);
+            return r;
+        }
+        int t = allocTemp();
+        emit(R_MOVE, t, r);
+        emit(R_INCR, t, delta, type);
+        emit(R_SET_GLOBAL, g, t);
+        return r;
+    }
+
+    int visitUnary(const UnaryExpr* unary)
+    {
+        int dst = target;
+        switch (unary->op)
+        {
+        case T_PLUS:
+            return compileExpr(unary->rhs, dst);
+        case T_MINUS:
+        case T_NOT:
+        {
+            int mark = freeReg;
+            int r = compileExpr(unary->rhs, ANY_RK);
+            freeReg = mark;
+            int d = resultRegister(dst);
+            emit(unary->op == T_MINUS ? R_NEG : R_NOT, d, r);
+            return d;
+        }
+        case T_INC:
+        case T_DEC:
+            return compileIncrement(unary->rhs, unary->op == T_INC ? 1 : -1, false);
+        default:
+            error(string("unsupported unary operator ") + TokenKindName(unary->op));
+        }
+    }
+    int visitPostfix(const PostfixExpr* post)
+    {
+        return compileIncrement(post->base, post->op == T_INC ? 1 : -1, true);
+    }
+
+    int visitBinary(const BinaryExpr* binary)
+    {
+        int dst = target;
+        switch (binary->op)
+        {
+        case T_ASSIGN:
+        {
+            SymbolId name = variableOperand(binary->left);
+            ValueType type = typeOfVariable(name);
+            if (const Symbol* local = findLocal(name))
+            {
+                // computed straight into the variable's slot
+                int slot = local->slot;
+                place(compileConverted(binary->right, slot, type), slot);
+                return place(slot, dst);
+            }
+            int r = compileConverted(binary->right, dst == DISCARD ? ANY_RK : dst, type);
+            emit(R_SET_GLOBAL, globalOf(name), r);
+            return r;
+        }
+        case T_AND:
+        case T_OR:
+        {
+            int d = resultRegister(dst);
+            vector<size_t> toFalse, toEnd;
+            compileCondJump(binary, false, toFalse);
+            emit(R_LOADK, d, constant(Value::Bool(true)));
+            toEnd.push_back(emit(R_JUMP));
+            patch(toFalse, here());
+            emit(R_LOADK, d, constant(Value::Bool(false)));
+            patch(toEnd, here());
+            return d;
+        }
+        default:
+            break;
+        }
+
+        RegOpCode op;
+        switch (binary->op)
+        {
+        case T_PLUS: op = R_ADD; break;
+        case T_MINUS: op = R_SUB; break;
+        case T_MULT: op = R_MUL; break;
+        case T_DIV: op = R_DIV; break;
+        case T_MOD: op = R_MOD; break;
+        case T_EQ: op = R_EQ; break;
+        case T_NEQ: op = R_NE; break;
+        case T_LT: op = R_LT; break;
+        case T_GT: op = R_GT; break;
+        case T_LEQ: op = R_LE; break;
+        case T_GEQ: op = R_GE; break;
+        default:
+            error(string("unsupported binary operator ") + TokenKindName(binary->op));
+        }
+        int mark = freeReg;
+        int l, r;
+        compileOperands(binary->left, binary->right, l, r);
+        freeReg = mark;
+        int d = resultRegister(dst);
+        emit(op, d, l, r);
+        return d;
+    }
+
+    int visitCall(const CallExpr* call)
+    {
+        int dst = target;
+        auto calleeId = nodeCast<IdentifierExpr>(call->callee);
+        if (!calleeId)
+            error("only named functions can be called");
+        if (findLocal(calleeId->name) || globalIndex.count(calleeId->name))
+            error("called object is not a function", calleeId->name);
+        auto it = functionIndex.find(calleeId->name);
+        if (it == functionIndex.end())
+            error("undefined function", calleeId->name);
+        const RegisterFunction& callee = module.functions[it->second];
+        if ((int)call->args.size() != callee.arity)
+            error("wrong number of arguments to", calleeId->name);
+
+        // arguments go to consecutive registers on top of the frame, where the
+        // callee's frame will start
+        int argBase = freeReg;
+        for (size_t i = 0; i < call->args.size(); i++)
+        {
+            int slot = argBase + (int)i;
+            freeReg = slot + 1;
+            useRegisters(freeReg);
+            place(compileConverted(call->args[i], slot, paramTypes[it->second][i]), slot);
+        }
+        freeReg = argBase;
+        int d = resultRegister(dst);
+        emit(R_CALL, d, it->second, argBase);
+        return d;
+    }
+};
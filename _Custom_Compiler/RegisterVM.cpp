@@ -0,0 +1,369 @@
+#include "RegisterVM.h"
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_COMPUTED_GOTO 1
+#endif
+
+string RegisterModule::Disassemble() const
+{
+    ostringstream o;
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        const RegisterFunction& fn = functions[f];
+        o << "function " << f << " " << SymbolName(fn.name) << " (arity " << fn.arity
+          << ", registers " << fn.regCount << ")\n";
+        for (size_t i = 0; i < fn.code.size(); i++)
+        {
+            const RegInstr& in = fn.code[i];
+            o << "  " << i << "\t" << RegOpCodeName(in.op) << " " << in.a << " " << in.b << " " << in.c;
+            if (in.op == R_CALL && (size_t)in.b < functions.size())
+                o << "\t; " << SymbolName(functions[in.b].name);
+            o << "\n";
+        }
+    }
+    return o.str();
+}
+
+RegisterVM::RegisterVM(const RegisterModule& module, bool jit)
+    : module(module), stack(STACK_SIZE), initialized(false), jitEnabled(jit && X64Jit::Available()),
+      callCounts(module.functions.size()), loopCounts(module.functions.size()),
+      bailoutCounts(module.functions.size()), nativeDepth(0)
+{
+    for (ValueType t : module.globalTypes)
+        globals.push_back(DefaultValue(t));
+    jitContext.globals = globals.data();
+    jitContext.call = JitCall;
+    jitContext.vm = this;
+}
+
+bool RegisterVM::Native(int function, uint32_t& counter, uint32_t threshold)
+{
+    if (!jitEnabled || nativeDepth >= MAX_NATIVE_DEPTH)
+        return false;
+    if (jit.Has(function))
+        return true;
+    if (jit.Tried(function) || ++counter < threshold)
+        return false;
+    return jit.Compile(module, function);
+}
+
+int64_t RegisterVM::RunNative(int function, Value* base, size_t ip)
+{
+    nativeDepth++;
+    int64_t r = jit.Run(function, base, &jitContext, ip);
+    nativeDepth--;
+    if (r == JIT_ERROR)
+        rethrow_exception(jitContext.error);
+    if (r != JIT_RETURNED && ++bailoutCounts[function] >= MAX_BAILOUTS)
+        jit.Disable(function);
+    return r;
+}
+
+int64_t RegisterVM::JitCall(JitContext* ctx, int function, Value* base)
+{
+    RegisterVM& vm = *(RegisterVM*)ctx->vm;
+    size_t depth = vm.frames.size();
+    try
+    {
+        const RegisterFunction& callee = vm.module.functions[function];
+        if (depth + vm.nativeDepth >= MAX_FRAMES || base + callee.regCount > vm.stack.data() + vm.stack.size())
+            RuntimeError("stack overflow");
+        size_t start = 0;
+        if (vm.Native(function, vm.callCounts[function], CALL_THRESHOLD))
+        {
+            int64_t r = vm.RunNative(function, base, 0);
+            if (r == JIT_RETURNED)
+                return 0;
+            start = (size_t)r;
+        }
+        ctx->result = vm.Execute(function, base, start);
+        return 0;
+    }
+    catch (...)
+    {
+        // the exception cannot unwind through native frames; the caller
+        // rethrows it once it is back in C++
+        vm.frames.resize(depth);
+        ctx->error = current_exception();
+        return JIT_ERROR;
+    }
+}
+
+Value RegisterVM::Call(string_view name, const vector<Value>& args)
+{
+    if (!initialized)
+    {
+        initialized = true;
+        Execute(module.globalInit, stack.data());
+    }
+    SymbolId id = StringInterner::Global().Find(name);
+    int f = id == NO_SYMBOL ? -1 : module.FindFunction(id);
+    if (f < 0)
+        RuntimeError("no function named " + string(name));
+    if ((int)args.size() != module.functions[f].arity)
+        RuntimeError("wrong number of arguments to " + string(name));
+    for (size_t i = 0; i < args.size(); i++)
+        stack[i] = args[i];
+    frames.clear();
+    nativeDepth = 0;
+    return Execute(f, stack.data());
+}
+
+Value RegisterVM::Execute(int function, Value* base, size_t start)
+{
+    const Value* constants = module.constants.data();
+    Value* stackEnd = stack.data() + stack.size();
+    const RegisterFunction* fn = &module.functions[function];
+    const RegInstr* code = fn->code.data();
+    const RegInstr* ip = code + start;
+    size_t entryDepth = frames.size();
+    Value result;
+
+    if (base + fn->regCount > stackEnd)
+        RuntimeError("stack overflow");
+    frames.push_back({ fn, nullptr, base });
+
+#define R(x) base[x]
+#define RK(x) ((x) >= 0 ? base[x] : constants[~(x)])
+
+    // a taken jump; jumping back counts towards compiling the function, and
+    // once it is compiled the loop carries on natively
+#define VM_JUMP(target) \
+    do { \
+        const RegInstr* to = code + (target); \
+        int f = (int)(fn - module.functions.data()); \
+        if (to <= ip && Native(f, loopCounts[f], LOOP_THRESHOLD)) \
+        { \
+            int64_t r = RunNative(f, base, to - code); \
+            if (r == JIT_RETURNED) \
+            { \
+                result = jitContext.result; \
+                goto return_result; \
+            } \
+            to = code + r; \
+        } \
+        ip = to; \
+    } while (0)
+
+#ifdef VM_COMPUTED_GOTO
+    static void* const dispatch[] = {
+#define REG_OP_LABEL(op) &&L_##op,
+        REG_OP_CODES(REG_OP_LABEL)
+#undef REG_OP_LABEL
+    };
+#define VM_CASE(op) L_##op:
+#define VM_NEXT goto *dispatch[ip->op]
+    VM_NEXT;
+#else
+#define VM_CASE(op) case op:
+#define VM_NEXT break
+    for (;;)
+    switch (ip->op)
+    {
+#endif
+
+    VM_CASE(R_MOVE)
+        R(ip->a) = R(ip->b);
+        ip++;
+        VM_NEXT;
+    VM_CASE(R_LOADK)
+        R(ip->a) = constants[ip->b];
+        ip++;
+        VM_NEXT;
+    VM_CASE(R_GET_GLOBAL)
+        R(ip->a) = globals[ip->b];
+        ip++;
+        VM_NEXT;
+    VM_CASE(R_SET_GLOBAL)
+        globals[ip->a] = RK(ip->b);
+        ip++;
+        VM_NEXT;
+
+    // int op int inline, everything else through Arith
+#define VM_ARITH(rop, op, intOp) \
+    VM_CASE(rop) \
+    { \
+        const Value& x = RK(ip->b); \
+        const Value& y = RK(ip->c); \
+        if (x.type == V_INT && y.type == V_INT) \
+            R(ip->a) = Value::Int((int64_t)((uint64_t)x.i intOp (uint64_t)y.i)); \
+        else \
+            R(ip->a) = Arith(op, x, y, strings); \
+        ip++; \
+        VM_NEXT; \
+    }
+    VM_ARITH(R_ADD, OP_ADD, +)
+    VM_ARITH(R_SUB, OP_SUB, -)
+    VM_ARITH(R_MUL, OP_MUL, *)
+#undef VM_ARITH
+    VM_CASE(R_DIV)
+        R(ip->a) = Arith(OP_DIV, RK(ip->b), RK(ip->c), strings);
+        ip++;
+        VM_NEXT;
+    VM_CASE(R_MOD)
+        R(ip->a) = Arith(OP_MOD, RK(ip->b), RK(ip->c), strings);
+        ip++;
+        VM_NEXT;
+
+#define VM_COMPARE(rop, op, intOp) \
+    VM_CASE(rop) \
+    { \
+        const Value& x = RK(ip->b); \
+        const Value& y = RK(ip->c); \
+        R(ip->a) = x.type == V_INT && y.type == V_INT ? Value::Bool(x.i intOp y.i) : Compare(op, x, y); \
+        ip++; \
+        VM_NEXT; \
+    }
+    VM_COMPARE(R_EQ, OP_EQ, ==)
+    VM_COMPARE(R_NE, OP_NE, !=)
+    VM_COMPARE(R_LT, OP_LT, <)
+    VM_COMPARE(R_GT, OP_GT, >)
+    VM_COMPARE(R_LE, OP_LE, <=)
+    VM_COMPARE(R_GE, OP_GE, >=)
+#undef VM_COMPARE
+
+    VM_CASE(R_NEG)
+    {
+        const Value& x = RK(ip->b);
+        if (x.type == V_FLOAT)
+            R(ip->a) = Value::Float(-x.f);
+        else if (IsNumber(x))
+            R(ip->a) = Value::Int((int64_t)(0 - (uint64_t)AsInt(x)));
+        else
+            RuntimeError(string("cannot negate a ") + ValueTypeName(x.type));
+        ip++;
+        VM_NEXT;
+    }
+    VM_CASE(R_NOT)
+        R(ip->a) = Value::Bool(!Truthy(RK(ip->b)));
+        ip++;
+        VM_NEXT;
+
+#define VM_CONVERT(rop, to) \
+    VM_CASE(rop) \
+        if (R(ip->a).type != to) \
+            R(ip->a) = Convert(to, R(ip->a)); \
+        ip++; \
+        VM_NEXT;
+    VM_CONVERT(R_TO_INT, V_INT)
+    VM_CONVERT(R_TO_FLOAT, V_FLOAT)
+    VM_CONVERT(R_TO_BOOL, V_BOOL)
+    VM_CONVERT(R_TO_STRING, V_STRING)
+#undef VM_CONVERT
+
+    VM_CASE(R_INCR)
+    {
+        Value& x = R(ip->a);
+        if (x.type == V_INT)
+            x.i = (int64_t)((uint64_t)x.i + (uint64_t)(int64_t)ip->b);
+        else
+            x = Convert((ValueType)ip->c, Arith(OP_ADD, x, Value::Int(ip->b), strings));
+        ip++;
+        VM_NEXT;
+    }
+
+    VM_CASE(R_JUMP)
+        VM_JUMP(ip->a);
+        VM_NEXT;
+    VM_CASE(R_JUMP_IF_TRUE)
+    {
+        const Value& x = RK(ip->b);
+        if (x.type == V_BOOL ? x.b : Truthy(x))
+            VM_JUMP(ip->a);
+        else
+            ip++;
+        VM_NEXT;
+    }
+    VM_CASE(R_JUMP_IF_FALSE)
+    {
+        const Value& x = RK(ip->b);
+        if (x.type == V_BOOL ? x.b : Truthy(x))
+            ip++;
+        else
+            VM_JUMP(ip->a);
+        VM_NEXT;
+    }
+
+    // compare and branch; taken is whether the comparison must hold to jump
+#define VM_BRANCH(rop, op, intOp, taken) \
+    VM_CASE(rop) \
+    { \
+        const Value& x = RK(ip->b); \
+        const Value& y = RK(ip->c); \
+        bool holds = x.type == V_INT && y.type == V_INT ? x.i intOp y.i : Compare(op, x, y).b; \
+        if (holds == taken) \
+            VM_JUMP(ip->a); \
+        else \
+            ip++; \
+        VM_NEXT; \
+    }
+    VM_BRANCH(R_JUMP_IF_EQ, OP_EQ, ==, true)
+    VM_BRANCH(R_JUMP_IF_NE, OP_NE, !=, true)
+    VM_BRANCH(R_JUMP_IF_LT, OP_LT, <, true)
+    VM_BRANCH(R_JUMP_IF_GT, OP_GT, >, true)
+    VM_BRANCH(R_JUMP_IF_LE, OP_LE, <=, true)
+    VM_BRANCH(R_JUMP_IF_GE, OP_GE, >=, true)
+    VM_BRANCH(R_JUMP_IF_NOT_EQ, OP_EQ, ==, false)
+    VM_BRANCH(R_JUMP_IF_NOT_NE, OP_NE, !=, false)
+    VM_BRANCH(R_JUMP_IF_NOT_LT, OP_LT, <, false)
+    VM_BRANCH(R_JUMP_IF_NOT_GT, OP_GT, >, false)
+    VM_BRANCH(R_JUMP_IF_NOT_LE, OP_LE, <=, false)
+    VM_BRANCH(R_JUMP_IF_NOT_GE, OP_GE, >=, false)
+#undef VM_BRANCH
+
+    VM_CASE(R_CALL)
+    {
+        const RegisterFunction* callee = &module.functions[ip->b];
+        Value* calleeBase = base + ip->c;
+        if (frames.size() + nativeDepth >= MAX_FRAMES || calleeBase + callee->regCount > stackEnd)
+            RuntimeError("stack overflow");
+        size_t calleeStart = 0;
+        if (Native(ip->b, callCounts[ip->b], CALL_THRESHOLD))
+        {
+            int64_t r = RunNative(ip->b, calleeBase, 0);
+            if (r == JIT_RETURNED)
+            {
+                R(ip->a) = jitContext.result;
+                ip++;
+                VM_NEXT;
+            }
+            calleeStart = (size_t)r;
+        }
+        frames.back().ip = ip;
+        frames.push_back({ callee, nullptr, calleeBase });
+        fn = callee;
+        base = calleeBase;
+        code = fn->code.data();
+        ip = code + calleeStart;
+        VM_NEXT;
+    }
+    VM_CASE(R_RETURN)
+        result = RK(ip->a);
+    return_result:
+    {
+        frames.pop_back();
+        if (frames.size() == entryDepth)
+            return result;
+        const Frame& caller = frames.back();
+        fn = caller.fn;
+        base = caller.base;
+        code = fn->code.data();
+        ip = caller.ip;
+        R(ip->a) = result;
+        ip++;
+        VM_NEXT;
+    }
+
+#ifndef VM_COMPUTED_GOTO
+    default:
+        RuntimeError("bad opcode");
+    }
+#endif
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_JUMP
+#undef R
+#undef RK
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include "RegisterCode.h"
+#include "X64Jit.h"
+using namespace std;
+
+// Runs a RegisterModule. Frames are windows on one value stack: a call's
+// arguments are the top registers of the caller, and the callee's frame starts
+// at the first of them, so arguments are never copied.
+//
+// Dispatch works like StackVM's (computed goto where available, a switch
+// otherwise), but an instruction names its operands directly, so an assignment
+// like x = x + 1 or a loop test like i < n is one dispatch instead of three or four.
+//
+// Where X64Jit is available, a function that has been called CALL_THRESHOLD
+// times, or whose loops have jumped back LOOP_THRESHOLD times, is compiled to
+// machine code. A hot loop switches to native code at its back edge; native
+// code hands its frame back at any instruction it cannot handle.
+class RegisterVM
+{
+    static const size_t STACK_SIZE = 1 << 20;     // values
+    static const size_t MAX_FRAMES = 1 << 16;     // interpreted and native together
+    static const size_t MAX_NATIVE_DEPTH = 8192;  // native frames live on the machine stack
+    static const uint32_t CALL_THRESHOLD = 1000;
+    static const uint32_t LOOP_THRESHOLD = 10000;
+    static const uint32_t MAX_BAILOUTS = 1000;    // then the function stays interpreted
+
+    struct Frame
+    {
+        const RegisterFunction* fn;
+        const RegInstr* ip;     // the caller continues after this call
+        Value* base;            // register 0
+    };
+
+    const RegisterModule& module;
+    vector<Value> globals;
+    vector<Value> stack;
+    vector<Frame> frames;
+    deque<string> strings;      // strings built at run time, kept until the VM goes away
+    bool initialized;
+
+    bool jitEnabled;
+    X64Jit jit;
+    JitContext jitContext;
+    vector<uint32_t> callCounts, loopCounts, bailoutCounts;
+    size_t nativeDepth;         // native calls currently on the machine stack
+
+    // Interprets function from instruction start, with its frame at base,
+    // until it returns.
+    Value Execute(int function, Value* base, size_t start = 0);
+
+    // true if function should run natively, compiling it once counter reaches threshold
+    bool Native(int function, uint32_t& counter, uint32_t threshold);
+    // JIT_RETURNED, or the instruction the interpreter has to continue at
+    int64_t RunNative(int function, Value* base, size_t ip);
+    // JitContext::call: a call made from native code
+    static int64_t JitCall(JitContext* ctx, int function, Value* base);
+
+public:
+    // jit: compile hot functions to machine code where the platform allows it
+    explicit RegisterVM(const RegisterModule& module, bool jit = true);
+
+    // Calls the named function (after running the global initializers once).
+    Value Call(string_view name, const vector<Value>& args = {});
+};
@@ -8,6 +8,8 @@
 #include <stdexcept>
 #include <algorithm>
 #include "Parser2.h" 
+#include "ScopeStack.h"
+#include "ThreadPool.h"
 
 using namespace std;
 
@@ -18,116 +20,73 @@ enum ScopeError {
     FunctionPrototypeRedefinition,
 };
 
-struct Symbol
-{
-    string name;
-    bool isFunction = false;
-    string type;
-    Symbol() = default;
-    Symbol(const string& n, const string& t, bool isFunc)
-        : name(n), type(t), isFunction(isFunc) {}
-};
-
-struct Scope
-{
-    unordered_map<string, Symbol> table;
-    shared_ptr<Scope> parent;
-
-    Scope(shared_ptr<Scope> parent = nullptr) : parent(parent) {}
-
-    // declare symbol only in this scope , returns false on redefinition in same scope
-    bool declareSym(const Symbol& s) {
-        if (table.find(s.name) != table.end()) return false;
-        table[s.name] = s;
-        return true;
+inline void reportScopeError(ostream& out, ScopeError err, SymbolId id) {
+    string_view name = SymbolName(id);
+    switch (err) {
+    case UndeclaredVariableAccessed:
+        out << "[ScopeError] UndeclaredVariableAccessed: " << name << "\n";
+        break;
+    case UndefinedFunctionCalled:
+        out << "[ScopeError] UndefinedFunctionCalled: " << name << "\n";
+        break;
+    case VariableRedefinition:
+        out << "[ScopeError] VariableRedefinition: " << name << "\n";
+        break;
+    case FunctionPrototypeRedefinition:
+        out << "[ScopeError] FunctionPrototypeRedefinition: " << name << "\n";
+        break;
     }
-
-    // lookup from this scope upward
-    const Symbol* lookup(const string& name) const {
-        const Scope* cur = this;
-        while (cur) {
-            auto it = cur->table.find(name);
-            if (it != cur->table.end()) return &it->second;
-            cur = cur->parent.get();
-        }
-        return nullptr;
-    }
-
-    // check only this scope for existence
-    bool existsInThisScope(const string& name) const {
-        return table.find(name) != table.end();
-    }
-
-};
-
-
-class ScopeAnalizer
+}
+
+// Checks one top-level item (a function, or a global variable's initializer)
+// against the global scope, which is frozen by then and shared read-only by
+// every checker. A function sees the globals declared up to and including
+// itself, a global initializer those before it, exactly what an in-order pass
+// would have seen. Names follow the scope rules in ScopeStack.h.
+class ItemScopeChecker : AstVisitor<ItemScopeChecker>
 {
-    Parser parser;
-    shared_ptr<Scope> globalScope;
-    shared_ptr<Scope> currentScope;
+    const ScopeStack& globals;
+    size_t visibleGlobals;
+    ScopeStack scopes;      // scopes of the function being analyzed
+    ostream& diagnostics;
 
 public:
-    ScopeAnalizer(const string& filename) :parser(filename) {
-        globalScope = make_shared<Scope>(nullptr);
-        currentScope = globalScope;
-    }
+    ItemScopeChecker(const ScopeStack& globals, size_t visibleGlobals, ostream& diagnostics)
+        : globals(globals), visibleGlobals(visibleGlobals), diagnostics(diagnostics) {}
 
-    void analyzeProgram() {
-        auto program = parser.parseProgram();
-        if (!program) {
-            cerr << "Parsing failed. Cannot perform scope analysis.\n";
-            return;
+    void analyzeItem(const ASTNode* item) {
+        if (auto func = nodeCast<FuncDecl>(item)) {
+            analyzeFunction(func);
         }
-        cout << "Parsed Program AST:\n";
-        program->print();
-        cout << "Scope Analysis Starting.\n";
-        for (const auto& item : program->globalItems)
-        {
-            if (auto func = dynamic_pointer_cast<FuncDecl>(item)) 
-            {
-                // Handle function declaration
-                if (!globalScope->declareSym(Symbol(func->name, func->retType, true))) 
-                {
-                    reportError(FunctionPrototypeRedefinition, func->name);                    
-                }
-                analyzeFunction(func);
-            }
-            else if (auto var = dynamic_pointer_cast<VarDeclStmt>(item)) 
-            {
-                // Handle global variable declaration
-                if (!globalScope->declareSym(Symbol(var->name, var->typeTok, false))) 
-                {
-                    reportError(VariableRedefinition, var->name);                   
-                }
-                if (var->init)
-                    analyzeExpr(var->init);
-            }
+        else if (auto var = nodeCast<VarDeclStmt>(item)) {
+            if (var->init)
+                analyzeExpr(var->init);
         }
-        
-
     }
 
 private:
+    // innermost local first, then the visible globals
+    const Symbol* lookup(SymbolId name) {
+        if (const Symbol* local = scopes.lookup(name))
+            return local;
+        return globals.lookupVisible(name, visibleGlobals);
+    }
+
     // push a new scope
     void pushScope() {
-        currentScope = make_shared<Scope>(currentScope);
+        scopes.pushScope();
     }
 
-    // pop current scope
+    // pop current scope, the global scope stays
     void popScope() {
-        if (!currentScope->parent) {
-            currentScope = globalScope;
-            return;
-        }
-        currentScope = currentScope->parent;
+        scopes.popScope();
     }
 
-    void analyzeFunction(const shared_ptr<FuncDecl>& func) {
+    void analyzeFunction(const FuncDecl* func) {
         pushScope();
 
         for (const auto& param : func->params) {
-            if (!currentScope->declareSym(Symbol(param.name, param.typeTok, false))) {
+            if (!scopes.declareSym(Symbol(param.name, param.typeTok, false))) {
                 reportError(VariableRedefinition, param.name);
             }
         }
@@ -136,7 +95,7 @@ private:
         }
         popScope();
     }
-    void analyzeBlockStmt(const shared_ptr<BlockStmt>& block, bool isFunctionBody = false) {
+    void analyzeBlockStmt(const BlockStmt* block, bool isFunctionBody = false) {
         if (!isFunctionBody)
             pushScope();
 
@@ -146,143 +105,165 @@ private:
         popScope();
     }
 
-    void analyzeStmt(const shared_ptr<Stmt>& stmt) {
+    void analyzeStmt(const Stmt* stmt) {
         if (!stmt) return;
-
-        // dynamic dispatch based on actual derived type:
-        if (auto bs = dynamic_pointer_cast<BlockStmt>(stmt)) {
-            analyzeBlockStmt(bs);
-            return;
-        }
-        if (auto vd = dynamic_pointer_cast<VarDeclStmt>(stmt)) {
-            // declare variable in current scope
-            if (!currentScope->declareSym(Symbol(vd->name, vd->typeTok, false))) {
-                reportError(ScopeError::VariableRedefinition, vd->name);
-            }
-            // analyze initializer expression if present
-            if (vd->init) analyzeExpr(vd->init);
-            return;
-        }
-        if (auto rs = dynamic_pointer_cast<ReturnStmt>(stmt)) {
-            if (rs->expr) analyzeExpr(rs->expr);
-            return;
-        }
-        if (auto es = dynamic_pointer_cast<ExprStmt>(stmt)) {
-            if (es->expr) analyzeExpr(es->expr);
-            return;
-        }
-        if (auto ifs = dynamic_pointer_cast<IfStmt>(stmt)) {
-            if (ifs->cond) analyzeExpr(ifs->cond);
-            if (ifs->thenStmt) analyzeStmt(ifs->thenStmt);
-            if (ifs->elseStmt) analyzeStmt(ifs->elseStmt);
-            return;
-        }
-        if (auto ws = dynamic_pointer_cast<WhileStmt>(stmt)) {
-            if (ws->cond) analyzeExpr(ws->cond);
-            if (ws->body) analyzeStmt(ws->body);
-            return;
-        }
-        if (auto fs = dynamic_pointer_cast<ForStmt>(stmt)) {
-            if (fs->init) analyzeStmt(fs->init);
-            if (fs->condStmt) analyzeStmt(fs->condStmt);
-            if (fs->iterExpr) analyzeExpr(fs->iterExpr);
-            if (fs->body) analyzeStmt(fs->body);
-            return;
-        }
-
-        // unknown stmt type -> ignore (or throw)
+        visit(stmt);
     }
 
     // analyze an expression
-    void analyzeExpr(const std::shared_ptr<Expr>& e) {
+    void analyzeExpr(const Expr* e) {
         if (!e) return;
+        visit(e);
+    }
 
-        if (auto id = dynamic_pointer_cast<IdentifierExpr>(e)) {
-            // lookup identifier as variable or parameter or function (we only check existence)
-            const Symbol* found = currentScope->lookup(id->name);
-            if (!found) {
-                // name not found -> undeclared variable accessed
-                reportError(ScopeError::UndeclaredVariableAccessed, id->name);
-            }
-            return;
-        }
+    // AstVisitor hooks: one switch on the node kind picks the handler.
+    // Literals have nothing to check and fall through to visitDefault.
+    friend struct AstVisitor<ItemScopeChecker>;
 
-        if (auto il = dynamic_pointer_cast<IntLiteral>(e)) {
-            return;
-        }
-        if (auto fl = dynamic_pointer_cast<FloatLiteral>(e)) {
-            return;
+    void visitBlock(const BlockStmt* bs) {
+        analyzeBlockStmt(bs);
+    }
+    void visitVarDecl(const VarDeclStmt* vd) {
+        // the initializer does not see the variable it initializes
+        if (vd->init) analyzeExpr(vd->init);
+        // declare variable in current scope
+        if (!scopes.declareSym(Symbol(vd->name, vd->typeTok, false))) {
+            reportError(ScopeError::VariableRedefinition, vd->name);
         }
-        if (auto sl = dynamic_pointer_cast<StringLiteral>(e)) {
-            return;
+    }
+    void visitReturn(const ReturnStmt* rs) {
+        if (rs->expr) analyzeExpr(rs->expr);
+    }
+    void visitExprStmt(const ExprStmt* es) {
+        if (es->expr) analyzeExpr(es->expr);
+    }
+    void visitIf(const IfStmt* ifs) {
+        if (ifs->cond) analyzeExpr(ifs->cond);
+        if (ifs->thenStmt) analyzeStmt(ifs->thenStmt);
+        if (ifs->elseStmt) analyzeStmt(ifs->elseStmt);
+    }
+    void visitWhile(const WhileStmt* ws) {
+        if (ws->cond) analyzeExpr(ws->cond);
+        if (ws->body) analyzeStmt(ws->body);
+    }
+    void visitFor(const ForStmt* fs) {
+        // a variable declared in the init clause lives until the end of the loop
+        pushScope();
+        if (fs->init) analyzeStmt(fs->init);
+        if (fs->condStmt) analyzeStmt(fs->condStmt);
+        if (fs->iterExpr) analyzeExpr(fs->iterExpr);
+        if (fs->body) analyzeStmt(fs->body);
+        popScope();
+    }
+
+    void visitIdentifier(const IdentifierExpr* id) {
+        // lookup identifier as variable or parameter or function (we only check existence)
+        const Symbol* found = lookup(id->name);
+        if (!found) {
+            // name not found -> undeclared variable accessed
+            reportError(ScopeError::UndeclaredVariableAccessed, id->name);
         }
-        if (auto bl = dynamic_pointer_cast<BoolLiteral>(e)) {
-            return;
+    }
+    void visitUnary(const UnaryExpr* unary) {
+        if (unary->rhs) analyzeExpr(unary->rhs);
+    }
+    void visitBinary(const BinaryExpr* binary) {
+        if (binary->left) analyzeExpr(binary->left);
+        if (binary->right) analyzeExpr(binary->right);
+    }
+    void visitCall(const CallExpr* call) {
+        // The callee can be an identifier expression (most common); try to resolve function name
+        // If callee is an Identifier, check that identifier exists and is a function
+        if (auto calleeId = nodeCast<IdentifierExpr>(call->callee)) {
+            const Symbol* sym = lookup(calleeId->name);
+            if (!sym) {
+                reportError(ScopeError::UndefinedFunctionCalled, calleeId->name);
+            }
+            else if (!sym->isFunction) {
+                // name exists but not a function -> undefined function called
+                reportError(ScopeError::UndefinedFunctionCalled, calleeId->name);
+            }
+            else {
+                // ok (we don't check arg counts/types here)
+            }
         }
-        if (auto cl = dynamic_pointer_cast<CharLiteral>(e)) {
-            return;
+        else {
+            // callee is an expression (e.g., more complex); analyze it anyway
+            analyzeExpr(call->callee);
         }
 
-        if (auto unary = dynamic_pointer_cast<UnaryExpr>(e)) {
-            if (unary->rhs) analyzeExpr(unary->rhs);
-            return;
-        }
+        // analyze args
+        for (auto& arg : call->args) if (arg) analyzeExpr(arg);
+    }
+    void visitPostfix(const PostfixExpr* post) {
+        if (post->base) analyzeExpr(post->base);
+    }
+
+    void reportError(ScopeError err, SymbolId id) {
+        reportScopeError(diagnostics, err, id);
+    }
+};
 
-        if (auto binary = dynamic_pointer_cast<BinaryExpr>(e)) {
-            if (binary->left) analyzeExpr(binary->left);
-            if (binary->right) analyzeExpr(binary->right);
+
+class ScopeAnalizer
+{
+    Parser parser;
+    ThreadPool& pool;
+    ScopeStack globals;
+
+public:
+    ScopeAnalizer(const string& filename, ThreadPool& pool = ThreadPool::Shared()) :parser(filename), pool(pool) {
+    }
+
+    // Two phases: the global symbols are declared in source order first, then the
+    // function bodies and global initializers are checked in parallel. Each item
+    // writes its diagnostics to its own buffer and the buffers are printed in
+    // source order, so the output is the same as a sequential pass. printAst
+    // false leaves out the printed AST, for timing the analysis alone.
+    void analyzeProgram(bool printAst = true) {
+        auto program = parser.parseProgramParallel(pool);
+        if (!program) {
+            cerr << "Parsing failed. Cannot perform scope analysis.\n";
             return;
         }
+        if (printAst) {
+            cout << "Parsed Program AST:\n";
+            program->print();
+            cout << "Scope Analysis Starting.\n";
+        }
 
-        if (auto call = dynamic_pointer_cast<CallExpr>(e)) {
-            // The callee can be an identifier expression (most common); try to resolve function name
-            // If callee is an Identifier, check that identifier exists and is a function
-            if (auto calleeId = dynamic_pointer_cast<IdentifierExpr>(call->callee)) {
-                const Symbol* sym = currentScope->lookup(calleeId->name);
-                if (!sym) {
-                    reportError(ScopeError::UndefinedFunctionCalled, calleeId->name);
-                }
-                else if (!sym->isFunction) {
-                    // name exists but not a function -> undefined function called
-                    reportError(ScopeError::UndefinedFunctionCalled, calleeId->name);
-                }
-                else {
-                    // ok (we don't check arg counts/types here)
+        const vector<ASTPtr>& items = program->globalItems;
+        vector<ostringstream> diagnostics(items.size());
+        vector<size_t> visible(items.size());
+        for (size_t k = 0; k < items.size(); k++)
+        {
+            if (auto func = nodeCast<FuncDecl>(items[k])) 
+            {
+                // Handle function declaration
+                if (!globals.declareSym(Symbol(func->name, func->retType, true))) 
+                {
+                    reportScopeError(diagnostics[k], FunctionPrototypeRedefinition, func->name);
                 }
             }
-            else {
-                // callee is an expression (e.g., more complex); analyze it anyway
-                analyzeExpr(call->callee);
+            else if (auto var = nodeCast<VarDeclStmt>(items[k])) 
+            {
+                // Handle global variable declaration; its initializer does not see it
+                visible[k] = globals.size();
+                if (!globals.declareSym(Symbol(var->name, var->typeTok, false))) 
+                {
+                    reportScopeError(diagnostics[k], VariableRedefinition, var->name);
+                }
+                continue;
             }
-
-            // analyze args
-            for (auto& arg : call->args) if (arg) analyzeExpr(arg);
-            return;
+            visible[k] = globals.size();
         }
 
-        if (auto post = dynamic_pointer_cast<PostfixExpr>(e)) {
-            if (post->base) analyzeExpr(post->base);
-            return;
-        }
+        pool.ParallelFor(items.size(), [&](size_t k) {
+            ItemScopeChecker checker(globals, visible[k], diagnostics[k]);
+            checker.analyzeItem(items[k]);
+        });
 
-        // other expression types: ignore or recursively inspect members if added in future.
+        for (const auto& d : diagnostics)
+            cerr << d.str();
     }
-
-    void reportError(ScopeError err, const string& name) {
-        switch (err) {
-        case UndeclaredVariableAccessed:
-            cerr << "[ScopeError] UndeclaredVariableAccessed: " << name << "\n";
-            break;
-        case UndefinedFunctionCalled:
-            cerr << "[ScopeError] UndefinedFunctionCalled: " << name << "\n";
-            break;
-        case VariableRedefinition:
-            cerr << "[ScopeError] VariableRedefinition: " << name << "\n";
-            break;
-        case FunctionPrototypeRedefinition:
-            cerr << "[ScopeError] FunctionPrototypeRedefinition: " << name << "\n";
-            break;
-        }
-        return;
-    }
-};
\ No newline at end of file
+};
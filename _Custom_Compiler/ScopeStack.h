@@ -0,0 +1,168 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "TokenKind.h"
+#include "StringInterner.h"
+using namespace std;
+
+struct Symbol
+{
+    SymbolId name = NO_SYMBOL;
+    bool isFunction = false;
+    TokenKind type = T_NONE;
+    int slot = -1;          // frame slot of a local, for the code generators
+    Symbol() = default;
+    Symbol(SymbolId n, TokenKind t, bool isFunc, int slot = -1)
+        : name(n), isFunction(isFunc), type(t), slot(slot) {}
+};
+
+// All scopes of the analysis in one structure.
+//
+// Names are interned SymbolIds. Every declaration appends a binding to one
+// vector; an open-addressed table maps an id to its innermost binding, and each
+// binding remembers the binding it shadows. pushScope only records a mark (the
+// binding count), popScope unwinds the bindings above the mark and restores the
+// table entries they shadowed. Lookup is an integer probe however deep the
+// nesting. The global scope (depth 0) is never popped.
+//
+// The scope rules. Every pass that resolves names walks the program in this
+// order, so they all agree on what a name means:
+// - A function's parameters and the outermost block of its body are one scope.
+// - Every other block opens a scope, and so does a for statement, for the
+//   variable of its init clause. A declaration that is by itself a branch of an
+//   if or the body of a loop belongs to the enclosing scope.
+// - A declaration is visible once its initializer is done: in `int x = x;`
+//   the initializer reads an outer x.
+// - Locals hide globals. A global variable is visible once its initializer is
+//   done, in the items after it.
+// Functions are the exception. The scope analysis checks in source order, so
+// it reports a call to a function declared further down, while the type
+// checker, the optimizations and the compilers know every function up front.
+class ScopeStack
+{
+    struct Binding
+    {
+        Symbol symbol;
+        int depth;
+        int shadowed;       // binding of the same id in an outer scope, -1 if none
+    };
+
+    struct Slot
+    {
+        SymbolId id = EMPTY;
+        int binding = -1;   // innermost binding, -1 while the name is not in scope
+    };
+
+    static const SymbolId EMPTY = NO_SYMBOL;
+
+    vector<Binding> bindings;
+    vector<size_t> marks;   // bindings.size() when each open scope was pushed
+    vector<Slot> table;     // power of two, at most half full
+    size_t used = 0;
+
+    static size_t hashId(SymbolId id)
+    {
+        return (size_t)(id * 2654435769u);
+    }
+
+    // index of the slot holding id, or of the empty slot where it would go
+    size_t findSlot(SymbolId id) const
+    {
+        size_t mask = table.size() - 1;
+        size_t i = hashId(id) & mask;
+        while (table[i].id != EMPTY && table[i].id != id)
+            i = (i + 1) & mask;
+        return i;
+    }
+    Slot& find(SymbolId id)
+    {
+        return table[findSlot(id)];
+    }
+
+    void grow()
+    {
+        vector<Slot> old;
+        old.swap(table);
+        table.assign(old.empty() ? 64 : old.size() * 2, Slot());
+        for (const Slot& s : old)
+            if (s.id != EMPTY)
+                find(s.id) = s;
+    }
+
+    int innermost(SymbolId name)
+    {
+        return find(name).binding;
+    }
+
+public:
+    ScopeStack() { grow(); }
+
+    int depth() const { return (int)marks.size(); }
+    size_t size() const { return bindings.size(); }
+
+    void pushScope()
+    {
+        marks.push_back(bindings.size());
+    }
+
+    void popScope()
+    {
+        if (marks.empty())
+            return;
+        size_t mark = marks.back();
+        marks.pop_back();
+        while (bindings.size() > mark)
+        {
+            const Binding& b = bindings.back();
+            find(b.symbol.name).binding = b.shadowed;
+            bindings.pop_back();
+        }
+    }
+
+    // declare symbol only in the innermost scope, returns false on redefinition in that scope
+    bool declareSym(const Symbol& s)
+    {
+        SymbolId id = s.name;
+        Slot* slot = &find(id);
+        if (slot->id == EMPTY)
+        {
+            if ((used + 1) * 2 > table.size())
+            {
+                grow();
+                slot = &find(id);
+            }
+            slot->id = id;
+            used++;
+        }
+        if (slot->binding >= 0 && bindings[slot->binding].depth == depth())
+            return false;
+        bindings.push_back({ s, depth(), slot->binding });
+        slot->binding = (int)bindings.size() - 1;
+        return true;
+    }
+
+    // innermost visible symbol with this name, nullptr if none.
+    // The pointer is only valid until the next declaration or pop.
+    const Symbol* lookup(SymbolId name)
+    {
+        int b = innermost(name);
+        return b >= 0 ? &bindings[b].symbol : nullptr;
+    }
+
+    // Read-only lookup that only sees the first `visible` bindings, for a stack
+    // that is no longer modified and is shared between threads (the global scope
+    // during parallel analysis). Global bindings are in declaration order, so this
+    // is the global scope as it was right after the visible-th declaration.
+    const Symbol* lookupVisible(SymbolId name, size_t visible) const
+    {
+        int b = table[findSlot(name)].binding;
+        return b >= 0 && (size_t)b < visible ? &bindings[b].symbol : nullptr;
+    }
+
+    // check only the innermost scope for existence
+    bool existsInThisScope(SymbolId name)
+    {
+        int b = innermost(name);
+        return b >= 0 && bindings[b].depth == depth();
+    }
+};
@@ -0,0 +1,201 @@
+#include "SimdScan.h"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(_M_IX86)
+#define SIMD_SCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SIMD_TARGET_AVX2
+#else
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// ---------------------------------------------------------------- scalar
+
+static inline bool IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+static inline bool IsIdent(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || IsDigit(c) || c == '_';
+}
+
+static size_t BlanksScalar(const char* s, size_t i, size_t n) { while (i < n && IsBlank(s[i])) i++; return i; }
+static size_t IdentScalar(const char* s, size_t i, size_t n) { while (i < n && IsIdent(s[i])) i++; return i; }
+static size_t DigitsScalar(const char* s, size_t i, size_t n) { while (i < n && IsDigit(s[i])) i++; return i; }
+static size_t StringScalar(const char* s, size_t i, size_t n)
+{
+    while (i < n && s[i] != '"' && s[i] != '\\' && s[i] != '\n') i++;
+    return i;
+}
+static size_t CommentScalar(const char* s, size_t i, size_t n)
+{
+    while (i < n && s[i] != '*' && s[i] != '\n') i++;
+    return i;
+}
+
+#ifdef SIMD_SCAN_X86
+
+static inline unsigned FirstSetBit(uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+// ---------------------------------------------------------------- SSE2, 16 bytes per step
+
+// bytes in [lo, hi]: bias so lo lands on -128 and use a signed compare
+static inline __m128i InRange16(__m128i v, char lo, char hi)
+{
+    __m128i t = _mm_add_epi8(v, _mm_set1_epi8((char)(0x80 - lo)));
+    return _mm_cmplt_epi8(t, _mm_set1_epi8((char)(0x80 + (hi - lo) + 1)));
+}
+static inline __m128i Eq16(__m128i v, char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); }
+
+static inline uint32_t BlankMask16(__m128i v)
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(Eq16(v, ' '), Eq16(v, '\t')), Eq16(v, '\r')));
+}
+static inline uint32_t IdentMask16(__m128i v)
+{
+    __m128i letter = InRange16(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letter, InRange16(v, '0', '9')), Eq16(v, '_')));
+}
+static inline uint32_t DigitMask16(__m128i v) { return (uint32_t)_mm_movemask_epi8(InRange16(v, '0', '9')); }
+static inline uint32_t StringStopMask16(__m128i v)
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(Eq16(v, '"'), Eq16(v, '\\')), Eq16(v, '\n')));
+}
+static inline uint32_t CommentStopMask16(__m128i v)
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(Eq16(v, '*'), Eq16(v, '\n')));
+}
+
+// RUN: skip while bytes are in the class. FIND: stop at the first byte in the class.
+#define SSE2_SCAN(name, maskFn, invert, tail) \
+    static size_t name(const char* s, size_t i, size_t n) \
+    { \
+        for (; i + 16 <= n; i += 16) \
+        { \
+            uint32_t m = maskFn(_mm_loadu_si128((const __m128i*)(s + i))); \
+            if (invert) m = ~m & 0xFFFFu; \
+            if (m) return i + FirstSetBit(m); \
+        } \
+        return tail(s, i, n); \
+    }
+
+SSE2_SCAN(BlanksSse2, BlankMask16, true, BlanksScalar)
+SSE2_SCAN(IdentSse2, IdentMask16, true, IdentScalar)
+SSE2_SCAN(DigitsSse2, DigitMask16, true, DigitsScalar)
+SSE2_SCAN(StringSse2, StringStopMask16, false, StringScalar)
+SSE2_SCAN(CommentSse2, CommentStopMask16, false, CommentScalar)
+
+// ---------------------------------------------------------------- AVX2, 32 bytes per step
+
+SIMD_TARGET_AVX2 static inline __m256i InRange32(__m256i v, char lo, char hi)
+{
+    __m256i t = _mm256_add_epi8(v, _mm256_set1_epi8((char)(0x80 - lo)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + (hi - lo) + 1)), t);
+}
+SIMD_TARGET_AVX2 static inline __m256i Eq32(__m256i v, char c) { return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)); }
+
+SIMD_TARGET_AVX2 static inline uint32_t BlankMask32(__m256i v)
+{
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(Eq32(v, ' '), Eq32(v, '\t')), Eq32(v, '\r')));
+}
+SIMD_TARGET_AVX2 static inline uint32_t IdentMask32(__m256i v)
+{
+    __m256i letter = InRange32(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(letter, InRange32(v, '0', '9')), Eq32(v, '_')));
+}
+SIMD_TARGET_AVX2 static inline uint32_t DigitMask32(__m256i v) { return (uint32_t)_mm256_movemask_epi8(InRange32(v, '0', '9')); }
+SIMD_TARGET_AVX2 static inline uint32_t StringStopMask32(__m256i v)
+{
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(Eq32(v, '"'), Eq32(v, '\\')), Eq32(v, '\n')));
+}
+SIMD_TARGET_AVX2 static inline uint32_t CommentStopMask32(__m256i v)
+{
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(Eq32(v, '*'), Eq32(v, '\n')));
+}
+
+#define AVX2_SCAN(name, maskFn, invert, tail) \
+    SIMD_TARGET_AVX2 static size_t name(const char* s, size_t i, size_t n) \
+    { \
+        for (; i + 32 <= n; i += 32) \
+        { \
+            uint32_t m = maskFn(_mm256_loadu_si256((const __m256i*)(s + i))); \
+            if (invert) m = ~m; \
+            if (m) return i + FirstSetBit(m); \
+        } \
+        return tail(s, i, n); \
+    }
+
+AVX2_SCAN(BlanksAvx2, BlankMask32, true, BlanksSse2)
+AVX2_SCAN(IdentAvx2, IdentMask32, true, IdentSse2)
+AVX2_SCAN(DigitsAvx2, DigitMask32, true, DigitsSse2)
+AVX2_SCAN(StringAvx2, StringStopMask32, false, StringSse2)
+AVX2_SCAN(CommentAvx2, CommentStopMask32, false, CommentSse2)
+
+static bool CpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)    // OS must save the YMM state
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // SIMD_SCAN_X86
+
+// ---------------------------------------------------------------- dispatch
+
+struct ScanTable
+{
+    size_t (*blanks)(const char*, size_t, size_t);
+    size_t (*ident)(const char*, size_t, size_t);
+    size_t (*digits)(const char*, size_t, size_t);
+    size_t (*string)(const char*, size_t, size_t);
+    size_t (*comment)(const char*, size_t, size_t);
+    const char* level;
+};
+
+static ScanTable PickScanTable()
+{
+#ifdef SIMD_SCAN_X86
+    if (CpuHasAvx2())
+        return { BlanksAvx2, IdentAvx2, DigitsAvx2, StringAvx2, CommentAvx2, "avx2" };
+    return { BlanksSse2, IdentSse2, DigitsSse2, StringSse2, CommentSse2, "sse2" };
+#else
+    return { BlanksScalar, IdentScalar, DigitsScalar, StringScalar, CommentScalar, "scalar" };
+#endif
+}
+
+static const ScanTable& Scan()
+{
+    static const ScanTable table = PickScanTable();
+    return table;
+}
+
+size_t ScanBlanks(const char* s, size_t from, size_t size) { return Scan().blanks(s, from, size); }
+size_t ScanIdentifier(const char* s, size_t from, size_t size) { return Scan().ident(s, from, size); }
+size_t ScanDigits(const char* s, size_t from, size_t size) { return Scan().digits(s, from, size); }
+size_t ScanStringBody(const char* s, size_t from, size_t size) { return Scan().string(s, from, size); }
+size_t ScanCommentBody(const char* s, size_t from, size_t size) { return Scan().comment(s, from, size); }
+const char* SimdScanLevel() { return Scan().level; }
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+
+// Vectorized scanners for the hand written lexer. Each takes the buffer, a start
+// index and the buffer size, and returns the index of the first byte at or after
+// `from` that ends the run (or `size` if the run reaches the end of the buffer).
+//
+// The implementation is picked on first use: AVX2 when the CPU and OS support it,
+// SSE2 on any other x86-64 machine, and plain loops everywhere else.
+
+// first byte that is not ' ', '\t' or '\r' (newlines are left to the caller for line counting)
+size_t ScanBlanks(const char* s, size_t from, size_t size);
+// first byte that is not [A-Za-z0-9_]
+size_t ScanIdentifier(const char* s, size_t from, size_t size);
+// first byte that is not [0-9]
+size_t ScanDigits(const char* s, size_t from, size_t size);
+// first '"', '\\' or '\n': the places a string literal body needs a closer look
+size_t ScanStringBody(const char* s, size_t from, size_t size);
+// first '*' or '\n': the places a block comment body needs a closer look
+size_t ScanCommentBody(const char* s, size_t from, size_t size);
+
+// "avx2", "sse2" or "scalar"
+const char* SimdScanLevel();
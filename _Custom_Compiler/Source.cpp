@@ -4,6 +4,17 @@
 #include "ScopeAnalysis_A_.h"
 //#include"Parser.h"
 #include"Parser2.h"
+#include "BytecodeCompiler.h"
+#include "StackVM.h"
+#include "RegisterCompiler.h"
+#include "RegisterVM.h"
+#include "SsaBuilder.h"
+#include "TypeChecker.h"
+#include "Inliner.h"
+#include "ConstantFolder.h"
+#include "DeadCodeEliminator.h"
+#include "CEmitter.h"
+#include "X64Asm.h"
 
 using namespace std;
 
@@ -26,8 +37,8 @@ using namespace std;
 //{
 //    Without_regex_Lexer lexer;
 //    string input = "int";
-//    string result = lexer.getKeywordToken(input);
-//    cout << "The token for '" << input << "' is: " << result << endl;
+//    TokenKind result = lexer.getKeywordToken(input);
+//    cout << "The token for '" << input << "' is: " << TokenKindName(result) << endl;
 //    vector<Token> tokens = lexer.CreateTokens("text.txt");
 //    lexer.printTokens();
 //    return 0;
@@ -74,9 +85,105 @@ int mai()
     return 0;
 }
 
-int main()
+// AST optimizations run before code generation; --no-opt turns them off.
+static bool optimize = true;
+
+// Type checks a parsed program and optimizes it.
+void prepareProgram(Program* program)
+{
+    TypeChecker::Check(program);
+    if (!optimize)
+        return;
+    Inliner::Run(program);
+    ConstantFolder::Run(program);
+    DeadCodeEliminator::Run(program);
+    // the passes do not keep the type annotations up to date
+    TypeChecker::Check(program);
+}
+
+// Prints what main returned. A string result points into the module or the
+// VM that made it, so both must still be alive.
+static int reportResult(const Value& result)
+{
+    cout << "main returned " << ValueToString(result) << endl;
+    return result.type == V_INT ? (int)result.i : 0;
+}
+
+// Compiles a program and runs its main function, on the register VM or,
+// with stackVM, on the stack VM. jit lets the register VM compile hot code.
+int runProgram(const string& filename, bool stackVM, bool jit = true)
+{
+    Parser p(filename);
+    shared_ptr<Program> program = p.parseProgram();
+    prepareProgram(program.get());
+    if (stackVM)
+    {
+        BytecodeModule module = BytecodeCompiler::Compile(program.get());
+        StackVM vm(module);
+        return reportResult(vm.Call("main"));
+    }
+    RegisterModule module = RegisterCompiler::Compile(program.get());
+    RegisterVM vm(module, jit);
+    return reportResult(vm.Call("main"));
+}
+
+// Prints the SSA form of a program.
+void dumpSsa(const string& filename)
+{
+    Parser p(filename);
+    shared_ptr<Program> program = p.parseProgram();
+    prepareProgram(program.get());
+    cout << SsaBuilder::Build(program.get()).Dump();
+}
+
+// Prints a program translated to C.
+void emitC(const string& filename)
+{
+    Parser p(filename);
+    shared_ptr<Program> program = p.parseProgram();
+    prepareProgram(program.get());
+    cout << CEmitter::Emit(program.get());
+}
+
+// Prints a program compiled to x86-64 assembly.
+void emitAsm(const string& filename)
+{
+    Parser p(filename);
+    shared_ptr<Program> program = p.parseProgram();
+    prepareProgram(program.get());
+    cout << X64Asm::Emit(SsaBuilder::Build(program.get()));
+}
+
+int main(int argc, char** argv)
 {
     try {
+        if (argc >= 2 && string(argv[1]) == "--no-opt")
+        {
+            optimize = false;
+            argc--;
+            argv++;
+        }
+        if (argc >= 3 && string(argv[1]) == "--run")
+            return runProgram(argv[2], false);
+        if (argc >= 3 && string(argv[1]) == "--run-stack")
+            return runProgram(argv[2], true);
+        if (argc >= 3 && string(argv[1]) == "--run-nojit")
+            return runProgram(argv[2], false, false);
+        if (argc >= 3 && string(argv[1]) == "--dump-ssa")
+        {
+            dumpSsa(argv[2]);
+            return 0;
+        }
+        if (argc >= 3 && string(argv[1]) == "--emit-c")
+        {
+            emitC(argv[2]);
+            return 0;
+        }
+        if (argc >= 3 && string(argv[1]) == "--emit-asm")
+        {
+            emitAsm(argv[2]);
+            return 0;
+        }
         ScopeAnalizer analyzer("text.txt");
         analyzer.analyzeProgram();
     }
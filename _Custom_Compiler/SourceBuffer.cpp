@@ -0,0 +1,130 @@
+#include "SourceBuffer.h"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+void SourceBuffer::Load(const string& filename)
+{
+    Release();
+
+    if (filename == "-")
+    {
+        ReadStream(cin);
+        return;
+    }
+    if (Map(filename))
+        return;
+
+    ifstream file(filename, ios::binary);
+    if (!file)
+        throw runtime_error("Could not open file!");
+    ReadStream(file);
+}
+
+void SourceBuffer::ReadStream(istream& in)
+{
+    owned.clear();
+    char chunk[1 << 16];
+    while (in.read(chunk, sizeof(chunk)) || in.gcount() > 0)
+        owned.append(chunk, (size_t)in.gcount());
+    data = owned.data();
+    size = owned.size();
+}
+
+#ifdef _WIN32
+
+bool SourceBuffer::Map(const string& filename)
+{
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER length;
+    if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &length) || length.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!handle)
+        return false;
+    void* view = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    mapping = view;
+    mapping_handle = handle;
+    data = (const char*)view;
+    size = (size_t)length.QuadPart;
+    return true;
+}
+
+void SourceBuffer::Release()
+{
+    if (mapping)
+    {
+        UnmapViewOfFile(mapping);
+        CloseHandle(mapping_handle);
+        mapping = nullptr;
+        mapping_handle = nullptr;
+    }
+    owned.clear();
+    data = "";
+    size = 0;
+}
+
+#else
+
+bool SourceBuffer::Map(const string& filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return false;
+    madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    mapping = view;
+    data = (const char*)view;
+    size = (size_t)st.st_size;
+    return true;
+}
+
+void SourceBuffer::Release()
+{
+    if (mapping)
+    {
+        munmap(mapping, size);
+        mapping = nullptr;
+    }
+    owned.clear();
+    data = "";
+    size = 0;
+}
+
+#endif
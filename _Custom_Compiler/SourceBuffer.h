@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+#include <string_view>
+using namespace std;
+
+// Owns the bytes of one source file. Tokens point into it with string_views,
+// so a SourceBuffer must outlive every token lexed from it. It is neither
+// copyable nor movable because that would leave those views dangling.
+//
+// Regular files are memory-mapped and lexed in place. Pipes, character devices
+// and "-" (stdin) cannot be mapped, so they are read into an owned string instead.
+class SourceBuffer
+{
+    const char* data = "";
+    size_t size = 0;
+    string owned;       // storage when the input could not be mapped
+    void* mapping = nullptr;
+#ifdef _WIN32
+    void* mapping_handle = nullptr;
+#endif
+
+    bool Map(const string& filename);
+    void ReadStream(istream& in);
+    void Release();
+
+public:
+    SourceBuffer() = default;
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+    ~SourceBuffer() { Release(); }
+
+    // Maps or reads the whole input, throws runtime_error if it cannot be opened.
+    void Load(const string& filename);
+
+    string_view View() const { return string_view(data, size); }
+    const char* Begin() const { return data; }
+    const char* End() const { return data + size; }
+    size_t Size() const { return size; }
+    bool IsMapped() const { return mapping != nullptr; }
+};
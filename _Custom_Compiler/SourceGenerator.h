@@ -0,0 +1,268 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <random>
+#include <sstream>
+using namespace std;
+
+// Knobs of SourceGenerator.
+struct GeneratorOptions
+{
+    int functions = 200;        // function declarations, main included
+    int depth = 3;              // deepest nesting of if, while and for bodies
+    double churn = 0.5;         // chance that a declaration uses a name never seen before
+    double comments = 0.1;      // chance of a comment before a line
+    unsigned seed = 1;
+};
+
+// Writes synthetic programs in the language's grammar, for benchmarks.
+//
+// A program is a series of globals and functions and ends with main. Every
+// name is declared before it is used, and calls only go to earlier functions
+// with the right number of arguments. So the output also gets through the
+// parser and the scope analysis, and its size grows linearly with
+// GeneratorOptions::functions.
+//
+// With churn 0, locals reuse the names of other functions' locals, so there
+// are few distinct identifiers. With churn 1, every declaration brings a new
+// one, which keeps the interner and symbol tables busy. Comments are // lines,
+// or /* */ blocks between top-level items, the only place the parser takes
+// them; some blocks span lines.
+class SourceGenerator
+{
+    struct Function
+    {
+        string name;
+        size_t params;
+    };
+
+    const GeneratorOptions& options;
+    mt19937 rng;
+    ostringstream out;
+    vector<Function> functions;
+    vector<string> globals;
+    vector<string> seen;                // every local name so far, for reuse
+    unordered_set<string> declared;     // names of the function being written
+    int fresh = 0;
+
+    explicit SourceGenerator(const GeneratorOptions& options) : options(options), rng(options.seed) {}
+
+public:
+    static string Generate(const GeneratorOptions& options)
+    {
+        SourceGenerator g(options);
+        g.program();
+        return g.out.str();
+    }
+
+private:
+    int below(int n)
+    {
+        return uniform_int_distribution<int>(0, n - 1)(rng);
+    }
+
+    bool chance(double p)
+    {
+        return uniform_real_distribution<double>(0, 1)(rng) < p;
+    }
+
+    template <typename T>
+    const T& pick(const vector<T>& v)
+    {
+        return v[below((int)v.size())];
+    }
+
+    void indent(int level)
+    {
+        out << string(4 * level, ' ');
+    }
+
+    // a name no declaration has used, spelled like real identifiers
+    string freshName()
+    {
+        static const char* const stems[] = { "count", "total", "index", "value", "offset", "limit", "step", "acc", "tmp", "len" };
+        return stems[below(10)] + string("_") + to_string(fresh++);
+    }
+
+    string declareLocal()
+    {
+        string name;
+        if (!chance(options.churn) && !seen.empty())
+        {
+            // a few tries at a name another function used and this one has not
+            for (int i = 0; i < 4 && name.empty(); i++)
+            {
+                const string& s = pick(seen);
+                if (!declared.count(s))
+                    name = s;
+            }
+        }
+        if (name.empty())
+        {
+            name = freshName();
+            seen.push_back(name);
+        }
+        declared.insert(name);
+        return name;
+    }
+
+    void comment(int level)
+    {
+        if (!chance(options.comments))
+            return;
+        static const char* const words[] = { "update", "the", "running", "total", "before", "next", "check", "bound", "of", "loop", "keep", "value" };
+        auto text = [&]() {
+            string s;
+            for (int i = 0, n = 3 + below(6); i < n; i++)
+                s += string(i ? " " : "") + words[below(12)];
+            return s;
+        };
+        indent(level);
+        if (level > 0 || chance(0.4))
+            out << "// " << text() << "\n";
+        else if (chance(0.5))
+            out << "/* " << text() << " */\n";
+        else
+        {
+            out << "/* " << text() << "\n";
+            indent(level);
+            out << "   " << text() << " */\n";
+        }
+    }
+
+    string literal()
+    {
+        switch (below(4))
+        {
+        case 0: return to_string(below(1000));
+        case 1: return to_string(below(100)) + "." + to_string(below(100));
+        case 2: return chance(0.5) ? "true" : "false";
+        default: return to_string(below(10));
+        }
+    }
+
+    string operand(const vector<string>& vars)
+    {
+        return !vars.empty() && chance(0.7) ? pick(vars) : literal();
+    }
+
+    string expression(const vector<string>& vars, int depth)
+    {
+        static const char* const ops[] = { "+", "-", "*", "+", "<", ">", "<=", "==", "!=", "&&", "||" };
+        if (depth <= 0 || chance(0.35))
+            return operand(vars);
+        if (!functions.empty() && chance(0.15))
+        {
+            const Function& f = pick(functions);
+            string call = f.name + "(";
+            for (size_t i = 0; i < f.params; i++)
+                call += (i ? ", " : "") + expression(vars, depth - 1);
+            return call + ")";
+        }
+        string e = expression(vars, depth - 1) + " " + ops[below(11)] + " " + expression(vars, depth - 1);
+        return chance(0.3) ? "(" + e + ")" : e;
+    }
+
+    void block(vector<string> vars, int level, int depth)
+    {
+        for (int i = 0, n = 2 + below(4); i < n; i++)
+        {
+            comment(level);
+            int kind = below(depth > 0 ? 6 : 3);
+            indent(level);
+            switch (kind)
+            {
+            case 0:
+            {
+                string init = expression(vars, 2);
+                string name = declareLocal();
+                out << "int " << name << " = " << init << ";\n";
+                vars.push_back(name);
+                break;
+            }
+            case 1:
+            case 2:
+                if (vars.empty())
+                    out << expression(vars, 2) << ";\n";
+                else
+                    out << pick(vars) << " = " << expression(vars, 3) << ";\n";
+                break;
+            case 3:
+                out << "if (" << expression(vars, 2) << ")\n";
+                indent(level);
+                out << "{\n";
+                block(vars, level + 1, depth - 1);
+                indent(level);
+                out << "}\n";
+                if (chance(0.4))
+                {
+                    indent(level);
+                    out << "else\n";
+                    indent(level);
+                    out << "{\n";
+                    block(vars, level + 1, depth - 1);
+                    indent(level);
+                    out << "}\n";
+                }
+                break;
+            case 4:
+            {
+                string i = declareLocal();
+                out << "for (int " << i << " = 0; " << i << " < " << 1 + below(10) << "; " << i << "++)\n";
+                indent(level);
+                out << "{\n";
+                vector<string> inner = vars;
+                inner.push_back(i);
+                block(inner, level + 1, depth - 1);
+                indent(level);
+                out << "}\n";
+                break;
+            }
+            default:
+                out << "while (" << expression(vars, 2) << ")\n";
+                indent(level);
+                out << "{\n";
+                block(vars, level + 1, depth - 1);
+                indent(level);
+                out << "}\n";
+                break;
+            }
+        }
+    }
+
+    void function(const string& name, size_t params)
+    {
+        declared.clear();
+        vector<string> vars = globals;
+        out << "int " << name << "(";
+        for (size_t i = 0; i < params; i++)
+        {
+            string p = declareLocal();
+            out << (i ? ", " : "") << "int " << p;
+            vars.push_back(p);
+        }
+        out << ")\n{\n";
+        block(vars, 1, options.depth);
+        comment(1);
+        out << "    return " << expression(vars, 2) << ";\n}\n\n";
+    }
+
+    void program()
+    {
+        for (int f = 0; f + 1 < options.functions; f++)
+        {
+            if (chance(0.2))
+            {
+                string g = "global_" + to_string(globals.size());
+                out << "int " << g << " = " << literal() << ";\n\n";
+                globals.push_back(g);
+            }
+            comment(0);
+            Function fn{ "func_" + to_string(f), (size_t)below(4) };
+            function(fn.name, fn.params);
+            functions.push_back(fn);
+        }
+        function("main", 0);
+    }
+};
@@ -0,0 +1,821 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include "Parser2.h"
+#include "ScopeStack.h"
+#include "BytecodeCompiler.h"
+#include "SsaIR.h"
+
+using namespace std;
+
+// Lowers a parsed Program to an SsaModule.
+//
+// Variables are renamed while the blocks are built (Braun et al., "Simple and
+// Efficient Construction of Static Single Assignment Form"). A read looks for
+// the variable's last definition in the current block and otherwise asks the
+// predecessors, with a phi where they might disagree. A block is sealed once all
+// its predecessors are known. A read in an unsealed block (a loop header) gets a
+// phi whose operands are filled in at sealing. Afterwards the function is
+// cleaned up: unreachable blocks and phis whose operands are all the same value
+// go, and blocks are renumbered in reverse postorder for the dominator tree.
+//
+// Name, arity and type errors throw runtime_error as in the bytecode compilers.
+// Since every value is typed, an operation that can only fail (a string used as
+// a number) is rejected here instead of at run time.
+class SsaBuilder : AstVisitor<SsaBuilder, ValueId>
+{
+    struct BlockState
+    {
+        unordered_map<int, ValueId> defs;           // variable -> its value at the end of the block so far
+        vector<pair<int, ValueId>> incompletePhis;  // variable, phi; operands wait for sealing
+        bool sealed = false;
+    };
+
+    SsaModule module;
+    unordered_map<SymbolId, int> functionIndex;
+    unordered_map<SymbolId, int> globalIndex;
+    int visibleGlobals = 0;     // globals declared before the code being built
+    vector<pair<const VarDeclStmt*, int>> globalInits;
+
+    SsaFunction* fn = nullptr;  // function being built
+    int current = -1;           // block being filled
+    vector<BlockState> state;   // by block
+    ScopeStack scopes;          // Symbol::slot is the variable's number
+    vector<ValueType> varTypes; // by variable number
+
+public:
+    static SsaModule Build(const Program* program)
+    {
+        SsaBuilder b;
+        b.buildProgram(program);
+        return move(b.module);
+    }
+
+private:
+    void buildProgram(const Program* program)
+    {
+        for (const ASTPtr item : program->globalItems)
+        {
+            if (auto func = nodeCast<FuncDecl>(item))
+            {
+                if (functionIndex.count(func->name))
+                    error("function redefined", func->name);
+                functionIndex[func->name] = (int)module.functions.size();
+                module.functions.emplace_back();
+                SsaFunction& f = module.functions.back();
+                f.name = func->name;
+                f.retType = valueTypeOf(func->retType);
+                for (const Param& p : func->params)
+                    f.paramTypes.push_back(valueTypeOf(p.typeTok));
+            }
+        }
+        module.globalInit = (int)module.functions.size();
+        module.functions.emplace_back();
+        module.functions.back().name = Intern("<globals>");
+
+        for (const ASTPtr item : program->globalItems)
+        {
+            if (auto func = nodeCast<FuncDecl>(item))
+                buildFunction(func);
+            else if (auto var = nodeCast<VarDeclStmt>(item))
+                declareGlobal(var);
+        }
+
+        // initializers run in source order, each seeing only the globals before it
+        beginFunction(module.globalInit);
+        for (auto& init : globalInits)
+        {
+            visibleGlobals = init.second;
+            ValueType type = module.globalTypes[init.second];
+            ValueId value = init.first->init ? converted(init.first->init, type) : constant(DefaultValue(type));
+            emit(S_SET_GLOBAL, V_VOID, { value }, init.second);
+        }
+        emit(S_RETURN, V_VOID);
+        endFunction();
+    }
+
+    void declareGlobal(const VarDeclStmt* var)
+    {
+        ValueType type = valueTypeOf(var->typeTok);
+        if (type == V_VOID)
+            error("variable declared void", var->name);
+        if (globalIndex.count(var->name))
+            error("global variable redefined", var->name);
+        int index = (int)module.globalTypes.size();
+        globalIndex[var->name] = index;
+        module.globalTypes.push_back(type);
+        module.globalNames.push_back(var->name);
+        globalInits.push_back({ var, index });
+        visibleGlobals = index + 1;
+    }
+
+    void buildFunction(const FuncDecl* func)
+    {
+        beginFunction(functionIndex[func->name]);
+        // parameters share the scope of the outermost block of the body
+        scopes.pushScope();
+        for (size_t i = 0; i < func->params.size(); i++)
+        {
+            const Param& p = func->params[i];
+            ValueType type = valueTypeOf(p.typeTok);
+            if (type == V_VOID)
+                error("parameter declared void", p.name);
+            int var = declareVariable(p.name, p.typeTok);
+            writeVariable(var, current, emit(S_PARAM, type, {}, (int32_t)i));
+        }
+        if (func->body)
+            for (const auto& stmt : func->body->stmts)
+                buildStmt(stmt);
+        scopes.popScope();
+        // falling off the end returns the default value of the return type
+        if (fn->retType == V_VOID)
+            emit(S_RETURN, V_VOID);
+        else
+            emit(S_RETURN, V_VOID, { constant(DefaultValue(fn->retType)) });
+        endFunction();
+    }
+
+    void beginFunction(int index)
+    {
+        fn = &module.functions[index];
+        state.clear();
+        scopes = ScopeStack();
+        varTypes.clear();
+        current = newBlock();
+        sealBlock(current);
+    }
+
+    void endFunction()
+    {
+        finishFunction();
+        fn->ComputeDominators();
+        fn->Verify();
+        fn = nullptr;
+    }
+
+    // ---- blocks and instructions ----
+
+    int newBlock()
+    {
+        fn->blocks.emplace_back();
+        state.emplace_back();
+        return (int)fn->blocks.size() - 1;
+    }
+
+    // a block no code jumps to, for whatever follows a return
+    int deadBlock()
+    {
+        int b = newBlock();
+        sealBlock(b);
+        return b;
+    }
+
+    ValueId emit(SsaOp op, ValueType type, vector<ValueId> args = {}, int32_t index = 0)
+    {
+        return insert(current, fn->blocks[current].insts.size(), op, type, move(args), index);
+    }
+
+    ValueId insert(int block, size_t at, SsaOp op, ValueType type, vector<ValueId> args = {}, int32_t index = 0)
+    {
+        ValueId v = (ValueId)fn->insts.size();
+        fn->insts.emplace_back();
+        SsaInst& in = fn->insts.back();
+        in.op = op;
+        in.type = type;
+        in.block = block;
+        in.index = index;
+        in.args = move(args);
+        vector<ValueId>& list = fn->blocks[block].insts;
+        list.insert(list.begin() + at, v);
+        return v;
+    }
+
+    ValueType typeOf(ValueId v) const
+    {
+        return fn->insts[v].type;
+    }
+
+    ValueId constant(const Value& v)
+    {
+        Value k = v;
+        if (v.type == V_STRING)
+        {
+            module.strings.push_back(*v.s);
+            k = Value::String(&module.strings.back());
+        }
+        ValueId c = emit(S_CONST, v.type);
+        fn->insts[c].constant = k;
+        return c;
+    }
+
+    void addEdge(int from, int to)
+    {
+        fn->blocks[from].succs.push_back(to);
+        fn->blocks[to].preds.push_back(from);
+    }
+
+    void jump(int to)
+    {
+        emit(S_JUMP, V_VOID);
+        addEdge(current, to);
+    }
+
+    void branch(ValueId cond, int ifTrue, int ifFalse)
+    {
+        emit(S_BRANCH, V_VOID, { cond });
+        addEdge(current, ifTrue);
+        addEdge(current, ifFalse);
+    }
+
+    // ---- variables ----
+
+    int declareVariable(SymbolId name, TokenKind typeTok)
+    {
+        int var = (int)varTypes.size();
+        if (!scopes.declareSym(Symbol(name, typeTok, false, var)))
+            error("variable redefined", name);
+        varTypes.push_back(valueTypeOf(typeTok));
+        return var;
+    }
+
+    void writeVariable(int var, int block, ValueId v)
+    {
+        state[block].defs[var] = v;
+    }
+
+    ValueId readVariable(int var, int block)
+    {
+        auto it = state[block].defs.find(var);
+        if (it != state[block].defs.end())
+            return it->second;
+        return readVariableRecursive(var, block);
+    }
+
+    ValueId readVariableRecursive(int var, int block)
+    {
+        ValueType type = varTypes[var];
+        vector<int> preds = fn->blocks[block].preds;
+        ValueId v;
+        if (!state[block].sealed)
+        {
+            v = newPhi(block, type);
+            state[block].incompletePhis.push_back({ var, v });
+        }
+        else if (preds.size() == 1)
+            v = readVariable(var, preds[0]);
+        else if (preds.empty())
+        {
+            // only in code after a return: no path defines the variable
+            v = insert(block, leading(block, true), S_UNDEF, type);
+        }
+        else
+        {
+            // the phi is the definition while its operands are read, which ends loops
+            v = newPhi(block, type);
+            writeVariable(var, block, v);
+            addPhiOperands(var, v);
+        }
+        writeVariable(var, block, v);
+        return v;
+    }
+
+    // position after the block's phis (and its undefs with withUndef)
+    size_t leading(int block, bool withUndef) const
+    {
+        const vector<ValueId>& list = fn->blocks[block].insts;
+        size_t at = 0;
+        while (at < list.size() && (fn->insts[list[at]].op == S_PHI || (withUndef && fn->insts[list[at]].op == S_UNDEF)))
+            at++;
+        return at;
+    }
+
+    ValueId newPhi(int block, ValueType type)
+    {
+        return insert(block, leading(block, false), S_PHI, type);
+    }
+
+    void addPhiOperands(int var, ValueId phi)
+    {
+        vector<int> preds = fn->blocks[fn->insts[phi].block].preds;
+        for (int p : preds)
+        {
+            ValueId v = readVariable(var, p);
+            fn->insts[phi].args.push_back(v);
+        }
+    }
+
+    void sealBlock(int block)
+    {
+        // reading through the predecessors may add phis to this block too
+        for (size_t i = 0; i < state[block].incompletePhis.size(); i++)
+        {
+            auto incomplete = state[block].incompletePhis[i];
+            addPhiOperands(incomplete.first, incomplete.second);
+        }
+        state[block].incompletePhis.clear();
+        state[block].sealed = true;
+    }
+
+    // ---- cleanup ----
+
+    void finishFunction()
+    {
+        size_t blockCount = fn->blocks.size();
+
+        // reverse postorder of the blocks reachable from the entry
+        vector<int> order;
+        vector<char> seen(blockCount, 0);
+        vector<pair<int, size_t>> work{ { 0, 0 } };
+        seen[0] = 1;
+        while (!work.empty())
+        {
+            int b = work.back().first;
+            size_t& next = work.back().second;
+            if (next < fn->blocks[b].succs.size())
+            {
+                int s = fn->blocks[b].succs[next++];
+                if (!seen[s])
+                {
+                    seen[s] = 1;
+                    work.push_back({ s, 0 });
+                }
+            }
+            else
+            {
+                order.push_back(b);
+                work.pop_back();
+            }
+        }
+        reverse(order.begin(), order.end());
+        vector<int> newBlock(blockCount, -1);
+        for (size_t i = 0; i < order.size(); i++)
+            newBlock[order[i]] = (int)i;
+
+        // edges from unreachable blocks, and the phi operands that came along them
+        for (int b : order)
+        {
+            vector<int>& preds = fn->blocks[b].preds;
+            for (size_t i = preds.size(); i-- > 0;)
+            {
+                if (newBlock[preds[i]] >= 0)
+                    continue;
+                preds.erase(preds.begin() + i);
+                for (ValueId v : fn->blocks[b].insts)
+                    if (fn->insts[v].op == S_PHI)
+                        fn->insts[v].args.erase(fn->insts[v].args.begin() + i);
+            }
+        }
+
+        // a phi whose operands are all one value (or itself) is that value
+        vector<ValueId> forward(fn->insts.size());
+        for (size_t v = 0; v < forward.size(); v++)
+            forward[v] = (ValueId)v;
+        auto resolve = [&](ValueId v) {
+            while (forward[v] != v)
+                v = forward[v];
+            return v;
+        };
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (int b : order)
+                for (ValueId v : fn->blocks[b].insts)
+                {
+                    if (fn->insts[v].op != S_PHI || forward[v] != v)
+                        continue;
+                    ValueId same = NO_VALUE;
+                    bool trivial = true;
+                    for (ValueId a : fn->insts[v].args)
+                    {
+                        a = resolve(a);
+                        if (a == same || a == v)
+                            continue;
+                        if (same != NO_VALUE)
+                        {
+                            trivial = false;
+                            break;
+                        }
+                        same = a;
+                    }
+                    if (trivial && same != NO_VALUE)
+                    {
+                        forward[v] = same;
+                        changed = true;
+                    }
+                }
+        }
+
+        // renumber blocks in reverse postorder and values in block order
+        vector<ValueId> newValue(fn->insts.size(), NO_VALUE);
+        vector<SsaInst> insts;
+        vector<SsaBlock> blocks(order.size());
+        for (size_t nb = 0; nb < order.size(); nb++)
+            for (ValueId v : fn->blocks[order[nb]].insts)
+                if (forward[v] == v)
+                {
+                    newValue[v] = (ValueId)insts.size();
+                    blocks[nb].insts.push_back(newValue[v]);
+                    insts.push_back(move(fn->insts[v]));
+                    insts.back().block = (int)nb;
+                }
+        for (SsaInst& in : insts)
+            for (ValueId& a : in.args)
+                a = newValue[resolve(a)];
+        for (size_t nb = 0; nb < order.size(); nb++)
+        {
+            for (int p : fn->blocks[order[nb]].preds)
+                blocks[nb].preds.push_back(newBlock[p]);
+            for (int s : fn->blocks[order[nb]].succs)
+                blocks[nb].succs.push_back(newBlock[s]);
+        }
+        fn->insts.swap(insts);
+        fn->blocks.swap(blocks);
+    }
+
+    [[noreturn]] void error(const string& message, SymbolId name = NO_SYMBOL)
+    {
+        string text = "[CompileError] " + message;
+        if (name != NO_SYMBOL)
+            text += ": " + string(SymbolName(name));
+        throw runtime_error(text);
+    }
+
+    // ---- types ----
+
+    static bool isNumeric(ValueType t)
+    {
+        return t == V_INT || t == V_FLOAT || t == V_BOOL;
+    }
+
+    // v as a value of type to, for a store, an argument, a return value or an operand
+    ValueId convert(ValueId v, ValueType to)
+    {
+        ValueType from = typeOf(v);
+        if (from == to)
+            return v;
+        if (!isNumeric(from) || !isNumeric(to))
+            error(string("cannot convert ") + ValueTypeName(from) + " to " + ValueTypeName(to));
+        return emit(S_CONVERT, to, { v });
+    }
+
+    ValueId converted(const Expr* e, ValueType to)
+    {
+        return convert(buildExpr(e), to);
+    }
+
+    // type both operands of arithmetic or a comparison are converted to:
+    // float if either is a float, int otherwise (bools count as ints)
+    static ValueType commonType(ValueType a, ValueType b)
+    {
+        return a == V_FLOAT || b == V_FLOAT ? V_FLOAT : V_INT;
+    }
+
+    // ---- conditions ----
+
+    // Ends the current block with a branch to ifTrue or ifFalse on e; && || and !
+    // become control flow.
+    void condBranch(const Expr* e, int ifTrue, int ifFalse)
+    {
+        if (auto u = nodeCast<UnaryExpr>(e))
+        {
+            if (u->op == T_NOT)
+            {
+                condBranch(u->rhs, ifFalse, ifTrue);
+                return;
+            }
+        }
+        else if (auto b = nodeCast<BinaryExpr>(e))
+        {
+            if (b->op == T_AND || b->op == T_OR)
+            {
+                int right = newBlock();
+                if (b->op == T_AND)
+                    condBranch(b->left, right, ifFalse);
+                else
+                    condBranch(b->left, ifTrue, right);
+                sealBlock(right);
+                current = right;
+                condBranch(b->right, ifTrue, ifFalse);
+                return;
+            }
+        }
+        else if (auto lit = nodeCast<BoolLiteral>(e))
+        {
+            jump(lit->value ? ifTrue : ifFalse);
+            return;
+        }
+        branch(converted(e, V_BOOL), ifTrue, ifFalse);
+    }
+
+    // ---- statements ----
+
+    void buildStmt(const Stmt* stmt)
+    {
+        if (stmt)
+            visit(stmt);
+    }
+
+    friend struct AstVisitor<SsaBuilder, ValueId>;
+
+    ValueId visitDefault(const ASTNode*)
+    {
+        error("construct not supported by the SSA builder");
+    }
+
+    ValueId visitBlock(const BlockStmt* bs)
+    {
+        scopes.pushScope();
+        for (const auto& stmt : bs->stmts)
+            buildStmt(stmt);
+        scopes.popScope();
+        return NO_VALUE;
+    }
+    ValueId visitVarDecl(const VarDeclStmt* vd)
+    {
+        ValueType type = valueTypeOf(vd->typeTok);
+        if (type == V_VOID)
+            error("variable declared void", vd->name);
+        // the initializer does not see the variable it initializes
+        ValueId value = vd->init ? converted(vd->init, type) : constant(DefaultValue(type));
+        writeVariable(declareVariable(vd->name, vd->typeTok), current, value);
+        return NO_VALUE;
+    }
+    ValueId visitReturn(const ReturnStmt* rs)
+    {
+        if (fn->retType == V_VOID)
+        {
+            buildExpr(rs->expr);
+            emit(S_RETURN, V_VOID);
+        }
+        else
+            emit(S_RETURN, V_VOID, { converted(rs->expr, fn->retType) });
+        current = deadBlock();
+        return NO_VALUE;
+    }
+    ValueId visitExprStmt(const ExprStmt* es)
+    {
+        if (es->expr)
+            buildExpr(es->expr);
+        return NO_VALUE;
+    }
+    ValueId visitIf(const IfStmt* ifs)
+    {
+        int thenBlock = newBlock();
+        int endBlock = newBlock();
+        int elseBlock = ifs->elseStmt ? newBlock() : endBlock;
+        condBranch(ifs->cond, thenBlock, elseBlock);
+        sealBlock(thenBlock);
+        current = thenBlock;
+        buildStmt(ifs->thenStmt);
+        jump(endBlock);
+        if (ifs->elseStmt)
+        {
+            sealBlock(elseBlock);
+            current = elseBlock;
+            buildStmt(ifs->elseStmt);
+            jump(endBlock);
+        }
+        sealBlock(endBlock);
+        current = endBlock;
+        return NO_VALUE;
+    }
+    ValueId visitWhile(const WhileStmt* ws)
+    {
+        int header = newBlock(), body = newBlock(), exit = newBlock();
+        jump(header);
+        current = header;
+        condBranch(ws->cond, body, exit);
+        sealBlock(body);
+        current = body;
+        buildStmt(ws->body);
+        jump(header);
+        // the back edge is in: the header's phis can be completed
+        sealBlock(header);
+        sealBlock(exit);
+        current = exit;
+        return NO_VALUE;
+    }
+    ValueId visitFor(const ForStmt* fs)
+    {
+        // a variable declared in the init clause lives until the end of the loop
+        scopes.pushScope();
+        buildStmt(fs->init);
+        int header = newBlock(), body = newBlock(), exit = newBlock();
+        jump(header);
+        current = header;
+        const ExprStmt* cond = nodeCast<ExprStmt>(fs->condStmt);
+        if (cond && cond->expr)
+            condBranch(cond->expr, body, exit);
+        else
+            jump(body);
+        sealBlock(body);
+        current = body;
+        buildStmt(fs->body);
+        if (fs->iterExpr)
+            buildExpr(fs->iterExpr);
+        jump(header);
+        sealBlock(header);
+        sealBlock(exit);
+        current = exit;
+        scopes.popScope();
+        return NO_VALUE;
+    }
+
+    // ---- expressions ----
+
+    ValueId buildExpr(const Expr* e)
+    {
+        return visit(e);
+    }
+
+    int globalOf(SymbolId name)
+    {
+        auto it = globalIndex.find(name);
+        if (it == globalIndex.end() || it->second >= visibleGlobals)
+            error("undeclared variable", name);
+        return it->second;
+    }
+
+    ValueId visitIdentifier(const IdentifierExpr* id)
+    {
+        if (const Symbol* local = scopes.lookup(id->name))
+            return readVariable(local->slot, current);
+        int g = globalOf(id->name);
+        return emit(S_GET_GLOBAL, module.globalTypes[g], {}, g);
+    }
+    ValueId visitIntLiteral(const IntLiteral* lit)
+    {
+        if (!lit->inRange)
+            error("integer literal out of range: " + lit->val);
+        return constant(Value::Int(lit->value));
+    }
+    ValueId visitFloatLiteral(const FloatLiteral* lit)
+    {
+        return constant(Value::Float(lit->value));
+    }
+    ValueId visitBoolLiteral(const BoolLiteral* lit)
+    {
+        return constant(Value::Bool(lit->value));
+    }
+    ValueId visitCharLiteral(const CharLiteral* lit)
+    {
+        return constant(Value::Int(lit->value));
+    }
+    ValueId visitStringLiteral(const StringLiteral* lit)
+    {
+        return constant(Value::String(&lit->text));
+    }
+
+    SymbolId variableOperand(const Expr* e)
+    {
+        auto id = nodeCast<IdentifierExpr>(e);
+        if (!id)
+            error("++ and -- need a variable");
+        return id->name;
+    }
+
+    // stores v (already of the variable's type) into the named variable
+    void assign(SymbolId name, ValueId v)
+    {
+        if (const Symbol* local = scopes.lookup(name))
+            writeVariable(local->slot, current, v);
+        else
+            emit(S_SET_GLOBAL, V_VOID, { v }, globalOf(name));
+    }
+
+    ValueType typeOfVariable(SymbolId name)
+    {
+        if (const Symbol* local = scopes.lookup(name))
+            return varTypes[local->slot];
+        return module.globalTypes[globalOf(name)];
+    }
+
+    // ++x / --x, or x++ / x-- when postfix (the old value is the result)
+    ValueId increment(const Expr* operand, int delta, bool postfix)
+    {
+        SymbolId name = variableOperand(operand);
+        ValueType type = typeOfVariable(name);
+        if (!isNumeric(type))
+            error(string("cannot increment a ") + ValueTypeName(type), name);
+        ValueId old = visit(operand);
+        ValueType sumType = commonType(type, V_INT);
+        ValueId step = constant(sumType == V_FLOAT ? Value::Float(delta) : Value::Int(delta));
+        ValueId updated = convert(emit(S_ADD, sumType, { convert(old, sumType), step }), type);
+        assign(name, updated);
+        return postfix ? old : updated;
+    }
+
+    ValueId visitUnary(const UnaryExpr* unary)
+    {
+        switch (unary->op)
+        {
+        case T_PLUS:
+            return buildExpr(unary->rhs);
+        case T_MINUS:
+        {
+            ValueId v = buildExpr(unary->rhs);
+            if (!isNumeric(typeOf(v)))
+                error(string("cannot negate a ") + ValueTypeName(typeOf(v)));
+            ValueType t = commonType(typeOf(v), V_INT);
+            return emit(S_NEG, t, { convert(v, t) });
+        }
+        case T_NOT:
+            return emit(S_NOT, V_BOOL, { converted(unary->rhs, V_BOOL) });
+        case T_INC:
+        case T_DEC:
+            return increment(unary->rhs, unary->op == T_INC ? 1 : -1, false);
+        default:
+            error(string("unsupported unary operator ") + TokenKindName(unary->op));
+        }
+    }
+    ValueId visitPostfix(const PostfixExpr* post)
+    {
+        return increment(post->base, post->op == T_INC ? 1 : -1, true);
+    }
+
+    ValueId visitBinary(const BinaryExpr* binary)
+    {
+        switch (binary->op)
+        {
+        case T_ASSIGN:
+        {
+            SymbolId name = variableOperand(binary->left);
+            ValueId v = converted(binary->right, typeOfVariable(name));
+            assign(name, v);
+            return v;
+        }
+        case T_AND:
+        case T_OR:
+        {
+            // a bool variable of its own, set on each path; the join gets the phi
+            int var = (int)varTypes.size();
+            varTypes.push_back(V_BOOL);
+            int ifTrue = newBlock(), ifFalse = newBlock(), end = newBlock();
+            condBranch(binary, ifTrue, ifFalse);
+            for (int b : { ifTrue, ifFalse })
+            {
+                sealBlock(b);
+                current = b;
+                writeVariable(var, b, constant(Value::Bool(b == ifTrue)));
+                jump(end);
+            }
+            sealBlock(end);
+            current = end;
+            return readVariable(var, end);
+        }
+        default:
+            break;
+        }
+
+        SsaOp op;
+        bool comparison = false;
+        switch (binary->op)
+        {
+        case T_PLUS: op = S_ADD; break;
+        case T_MINUS: op = S_SUB; break;
+        case T_MULT: op = S_MUL; break;
+        case T_DIV: op = S_DIV; break;
+        case T_MOD: op = S_MOD; break;
+        case T_EQ: op = S_EQ; comparison = true; break;
+        case T_NEQ: op = S_NE; comparison = true; break;
+        case T_LT: op = S_LT; comparison = true; break;
+        case T_GT: op = S_GT; comparison = true; break;
+        case T_LEQ: op = S_LE; comparison = true; break;
+        case T_GEQ: op = S_GE; comparison = true; break;
+        default:
+            error(string("unsupported binary operator ") + TokenKindName(binary->op));
+        }
+        ValueId l = buildExpr(binary->left);
+        ValueId r = buildExpr(binary->right);
+        ValueType lt = typeOf(l), rt = typeOf(r);
+        if (lt == V_STRING && rt == V_STRING && (comparison || op == S_ADD))
+            return emit(op, comparison ? V_BOOL : V_STRING, { l, r });
+        if (!isNumeric(lt) || !isNumeric(rt))
+            error(string("invalid operands to ") + TokenKindName(binary->op) + ": " + ValueTypeName(lt) + " and " + ValueTypeName(rt));
+        ValueType t = commonType(lt, rt);
+        return emit(op, comparison ? V_BOOL : t, { convert(l, t), convert(r, t) });
+    }
+
+    ValueId visitCall(const CallExpr* call)
+    {
+        auto calleeId = nodeCast<IdentifierExpr>(call->callee);
+        if (!calleeId)
+            error("only named functions can be called");
+        auto global = globalIndex.find(calleeId->name);
+        if (scopes.lookup(calleeId->name) || (global != globalIndex.end() && global->second < visibleGlobals))
+            error("called object is not a function", calleeId->name);
+        auto it = functionIndex.find(calleeId->name);
+        if (it == functionIndex.end())
+            error("undefined function", calleeId->name);
+        const SsaFunction& callee = module.functions[it->second];
+        if (call->args.size() != callee.paramTypes.size())
+            error("wrong number of arguments to", calleeId->name);
+        vector<ValueId> args;
+        for (size_t i = 0; i < call->args.size(); i++)
+            args.push_back(converted(call->args[i], callee.paramTypes[i]));
+        return emit(S_CALL, callee.retType, move(args), it->second);
+    }
+};
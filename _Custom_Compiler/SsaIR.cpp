@@ -0,0 +1,241 @@
+#include "SsaIR.h"
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+
+string SsaOpName(SsaOp op)
+{
+    static const char* const names[] = {
+#define SSA_OP_NAME(op) #op,
+        SSA_OPS(SSA_OP_NAME)
+#undef SSA_OP_NAME
+    };
+    if (op >= S_OP_COUNT)
+        return "?";
+    // lower case without the S_, as in the dump
+    string s = names[op] + 2;
+    transform(s.begin(), s.end(), s.begin(), [](char c) { return (char)tolower(c); });
+    return s;
+}
+
+void SsaFunction::ComputeDominators()
+{
+    // blocks are numbered in reverse postorder, so a block's dominators all
+    // have smaller numbers and intersect walks towards 0
+    vector<int> idom(blocks.size(), -1);
+    if (blocks.empty())
+        return;
+    idom[0] = 0;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (size_t b = 1; b < blocks.size(); b++)
+        {
+            int newIdom = -1;
+            for (int p : blocks[b].preds)
+            {
+                if (idom[p] < 0)
+                    continue;
+                if (newIdom < 0)
+                {
+                    newIdom = p;
+                    continue;
+                }
+                int x = p, y = newIdom;
+                while (x != y)
+                {
+                    while (x > y)
+                        x = idom[x];
+                    while (y > x)
+                        y = idom[y];
+                }
+                newIdom = x;
+            }
+            if (newIdom != idom[b])
+            {
+                idom[b] = newIdom;
+                changed = true;
+            }
+        }
+    }
+    for (SsaBlock& block : blocks)
+        block.dominated.clear();
+    blocks[0].idom = -1;
+    for (size_t b = 1; b < blocks.size(); b++)
+    {
+        blocks[b].idom = idom[b];
+        if (idom[b] >= 0)
+            blocks[idom[b]].dominated.push_back((int)b);
+    }
+}
+
+bool SsaFunction::Dominates(int a, int b) const
+{
+    while (b > a)
+        b = blocks[b].idom;
+    return a == b;
+}
+
+void SsaFunction::Verify() const
+{
+    auto fail = [&](const string& message) {
+        throw runtime_error("[SsaError] " + string(SymbolName(name)) + ": " + message);
+    };
+
+    vector<int> position(insts.size(), -1);
+    for (size_t b = 0; b < blocks.size(); b++)
+        for (size_t i = 0; i < blocks[b].insts.size(); i++)
+        {
+            ValueId v = blocks[b].insts[i];
+            if (v < 0 || v >= (ValueId)insts.size() || position[v] >= 0 || insts[v].block != (int)b)
+                fail("instruction %" + to_string(v) + " misplaced in b" + to_string(b));
+            position[v] = (int)i;
+        }
+
+    for (size_t b = 0; b < blocks.size(); b++)
+    {
+        const SsaBlock& block = blocks[b];
+        if (block.insts.empty() || !IsTerminator(insts[block.insts.back()].op))
+            fail("b" + to_string(b) + " has no terminator");
+        if (b > 0 && block.preds.empty())
+            fail("b" + to_string(b) + " is unreachable");
+        for (int s : block.succs)
+            if (count(blocks[s].preds.begin(), blocks[s].preds.end(), (int)b) != count(block.succs.begin(), block.succs.end(), s))
+                fail("edge b" + to_string(b) + " -> b" + to_string(s) + " is not in both lists");
+
+        bool phis = true;
+        for (size_t i = 0; i < block.insts.size(); i++)
+        {
+            ValueId v = block.insts[i];
+            const SsaInst& in = insts[v];
+            string at = "%" + to_string(v) + " in b" + to_string(b);
+            if (in.op == S_PHI)
+            {
+                if (!phis)
+                    fail("phi " + at + " after other instructions");
+                if (in.args.size() != block.preds.size())
+                    fail("phi " + at + " does not have one operand per predecessor");
+            }
+            else
+                phis = false;
+            if (IsTerminator(in.op) != (i + 1 == block.insts.size()))
+                fail("terminator " + at + " not at the end of its block");
+            size_t succs = in.op == S_JUMP ? 1 : in.op == S_BRANCH ? 2 : 0;
+            if (IsTerminator(in.op) && block.succs.size() != succs)
+                fail(at + " has the wrong number of successors");
+
+            for (size_t k = 0; k < in.args.size(); k++)
+            {
+                ValueId arg = in.args[k];
+                if (arg < 0 || arg >= (ValueId)insts.size() || position[arg] < 0)
+                    fail(at + " uses an undefined value");
+                if (insts[arg].type == V_VOID)
+                    fail(at + " uses %" + to_string(arg) + ", which has no value");
+                int def = insts[arg].block;
+                // a phi operand is used at the end of its predecessor
+                bool ok = in.op == S_PHI ? Dominates(def, block.preds[k])
+                    : def == (int)b ? position[arg] < (int)i : Dominates(def, (int)b);
+                if (!ok)
+                    fail(at + " uses %" + to_string(arg) + ", whose definition does not dominate it");
+            }
+        }
+    }
+}
+
+static void DumpConstant(ostringstream& o, const Value& v)
+{
+    if (v.type != V_STRING)
+    {
+        o << ValueToString(v);
+        return;
+    }
+    o << '"';
+    for (char c : *v.s)
+    {
+        switch (c)
+        {
+        case '\n': o << "\\n"; break;
+        case '\t': o << "\\t"; break;
+        case '\r': o << "\\r"; break;
+        case '\0': o << "\\0"; break;
+        case '"': o << "\\\""; break;
+        case '\\': o << "\\\\"; break;
+        default: o << c; break;
+        }
+    }
+    o << '"';
+}
+
+string SsaModule::Dump() const
+{
+    ostringstream o;
+    for (size_t f = 0; f < functions.size(); f++)
+    {
+        const SsaFunction& fn = functions[f];
+        o << "function " << SymbolName(fn.name) << "(";
+        for (size_t p = 0; p < fn.paramTypes.size(); p++)
+            o << (p ? ", " : "") << ValueTypeName(fn.paramTypes[p]);
+        o << ") -> " << ValueTypeName(fn.retType) << "\n";
+
+        for (size_t b = 0; b < fn.blocks.size(); b++)
+        {
+            const SsaBlock& block = fn.blocks[b];
+            o << "b" << b << ":";
+            if (!block.preds.empty())
+            {
+                o << "\t; preds";
+                for (int p : block.preds)
+                    o << " b" << p;
+                o << ", idom b" << block.idom;
+            }
+            o << "\n";
+            for (ValueId v : block.insts)
+            {
+                const SsaInst& in = fn.insts[v];
+                o << "    ";
+                if (in.type != V_VOID)
+                    o << "%" << v << " = ";
+                o << SsaOpName(in.op);
+                if (in.type != V_VOID)
+                    o << " " << ValueTypeName(in.type);
+                switch (in.op)
+                {
+                case S_CONST:
+                    o << " ";
+                    DumpConstant(o, in.constant);
+                    break;
+                case S_PARAM:
+                    o << " " << in.index;
+                    break;
+                case S_PHI:
+                    for (size_t k = 0; k < in.args.size(); k++)
+                        o << (k ? ", [%" : " [%") << in.args[k] << ", b" << block.preds[k] << "]";
+                    break;
+                case S_GET_GLOBAL:
+                case S_SET_GLOBAL:
+                    o << " @" << SymbolName(globalNames[in.index]);
+                    for (ValueId a : in.args)
+                        o << ", %" << a;
+                    break;
+                case S_CALL:
+                    o << " " << SymbolName(functions[in.index].name) << "(";
+                    for (size_t k = 0; k < in.args.size(); k++)
+                        o << (k ? ", %" : "%") << in.args[k];
+                    o << ")";
+                    break;
+                default:
+                    for (size_t k = 0; k < in.args.size(); k++)
+                        o << (k ? ", %" : " %") << in.args[k];
+                    break;
+                }
+                if (in.op == S_JUMP || in.op == S_BRANCH)
+                    for (size_t s = 0; s < block.succs.size(); s++)
+                        o << (s || in.op == S_BRANCH ? ", b" : " b") << block.succs[s];
+                o << "\n";
+            }
+        }
+        o << "\n";
+    }
+    return o.str();
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include "Bytecode.h"
+using namespace std;
+
+// SSA intermediate representation, built from the AST by SsaBuilder.
+//
+// A function is two dense arrays: its instructions, where an instruction's
+// index is the id of the value it defines, and its basic blocks, which list
+// their instructions in order. Every value has a ValueType and is defined
+// exactly once. Operands are other values' ids. Conversions are explicit
+// (S_CONVERT), so the operands of arithmetic and comparisons already have the
+// operation's type.
+// Phis come first in their block, with one operand per predecessor in the
+// order of SsaBlock::preds. The last instruction of a block is its terminator,
+// and its targets are the block's succs.
+#define SSA_OPS(X) \
+    X(S_CONST)          /* constant */ \
+    X(S_PARAM)          /* parameter index */ \
+    X(S_UNDEF)          /* a variable read where it has no definition (dead code only) */ \
+    X(S_PHI)            /* args[i] when control came from preds[i] */ \
+    X(S_GET_GLOBAL)     /* globals[index] */ \
+    X(S_SET_GLOBAL)     /* globals[index] = args[0] */ \
+    X(S_ADD)            /* args[0] + args[1] */ \
+    X(S_SUB) \
+    X(S_MUL) \
+    X(S_DIV) \
+    X(S_MOD) \
+    X(S_EQ)             /* args[0] == args[1], a bool */ \
+    X(S_NE) \
+    X(S_LT) \
+    X(S_GT) \
+    X(S_LE) \
+    X(S_GE) \
+    X(S_NEG)            /* -args[0] */ \
+    X(S_NOT)            /* !args[0], a bool */ \
+    X(S_CONVERT)        /* args[0] converted to type */ \
+    X(S_CALL)           /* functions[index](args ..) */ \
+    X(S_JUMP)           /* goto succs[0] */ \
+    X(S_BRANCH)         /* goto args[0] ? succs[0] : succs[1] */ \
+    X(S_RETURN)         /* return args[0], or nothing when args is empty */
+
+enum SsaOp : uint8_t
+{
+#define SSA_OP_ENUM(op) op,
+    SSA_OPS(SSA_OP_ENUM)
+#undef SSA_OP_ENUM
+    S_OP_COUNT
+};
+
+string SsaOpName(SsaOp op);     // as in the dump: lower case, without S_
+
+inline bool IsTerminator(SsaOp op)
+{
+    return op == S_JUMP || op == S_BRANCH || op == S_RETURN;
+}
+
+typedef int32_t ValueId;
+const ValueId NO_VALUE = -1;
+
+struct SsaInst
+{
+    SsaOp op;
+    ValueType type = V_VOID;    // of the value defined, V_VOID if none
+    int32_t block = -1;
+    int32_t index = 0;          // parameter, global or function index
+    Value constant;             // S_CONST
+    vector<ValueId> args;
+};
+
+struct SsaBlock
+{
+    vector<ValueId> insts;
+    vector<int> preds, succs;
+    int idom = -1;              // immediate dominator, -1 for the entry
+    vector<int> dominated;      // children in the dominator tree
+};
+
+struct SsaFunction
+{
+    SymbolId name = NO_SYMBOL;
+    ValueType retType = V_VOID;
+    vector<ValueType> paramTypes;
+    vector<SsaInst> insts;
+    vector<SsaBlock> blocks;    // in reverse postorder, blocks[0] is the entry
+
+    // Fills in idom and dominated (Cooper, Harvey and Kennedy, "A Simple, Fast
+    // Dominance Algorithm"); blocks must be in reverse postorder.
+    void ComputeDominators();
+    bool Dominates(int a, int b) const;
+
+    // Checks that the function is well formed: terminators, phi arity and
+    // every use dominated by its definition. Throws runtime_error if not.
+    void Verify() const;
+};
+
+struct SsaModule
+{
+    vector<SsaFunction> functions;
+    deque<string> strings;          // text of the string constants
+    vector<ValueType> globalTypes;
+    vector<SymbolId> globalNames;
+    int globalInit = -1;            // function that initializes the globals, in source order
+
+    // Textual form of every function, for debugging and tests.
+    string Dump() const;
+};
@@ -0,0 +1,204 @@
+#include "StackVM.h"
+#include <stdexcept>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_COMPUTED_GOTO 1
+#endif
+
+StackVM::StackVM(const BytecodeModule& module)
+    : module(module), stack(STACK_SIZE), initialized(false)
+{
+    for (ValueType t : module.globalTypes)
+        globals.push_back(DefaultValue(t));
+}
+
+Value StackVM::Call(string_view name, const vector<Value>& args)
+{
+    if (!initialized)
+    {
+        initialized = true;
+        Execute(module.globalInit, stack.data());
+    }
+    SymbolId id = StringInterner::Global().Find(name);
+    int f = id == NO_SYMBOL ? -1 : module.FindFunction(id);
+    if (f < 0)
+        RuntimeError("no function named " + string(name));
+    if ((int)args.size() != module.functions[f].arity)
+        RuntimeError("wrong number of arguments to " + string(name));
+    for (size_t i = 0; i < args.size(); i++)
+        stack[i] = args[i];
+    return Execute(f, stack.data());
+}
+
+Value StackVM::Execute(int function, Value* args)
+{
+    const Value* constants = module.constants.data();
+    Value* stackEnd = stack.data() + stack.size();
+    const FunctionCode* fn = &module.functions[function];
+    Value* base = args;
+    Value* sp = args + fn->arity;
+    const uint32_t* code = fn->code.data();
+    const uint32_t* ip = code;
+
+    frames.clear();
+    if (base + fn->slotCount + fn->maxStack > stackEnd)
+        RuntimeError("stack overflow");
+    frames.push_back({ fn, nullptr, base });
+    for (; sp < base + fn->slotCount; sp++)
+        *sp = Value();
+
+#define BOTH_INT (sp[-1].type == V_INT && sp[0].type == V_INT)
+
+#ifdef VM_COMPUTED_GOTO
+    static void* const dispatch[] = {
+#define OP_CODE_LABEL(op) &&L_##op,
+        OP_CODES(OP_CODE_LABEL)
+#undef OP_CODE_LABEL
+    };
+#define VM_CASE(op) L_##op:
+#define VM_NEXT goto *dispatch[*ip++]
+    VM_NEXT;
+#else
+#define VM_CASE(op) case op:
+#define VM_NEXT break
+    for (;;)
+    switch ((OpCode)*ip++)
+    {
+#endif
+
+    VM_CASE(OP_CONST)
+        *sp++ = constants[*ip++];
+        VM_NEXT;
+    VM_CASE(OP_LOAD_LOCAL)
+        *sp++ = base[*ip++];
+        VM_NEXT;
+    VM_CASE(OP_STORE_LOCAL)
+        base[*ip++] = *--sp;
+        VM_NEXT;
+    VM_CASE(OP_LOAD_GLOBAL)
+        *sp++ = globals[*ip++];
+        VM_NEXT;
+    VM_CASE(OP_STORE_GLOBAL)
+        globals[*ip++] = *--sp;
+        VM_NEXT;
+    VM_CASE(OP_POP)
+        sp--;
+        VM_NEXT;
+    VM_CASE(OP_DUP)
+        sp[0] = sp[-1];
+        sp++;
+        VM_NEXT;
+
+#define VM_ARITH(op, intOp) \
+    VM_CASE(op) \
+        sp--; \
+        if (BOTH_INT) \
+            sp[-1].i = (int64_t)((uint64_t)sp[-1].i intOp (uint64_t)sp[0].i); \
+        else \
+            sp[-1] = Arith(op, sp[-1], sp[0], strings); \
+        VM_NEXT;
+    VM_ARITH(OP_ADD, +)
+    VM_ARITH(OP_SUB, -)
+    VM_ARITH(OP_MUL, *)
+#undef VM_ARITH
+    VM_CASE(OP_DIV)
+        sp--;
+        sp[-1] = Arith(OP_DIV, sp[-1], sp[0], strings);
+        VM_NEXT;
+    VM_CASE(OP_MOD)
+        sp--;
+        sp[-1] = Arith(OP_MOD, sp[-1], sp[0], strings);
+        VM_NEXT;
+    VM_CASE(OP_NEG)
+        if (sp[-1].type == V_FLOAT)
+            sp[-1].f = -sp[-1].f;
+        else if (IsNumber(sp[-1]))
+            sp[-1] = Value::Int((int64_t)(0 - (uint64_t)AsInt(sp[-1])));
+        else
+            RuntimeError(string("cannot negate a ") + ValueTypeName(sp[-1].type));
+        VM_NEXT;
+    VM_CASE(OP_NOT)
+        sp[-1] = Value::Bool(!Truthy(sp[-1]));
+        VM_NEXT;
+
+#define VM_COMPARE(op, intOp) \
+    VM_CASE(op) \
+        sp--; \
+        sp[-1] = BOTH_INT ? Value::Bool(sp[-1].i intOp sp[0].i) : Compare(op, sp[-1], sp[0]); \
+        VM_NEXT;
+    VM_COMPARE(OP_EQ, ==)
+    VM_COMPARE(OP_NE, !=)
+    VM_COMPARE(OP_LT, <)
+    VM_COMPARE(OP_GT, >)
+    VM_COMPARE(OP_LE, <=)
+    VM_COMPARE(OP_GE, >=)
+#undef VM_COMPARE
+
+    VM_CASE(OP_TO_INT)
+        if (sp[-1].type != V_INT)
+            sp[-1] = Convert(V_INT, sp[-1]);
+        VM_NEXT;
+    VM_CASE(OP_TO_FLOAT)
+        if (sp[-1].type != V_FLOAT)
+            sp[-1] = Convert(V_FLOAT, sp[-1]);
+        VM_NEXT;
+    VM_CASE(OP_TO_BOOL)
+        if (sp[-1].type != V_BOOL)
+            sp[-1] = Convert(V_BOOL, sp[-1]);
+        VM_NEXT;
+    VM_CASE(OP_TO_STRING)
+        if (sp[-1].type != V_STRING)
+            sp[-1] = Convert(V_STRING, sp[-1]);
+        VM_NEXT;
+
+    VM_CASE(OP_JUMP)
+        ip = code + *ip;
+        VM_NEXT;
+    VM_CASE(OP_JUMP_IF_FALSE)
+        sp--;
+        if (sp->type == V_BOOL ? sp->b : Truthy(*sp))
+            ip++;
+        else
+            ip = code + *ip;
+        VM_NEXT;
+
+    VM_CASE(OP_CALL)
+    {
+        const FunctionCode* callee = &module.functions[*ip++];
+        Value* calleeBase = sp - callee->arity;
+        if (frames.size() >= MAX_FRAMES || calleeBase + callee->slotCount + callee->maxStack > stackEnd)
+            RuntimeError("stack overflow");
+        frames.back().ip = ip;
+        frames.push_back({ callee, nullptr, calleeBase });
+        for (; sp < calleeBase + callee->slotCount; sp++)
+            *sp = Value();
+        fn = callee;
+        base = calleeBase;
+        code = ip = fn->code.data();
+        VM_NEXT;
+    }
+    VM_CASE(OP_RETURN)
+    {
+        Value result = sp[-1];
+        sp = base;
+        frames.pop_back();
+        if (frames.empty())
+            return result;
+        *sp++ = result;
+        const Frame& caller = frames.back();
+        fn = caller.fn;
+        base = caller.base;
+        code = fn->code.data();
+        ip = caller.ip;
+        VM_NEXT;
+    }
+
+#ifndef VM_COMPUTED_GOTO
+    default:
+        RuntimeError("bad opcode");
+    }
+#endif
+#undef VM_CASE
+#undef VM_NEXT
+#undef BOTH_INT
+}
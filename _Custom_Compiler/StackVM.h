@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include "Bytecode.h"
+using namespace std;
+
+// Runs a BytecodeModule. All frames share one value stack: a call's arguments
+// become the first slots of the callee's frame, its locals follow, and its
+// operand stack grows above them.
+//
+// The dispatch loop uses computed goto where the compiler supports it (GCC and
+// Clang), so every instruction ends in its own indirect jump, and a switch
+// everywhere else. Runtime errors (division by zero, a value of the wrong type,
+// stack overflow) throw runtime_error.
+class StackVM
+{
+    static const size_t STACK_SIZE = 1 << 20;     // values
+    static const size_t MAX_FRAMES = 1 << 16;
+
+    struct Frame
+    {
+        const FunctionCode* fn;
+        const uint32_t* ip;     // where to continue in the caller
+        Value* base;            // first slot
+    };
+
+    const BytecodeModule& module;
+    vector<Value> globals;
+    vector<Value> stack;
+    vector<Frame> frames;
+    deque<string> strings;      // strings built at run time, kept until the VM goes away
+    bool initialized;
+
+    Value Execute(int function, Value* args);
+
+public:
+    explicit StackVM(const BytecodeModule& module);
+
+    // Calls the named function (after running the global initializers once).
+    Value Call(string_view name, const vector<Value>& args = {});
+};
@@ -0,0 +1,66 @@
+#include "StringInterner.h"
+#include <cstring>
+#include <mutex>
+using namespace std;
+
+static const size_t INTERN_BLOCK_SIZE = 64 * 1024;
+
+string_view StringInterner::store(string_view s)
+{
+    if (s.size() > left)
+    {
+        size_t size = s.size() > INTERN_BLOCK_SIZE ? s.size() : INTERN_BLOCK_SIZE;
+        blocks.emplace_back(new char[size]);
+        cursor = blocks.back().get();
+        left = size;
+    }
+    memcpy(cursor, s.data(), s.size());
+    string_view stored(cursor, s.size());
+    cursor += s.size();
+    left -= s.size();
+    return stored;
+}
+
+SymbolId StringInterner::Intern(string_view s)
+{
+    {
+        shared_lock<shared_mutex> reading(lock);
+        auto it = ids.find(s);
+        if (it != ids.end())
+            return it->second;
+    }
+    unique_lock<shared_mutex> writing(lock);
+    auto it = ids.find(s);      // another thread may have added it meanwhile
+    if (it != ids.end())
+        return it->second;
+    string_view stored = store(s);
+    SymbolId id = (SymbolId)names.size();
+    names.push_back(stored);
+    ids.emplace(stored, id);
+    return id;
+}
+
+SymbolId StringInterner::Find(string_view s) const
+{
+    shared_lock<shared_mutex> reading(lock);
+    auto it = ids.find(s);
+    return it == ids.end() ? NO_SYMBOL : it->second;
+}
+
+string_view StringInterner::Name(SymbolId id) const
+{
+    shared_lock<shared_mutex> reading(lock);
+    return id < names.size() ? names[id] : string_view();
+}
+
+size_t StringInterner::Size() const
+{
+    shared_lock<shared_mutex> reading(lock);
+    return names.size();
+}
+
+StringInterner& StringInterner::Global()
+{
+    static StringInterner interner;
+    return interner;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <shared_mutex>
+using namespace std;
+
+// Index of an interned name. Two names are equal exactly when their ids are.
+using SymbolId = uint32_t;
+const SymbolId NO_SYMBOL = 0xFFFFFFFFu;
+
+// Maps every distinct name to a small integer id, once per process.
+// The lexer interns identifiers as it produces them, so the AST, the scope
+// tables and later passes compare and hash plain integers. Interning and
+// lookups may run on several threads at once. Name() views stay valid for the
+// life of the process.
+class StringInterner
+{
+    mutable shared_mutex lock;
+    unordered_map<string_view, SymbolId> ids;   // keys point into blocks
+    vector<string_view> names;
+    vector<unique_ptr<char[]>> blocks;
+    char* cursor = nullptr;
+    size_t left = 0;
+
+    string_view store(string_view s);
+
+public:
+    StringInterner() = default;
+    StringInterner(const StringInterner&) = delete;
+    StringInterner& operator=(const StringInterner&) = delete;
+
+    SymbolId Intern(string_view s);
+    // NO_SYMBOL if s was never interned
+    SymbolId Find(string_view s) const;
+    string_view Name(SymbolId id) const;
+    size_t Size() const;
+
+    static StringInterner& Global();
+};
+
+// Shorthands for the process-wide interner.
+inline SymbolId Intern(string_view s) { return StringInterner::Global().Intern(s); }
+inline string_view SymbolName(SymbolId id) { return StringInterner::Global().Name(id); }
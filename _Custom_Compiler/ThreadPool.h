@@ -0,0 +1,189 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <cstdint>
+using namespace std;
+
+// Fixed set of worker threads for data-parallel passes.
+// ParallelFor(n, fn) calls fn(0) .. fn(n - 1) spread over the workers and the
+// calling thread, and returns once every call has finished.
+//
+// Scheduling is work stealing over index ranges: every thread starts with an
+// equal slice of [0, n) and takes indices from the front of its own slice.
+// A thread whose slice runs dry steals the back half of another thread's
+// slice, so a few expensive indices do not leave the other threads idle.
+//
+// n must fit in 32 bits. fn must not throw (callers that can fail store an
+// exception_ptr per index) and must not start another ParallelFor on the same pool.
+class ThreadPool
+{
+    // [begin, end) packed in one word so the owner and thieves race on a single CAS
+    struct alignas(64) Slice
+    {
+        atomic<uint64_t> bounds{ 0 };
+    };
+
+    static uint64_t Pack(uint64_t begin, uint64_t end) { return end << 32 | begin; }
+    static uint64_t Begin(uint64_t b) { return b & 0xFFFFFFFFu; }
+    static uint64_t End(uint64_t b) { return b >> 32; }
+
+    vector<thread> workers;
+    mutex run_lock;             // one ParallelFor at a time
+    mutex lock;
+    condition_variable wake;
+    condition_variable done;
+
+    const function<void(size_t)>* job = nullptr;
+    unique_ptr<Slice[]> slices;
+    size_t busy = 0;            // workers still inside the current job
+    unsigned generation = 0;    // bumped for every job so workers see each one once
+    bool stopping = false;
+
+    // take the first index of a slice
+    static bool PopFront(Slice& s, size_t& index)
+    {
+        uint64_t b = s.bounds.load();
+        while (Begin(b) < End(b))
+        {
+            if (s.bounds.compare_exchange_weak(b, Pack(Begin(b) + 1, End(b))))
+            {
+                index = (size_t)Begin(b);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // take the back half of a slice (all of it if only one index is left)
+    static bool StealHalf(Slice& s, uint64_t& stolen)
+    {
+        uint64_t b = s.bounds.load();
+        while (Begin(b) < End(b))
+        {
+            uint64_t mid = Begin(b) + (End(b) - Begin(b)) / 2;
+            if (s.bounds.compare_exchange_weak(b, Pack(Begin(b), mid)))
+            {
+                stolen = Pack(mid, End(b));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Run(const function<void(size_t)>& fn, size_t self)
+    {
+        size_t count = Size();
+        Slice& own = slices[self];
+        while (true)
+        {
+            size_t index;
+            while (PopFront(own, index))
+                fn(index);
+
+            bool found = false;
+            for (size_t k = 1; k < count && !found; k++)
+            {
+                uint64_t stolen;
+                if (StealHalf(slices[(self + k) % count], stolen))
+                {
+                    // own slice is empty, so nobody else can be taking from it
+                    own.bounds.store(stolen);
+                    found = true;
+                }
+            }
+            if (!found)
+                return;
+        }
+    }
+
+    void WorkerLoop(size_t self)
+    {
+        unsigned seen = 0;
+        while (true)
+        {
+            const function<void(size_t)>* fn;
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+                fn = job;
+            }
+            Run(*fn, self);
+            {
+                lock_guard<mutex> guard(lock);
+                if (--busy == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+public:
+    // threads counts the calling thread, so ThreadPool(1) starts no workers.
+    explicit ThreadPool(size_t threads = 0)
+    {
+        if (threads == 0)
+            threads = thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+        slices.reset(new Slice[threads]);
+        for (size_t i = 1; i < threads; i++)
+            workers.emplace_back([this, i] { WorkerLoop(i); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread& t : workers)
+            t.join();
+    }
+
+    size_t Size() const { return workers.size() + 1; }
+
+    void ParallelFor(size_t n, const function<void(size_t)>& fn)
+    {
+        if (n == 0)
+            return;
+        if (workers.empty() || n == 1)
+        {
+            for (size_t i = 0; i < n; i++)
+                fn(i);
+            return;
+        }
+        lock_guard<mutex> running(run_lock);
+        {
+            lock_guard<mutex> guard(lock);
+            size_t count = Size();
+            for (size_t t = 0; t < count; t++)
+                slices[t].bounds.store(Pack(n * t / count, n * (t + 1) / count));
+            job = &fn;
+            busy = workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        Run(fn, 0);
+        unique_lock<mutex> guard(lock);
+        done.wait(guard, [&] { return busy == 0; });
+        job = nullptr;
+    }
+
+    // Process-wide pool sized to the machine, created on first use.
+    static ThreadPool& Shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+};
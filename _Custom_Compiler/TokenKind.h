@@ -0,0 +1,142 @@
+#pragma once
+
+// Every token type produced by either lexer. The two lexers spell some tokens
+// differently (T_NUMBER vs T_INTLIT, T_LPAREN vs T_PARENL, ...) and both spellings
+// are kept so printed output stays the same.
+#define TOKEN_KINDS(X) \
+    X(T_NONE, "") \
+    X(T_EOF, "eof") \
+    X(T_INVALID, "T_INVALID") \
+    X(T_LINE_COMMENT, "T_LINE_COMMENT") \
+    /* keywords */ \
+    X(T_COUT, "T_COUT") \
+    X(T_CIN, "T_CIN") \
+    X(T_INT, "T_INT") \
+    X(T_MAIN, "T_MAIN") \
+    X(T_FLOAT, "T_FLOAT") \
+    X(T_DOUBLE, "T_DOUBLE") \
+    X(T_STRING, "T_STRING") \
+    X(T_BOOL, "T_BOOL") \
+    X(T_RETURN, "T_RETURN") \
+    X(T_IF, "T_IF") \
+    X(T_ELSE, "T_ELSE") \
+    X(T_WHILE, "T_WHILE") \
+    X(T_FOR, "T_FOR") \
+    X(T_FUNCTION, "T_FUNCTION") \
+    X(T_TRUE, "T_TRUE") \
+    X(T_FALSE, "T_FALSE") \
+    X(T_VOID, "T_VOID") \
+    X(T_LET, "T_LET") \
+    X(T_CONST, "T_CONST") \
+    X(T_STRUCT, "T_STRUCT") \
+    X(T_BREAK, "T_BREAK") \
+    X(T_CONTINUE, "T_CONTINUE") \
+    X(T_NULL, "T_NULL") \
+    X(T_NEW, "T_NEW") \
+    X(T_CLASS, "T_CLASS") \
+    X(T_PUBLIC, "T_PUBLIC") \
+    X(T_PRIVATE, "T_PRIVATE") \
+    X(T_PROTECTED, "T_PROTECTED") \
+    X(T_STATIC, "T_STATIC") \
+    X(T_IMPORT, "T_IMPORT") \
+    X(T_THEN, "T_THEN") \
+    X(T_SWITCH, "T_SWITCH") \
+    X(T_CASE, "T_CASE") \
+    X(T_DEFAULT, "T_DEFAULT") \
+    X(T_ENUM, "T_ENUM") \
+    /* literals and names */ \
+    X(T_IDENTIFIER, "T_IDENTIFIER") \
+    X(T_NUMBER, "T_NUMBER") \
+    X(T_FLOAT_LIT, "T_FLOAT_LIT") \
+    X(T_STRING_LIT, "T_STRING_LIT") \
+    X(T_CHAR_LIT, "T_CHAR_LIT") \
+    X(T_INTLIT, "T_INTLIT") \
+    X(T_FLOATLIT, "T_FLOATLIT") \
+    X(T_STRINGLIT, "T_STRINGLIT") \
+    X(T_QUOTE, "T_QUOTE") \
+    /* comments */ \
+    X(T_COMSTART, "T_COMSTART") \
+    X(T_COMEND, "T_COMEND") \
+    /* operators, Lexer_regex spelling */ \
+    X(T_ASSIGN, "T_ASSIGN") \
+    X(T_PLUS, "T_PLUS") \
+    X(T_MINUS, "T_MINUS") \
+    X(T_MULT, "T_MULT") \
+    X(T_DIV, "T_DIV") \
+    X(T_MOD, "T_MOD") \
+    X(T_LT, "T_LT") \
+    X(T_GT, "T_GT") \
+    X(T_NOT, "T_NOT") \
+    X(T_EQ, "T_EQ") \
+    X(T_NEQ, "T_NEQ") \
+    X(T_LEQ, "T_LEQ") \
+    X(T_GEQ, "T_GEQ") \
+    X(T_INC, "T_INC") \
+    X(T_DEC, "T_DEC") \
+    X(T_AND, "T_AND") \
+    X(T_OR, "T_OR") \
+    X(T_RSHIFT, "T_RSHIFT") \
+    X(T_LSHIFT, "T_LSHIFT") \
+    X(T_LPAREN, "T_LPAREN") \
+    X(T_RPAREN, "T_RPAREN") \
+    X(T_LBRACE, "T_LBRACE") \
+    X(T_RBRACE, "T_RBRACE") \
+    X(T_LBRACKET, "T_LBRACKET") \
+    X(T_RBRACKET, "T_RBRACKET") \
+    X(T_COMMA, "T_COMMA") \
+    X(T_SEMICOLON, "T_SEMICOLON") \
+    X(T_DOT, "T_DOT") \
+    X(T_ARROW, "T_ARROW") \
+    /* operators, Without_regex_Lexer spelling */ \
+    X(T_INCREMENT, "T_INCREMENT") \
+    X(T_DECREMENT, "T_DECREMENT") \
+    X(T_PLUSEQ, "T_PLUSEQ") \
+    X(T_MINUSEQ, "T_MINUSEQ") \
+    X(T_MULTEQ, "T_MULTEQ") \
+    X(T_MULTIPLY, "T_MULTIPLY") \
+    X(T_DIVEQ, "T_DIVEQ") \
+    X(T_DIVIDE, "T_DIVIDE") \
+    X(T_EQUALSOP, "T_EQUALSOP") \
+    X(T_ASSIGNOP, "T_ASSIGNOP") \
+    X(T_NOTEQ, "T_NOTEQ") \
+    X(T_LTE, "T_LTE") \
+    X(T_GTE, "T_GTE") \
+    X(T_SHL, "T_SHL") \
+    X(T_SHLEQ, "T_SHLEQ") \
+    X(T_SHR, "T_SHR") \
+    X(T_SHREQ, "T_SHREQ") \
+    X(T_ANDEQ, "T_ANDEQ") \
+    X(T_AMPERSAND, "T_AMPERSAND") \
+    X(T_BITOR, "T_BITOR") \
+    X(T_PARENL, "T_PARENL") \
+    X(T_PARENR, "T_PARENR") \
+    X(T_BRACEL, "T_BRACEL") \
+    X(T_BRACER, "T_BRACER") \
+    X(T_BRACKETL, "T_BRACKETL") \
+    X(T_BRACKETR, "T_BRACKETR") \
+    X(T_COLON, "T_COLON") \
+    X(T_MODEQ, "T_MODEQ") \
+    X(T_MODULO, "T_MODULO") \
+    X(T_BITXOREQ, "T_BITXOREQ") \
+    X(T_BITXOR, "T_BITXOR") \
+    X(T_BITNOT, "T_BITNOT") \
+    X(T_QUESTION, "T_QUESTION") \
+    X(T_HASH, "T_HASH")
+
+enum TokenKind : unsigned char
+{
+#define TOKEN_KIND_ENUM(kind, name) kind,
+    TOKEN_KINDS(TOKEN_KIND_ENUM)
+#undef TOKEN_KIND_ENUM
+    T_KIND_COUNT
+};
+
+inline const char* TokenKindName(TokenKind kind)
+{
+    static const char* const names[] = {
+#define TOKEN_KIND_NAME(kind, name) name,
+        TOKEN_KINDS(TOKEN_KIND_NAME)
+#undef TOKEN_KIND_NAME
+    };
+    return kind < T_KIND_COUNT ? names[kind] : "?";
+}
@@ -0,0 +1,391 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+#include "Parser2.h"
+#include "ScopeStack.h"
+
+using namespace std;
+
+// Checks the types of a Program and sets Expr::type on every expression.
+//
+// Declared types come from VarDeclStmt::typeTok, Param::typeTok and
+// FuncDecl::retType. Literals have their own type; a float literal is a double,
+// as in C. The rules follow what the VMs accept at run time, so a program
+// that type checks fails at run time only through its values (division by zero,
+// a float out of range for int). The check is static, though: it also rejects a
+// type error on a path that never runs, which the VMs would have let pass.
+// - int, float, double, bool and char are numbers. Arithmetic on numbers gives
+//   double if either operand is a double, float if either is a float, and int
+//   otherwise; + also joins two strings.
+// - Numbers compare with numbers and strings with strings, giving bool.
+// - !, && and || and every condition take numbers; ! && and || give bool.
+// - A number stores into any numeric variable, parameter or return value, a
+//   string only into a string.
+// - A call names a function and passes one argument per parameter.
+// - A function that is not void may run off its end. It then returns the
+//   default value of its return type (0, false or ""), as in the VMs, and every
+//   backend emits that return.
+// Names follow the scope rules in ScopeStack.h: locals first, then the globals
+// declared so far. The callee of a call gets the return type of the function
+// it names.
+// The first error is thrown as a runtime_error("[TypeError] function: ...").
+class TypeChecker
+{
+    struct Signature
+    {
+        TypeKind ret;
+        vector<TypeKind> params;
+    };
+    unordered_map<SymbolId, Signature> functions;
+    unordered_map<SymbolId, TypeKind> globals;     // declared so far
+    ScopeStack scopes;                              // Symbol::type is the declared type token
+    SymbolId function = NO_SYMBOL;                  // being checked, NO_SYMBOL for global initializers
+    TypeKind retType = TY_VOID;
+
+public:
+    static void Check(Program* program)
+    {
+        TypeChecker c;
+        for (ASTPtr item : program->globalItems)
+        {
+            if (auto func = nodeCast<FuncDecl>(item))
+            {
+                Signature sig;
+                sig.ret = TypeOf(func->retType);
+                for (const Param& p : func->params)
+                    sig.params.push_back(TypeOf(p.typeTok));
+                if (!c.functions.emplace(func->name, sig).second)
+                    c.error("function redefined: " + string(SymbolName(func->name)));
+            }
+        }
+        for (ASTPtr item : program->globalItems)
+        {
+            if (auto func = nodeCast<FuncDecl>(item))
+                c.checkFunction(func);
+            else if (auto var = nodeCast<VarDeclStmt>(item))
+            {
+                c.function = NO_SYMBOL;
+                TypeKind type = c.declaredType(var->typeTok, var->name);
+                if (var->init)
+                    c.expectStore(type, c.check(var->init), "initializer of " + string(SymbolName(var->name)));
+                if (!c.globals.emplace(var->name, type).second)
+                    c.error("global variable redefined: " + string(SymbolName(var->name)));
+            }
+        }
+    }
+
+    static TypeKind TypeOf(TokenKind typeTok)
+    {
+        switch (typeTok)
+        {
+        case T_INT: return TY_INT;
+        case T_FLOAT: return TY_FLOAT;
+        case T_DOUBLE: return TY_DOUBLE;
+        case T_BOOL: return TY_BOOL;
+        case T_STRING: return TY_STRING;
+        default: return TY_VOID;
+        }
+    }
+
+    static const char* TypeName(TypeKind type)
+    {
+        switch (type)
+        {
+        case TY_INT: return "int";
+        case TY_FLOAT: return "float";
+        case TY_DOUBLE: return "double";
+        case TY_BOOL: return "bool";
+        case TY_STRING: return "string";
+        case TY_CHAR: return "char";
+        case TY_VOID: return "void";
+        default: return "?";
+        }
+    }
+
+    static bool IsNumber(TypeKind type)
+    {
+        return type == TY_INT || type == TY_FLOAT || type == TY_DOUBLE || type == TY_BOOL || type == TY_CHAR;
+    }
+
+private:
+    [[noreturn]] void error(const string& message)
+    {
+        string where = function == NO_SYMBOL ? "<globals>" : string(SymbolName(function));
+        throw runtime_error("[TypeError] " + where + ": " + message);
+    }
+
+    TypeKind declaredType(TokenKind typeTok, SymbolId name)
+    {
+        TypeKind type = TypeOf(typeTok);
+        if (type == TY_VOID)
+            error("variable declared void: " + string(SymbolName(name)));
+        return type;
+    }
+
+    static const char* opName(TokenKind op)
+    {
+        switch (op)
+        {
+        case T_PLUS: return "+";
+        case T_MINUS: return "-";
+        case T_MULT: return "*";
+        case T_DIV: return "/";
+        case T_MOD: return "%";
+        case T_EQ: return "==";
+        case T_NEQ: return "!=";
+        case T_LT: return "<";
+        case T_GT: return ">";
+        case T_LEQ: return "<=";
+        case T_GEQ: return ">=";
+        case T_AND: return "&&";
+        case T_OR: return "||";
+        case T_NOT: return "!";
+        case T_INC: return "++";
+        case T_DEC: return "--";
+        case T_ASSIGN: return "=";
+        default: return TokenKindName(op);
+        }
+    }
+
+    void expectStore(TypeKind to, TypeKind from, const string& what)
+    {
+        if (to == from || (IsNumber(to) && IsNumber(from)))
+            return;
+        error(string("cannot convert ") + TypeName(from) + " to " + TypeName(to) + " in " + what);
+    }
+
+    void expectCondition(TypeKind type)
+    {
+        if (!IsNumber(type))
+            error(string("a ") + TypeName(type) + " value cannot be used as a condition");
+    }
+
+    void checkFunction(const FuncDecl* func)
+    {
+        function = func->name;
+        retType = TypeOf(func->retType);
+        scopes = ScopeStack();
+        // parameters share the scope of the outermost block of the body
+        scopes.pushScope();
+        for (const Param& p : func->params)
+        {
+            if (TypeOf(p.typeTok) == TY_VOID)
+                error("parameter declared void: " + string(SymbolName(p.name)));
+            if (!scopes.declareSym(Symbol(p.name, p.typeTok, false)))
+                error("parameter redefined: " + string(SymbolName(p.name)));
+        }
+        if (func->body)
+            for (StmtPtr stmt : func->body->stmts)
+                checkStmt(stmt);
+        scopes.popScope();
+    }
+
+    // ---- statements ----
+
+    void checkStmt(StmtPtr stmt)
+    {
+        if (!stmt)
+            return;
+        switch (stmt->kind)
+        {
+        case NK_EXPR_STMT:
+        {
+            auto es = static_cast<ExprStmt*>(stmt);
+            if (es->expr)
+                check(es->expr);
+            break;
+        }
+        case NK_RETURN:
+        {
+            // a void function returns nothing, whatever its return statement computes
+            auto rs = static_cast<ReturnStmt*>(stmt);
+            TypeKind type = rs->expr ? check(rs->expr) : TY_VOID;
+            if (retType != TY_VOID)
+                expectStore(retType, type, "return value");
+            break;
+        }
+        case NK_VAR_DECL:
+        {
+            // the initializer does not see the variable it initializes
+            auto vd = static_cast<VarDeclStmt*>(stmt);
+            TypeKind type = declaredType(vd->typeTok, vd->name);
+            if (vd->init)
+                expectStore(type, check(vd->init), "initializer of " + string(SymbolName(vd->name)));
+            if (!scopes.declareSym(Symbol(vd->name, vd->typeTok, false)))
+                error("variable redefined: " + string(SymbolName(vd->name)));
+            break;
+        }
+        case NK_IF:
+        {
+            auto ifs = static_cast<IfStmt*>(stmt);
+            expectCondition(check(ifs->cond));
+            checkStmt(ifs->thenStmt);
+            checkStmt(ifs->elseStmt);
+            break;
+        }
+        case NK_WHILE:
+        {
+            auto ws = static_cast<WhileStmt*>(stmt);
+            expectCondition(check(ws->cond));
+            checkStmt(ws->body);
+            break;
+        }
+        case NK_FOR:
+        {
+            // a variable declared in the init clause lives until the end of the loop
+            auto fs = static_cast<ForStmt*>(stmt);
+            scopes.pushScope();
+            checkStmt(fs->init);
+            auto cond = nodeCast<ExprStmt>(fs->condStmt);
+            if (cond && cond->expr)
+                expectCondition(check(cond->expr));
+            else
+                checkStmt(fs->condStmt);
+            checkStmt(fs->body);
+            if (fs->iterExpr)
+                check(fs->iterExpr);
+            scopes.popScope();
+            break;
+        }
+        case NK_BLOCK:
+            scopes.pushScope();
+            for (StmtPtr s : static_cast<BlockStmt*>(stmt)->stmts)
+                checkStmt(s);
+            scopes.popScope();
+            break;
+        default:
+            error("unexpected statement");
+        }
+    }
+
+    // ---- expressions ----
+
+    // sets and returns the type of e
+    TypeKind check(ExprPtr e)
+    {
+        return e->type = typeOf(e);
+    }
+
+    // type of the variable e names; an error if e is not a variable
+    TypeKind variable(ExprPtr e, const char* what)
+    {
+        auto id = nodeCast<IdentifierExpr>(e);
+        if (!id)
+            error(string("operand of ") + what + " is not a variable");
+        return check(e);
+    }
+
+    TypeKind typeOf(ExprPtr e)
+    {
+        switch (e->kind)
+        {
+        case NK_INT_LITERAL: return TY_INT;
+        case NK_FLOAT_LITERAL: return TY_DOUBLE;
+        case NK_STRING_LITERAL: return TY_STRING;
+        case NK_BOOL_LITERAL: return TY_BOOL;
+        case NK_CHAR_LITERAL: return TY_CHAR;
+        case NK_IDENTIFIER:
+        {
+            SymbolId name = static_cast<IdentifierExpr*>(e)->name;
+            if (const Symbol* local = scopes.lookup(name))
+                return TypeOf(local->type);
+            auto it = globals.find(name);
+            if (it != globals.end())
+                return it->second;
+            error(string(functions.count(name) ? "function used as a value: " : "undeclared variable: ") + string(SymbolName(name)));
+        }
+        case NK_UNARY:
+        {
+            auto u = static_cast<UnaryExpr*>(e);
+            if (u->op == T_INC || u->op == T_DEC)
+            {
+                TypeKind t = variable(u->rhs, opName(u->op));
+                if (!IsNumber(t))
+                    error(string("invalid operand to ") + opName(u->op) + ": " + TypeName(t));
+                return t;
+            }
+            TypeKind t = check(u->rhs);
+            if (u->op == T_PLUS && t != TY_VOID)
+                return t;
+            if (!IsNumber(t))
+                error(string("invalid operand to ") + opName(u->op) + ": " + TypeName(t));
+            if (u->op == T_NOT)
+                return TY_BOOL;
+            return t == TY_FLOAT || t == TY_DOUBLE ? t : TY_INT;
+        }
+        case NK_POSTFIX:
+        {
+            auto p = static_cast<PostfixExpr*>(e);
+            TypeKind t = variable(p->base, opName(p->op));
+            if (!IsNumber(t))
+                error(string("invalid operand to ") + opName(p->op) + ": " + TypeName(t));
+            return t;
+        }
+        case NK_BINARY:
+            return binary(static_cast<BinaryExpr*>(e));
+        case NK_CALL:
+            return call(static_cast<CallExpr*>(e));
+        default:
+            error("unexpected expression");
+        }
+    }
+
+    TypeKind binary(BinaryExpr* b)
+    {
+        if (b->op == T_ASSIGN)
+        {
+            TypeKind value = check(b->right);
+            TypeKind target = variable(b->left, "=");
+            expectStore(target, value, "assignment");
+            return target;
+        }
+        TypeKind l = check(b->left), r = check(b->right);
+        auto invalid = [&]() {
+            error(string("invalid operands to ") + opName(b->op) + ": " + TypeName(l) + " and " + TypeName(r));
+        };
+        switch (b->op)
+        {
+        case T_AND: case T_OR:
+            if (!IsNumber(l) || !IsNumber(r))
+                invalid();
+            return TY_BOOL;
+        case T_EQ: case T_NEQ: case T_LT: case T_GT: case T_LEQ: case T_GEQ:
+            if (!(IsNumber(l) && IsNumber(r)) && !(l == TY_STRING && r == TY_STRING))
+                invalid();
+            return TY_BOOL;
+        case T_PLUS: case T_MINUS: case T_MULT: case T_DIV: case T_MOD:
+            if (b->op == T_PLUS && l == TY_STRING && r == TY_STRING)
+                return TY_STRING;
+            if (!IsNumber(l) || !IsNumber(r))
+                invalid();
+            if (l == TY_DOUBLE || r == TY_DOUBLE)
+                return TY_DOUBLE;
+            return l == TY_FLOAT || r == TY_FLOAT ? TY_FLOAT : TY_INT;
+        default:
+            error(string("unexpected operator ") + opName(b->op));
+        }
+    }
+
+    TypeKind call(CallExpr* c)
+    {
+        auto callee = nodeCast<IdentifierExpr>(c->callee);
+        if (!callee)
+            error("only named functions can be called");
+        SymbolId name = callee->name;
+        if (scopes.lookup(name) || globals.count(name))
+            error("called object is not a function: " + string(SymbolName(name)));
+        auto it = functions.find(name);
+        if (it == functions.end())
+            error("undefined function: " + string(SymbolName(name)));
+        const Signature& sig = it->second;
+        if (c->args.size() != sig.params.size())
+            error("wrong number of arguments to " + string(SymbolName(name)) + ": expected "
+                + to_string(sig.params.size()) + ", got " + to_string(c->args.size()));
+        for (size_t i = 0; i < c->args.size(); i++)
+            expectStore(sig.params[i], check(c->args[i]), "argument " + to_string(i + 1) + " of " + string(SymbolName(name)));
+        callee->type = sig.ret;
+        return sig.ret;
+    }
+};
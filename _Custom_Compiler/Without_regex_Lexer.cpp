@@ -1,73 +1,55 @@
 #include "Without_regex_Lexer.h"
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <iterator>
+#include <algorithm>
+#include <exception>
+#include "Keywords.h"
+#include "SimdScan.h"
 using namespace std;
 
+static constexpr KeywordEntry LexerKeywords[] = {
+    { "int", T_INT }, { "float", T_FLOAT }, { "double", T_DOUBLE }, { "string", T_STRING },
+    { "bool", T_BOOL }, { "return", T_RETURN }, { "if", T_IF }, { "else", T_ELSE },
+    { "while", T_WHILE }, { "for", T_FOR }, { "fn", T_FUNCTION }, { "true", T_TRUE },
+    { "false", T_FALSE }, { "void", T_VOID }, { "let", T_LET }, { "const", T_CONST },
+    { "struct", T_STRUCT }, { "break", T_BREAK }, { "continue", T_CONTINUE }, { "null", T_NULL },
+    { "new", T_NEW }, { "class", T_CLASS }, { "public", T_PUBLIC }, { "private", T_PRIVATE },
+    { "protected", T_PROTECTED }, { "static", T_STATIC }, { "import", T_IMPORT }, { "then", T_THEN },
+    { "switch", T_SWITCH }, { "case", T_CASE }, { "default", T_DEFAULT }, { "enum", T_ENUM },
+};
+static constexpr KeywordTable<size(LexerKeywords)> Keywords(LexerKeywords);
+static_assert(Keywords.Lookup("enum") == T_ENUM && Keywords.Lookup("main") == T_IDENTIFIER, "keyword table");
+
 Without_regex_Lexer::Without_regex_Lexer()
 {
-    keywords["int"] = "T_INT";
-    keywords["float"] = "T_FLOAT";
-    keywords["double"] = "T_DOUBLE";
-    keywords["string"] = "T_STRING";
-    keywords["bool"] = "T_BOOL";
-    keywords["return"] = "T_RETURN";
-    keywords["if"] = "T_IF";
-    keywords["else"] = "T_ELSE";
-    keywords["while"] = "T_WHILE";
-    keywords["for"] = "T_FOR";
-    keywords["fn"] = "T_FUNCTION";
-    keywords["true"] = "T_TRUE";
-    keywords["false"] = "T_FALSE";
-    keywords["void"] = "T_VOID";
-    keywords["let"] = "T_LET";
-    keywords["const"] = "T_CONST";
-    keywords["struct"] = "T_STRUCT";
-    keywords["break"] = "T_BREAK";
-    keywords["continue"] = "T_CONTINUE";
-    keywords["null"] = "T_NULL";
-    keywords["new"] = "T_NEW";
-    keywords["class"] = "T_CLASS";
-    keywords["public"] = "T_PUBLIC";
-    keywords["private"] = "T_PRIVATE";
-    keywords["protected"] = "T_PROTECTED";
-    keywords["static"] = "T_STATIC";
-    keywords["import"] = "T_IMPORT";
-    keywords["then"] = "T_THEN";
-    keywords["switch"] = "T_SWITCH";
-    keywords["case"] = "T_CASE";
-    keywords["default"] = "T_DEFAULT";
-    keywords["enum"] = "T_ENUM";
 }
 
-vector<Token> Without_regex_Lexer::CreateTokens(const string &filename)
+const vector<Token>& Without_regex_Lexer::CreateTokens(const string &filename)
 {
-    ifstream file(filename);
-    if (!file)
-        throw runtime_error("Could not open file!");
+    source.Load(filename);
 
-    string line;
-    while (getline(file, line))
-    {
-        column_number = 1;
-        Tokenize(line);
-        line_number++;
-    }
+    // the whole buffer is tokenized in one pass, '\n' is handled as whitespace
+    column_number = 1;
+    Tokenize(source.View());
     return tokens;
 }
 
-bool Without_regex_Lexer::isKeyword(const string &word)
+const vector<Token>& Without_regex_Lexer::CreateTokensParallel(const string& filename, ThreadPool& pool)
 {
-    return keywords.find(word) != keywords.end();
+    source.Load(filename);
+    column_number = 1;
+    TokenizeParallel(source.View(), pool);
+    return tokens;
 }
 
-string Without_regex_Lexer::getKeywordToken(const string &word)
+bool Without_regex_Lexer::isKeyword(string_view word)
 {
-    if (isKeyword(word))
-    {
-        return keywords[word];
-    }
-    return "T_IDENTIFIER";
+    return Keywords.Lookup(word) != T_IDENTIFIER;
+}
+
+TokenKind Without_regex_Lexer::getKeywordToken(string_view word)
+{
+    return Keywords.Lookup(word);
 }
 
 bool Without_regex_Lexer::isIgnoreChar(char c)
@@ -85,19 +67,36 @@ bool Without_regex_Lexer::isNum(char c)
     return c >= '0' && c <= '9';
 }
 
-void Without_regex_Lexer::Tokenize(const string &input)
+// Skips the rest of the current line: leaves i just before the next '\n' (or at the
+// end of input) so the main loop handles the newline itself.
+static size_t LastBeforeNewline(string_view input, size_t i)
 {
-    for (int i = 0; i < input.size(); i++)
+    size_t nl = input.find('\n', i);
+    return (nl == string_view::npos ? input.size() : nl) - 1;
+}
+
+void Without_regex_Lexer::Tokenize(string_view input)
+{
+    for (size_t i = 0; i < input.size(); i++)
     {
         char currentChar = input[i];
         //cout<<"char at "<<i<<" is "<<currentChar<<endl;
 
         if(isComment==true)
         {
-            while (i < input.size() && input[i] != '*')
+            while (true)
             {
-                i++;
-                column_number++;
+                size_t stop = ScanCommentBody(input.data(), i, input.size());
+                column_number += (int)(stop - i);
+                i = stop;
+                if (i < input.size() && input[i] == '\n')
+                {
+                    line_number++;
+                    column_number = 1;
+                    i++;
+                    continue;
+                }
+                break;
             }
             if(i + 1 < input.size() && input[i + 1] == '/')
             {
@@ -117,114 +116,103 @@ void Without_regex_Lexer::Tokenize(const string &input)
             }
             else
             {
-                column_number++;
+                size_t end = ScanBlanks(input.data(), i, input.size());
+                column_number += (int)(end - i);
+                i = end - 1;
             }
             continue;
         }
 
         if (isAlpha(currentChar) || currentChar == '_')
         {
-            string word;
+            size_t start = i;
             int sci = column_number;
-            while (i < input.size() && (isalnum(input[i]) || input[i] == '_'))
-            {
-                word += input[i];
-                i++;
-                column_number++;
-            }
+            i = ScanIdentifier(input.data(), i, input.size());
+            column_number += (int)(i - start);
+            string_view word = input.substr(start, i - start);
             i--;
-            string tokenType = getKeywordToken(word);
+            TokenKind tokenType = getKeywordToken(word);
             tokens.push_back({tokenType, word, line_number, sci});
             continue;
         }
 
         if (isNum(currentChar))
         {
-            string number;
+            size_t start = i;
             int sci = column_number;
             bool isFloat = false;
-            while (i < input.size() && isdigit(input[i]))
-            {
-                number += input[i];
-                i++;
-                column_number++;
-            }
+            i = ScanDigits(input.data(), i, input.size());
+            column_number += (int)(i - start);
             if (i < input.size() && input[i] == '.')
             {
-                number += input[i];
                 i++;
                 column_number++;
-                while (i < input.size() && isdigit(input[i]))
-                {
-                    number += input[i];
-                    i++;
-                    column_number++;
-                }
+                size_t digits = i;
+                i = ScanDigits(input.data(), i, input.size());
+                column_number += (int)(i - digits);
                 isFloat =true;
                 
             }
             if (i < input.size() && (input[i] == 'e' || input[i] == 'E'))
             {
-                number += input[i];
                 i++;
                 column_number++;
                 if (i < input.size() && (input[i] == '+' || input[i] == '-'))
                 {
-                    number += input[i];
-                    i++;
-                    column_number++;
-                }
-                while (i < input.size() && isdigit(input[i]))
-                {
-                    number += input[i];
                     i++;
                     column_number++;
                 }
+                size_t digits = i;
+                i = ScanDigits(input.data(), i, input.size());
+                column_number += (int)(i - digits);
             }
+            string_view number = input.substr(start, i - start);
             if (i < input.size() && (isAlpha(input[i]) || input[i] == '_'))
                 throw runtime_error("Invalid number format at line " + to_string(line_number) + ", column " + to_string(column_number));
             i--;
             if(isFloat)
-                tokens.push_back({"T_FLOATLIT", number, line_number, sci});
+                tokens.push_back({T_FLOATLIT, number, line_number, sci});
             else
-            tokens.push_back({"T_INTLIT", number, line_number, sci});
+            tokens.push_back({T_INTLIT, number, line_number, sci});
             continue;
         }
 
         if (currentChar == '"')
         {
-            string strLit;
             int sci = column_number;
-            tokens.push_back({"T_QUOTE", "\"", line_number, column_number});
+            tokens.push_back({T_QUOTE, "\"", line_number, column_number});
             i++;
             column_number++;
-            while (i < input.size() && input[i] != '"')
-            {
-                if (input[i] == '\\' && i + 1 < input.size() && (input[i + 1] == '"' ||  input[i + 1] == 'n' || input[i + 1] == 't' || input[i + 1] == 'r'))
+            size_t start = i;
+            while (true)
+            {
+                size_t stop = ScanStringBody(input.data(), i, input.size());
+                column_number += (int)(stop - i);
+                i = stop;
+                if (i >= input.size() || input[i] != '\\')
+                    break;
+                if (i + 1 < input.size() && (input[i + 1] == '"' ||  input[i + 1] == 'n' || input[i + 1] == 't' || input[i + 1] == 'r'))
                 {
-                    strLit += input[i];
-                    i++;
-                    strLit += input[i];
-                    i++;
+                    i += 2;
                     column_number+=2;
                 }
                 else
                 {
-                strLit += input[i];
                 i++;
                 column_number++;
                 }
             }
-            if (i < input.size())
+            if (i < input.size() && input[i] == '"')
             {
                
-                tokens.push_back({"T_STRINGLIT", strLit, line_number, sci});
-                tokens.push_back({"T_QUOTE", "\"", line_number, column_number});
+                tokens.push_back({T_STRINGLIT, input.substr(start, i - start), line_number, sci});
+                tokens.push_back({T_QUOTE, "\"", line_number, column_number});
 
             }
             else
             {
-                printTokens();
+                if (printOnError)
+                    printTokens();
                 throw runtime_error("Unterminated string literal at line " + to_string(line_number) + ", column " + to_string(sci));
             }
             continue;
@@ -235,240 +223,240 @@ void Without_regex_Lexer::Tokenize(const string &input)
         case '+':
             if (i + 1 < input.size() && input[i + 1] == '+')
             {
-                tokens.push_back({"T_INCREMENT", "++", line_number, column_number});
+                tokens.push_back({T_INCREMENT, "++", line_number, column_number});
                 i++;
                 column_number++;
             }
             else if (i + 1 < input.size() && input[i + 1] == '=')
             {
-                tokens.push_back({"T_PLUSEQ", "+=", line_number, column_number});
+                tokens.push_back({T_PLUSEQ, "+=", line_number, column_number});
                 i++;
                 column_number++;
                
             }
             else
             {
-                tokens.push_back({"T_PLUS", "+", line_number, column_number});
+                tokens.push_back({T_PLUS, "+", line_number, column_number});
             }
             break;
         case '-':
             if (i + 1 < input.size() && input[i + 1] == '-')
             {
-                tokens.push_back({"T_DECREMENT", "--", line_number, column_number});
+                tokens.push_back({T_DECREMENT, "--", line_number, column_number});
                 i++;
                 column_number++;
             }
             else if (i + 1 < input.size() && input[i + 1] == '=')
             {
-                tokens.push_back({"T_MINUSEQ", "-=", line_number, column_number});
+                tokens.push_back({T_MINUSEQ, "-=", line_number, column_number});
                 i++;
                 column_number++;
             }
             else
             {
-                tokens.push_back({"T_MINUS", "-", line_number, column_number});
+                tokens.push_back({T_MINUS, "-", line_number, column_number});
             }
             break;
         case '*':
             if (i + 1 < input.size() && input[i + 1] == '=')
             {
-                tokens.push_back({"T_MULTEQ", "*=", line_number, column_number});
+                tokens.push_back({T_MULTEQ, "*=", line_number, column_number});
                 i++;
                 column_number++;
             }
             else
             {
-                tokens.push_back({"T_MULTIPLY", "*", line_number, column_number});
+                tokens.push_back({T_MULTIPLY, "*", line_number, column_number});
             }
 
             break;
         case '/':
             if (i + 1 < input.size() && input[i + 1] == '=')
             {
-                tokens.push_back({"T_DIVEQ", "/=", line_number, column_number});
+                tokens.push_back({T_DIVEQ, "/=", line_number, column_number});
                 i++;
                 column_number++;
             }
             else if( i + 1 < input.size() && input[i + 1] == '/')
             {
-                i = input.size();
+                i = LastBeforeNewline(input, i);
                 break;
             }
             else if( i + 1 < input.size() && input[i + 1] == '*')
             {
                 isComment = true;
-                i = input.size();
+                i = LastBeforeNewline(input, i);
                 break;
             }
             else
             {
-                tokens.push_back({"T_DIVIDE", "/", line_number, column_number});
+                tokens.push_back({T_DIVIDE, "/", line_number, column_number});
             }
             break;
         case '=':
             if (i + 1 < input.size() && input[i + 1] == '=')
             {
-                tokens.push_back({"T_EQUALSOP", "==", line_number, column_number});
+                tokens.push_back({T_EQUALSOP, "==", line_number, column_number});
                 i++;
                 column_number++;
             }
             else
             {
-                tokens.push_back({"T_ASSIGNOP", "=", line_number, column_number});
+                tokens.push_back({T_ASSIGNOP, "=", line_number, column_number});
             }
             break;
         case '!':
             if (i + 1 < input.size() && input[i + 1] == '=')
             {
-                tokens.push_back({"T_NOTEQ", "!=", line_number, column_number});
+                tokens.push_back({T_NOTEQ, "!=", line_number, column_number});
                 i++;
                 column_number++;
             }
             else
             {
-                tokens.push_back({"T_NOT", "!", line_number, column_number});
+                tokens.push_back({T_NOT, "!", line_number, column_number});
             }
             break;
         case '<':
             if (i + 1 < input.size() && input[i + 1] == '=')
             {
-                tokens.push_back({"T_LTE", "<=", line_number, column_number});
+                tokens.push_back({T_LTE, "<=", line_number, column_number});
                 i++;
                 column_number++;
             }
             else if (i + 1 < input.size() && input[i + 1] == '<')
             {
-                tokens.push_back({"T_SHL", "<<", line_number, column_number});
+                tokens.push_back({T_SHL, "<<", line_number, column_number});
                 i++;
                 column_number++;
                 if (i + 1 < input.size() && input[i + 1] == '=')
                 {
-                    tokens.push_back({"T_SHLEQ", "<<=", line_number, column_number});
+                    tokens.push_back({T_SHLEQ, "<<=", line_number, column_number});
                     i++;
                     column_number++;
                 }
             }
             else
             {
-                tokens.push_back({"T_LT", "<", line_number, column_number});
+                tokens.push_back({T_LT, "<", line_number, column_number});
             }
             break;
         case '>':
             if (i + 1 < input.size() && input[i + 1] == '=')
             {
-                tokens.push_back({"T_GTE", ">=", line_number, column_number});
+                tokens.push_back({T_GTE, ">=", line_number, column_number});
                 i++;
                 column_number++;
             }
             else if( i + 1 < input.size() && input[i + 1] == '>')
             {
-                tokens.push_back({"T_SHR", ">>", line_number, column_number});
+                tokens.push_back({T_SHR, ">>", line_number, column_number});
                 i++;
                 column_number++;
                 if( i + 1 < input.size() && input[i + 1] == '=')
                 {
-                    tokens.push_back({"T_SHREQ", ">>=", line_number, column_number});
+                    tokens.push_back({T_SHREQ, ">>=", line_number, column_number});
                     i++;
                     column_number++;
                 }
             }
             else
             {
-                tokens.push_back({"T_GT", ">", line_number, column_number});
+                tokens.push_back({T_GT, ">", line_number, column_number});
             }
             break;
         case '&':
             if (i + 1 < input.size() && input[i + 1] == '&') 
             {
-                tokens.push_back({"T_AND", "&&", line_number, column_number});
+                tokens.push_back({T_AND, "&&", line_number, column_number});
                 i++;
                 column_number++;
             }
             else if( i + 1 < input.size() && input[i + 1] == '=')
             {
-                tokens.push_back({"T_ANDEQ", "&=", line_number, column_number});
+                tokens.push_back({T_ANDEQ, "&=", line_number, column_number});
                 i++;
                 column_number++;
             }
             else
             {
-                tokens.push_back({"T_AMPERSAND", "&", line_number, column_number});
+                tokens.push_back({T_AMPERSAND, "&", line_number, column_number});
             }
             break;
         case '|':
             if (i + 1 < input.size() && input[i + 1] == '|')
             {
-                tokens.push_back({"T_OR", "||", line_number, column_number});
+                tokens.push_back({T_OR, "||", line_number, column_number});
                 i++;
                 column_number++;
             }
             else
             {
-                tokens.push_back({"T_BITOR", "|", line_number, column_number});
+                tokens.push_back({T_BITOR, "|", line_number, column_number});
             }
             break;
         case ';':
-            tokens.push_back({"T_SEMICOLON", ";", line_number, column_number});
+            tokens.push_back({T_SEMICOLON, ";", line_number, column_number});
             break;
         case ',':
-            tokens.push_back({"T_COMMA", ",", line_number, column_number});
+            tokens.push_back({T_COMMA, ",", line_number, column_number});
             break;
         case '(':
-            tokens.push_back({"T_PARENL", "(", line_number, column_number});
+            tokens.push_back({T_PARENL, "(", line_number, column_number});
             break;
         case ')':
-            tokens.push_back({"T_PARENR", ")", line_number, column_number});
+            tokens.push_back({T_PARENR, ")", line_number, column_number});
             break;
         case '{':
-            tokens.push_back({"T_BRACEL", "{", line_number, column_number});
+            tokens.push_back({T_BRACEL, "{", line_number, column_number});
             break;
         case '}':
-            tokens.push_back({"T_BRACER", "}", line_number, column_number});
+            tokens.push_back({T_BRACER, "}", line_number, column_number});
             break;
         case '[':
-            tokens.push_back({"T_BRACKETL", "[", line_number, column_number});
+            tokens.push_back({T_BRACKETL, "[", line_number, column_number});
             break;
         case ']':
-            tokens.push_back({"T_BRACKETR", "]", line_number, column_number});
+            tokens.push_back({T_BRACKETR, "]", line_number, column_number});
             break;
         case '.':
-            tokens.push_back({"T_DOT", ".", line_number, column_number});
+            tokens.push_back({T_DOT, ".", line_number, column_number});
             break;
         case ':':
-            tokens.push_back({"T_COLON", ":", line_number, column_number});
+            tokens.push_back({T_COLON, ":", line_number, column_number});
             break;
         case '%':
             if (i + 1 < input.size() && input[i + 1] == '=')
             {
-                tokens.push_back({"T_MODEQ", "%=", line_number, column_number});
+                tokens.push_back({T_MODEQ, "%=", line_number, column_number});
                 i++;
                 column_number++;
             }
             else
             {
-                tokens.push_back({"T_MODULO", "%", line_number, column_number});
+                tokens.push_back({T_MODULO, "%", line_number, column_number});
             }
             break;
         case '^':
             if( i + 1 < input.size() && input[i + 1] == '=')
             {
-                tokens.push_back({"T_BITXOREQ", "^=", line_number, column_number});
+                tokens.push_back({T_BITXOREQ, "^=", line_number, column_number});
                 i++;
                 column_number++;
             }
             else
             {
-                tokens.push_back({"T_BITXOR", "^", line_number, column_number});
+                tokens.push_back({T_BITXOR, "^", line_number, column_number});
             }
             break;
         case '~':
-            tokens.push_back({"T_BITNOT", "~", line_number, column_number});
+            tokens.push_back({T_BITNOT, "~", line_number, column_number});
             break;
         case '?':
-            tokens.push_back({"T_QUESTION", "?", line_number, column_number});
+            tokens.push_back({T_QUESTION, "?", line_number, column_number});
             break;
         case '#':
-            tokens.push_back({"T_HASH", "#", line_number, column_number});
+            tokens.push_back({T_HASH, "#", line_number, column_number});
             break;
 
         default:
@@ -477,22 +465,135 @@ void Without_regex_Lexer::Tokenize(const string &input)
     }
 }
 
+// Parallel mode.
+// Chunks always end just after a '\n'. Nothing but a block comment carries over a
+// line break (strings, numbers and names stop at it), so the only state a chunk
+// needs from its predecessors is whether it starts inside a comment, plus the
+// line count so far. Every chunk is first lexed on the guess that it does not
+// start in a comment; the guesses are then checked in source order and the few
+// chunks that guessed wrong are lexed again with the real state.
+struct Without_regex_Lexer::Chunk
+{
+    string_view text;
+    bool startsInComment = false;
+    int firstColumn = 1;
+    vector<Token> tokens;
+    int lines = 0;              // '\n' characters in text
+    int endColumn = 1;
+    bool endsInComment = false;
+    exception_ptr error;
+};
+
+void Without_regex_Lexer::LexChunk(Chunk& chunk)
+{
+    Without_regex_Lexer lexer;
+    lexer.printOnError = false;
+    lexer.isComment = chunk.startsInComment;
+    lexer.column_number = chunk.firstColumn;
+    chunk.error = nullptr;
+    try
+    {
+        lexer.Tokenize(chunk.text);
+    }
+    catch (...)
+    {
+        chunk.error = current_exception();
+    }
+    chunk.tokens = move(lexer.tokens);
+    chunk.lines = lexer.line_number - 1;
+    chunk.endColumn = lexer.column_number;
+    chunk.endsInComment = lexer.isComment;
+}
+
+void Without_regex_Lexer::TokenizeParallel(string_view input, ThreadPool& pool, size_t min_chunk)
+{
+    size_t count = min(pool.Size() * 4, input.size() / max(min_chunk, (size_t)1));
+    vector<Chunk> chunks;
+    size_t begin = 0;
+    for (size_t k = 1; k <= count && begin < input.size(); k++)
+    {
+        size_t end = input.size();
+        if (k < count)
+        {
+            size_t nl = input.find('\n', max(begin, input.size() / count * k));
+            if (nl == string_view::npos)
+                k = count;
+            else
+                end = nl + 1;
+        }
+        chunks.emplace_back();
+        chunks.back().text = input.substr(begin, end - begin);
+        begin = end;
+    }
+    if (chunks.size() < 2)
+    {
+        Tokenize(input);
+        return;
+    }
+    chunks[0].startsInComment = isComment;
+    chunks[0].firstColumn = column_number;
+
+    pool.ParallelFor(chunks.size(), [&](size_t k) { LexChunk(chunks[k]); });
+
+    bool inComment = isComment;
+    vector<size_t> offsets(chunks.size());
+    vector<int> lineOffsets(chunks.size());
+    size_t total = tokens.size();
+    int lines = line_number - 1;
+    for (size_t k = 0; k < chunks.size(); k++)
+    {
+        Chunk& chunk = chunks[k];
+        if (chunk.startsInComment != inComment)
+        {
+            chunk.startsInComment = inComment;
+            LexChunk(chunk);
+        }
+        if (chunk.error)
+        {
+            // a real lexing error: redo the whole input sequentially so the message,
+            // the partial token dump and the tokens kept before it match CreateTokens
+            Tokenize(input);
+            return;
+        }
+        offsets[k] = total;
+        lineOffsets[k] = lines;
+        total += chunk.tokens.size();
+        lines += chunk.lines;
+        inComment = chunk.endsInComment;
+    }
+
+    tokens.resize(total);
+    pool.ParallelFor(chunks.size(), [&](size_t k)
+    {
+        Token* out = tokens.data() + offsets[k];
+        for (const Token& t : chunks[k].tokens)
+        {
+            *out = t;
+            out->line += lineOffsets[k];
+            out++;
+        }
+    });
+    line_number = lines + 1;
+    column_number = chunks.back().endColumn;
+    isComment = inComment;
+}
+
 void Without_regex_Lexer::printTokens()
 {
     cout << "[ ";
     for (int i = 0; i < tokens.size(); i++)
     {
-        if (tokens[i].type == "T_IDENTIFIER" || tokens[i].type == "T_STRINGLIT")
+        if (tokens[i].type == T_IDENTIFIER || tokens[i].type == T_STRINGLIT)
         {
-            cout << tokens[i].type << "(\"" << tokens[i].value << "\")";
+            cout << TokenKindName(tokens[i].type) << "(\"" << tokens[i].value << "\")";
         }
-        else if (tokens[i].type == "T_INTLIT" || tokens[i].type == "T_FLOATLIT")
+        else if (tokens[i].type == T_INTLIT || tokens[i].type == T_FLOATLIT)
         {
-            cout << tokens[i].type << "(" << tokens[i].value << ")";
+            cout << TokenKindName(tokens[i].type) << "(" << tokens[i].value << ")";
         }
         else
         {
-            cout << tokens[i].type;
+            cout << TokenKindName(tokens[i].type);
         }
         if (i != tokens.size() - 1)
             cout << ", ";
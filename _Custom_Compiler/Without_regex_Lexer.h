@@ -2,17 +2,21 @@
 #include<vector>
 #include<iostream>
 #include<string>
+#include<string_view>
 #include <unordered_map>
+#include "TokenKind.h"
+#include "SourceBuffer.h"
+#include "ThreadPool.h"
 using namespace std;
 
 
 struct Token
 {
-    string type;
-    string value;
+    TokenKind type;
+    string_view value;  // points into the lexer's SourceBuffer
     int line;
     int column;
-    Token(string t, string v, int l, int c):type(t), value(v), line(l), column(c){}
+    Token(TokenKind t, string_view v, int l, int c):type(t), value(v), line(l), column(c){}
     Token(){}
 };
 
@@ -20,17 +24,25 @@ struct Token
 class Without_regex_Lexer
 {
     
+    SourceBuffer source;
     vector<Token> tokens;
-    unordered_map<string, string> keywords;
     int line_number = 1;
     int column_number = 1;
     bool isComment = false;
+    bool printOnError = true;   // chunk lexers stay quiet, the sequential retry prints
+    struct Chunk;
+    static void LexChunk(Chunk& chunk);
     public:
+        // Inputs smaller than this are not worth splitting.
+        static const size_t PARALLEL_MIN_CHUNK = 1 << 20;
+
         Without_regex_Lexer();
-        bool isKeyword(const string& word);
-        string getKeywordToken(const string& word);
-        vector<Token> CreateTokens(const string& filename);
-        void Tokenize(const string& input);
+        bool isKeyword(string_view word);
+        TokenKind getKeywordToken(string_view word);
+        const vector<Token>& CreateTokens(const string& filename);
+        const vector<Token>& CreateTokensParallel(const string& filename, ThreadPool& pool = ThreadPool::Shared());
+        void Tokenize(string_view input);
+        void TokenizeParallel(string_view input, ThreadPool& pool, size_t min_chunk = PARALLEL_MIN_CHUNK);
         bool isIgnoreChar(char c);
         bool isAlpha(char c);
         bool isNum(char c);
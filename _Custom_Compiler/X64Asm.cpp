@@ -0,0 +1,1368 @@
+#include "X64Asm.h"
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <cstring>
+#include <climits>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+enum AsmReg
+{
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15,
+    XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7, XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15,
+    REG_COUNT
+};
+
+static const char* const regNames[REG_COUNT] = {
+    "%rax", "%rcx", "%rdx", "%rbx", "%rsp", "%rbp", "%rsi", "%rdi",
+    "%r8", "%r9", "%r10", "%r11", "%r12", "%r13", "%r14", "%r15",
+    "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7",
+    "%xmm8", "%xmm9", "%xmm10", "%xmm11", "%xmm12", "%xmm13", "%xmm14", "%xmm15",
+};
+
+// rax, rcx, rdx, r11, xmm0 and xmm1 are scratch registers of the instruction
+// templates and are never allocated. Caller-saved registers come first, so
+// the callee-saved ones are left for intervals that span a call.
+static const AsmReg gprOrder[] = { RSI, RDI, R8, R9, R10, RBX, R12, R13, R14, R15 };
+static const AsmReg intArgRegs[] = { RDI, RSI, RDX, RCX, R8, R9 };
+static const int FLOAT_ARG_REGS = 8;    // xmm0-xmm7
+
+static const int MAX_DEPTH = 1 << 16;   // frames, as in the VMs
+static const int STACK_BUDGET = 7 << 20;    // bytes of native stack the program may use
+
+// index of the lowest set bit of a nonzero mask
+static inline int FirstSetBit(uint64_t mask)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return (int)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, (unsigned long)mask))
+        return (int)index;
+    _BitScanForward(&index, (unsigned long)(mask >> 32));
+    return (int)index + 32;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+static bool IsXmm(int r)
+{
+    return r >= XMM0;
+}
+
+static bool IsCalleeSaved(int r)
+{
+    return r == RBX || (r >= R12 && r <= R15);
+}
+
+// Where a value is: a register, memory (a stack slot, a global, an incoming
+// argument) or, for constants, nowhere until it is used.
+struct Location
+{
+    enum Kind : uint8_t { NONE, REG, MEM, CONST } kind = NONE;
+    int reg = -1;               // REG
+    string address;             // MEM, as an operand: -8(%rbp), g0(%rip)
+    ValueId value = NO_VALUE;   // CONST: the S_CONST or S_UNDEF
+
+    static Location Reg(int r)
+    {
+        Location l;
+        l.kind = REG;
+        l.reg = r;
+        return l;
+    }
+    static Location Mem(const string& address)
+    {
+        Location l;
+        l.kind = MEM;
+        l.address = address;
+        return l;
+    }
+    static Location Const(ValueId v)
+    {
+        Location l;
+        l.kind = CONST;
+        l.value = v;
+        return l;
+    }
+    bool operator==(const Location& o) const
+    {
+        return kind == o.kind && reg == o.reg && address == o.address && value == o.value;
+    }
+    bool operator!=(const Location& o) const { return !(*this == o); }
+};
+
+// Float and string constants of the whole module, in .rodata.
+class AsmConstants
+{
+    map<uint64_t, string> floats;
+    map<string, string> strings;
+
+public:
+    string Float(double d)
+    {
+        uint64_t bits;
+        memcpy(&bits, &d, sizeof bits);
+        auto it = floats.find(bits);
+        if (it != floats.end())
+            return it->second;
+        string label = ".LF" + to_string(floats.size());
+        floats[bits] = label;
+        return label;
+    }
+
+    // a string is its length as a quad, then its bytes
+    string String(const string& s)
+    {
+        auto it = strings.find(s);
+        if (it != strings.end())
+            return it->second;
+        string label = ".LS" + to_string(strings.size());
+        strings[s] = label;
+        return label;
+    }
+
+    void Emit(ostream& out) const
+    {
+        out << "\n    .section .rodata\n";
+        for (auto& f : floats)
+            out << "    .align 8\n" << f.second << ":\n    .quad 0x" << hex << f.first << dec << "\n";
+        for (auto& s : strings)
+        {
+            out << "    .align 8\n" << s.second << ":\n    .quad " << s.first.size() << "\n";
+            if (s.first.empty())
+                continue;
+            out << "    .ascii \"";
+            for (unsigned char c : s.first)
+            {
+                if (c == '"' || c == '\\')
+                    out << '\\' << c;
+                else if (c >= 32 && c < 127)
+                    out << c;
+                else
+                {
+                    const char* digits = "01234567";
+                    out << '\\' << digits[c >> 6] << digits[(c >> 3) & 7] << digits[c & 7];
+                }
+            }
+            out << "\"\n";
+        }
+    }
+};
+
+static string Label(const SsaModule& module, int function)
+{
+    return function == module.globalInit ? "cc_init" : "f_" + string(SymbolName(module.functions[function].name));
+}
+
+static bool IsCompare(SsaOp op)
+{
+    return op >= S_EQ && op <= S_GE;
+}
+
+// condition code of an int or string comparison
+static const char* ConditionOf(SsaOp op)
+{
+    switch (op)
+    {
+    case S_EQ: return "e";
+    case S_NE: return "ne";
+    case S_LT: return "l";
+    case S_GT: return "g";
+    case S_LE: return "le";
+    default: return "ge";
+    }
+}
+
+static const char* Inverse(const string& cc)
+{
+    static const char* const pairs[][2] = { { "e", "ne" }, { "ne", "e" }, { "l", "ge" }, { "ge", "l" }, { "g", "le" }, { "le", "g" } };
+    for (auto& p : pairs)
+        if (cc == p[0])
+            return p[1];
+    return "ne";
+}
+
+// One function: allocation, then code.
+class AsmFunction
+{
+    struct Move
+    {
+        Location dst, src;
+    };
+
+    struct Interval
+    {
+        ValueId value;
+        int start, end;
+        bool xmm;
+        bool spansCall;
+    };
+
+    const SsaModule& module;
+    const SsaFunction& fn;
+    int index;
+    AsmConstants& constants;
+    ostream& out;
+
+    vector<int> position;       // of every instruction, in block order
+    vector<int> blockFrom, blockTo;
+    vector<int> uses;
+    vector<char> fused;         // int compares emitted as part of their branch
+    vector<int> calls;          // positions of instructions that call out
+    vector<int> start, end;     // live interval of every allocated value
+    vector<Location> where;
+    vector<int> slotOf;
+    vector<int> hint;           // argument register a value is passed in, or -1
+    vector<int> saved;          // callee-saved registers the function uses
+    int slots = 0;
+    int labels = 0;
+
+public:
+    AsmFunction(const SsaModule& module, int index, AsmConstants& constants, ostream& out)
+        : module(module), fn(module.functions[index]), index(index), constants(constants), out(out) {}
+
+    void Emit()
+    {
+        number();
+        computeIntervals();
+        allocate();
+        emitCode();
+    }
+
+private:
+    // ---- analysis ----
+
+    bool allocated(ValueId v) const
+    {
+        const SsaInst& in = fn.insts[v];
+        if (in.type == V_VOID || in.op == S_CONST || in.op == S_UNDEF || fused[v])
+            return false;
+        // a parameter or phi nobody reads is never written
+        return uses[v] > 0 || (in.op != S_PARAM && in.op != S_PHI);
+    }
+
+    bool callsOut(const SsaInst& in) const
+    {
+        switch (in.op)
+        {
+        case S_CALL: return true;
+        case S_ADD: return in.type == V_STRING;
+        case S_MOD: return in.type == V_FLOAT;
+        default: return IsCompare(in.op) && fn.insts[in.args[0]].type == V_STRING;
+        }
+    }
+
+    void number()
+    {
+        size_t n = fn.insts.size();
+        position.assign(n, 0);
+        uses.assign(n, 0);
+        fused.assign(n, 0);
+        int p = 0;
+        for (const SsaBlock& block : fn.blocks)
+        {
+            blockFrom.push_back(p);
+            for (ValueId v : block.insts)
+            {
+                position[v] = p;
+                p += 2;
+                for (ValueId a : fn.insts[v].args)
+                    uses[a]++;
+            }
+            blockTo.push_back(p - 2);
+        }
+        hint.assign(n, -1);
+        for (const SsaInst& in : fn.insts)
+        {
+            if (in.op != S_CALL)
+                continue;
+            int ints = 0, floats = 0;
+            for (ValueId a : in.args)
+            {
+                int r = fn.insts[a].type == V_FLOAT ? (floats < FLOAT_ARG_REGS ? XMM0 + floats++ : -1) : (ints < 6 ? intArgRegs[ints++] : -1);
+                if (hint[a] < 0)
+                    hint[a] = r;
+            }
+        }
+        for (const SsaBlock& block : fn.blocks)
+        {
+            const SsaInst& term = fn.insts[block.insts.back()];
+            if (term.op != S_BRANCH || block.insts.size() < 2)
+                continue;
+            ValueId c = term.args[0];
+            const SsaInst& cmp = fn.insts[c];
+            if (c == block.insts[block.insts.size() - 2] && uses[c] == 1 && IsCompare(cmp.op) && fn.insts[cmp.args[0]].type == V_INT)
+                fused[c] = 1;
+        }
+    }
+
+    // index of the phi operands that come from pred
+    int predIndex(int block, int pred) const
+    {
+        const vector<int>& preds = fn.blocks[block].preds;
+        return (int)(find(preds.begin(), preds.end(), pred) - preds.begin());
+    }
+
+    void computeIntervals()
+    {
+        size_t n = fn.insts.size(), words = (n + 63) / 64;
+        size_t blocks = fn.blocks.size();
+        vector<vector<uint64_t>> liveIn(blocks, vector<uint64_t>(words)), liveOut(liveIn);
+        auto set = [](vector<uint64_t>& s, ValueId v) { s[v >> 6] |= 1ull << (v & 63); };
+        auto clear = [](vector<uint64_t>& s, ValueId v) { s[v >> 6] &= ~(1ull << (v & 63)); };
+
+        // backwards dataflow; a phi operand is live out of its predecessor only
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (size_t b = blocks; b-- > 0;)
+            {
+                const SsaBlock& block = fn.blocks[b];
+                vector<uint64_t> live(words);
+                for (int s : block.succs)
+                {
+                    for (size_t w = 0; w < words; w++)
+                        live[w] |= liveIn[s][w];
+                    int k = predIndex(s, (int)b);
+                    for (ValueId v : fn.blocks[s].insts)
+                        if (fn.insts[v].op == S_PHI && allocated(fn.insts[v].args[k]))
+                            set(live, fn.insts[v].args[k]);
+                }
+                liveOut[b] = live;
+                for (size_t i = block.insts.size(); i-- > 0;)
+                {
+                    ValueId v = block.insts[i];
+                    clear(live, v);
+                    if (fn.insts[v].op != S_PHI)
+                        for (ValueId a : fn.insts[v].args)
+                            if (allocated(a))
+                                set(live, a);
+                }
+                if (live != liveIn[b])
+                {
+                    liveIn[b] = live;
+                    changed = true;
+                }
+            }
+        }
+
+        start.assign(n, INT_MAX);
+        end.assign(n, -1);
+        auto extend = [&](ValueId v, int p) {
+            start[v] = min(start[v], p);
+            end[v] = max(end[v], p);
+        };
+        auto extendAll = [&](const vector<uint64_t>& s, int p) {
+            for (size_t w = 0; w < words; w++)
+                for (uint64_t bits = s[w]; bits; bits &= bits - 1)
+                    extend((ValueId)(w * 64 + FirstSetBit(bits)), p);
+        };
+        for (size_t b = 0; b < blocks; b++)
+        {
+            extendAll(liveIn[b], blockFrom[b]);
+            extendAll(liveOut[b], blockTo[b]);
+            for (ValueId v : fn.blocks[b].insts)
+            {
+                const SsaInst& in = fn.insts[v];
+                if (in.op == S_PHI || in.op == S_PARAM)
+                {
+                    // written together, on the edge or at the entry: they must not share
+                    int at = in.op == S_PHI ? blockFrom[b] : 0;
+                    if (allocated(v))
+                    {
+                        extend(v, at);
+                        extend(v, at + 1);
+                    }
+                    if (in.op == S_PHI)
+                        for (size_t k = 0; k < in.args.size(); k++)
+                            if (allocated(in.args[k]))
+                                extend(in.args[k], blockTo[fn.blocks[b].preds[k]]);
+                    continue;
+                }
+                if (allocated(v))
+                    extend(v, position[v]);
+                for (ValueId a : in.args)
+                    if (allocated(a))
+                        extend(a, position[v]);
+                if (callsOut(in))
+                    calls.push_back(position[v]);
+            }
+        }
+    }
+
+    bool spansCall(ValueId v) const
+    {
+        auto it = upper_bound(calls.begin(), calls.end(), start[v]);
+        return it != calls.end() && *it < end[v];
+    }
+
+    bool usable(int reg, const Interval& it) const
+    {
+        return IsXmm(reg) == it.xmm && (!it.spansCall || IsCalleeSaved(reg));
+    }
+
+    // Registers worth trying first for v: the argument register of the call
+    // that reads it, then the register of an operand that dies where v is
+    // defined, so the operation can work in place.
+    vector<int> preferred(ValueId v, const vector<int>& regOf) const
+    {
+        vector<int> regs{ hint[v] };
+        const SsaInst& in = fn.insts[v];
+        if (in.op != S_PHI && in.op != S_CALL)
+            for (ValueId a : in.args)
+                if (allocated(a) && end[a] == position[v])
+                    regs.push_back(regOf[a]);
+        return regs;
+    }
+
+    void allocate()
+    {
+        size_t n = fn.insts.size();
+        where.assign(n, Location());
+        slotOf.assign(n, -1);
+        vector<Interval> intervals;
+        for (size_t v = 0; v < n; v++)
+            if (allocated((ValueId)v) && end[v] >= 0)
+                intervals.push_back({ (ValueId)v, start[v], end[v], fn.insts[v].type == V_FLOAT, spansCall((ValueId)v) });
+        sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b) {
+            return a.start != b.start ? a.start < b.start : a.value < b.value;
+        });
+
+        vector<Interval*> active;               // in registers
+        vector<pair<int, int>> activeSlots;     // end, slot
+        vector<int> freeSlots;
+        vector<char> free(REG_COUNT, 0);
+        vector<int> regOf(n, -1);
+        for (AsmReg r : gprOrder)
+            free[r] = 1;
+        for (int r = XMM2; r <= XMM15; r++)
+            free[r] = 1;
+        vector<char> used(REG_COUNT, 0);
+
+        auto spill = [&](Interval* it, bool reuse) {
+            int slot;
+            if (reuse && !freeSlots.empty())
+            {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            else
+                slot = slots++;
+            slotOf[it->value] = slot;
+            activeSlots.push_back({ it->end, slot });
+        };
+
+        for (Interval& it : intervals)
+        {
+            // a register or slot whose interval ends here is free: every
+            // instruction reads its operands before it writes its result
+            for (size_t i = 0; i < active.size();)
+                if (active[i]->end <= it.start)
+                {
+                    free[regOf[active[i]->value]] = 1;
+                    active.erase(active.begin() + i);
+                }
+                else
+                    i++;
+            for (size_t i = 0; i < activeSlots.size();)
+                if (activeSlots[i].first <= it.start)
+                {
+                    freeSlots.push_back(activeSlots[i].second);
+                    activeSlots.erase(activeSlots.begin() + i);
+                }
+                else
+                    i++;
+
+            vector<int> candidates = preferred(it.value, regOf);
+            if (it.xmm)
+                for (int r = XMM2; r <= XMM15; r++)
+                    candidates.push_back(r);
+            else
+                candidates.insert(candidates.end(), std::begin(gprOrder), std::end(gprOrder));
+            int reg = -1;
+            for (int r : candidates)
+                if (r >= 0 && free[r] && usable(r, it))
+                {
+                    reg = r;
+                    break;
+                }
+            if (reg >= 0)
+            {
+                free[reg] = 0;
+                used[reg] = 1;
+                regOf[it.value] = reg;
+                active.push_back(&it);
+                continue;
+            }
+            // no register: the interval that ends last goes to memory
+            Interval* victim = nullptr;
+            for (Interval* a : active)
+                if (usable(regOf[a->value], it) && (!victim || a->end > victim->end))
+                    victim = a;
+            if (victim && victim->end > it.end)
+            {
+                regOf[it.value] = regOf[victim->value];
+                regOf[victim->value] = -1;
+                // the victim has been live since before the free slots were freed
+                spill(victim, false);
+                replace(active.begin(), active.end(), victim, &it);
+            }
+            else
+                spill(&it, true);
+        }
+
+        for (int r = 0; r < REG_COUNT; r++)
+            if (used[r] && IsCalleeSaved(r))
+                saved.push_back(r);
+        for (size_t v = 0; v < n; v++)
+        {
+            if (regOf[v] >= 0)
+                where[v] = Location::Reg(regOf[v]);
+            else if (slotOf[v] >= 0)
+                where[v] = Location::Mem(to_string(-8 * (int)(saved.size() + slotOf[v] + 1)) + "(%rbp)");
+        }
+    }
+
+    // ---- code ----
+
+    void emit(const string& line)
+    {
+        out << "    " << line << "\n";
+    }
+
+    string newLabel()
+    {
+        return ".L" + to_string(index) + "_" + to_string(labels++);
+    }
+
+    string blockLabel(int block) const
+    {
+        return ".L" + to_string(index) + "_b" + to_string(block);
+    }
+
+    string retLabel() const
+    {
+        return ".L" + to_string(index) + "_ret";
+    }
+
+    Location loc(ValueId v) const
+    {
+        SsaOp op = fn.insts[v].op;
+        return op == S_CONST || op == S_UNDEF ? Location::Const(v) : where[v];
+    }
+
+    static string reg(int r)
+    {
+        return regNames[r];
+    }
+
+    int64_t intConstant(ValueId v) const
+    {
+        const SsaInst& in = fn.insts[v];
+        if (in.op == S_UNDEF)
+            return 0;
+        return in.type == V_BOOL ? (int64_t)in.constant.b : in.constant.i;
+    }
+
+    static bool fitsImm32(int64_t k)
+    {
+        return k >= INT32_MIN && k <= INT32_MAX;
+    }
+
+    // a float or string constant, as a label
+    string constantLabel(ValueId v)
+    {
+        const SsaInst& in = fn.insts[v];
+        if (in.type == V_FLOAT)
+            return constants.Float(in.op == S_UNDEF ? 0.0 : in.constant.f);
+        return constants.String(in.op == S_UNDEF ? string() : *in.constant.s);
+    }
+
+    // v as the source operand of an instruction; constants that are not an
+    // immediate or in memory are loaded into scratch
+    string operand(ValueId v, int scratch)
+    {
+        Location l = loc(v);
+        if (l.kind == Location::REG)
+            return reg(l.reg);
+        if (l.kind == Location::MEM)
+            return l.address;
+        ValueType type = fn.insts[v].type;
+        if (type == V_FLOAT)
+            return constantLabel(v) + "(%rip)";
+        if (type != V_STRING && fitsImm32(intConstant(v)))
+            return "$" + to_string(intConstant(v));
+        move(Location::Reg(scratch), l);
+        return reg(scratch);
+    }
+
+    // copies the 64 bits of src to dst; r11 is the scratch of memory to memory
+    void move(const Location& dst, const Location& src)
+    {
+        if (dst == src || dst.kind == Location::NONE)
+            return;
+        if (src.kind == Location::CONST)
+        {
+            moveConstant(dst, src.value);
+            return;
+        }
+        if (dst.kind == Location::REG && src.kind == Location::REG)
+        {
+            const char* op = IsXmm(dst.reg) && IsXmm(src.reg) ? "movapd " : "movq ";
+            emit(op + reg(src.reg) + ", " + reg(dst.reg));
+        }
+        else if (dst.kind == Location::REG)
+            emit((IsXmm(dst.reg) ? "movsd " : "movq ") + src.address + ", " + reg(dst.reg));
+        else if (src.kind == Location::REG)
+            emit((IsXmm(src.reg) ? "movsd " : "movq ") + reg(src.reg) + ", " + dst.address);
+        else
+        {
+            emit("movq " + src.address + ", %r11");
+            emit("movq %r11, " + dst.address);
+        }
+    }
+
+    void moveConstant(const Location& dst, ValueId v)
+    {
+        ValueType type = fn.insts[v].type;
+        if (type == V_FLOAT || type == V_STRING)
+        {
+            string address = constantLabel(v) + "(%rip)";
+            const char* op = type == V_FLOAT ? "movq " : "leaq ";
+            if (dst.kind == Location::REG && IsXmm(dst.reg))
+                emit("movsd " + address + ", " + reg(dst.reg));
+            else if (dst.kind == Location::REG)
+                emit(op + address + ", " + reg(dst.reg));
+            else
+            {
+                emit(op + address + ", %r11");
+                emit("movq %r11, " + dst.address);
+            }
+            return;
+        }
+        int64_t k = intConstant(v);
+        string target = dst.kind == Location::REG ? reg(dst.reg) : dst.address;
+        if (fitsImm32(k))
+            emit("movq $" + to_string(k) + ", " + target);
+        else if (dst.kind == Location::REG)
+            emit("movabsq $" + to_string(k) + ", " + target);
+        else
+        {
+            emit("movabsq $" + to_string(k) + ", %r11");
+            emit("movq %r11, " + target);
+        }
+    }
+
+    // Performs moves as if all at once: a move runs once nothing still has to
+    // read its destination, a cycle is broken through rax, constants go last.
+    void parallelMove(vector<Move> moves)
+    {
+        vector<Move> pending, fromConstants;
+        for (const Move& m : moves)
+        {
+            if (m.dst.kind == Location::NONE || m.dst == m.src)
+                continue;
+            (m.src.kind == Location::CONST ? fromConstants : pending).push_back(m);
+        }
+        while (!pending.empty())
+        {
+            bool progress = false;
+            for (size_t i = 0; i < pending.size();)
+            {
+                bool read = false;
+                for (size_t j = 0; j < pending.size() && !read; j++)
+                    read = j != i && pending[j].src == pending[i].dst;
+                if (read)
+                {
+                    i++;
+                    continue;
+                }
+                move(pending[i].dst, pending[i].src);
+                pending.erase(pending.begin() + i);
+                progress = true;
+            }
+            if (progress || pending.empty())
+                continue;
+            Location blocked = pending[0].dst;
+            move(Location::Reg(RAX), blocked);
+            for (Move& m : pending)
+                if (m.src == blocked)
+                    m.src = Location::Reg(RAX);
+        }
+        for (const Move& m : fromConstants)
+            move(m.dst, m.src);
+    }
+
+    void push(const Location& l)
+    {
+        if (l.kind == Location::REG && IsXmm(l.reg))
+        {
+            emit("subq $8, %rsp");
+            emit("movsd " + reg(l.reg) + ", (%rsp)");
+        }
+        else if (l.kind == Location::REG)
+            emit("pushq " + reg(l.reg));
+        else if (l.kind == Location::MEM)
+            emit("pushq " + l.address);
+        else if (fn.insts[l.value].type == V_FLOAT)
+            emit("pushq " + constantLabel(l.value) + "(%rip)");
+        else
+        {
+            move(Location::Reg(R11), l);
+            emit("pushq %r11");
+        }
+    }
+
+    // A call with the System V convention: int, bool and string arguments in
+    // rdi, rsi, rdx, rcx, r8, r9, floats in xmm0-xmm7, the rest on the stack.
+    void call(const string& target, const vector<ValueId>& args)
+    {
+        vector<Move> moves;
+        vector<ValueId> onStack;
+        int ints = 0, floats = 0;
+        for (ValueId a : args)
+        {
+            if (fn.insts[a].type == V_FLOAT ? floats < FLOAT_ARG_REGS : ints < 6)
+                moves.push_back({ Location::Reg(fn.insts[a].type == V_FLOAT ? XMM0 + floats++ : intArgRegs[ints++]), loc(a) });
+            else
+                onStack.push_back(a);
+        }
+        // the stack stays 16-byte aligned at the call
+        int bytes = 8 * (int)(onStack.size() + onStack.size() % 2);
+        if (onStack.size() % 2)
+            emit("subq $8, %rsp");
+        for (size_t i = onStack.size(); i-- > 0;)
+            push(loc(onStack[i]));
+        parallelMove(moves);
+        emit("call " + target);
+        if (bytes)
+            emit("addq $" + to_string(bytes) + ", %rsp");
+    }
+
+    void emitCode()
+    {
+        string name = Label(module, index);
+        out << "\n    .type " << name << ", @function\n" << name << ":\n";
+        emit("pushq %rbp");
+        emit("movq %rsp, %rbp");
+        for (int r : saved)
+            emit("pushq " + reg(r));
+        int frame = 8 * slots;
+        if ((8 * saved.size() + frame) % 16)
+            frame += 8;
+        if (frame)
+            emit("subq $" + to_string(frame) + ", %rsp");
+        emit("incl cc_depth(%rip)");
+        emit("cmpl $" + to_string(MAX_DEPTH) + ", cc_depth(%rip)");
+        emit("jg cc_stack_overflow");
+        emit("cmpq cc_stack_limit(%rip), %rsp");
+        emit("jb cc_stack_overflow");
+
+        // parameters, from where the caller left them to where they are allocated
+        vector<Move> moves;
+        int ints = 0, floats = 0, onStack = 0;
+        vector<Location> incoming;
+        for (ValueType type : fn.paramTypes)
+        {
+            if (type == V_FLOAT ? floats < FLOAT_ARG_REGS : ints < 6)
+                incoming.push_back(Location::Reg(type == V_FLOAT ? XMM0 + floats++ : intArgRegs[ints++]));
+            else
+                incoming.push_back(Location::Mem(to_string(16 + 8 * onStack++) + "(%rbp)"));
+        }
+        if (!fn.blocks.empty())
+            for (ValueId v : fn.blocks[0].insts)
+                if (fn.insts[v].op == S_PARAM && allocated(v))
+                    moves.push_back({ where[v], incoming[fn.insts[v].index] });
+        parallelMove(moves);
+
+        for (size_t b = 0; b < fn.blocks.size(); b++)
+        {
+            out << blockLabel((int)b) << ":\n";
+            for (ValueId v : fn.blocks[b].insts)
+                emitInst(v, (int)b);
+        }
+
+        out << retLabel() << ":\n";
+        emit("decl cc_depth(%rip)");
+        if (!saved.empty())
+            emit("leaq " + to_string(-8 * (int)saved.size()) + "(%rbp), %rsp");
+        for (size_t i = saved.size(); i-- > 0;)
+            emit("popq " + reg(saved[i]));
+        if (saved.empty())
+            emit("movq %rbp, %rsp");
+        emit("popq %rbp");
+        emit("ret");
+        out << "    .size " << name << ", .-" << name << "\n";
+    }
+
+    // moves into the phis of block for the edge from pred
+    vector<Move> edgeMoves(int pred, int block)
+    {
+        vector<Move> moves;
+        int k = predIndex(block, pred);
+        for (ValueId v : fn.blocks[block].insts)
+            if (fn.insts[v].op == S_PHI)
+                moves.push_back({ where[v], loc(fn.insts[v].args[k]) });
+        return moves;
+    }
+
+    void emitInst(ValueId v, int block)
+    {
+        const SsaInst& in = fn.insts[v];
+        switch (in.op)
+        {
+        case S_CONST:
+        case S_UNDEF:
+        case S_PARAM:
+        case S_PHI:
+            break;
+        case S_GET_GLOBAL:
+            move(where[v], Location::Mem("g" + to_string(in.index) + "(%rip)"));
+            break;
+        case S_SET_GLOBAL:
+            move(Location::Mem("g" + to_string(in.index) + "(%rip)"), loc(in.args[0]));
+            break;
+        case S_ADD:
+        case S_SUB:
+        case S_MUL:
+        case S_DIV:
+        case S_MOD:
+            arithmetic(v);
+            break;
+        case S_EQ:
+        case S_NE:
+        case S_LT:
+        case S_GT:
+        case S_LE:
+        case S_GE:
+            if (!fused[v])
+                compare(v);
+            break;
+        case S_NEG:
+            negate(v);
+            break;
+        case S_NOT:
+        {
+            int t = where[v].kind == Location::REG ? where[v].reg : RAX;
+            move(Location::Reg(t), loc(in.args[0]));
+            emit("xorq $1, " + reg(t));
+            move(where[v], Location::Reg(t));
+            break;
+        }
+        case S_CONVERT:
+            convert(v);
+            break;
+        case S_CALL:
+            call(Label(module, in.index), in.args);
+            if (in.type != V_VOID)
+                move(where[v], Location::Reg(in.type == V_FLOAT ? XMM0 : RAX));
+            break;
+        case S_JUMP:
+        {
+            int to = fn.blocks[block].succs[0];
+            parallelMove(edgeMoves(block, to));
+            if (to != block + 1)
+                emit("jmp " + blockLabel(to));
+            break;
+        }
+        case S_BRANCH:
+            branch(v, block);
+            break;
+        case S_RETURN:
+            if (!in.args.empty())
+                move(Location::Reg(fn.retType == V_FLOAT ? XMM0 : RAX), loc(in.args[0]));
+            if (block + 1 != (int)fn.blocks.size())
+                emit("jmp " + retLabel());
+            break;
+        default:
+            throw runtime_error("[CompileError] " + SsaOpName(in.op) + " not supported by the assembly backend");
+        }
+    }
+
+    void arithmetic(ValueId v)
+    {
+        const SsaInst& in = fn.insts[v];
+        ValueId a = in.args[0], b = in.args[1];
+        const Location& d = where[v];
+        if (in.type == V_STRING)
+        {
+            call("cc_concat", { a, b });
+            move(d, Location::Reg(RAX));
+            return;
+        }
+        if (in.type == V_FLOAT)
+        {
+            if (in.op == S_MOD)
+            {
+                call("fmod@PLT", { a, b });
+                move(d, Location::Reg(XMM0));
+                return;
+            }
+            static const char* const ops[] = { "addsd ", "subsd ", "mulsd ", "divsd " };
+            if ((in.op == S_ADD || in.op == S_MUL) && loc(b) == d)
+                swap(a, b);
+            int t = d.kind == Location::REG && loc(b) != d ? d.reg : XMM0;
+            move(Location::Reg(t), loc(a));
+            emit(ops[in.op - S_ADD] + operand(b, XMM1) + ", " + reg(t));
+            move(d, Location::Reg(t));
+            return;
+        }
+        if (in.op == S_DIV || in.op == S_MOD)
+        {
+            divide(v);
+            return;
+        }
+        static const char* const ops[] = { "addq ", "subq ", "imulq " };
+        if (in.op != S_SUB && loc(b) == d)
+            swap(a, b);
+        int t = d.kind == Location::REG && loc(b) != d ? d.reg : RAX;
+        move(Location::Reg(t), loc(a));
+        emit(ops[in.op - S_ADD] + operand(b, RCX) + ", " + reg(t));
+        move(d, Location::Reg(t));
+    }
+
+    // Division by zero is an error; x / -1 and x % -1 are -x and 0, since
+    // idiv traps on INT64_MIN / -1. A power of two divides by shifting,
+    // rounding towards zero as idiv does.
+    void divide(ValueId v)
+    {
+        const SsaInst& in = fn.insts[v];
+        ValueId a = in.args[0], b = in.args[1];
+        bool known = loc(b).kind == Location::CONST;
+        int64_t k = known ? intConstant(b) : 0;
+        if (k >= 2 && k <= (1 << 30) && (k & (k - 1)) == 0)
+        {
+            int shift = FirstSetBit((uint64_t)k);
+            move(Location::Reg(RAX), loc(a));
+            emit("movq %rax, %rdx");
+            emit("sarq $63, %rdx");
+            emit("shrq $" + to_string(64 - shift) + ", %rdx");
+            if (in.op == S_DIV)
+            {
+                emit("addq %rdx, %rax");
+                emit("sarq $" + to_string(shift) + ", %rax");
+            }
+            else
+            {
+                emit("leaq (%rax,%rdx), %rcx");
+                emit("andq $" + to_string(-k) + ", %rcx");
+                emit("subq %rcx, %rax");
+            }
+            move(where[v], Location::Reg(RAX));
+            return;
+        }
+        string minusOne = newLabel(), done = newLabel();
+        if (!known || k != -1)
+        {
+            move(Location::Reg(RCX), loc(b));
+            if (!known || k == 0)
+            {
+                emit("testq %rcx, %rcx");
+                emit("jz cc_division_by_zero");
+            }
+        }
+        move(Location::Reg(RAX), loc(a));
+        if (!known)
+        {
+            emit("cmpq $-1, %rcx");
+            emit("je " + minusOne);
+        }
+        if (!known || k != -1)
+        {
+            emit("cqto");
+            emit("idivq %rcx");
+            if (in.op == S_MOD)
+                emit("movq %rdx, %rax");
+        }
+        if (!known)
+        {
+            emit("jmp " + done);
+            out << minusOne << ":\n";
+        }
+        if (!known || k == -1)
+            emit(in.op == S_DIV ? "negq %rax" : "xorl %eax, %eax");
+        if (!known)
+            out << done << ":\n";
+        move(where[v], Location::Reg(RAX));
+    }
+
+    // sets the flags for an int comparison of a with b
+    void compareInts(ValueId a, ValueId b)
+    {
+        Location la = loc(a);
+        string left;
+        if (la.kind == Location::REG)
+            left = reg(la.reg);
+        else
+        {
+            move(Location::Reg(RAX), la);
+            left = "%rax";
+        }
+        emit("cmpq " + operand(b, RCX) + ", " + left);
+    }
+
+    void compare(ValueId v)
+    {
+        const SsaInst& in = fn.insts[v];
+        ValueId a = in.args[0], b = in.args[1];
+        ValueType type = fn.insts[a].type;
+        if (type == V_STRING)
+        {
+            call("cc_compare", { a, b });
+            emit("testq %rax, %rax");
+            emit(string("set") + ConditionOf(in.op) + " %al");
+        }
+        else if (type == V_FLOAT)
+        {
+            // unordered (NaN) compares false, except !=; a < b is b > a
+            bool swap = in.op == S_LT || in.op == S_LE;
+            move(Location::Reg(XMM0), loc(swap ? b : a));
+            emit("ucomisd " + operand(swap ? a : b, XMM1) + ", %xmm0");
+            switch (in.op)
+            {
+            case S_EQ:
+                emit("sete %al");
+                emit("setnp %cl");
+                emit("andb %cl, %al");
+                break;
+            case S_NE:
+                emit("setne %al");
+                emit("setp %cl");
+                emit("orb %cl, %al");
+                break;
+            case S_LT: case S_GT:
+                emit("seta %al");
+                break;
+            default:
+                emit("setae %al");
+                break;
+            }
+        }
+        else
+        {
+            compareInts(a, b);
+            emit(string("set") + ConditionOf(in.op) + " %al");
+        }
+        emit("movzbl %al, %eax");
+        move(where[v], Location::Reg(RAX));
+    }
+
+    void negate(ValueId v)
+    {
+        const SsaInst& in = fn.insts[v];
+        const Location& d = where[v];
+        if (in.type == V_FLOAT)
+        {
+            int t = d.kind == Location::REG ? d.reg : XMM0;
+            move(Location::Reg(t), loc(in.args[0]));
+            emit("xorpd cc_sign_mask(%rip), " + reg(t));
+            move(d, Location::Reg(t));
+            return;
+        }
+        int t = d.kind == Location::REG ? d.reg : RAX;
+        move(Location::Reg(t), loc(in.args[0]));
+        emit("negq " + reg(t));
+        move(d, Location::Reg(t));
+    }
+
+    void convert(ValueId v)
+    {
+        const SsaInst& in = fn.insts[v];
+        ValueId a = in.args[0];
+        ValueType from = fn.insts[a].type;
+        const Location& d = where[v];
+        if (in.type == V_FLOAT)
+        {
+            int t = d.kind == Location::REG ? d.reg : XMM0;
+            Location la = loc(a);
+            if (la.kind == Location::CONST)
+            {
+                move(Location::Reg(RAX), la);
+                la = Location::Reg(RAX);
+            }
+            emit("pxor " + reg(t) + ", " + reg(t));
+            emit("cvtsi2sdq " + (la.kind == Location::REG ? reg(la.reg) : la.address) + ", " + reg(t));
+            move(d, Location::Reg(t));
+            return;
+        }
+        if (from == V_FLOAT)
+        {
+            move(Location::Reg(XMM0), loc(a));
+            if (in.type == V_INT)
+            {
+                emit("ucomisd " + constants.Float(-9.2e18) + "(%rip), %xmm0");
+                emit("jbe cc_float_out_of_range");
+                emit("ucomisd " + constants.Float(9.2e18) + "(%rip), %xmm0");
+                emit("jae cc_float_out_of_range");
+                emit("cvttsd2siq %xmm0, %rax");
+            }
+            else
+            {
+                emit("xorpd %xmm1, %xmm1");
+                emit("ucomisd %xmm1, %xmm0");
+                emit("setne %al");
+                emit("setp %cl");
+                emit("orb %cl, %al");
+                emit("movzbl %al, %eax");
+            }
+            move(d, Location::Reg(RAX));
+            return;
+        }
+        if (in.type == V_INT)
+        {
+            move(d, loc(a));    // a bool is already 0 or 1
+            return;
+        }
+        Location la = loc(a);
+        if (la.kind == Location::CONST)
+        {
+            move(Location::Reg(RAX), la);
+            la = Location::Reg(RAX);
+        }
+        emit("cmpq $0, " + (la.kind == Location::REG ? reg(la.reg) : la.address));
+        emit("setne %al");
+        emit("movzbl %al, %eax");
+        move(d, Location::Reg(RAX));
+    }
+
+    void branch(ValueId v, int block)
+    {
+        const SsaInst& in = fn.insts[v];
+        int ifTrue = fn.blocks[block].succs[0], ifFalse = fn.blocks[block].succs[1];
+        vector<Move> trueMoves = edgeMoves(block, ifTrue), falseMoves = edgeMoves(block, ifFalse);
+        ValueId c = in.args[0];
+        string cc;
+        if (fused[c])
+        {
+            compareInts(fn.insts[c].args[0], fn.insts[c].args[1]);
+            cc = ConditionOf(fn.insts[c].op);
+        }
+        else
+        {
+            Location l = loc(c);
+            if (l.kind == Location::REG)
+                emit("testq " + reg(l.reg) + ", " + reg(l.reg));
+            else if (l.kind == Location::MEM)
+                emit("cmpq $0, " + l.address);
+            else
+            {
+                move(Location::Reg(RAX), l);
+                emit("testq %rax, %rax");
+            }
+            cc = "ne";
+        }
+
+        if (trueMoves.empty() && falseMoves.empty() && ifTrue == block + 1)
+        {
+            emit(string("j") + Inverse(cc) + " " + blockLabel(ifFalse));
+            return;
+        }
+        // an edge with moves gets code of its own, as the edge is critical
+        string trueEdge = trueMoves.empty() ? blockLabel(ifTrue) : newLabel();
+        emit("j" + cc + " " + trueEdge);
+        parallelMove(falseMoves);
+        if (ifFalse != block + 1 || !trueMoves.empty())
+            emit("jmp " + blockLabel(ifFalse));
+        if (!trueMoves.empty())
+        {
+            out << trueEdge << ":\n";
+            parallelMove(trueMoves);
+            if (ifTrue != block + 1)
+                emit("jmp " + blockLabel(ifTrue));
+        }
+    }
+};
+
+// Support code every program links with.
+static const char* const runtime = R"(
+    .text
+# never returns: prints the message in rdi as the driver prints a RuntimeError
+cc_fail:
+    andq $-16, %rsp
+    movq %rdi, %rdx
+    leaq .Lfail_format(%rip), %rsi
+    movl $2, %edi
+    xorl %eax, %eax
+    call dprintf@PLT
+    xorl %edi, %edi
+    call exit@PLT
+cc_division_by_zero:
+    leaq .Ldivision_by_zero(%rip), %rdi
+    jmp cc_fail
+cc_float_out_of_range:
+    leaq .Lfloat_out_of_range(%rip), %rdi
+    jmp cc_fail
+cc_stack_overflow:
+    leaq .Lstack_overflow(%rip), %rdi
+    jmp cc_fail
+cc_out_of_memory:
+    leaq .Lout_of_memory(%rip), %rdi
+    jmp cc_fail
+
+# rdi + rsi, a new string
+cc_concat:
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    movq %rdi, %rbx
+    movq %rsi, %r12
+    movq (%rdi), %rdi
+    addq (%rsi), %rdi
+    addq $8, %rdi
+    call malloc@PLT
+    testq %rax, %rax
+    jz cc_out_of_memory
+    movq %rax, %r13
+    movq (%rbx), %rcx
+    addq (%r12), %rcx
+    movq %rcx, (%rax)
+    leaq 8(%rax), %rdi
+    leaq 8(%rbx), %rsi
+    movq (%rbx), %rdx
+    call memcpy@PLT
+    leaq 8(%r13), %rdi
+    addq (%rbx), %rdi
+    leaq 8(%r12), %rsi
+    movq (%r12), %rdx
+    call memcpy@PLT
+    movq %r13, %rax
+    popq %r13
+    popq %r12
+    popq %rbx
+    ret
+
+# rdi compared with rsi as std::string::compare: negative, zero or positive
+cc_compare:
+    pushq %rbx
+    pushq %r12
+    pushq %r13
+    movq %rdi, %rbx
+    movq %rsi, %r12
+    movq (%rdi), %rdx
+    cmpq (%rsi), %rdx
+    cmovaq (%rsi), %rdx
+    addq $8, %rdi
+    addq $8, %rsi
+    call memcmp@PLT
+    movslq %eax, %rax
+    testq %rax, %rax
+    jnz 1f
+    movq (%rbx), %rax
+    subq (%r12), %rax
+1:
+    popq %r13
+    popq %r12
+    popq %rbx
+    ret
+
+    .section .rodata
+.Lfail_format:
+    .string "Exception: [RuntimeError] %s\n"
+.Ldivision_by_zero:
+    .string "division by zero"
+.Lfloat_out_of_range:
+    .string "float value out of range for int"
+.Lstack_overflow:
+    .string "stack overflow"
+.Lout_of_memory:
+    .string "out of memory"
+.Lno_main:
+    .string "no function named main"
+.Lmain_arity:
+    .string "wrong number of arguments to main"
+.Lreturned_int:
+    .string "main returned %ld\n"
+.Lreturned_float:
+    .string "main returned %g\n"
+.Lreturned_string:
+    .string "main returned %.*s\n"
+.Lreturned_text:
+    .string "main returned %s\n"
+.Lreturned_void:
+    .string "main returned void\n"
+.Ltrue:
+    .string "true"
+.Lfalse:
+    .string "false"
+    .align 16
+cc_sign_mask:
+    .quad 0x8000000000000000, 0
+
+    .bss
+    .align 8
+cc_stack_limit:
+    .zero 8
+cc_depth:
+    .zero 4
+)";
+
+// The C entry point: globals, the program's main, then its result.
+static void EmitMain(const SsaModule& module, ostream& out)
+{
+    out << "\n    .text\n    .globl main\n    .type main, @function\nmain:\n";
+    out << "    pushq %rbp\n    movq %rsp, %rbp\n    subq $16, %rsp\n";
+    out << "    leaq -" << STACK_BUDGET << "(%rsp), %rax\n    movq %rax, cc_stack_limit(%rip)\n";
+    out << "    call cc_init\n";
+    int f = -1;
+    for (size_t i = 0; i < module.functions.size(); i++)
+        if ((int)i != module.globalInit && string(SymbolName(module.functions[i].name)) == "main")
+            f = (int)i;
+    if (f < 0 || !module.functions[f].paramTypes.empty())
+    {
+        out << "    leaq " << (f < 0 ? ".Lno_main" : ".Lmain_arity") << "(%rip), %rdi\n    jmp cc_fail\n";
+        out << "    .size main, .-main\n";
+        return;
+    }
+    out << "    call f_main\n";
+    switch (module.functions[f].retType)
+    {
+    case V_INT:
+        out << "    movq %rax, -8(%rbp)\n    movq %rax, %rsi\n    leaq .Lreturned_int(%rip), %rdi\n    xorl %eax, %eax\n"
+            << "    call printf@PLT\n    movl -8(%rbp), %eax\n    leave\n    ret\n";
+        break;
+    case V_FLOAT:
+        out << "    leaq .Lreturned_float(%rip), %rdi\n    movl $1, %eax\n    call printf@PLT\n    xorl %eax, %eax\n    leave\n    ret\n";
+        break;
+    case V_BOOL:
+        out << "    leaq .Ltrue(%rip), %rsi\n    leaq .Lfalse(%rip), %rcx\n    testq %rax, %rax\n    cmoveq %rcx, %rsi\n"
+            << "    leaq .Lreturned_text(%rip), %rdi\n    xorl %eax, %eax\n    call printf@PLT\n    xorl %eax, %eax\n    leave\n    ret\n";
+        break;
+    case V_STRING:
+        out << "    movq (%rax), %rsi\n    leaq 8(%rax), %rdx\n    leaq .Lreturned_string(%rip), %rdi\n    xorl %eax, %eax\n"
+            << "    call printf@PLT\n    xorl %eax, %eax\n    leave\n    ret\n";
+        break;
+    default:
+        out << "    leaq .Lreturned_void(%rip), %rdi\n    xorl %eax, %eax\n    call printf@PLT\n    xorl %eax, %eax\n    leave\n    ret\n";
+        break;
+    }
+    out << "    .size main, .-main\n";
+}
+
+string X64Asm::Emit(const SsaModule& module)
+{
+    ostringstream out;
+    AsmConstants constants;
+    out << "# generated from the source program; assemble and link with: gcc out.s -lm\n";
+    out << runtime;
+
+    out << "\n    .data\n    .align 8\n";
+    for (size_t g = 0; g < module.globalTypes.size(); g++)
+    {
+        out << "g" << g << ":    # " << SymbolName(module.globalNames[g]) << "\n";
+        out << "    .quad " << (module.globalTypes[g] == V_STRING ? constants.String("") : "0") << "\n";
+    }
+
+    out << "\n    .text\n";
+    for (size_t f = 0; f < module.functions.size(); f++)
+        AsmFunction(module, (int)f, constants, out).Emit();
+    EmitMain(module, out);
+    constants.Emit(out);
+    out << "\n    .section .note.GNU-stack,\"\",@progbits\n";
+    return out.str();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include "SsaIR.h"
+using namespace std;
+
+// Ahead-of-time backend from the SSA IR to x86-64 GNU assembly (AT&T syntax,
+// System V ABI), assembled and linked against the C library by gcc:
+//     Source --emit-asm file.txt > out.s && gcc out.s -o out -lm
+//
+// Each SsaFunction becomes one native function. Its registers are allocated
+// by linear scan (Poletto and Sarkar, "Linear Scan Register Allocation"):
+// - Block liveness gives every value one live interval over the instructions
+//   in block order.
+// - Intervals are handed registers in order of their start, and a register
+//   comes back when its interval ends. When none is free, the interval that
+//   ends last goes to a stack slot.
+// - An interval that spans a call only gets a callee-saved register (rbx,
+//   r12-r15), or a stack slot. Floats span calls on the stack, since the ABI
+//   has no callee-saved xmm registers.
+// - Constants are never allocated. They are immediates, or .rodata for floats
+//   and strings.
+// Phis become parallel moves on their incoming edges, with critical edges
+// split. A compare of ints that only feeds the branch after it becomes a cmp
+// and a conditional jump.
+//
+// Run-time behaviour follows the VMs:
+// - int arithmetic wraps; / and % check for zero and for -1;
+// - float to int conversion is range checked;
+// - more than 1 << 16 nested calls is a stack overflow.
+// Errors print "Exception: [RuntimeError] ..." to stderr and exit with 0.
+// Strings are a pointer to a 64-bit length followed by the bytes. Strings made
+// by + are never freed. The generated main runs the global initializers and
+// the program's main, then prints "main returned ..." as --run does.
+class X64Asm
+{
+public:
+    static string Emit(const SsaModule& module);
+};
@@ -0,0 +1,622 @@
+#include "X64Jit.h"
+#include <cstring>
+#include <cstddef>
+#include <map>
+
+#ifdef X64_JIT_AVAILABLE
+#include <sys/mman.h>
+#include <unistd.h>
+
+static_assert(sizeof(Value) == 16, "the JIT templates assume a 16-byte Value");
+
+// Value fields as the templates address them: the tag is the first byte (the
+// templates write it as a whole word), the payload is the second word.
+static const int32_t TAG = 0;
+static const int32_t PAYLOAD = 8;
+
+enum X64Reg { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12 };
+enum X64Cond { CC_B = 2, CC_AE = 3, CC_E = 4, CC_NE = 5, CC_BE = 6, CC_A = 7, CC_P = 0xA, CC_NP = 0xB, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+// Just enough of the x86-64 encoding for the templates. Memory operands are
+// always [base + disp32]; xmm operands are xmm0 and xmm1.
+class X64Emitter
+{
+public:
+    vector<uint8_t> bytes;
+
+    size_t Size() const { return bytes.size(); }
+    void Byte(uint8_t b) { bytes.push_back(b); }
+    void U32(uint32_t v)
+    {
+        for (int i = 0; i < 4; i++)
+            Byte((uint8_t)(v >> (8 * i)));
+    }
+    void U64(uint64_t v)
+    {
+        for (int i = 0; i < 8; i++)
+            Byte((uint8_t)(v >> (8 * i)));
+    }
+
+    void Rex(bool w, int reg, int base)
+    {
+        uint8_t rex = (uint8_t)(0x40 | (w ? 8 : 0) | ((reg >> 3) << 2) | (base >> 3));
+        if (rex != 0x40)
+            Byte(rex);
+    }
+    void Mem(int reg, int base, int32_t disp)
+    {
+        Byte((uint8_t)(0x80 | (reg & 7) << 3 | (base & 7)));
+        if ((base & 7) == RSP)      // rsp and r12 need a SIB byte
+            Byte(0x24);
+        U32((uint32_t)disp);
+    }
+    void RegReg(int reg, int rm)
+    {
+        Byte((uint8_t)(0xC0 | (reg & 7) << 3 | (rm & 7)));
+    }
+
+    void Load(int dst, int base, int32_t disp) { Rex(true, dst, base); Byte(0x8B); Mem(dst, base, disp); }
+    void Store(int base, int32_t disp, int src) { Rex(true, src, base); Byte(0x89); Mem(src, base, disp); }
+    void LoadByte(int dst, int base, int32_t disp) { Rex(false, dst, base); Byte(0x0F); Byte(0xB6); Mem(dst, base, disp); }
+    void StoreImm(int base, int32_t disp, int32_t v) { Rex(true, 0, base); Byte(0xC7); Mem(0, base, disp); U32((uint32_t)v); }
+    void AddMemImm(int base, int32_t disp, int32_t v) { Rex(true, 0, base); Byte(0x81); Mem(0, base, disp); U32((uint32_t)v); }
+    void Lea(int dst, int base, int32_t disp) { Rex(true, dst, base); Byte(0x8D); Mem(dst, base, disp); }
+    void MovImm64(int dst, uint64_t v) { Rex(true, 0, dst); Byte((uint8_t)(0xB8 + (dst & 7))); U64(v); }
+    void MovImm32(int dst, uint32_t v) { Rex(false, 0, dst); Byte((uint8_t)(0xB8 + (dst & 7))); U32(v); }
+
+    // op r/m64, r64 (0x01 add, 0x29 sub, 0x39 cmp, 0x85 test, 0x89 mov)
+    void Alu(uint8_t op, int dst, int src) { Rex(true, src, dst); Byte(op); RegReg(src, dst); }
+    void Imul(int dst, int src) { Rex(true, dst, src); Byte(0x0F); Byte(0xAF); RegReg(dst, src); }
+    void Neg(int r) { Rex(true, 0, r); Byte(0xF7); RegReg(3, r); }
+    void Cqo() { Byte(0x48); Byte(0x99); }
+    void Idiv(int r) { Rex(true, 0, r); Byte(0xF7); RegReg(7, r); }
+    void CmpImm8(int r, int8_t v, bool wide) { Rex(wide, 0, r); Byte(0x83); RegReg(7, r); Byte((uint8_t)v); }
+    void BtcImm(int r, uint8_t bit) { Rex(true, 0, r); Byte(0x0F); Byte(0xBA); RegReg(7, r); Byte(bit); }
+
+    // al, cl, dl, bl only
+    void Setcc(X64Cond c, int r8) { Byte(0x0F); Byte((uint8_t)(0x90 | c)); RegReg(0, r8); }
+    void MovzxByte(int dst, int src8) { Byte(0x0F); Byte(0xB6); RegReg(dst, src8); }
+    void And8(int dst, int src) { Byte(0x20); RegReg(src, dst); }
+    void Or8(int dst, int src) { Byte(0x08); RegReg(src, dst); }
+
+    void MovqToXmm(int x, int r) { Byte(0x66); Rex(true, x, r); Byte(0x0F); Byte(0x6E); RegReg(x, r); }
+    void MovqFromXmm(int r, int x) { Byte(0x66); Rex(true, x, r); Byte(0x0F); Byte(0x7E); RegReg(x, r); }
+    void Cvtsi2sd(int x, int r) { Byte(0xF2); Rex(true, x, r); Byte(0x0F); Byte(0x2A); RegReg(x, r); }
+    // 0x58 add, 0x5C sub, 0x59 mul, 0x5E div
+    void ScalarDouble(uint8_t op, int dst, int src) { Byte(0xF2); Byte(0x0F); Byte(op); RegReg(dst, src); }
+    void Ucomisd(int a, int b) { Byte(0x66); Byte(0x0F); Byte(0x2E); RegReg(a, b); }
+
+    void Push(int r) { Rex(false, 0, r); Byte((uint8_t)(0x50 + (r & 7))); }
+    void Pop(int r) { Rex(false, 0, r); Byte((uint8_t)(0x58 + (r & 7))); }
+    void Ret() { Byte(0xC3); }
+    void JmpReg(int r) { Rex(false, 0, r); Byte(0xFF); RegReg(4, r); }
+    void CallMem(int base, int32_t disp) { Rex(false, 0, base); Byte(0xFF); Mem(2, base, disp); }
+
+    // jumps return the position of their rel32, for Patch
+    size_t Jmp() { Byte(0xE9); U32(0); return Size() - 4; }
+    size_t Jcc(X64Cond c) { Byte(0x0F); Byte((uint8_t)(0x80 | c)); U32(0); return Size() - 4; }
+    void Patch(size_t at, size_t target)
+    {
+        int32_t rel = (int32_t)((int64_t)target - (int64_t)(at + 4));
+        memcpy(&bytes[at], &rel, 4);
+    }
+};
+
+// Translates one RegisterFunction. rbx holds the frame base and r12 the
+// JitContext for the whole function; rax, rcx, rdx, rsi, rdi, r8, xmm0 and xmm1
+// are scratch inside a template.
+class X64Translator
+{
+    const RegisterModule& module;
+    const RegisterFunction& fn;
+    X64Emitter e;
+    vector<uint32_t> offsets;
+    vector<pair<size_t, int>> jumps;            // rel32 position, target instruction
+    map<int, vector<size_t>> bailouts;          // instruction, rel32 positions jumping to its stub
+    vector<size_t> exits;                       // rel32 positions jumping to the epilogue
+    size_t index = 0;                           // instruction being translated
+
+    static int32_t Reg(int r) { return r * 16; }
+
+    size_t Bail(X64Cond c)
+    {
+        size_t at = e.Jcc(c);
+        bailouts[(int)index].push_back(at);
+        return at;
+    }
+    void BailAlways()
+    {
+        bailouts[(int)index].push_back(e.Jmp());
+    }
+    void JumpTo(X64Cond c, int target)
+    {
+        jumps.push_back({ e.Jcc(c), target });
+    }
+    void JumpTo(int target)
+    {
+        jumps.push_back({ e.Jmp(), target });
+    }
+
+    static uint64_t Payload(const Value& v)
+    {
+        uint64_t bits;
+        memcpy(&bits, (const char*)&v + PAYLOAD, 8);
+        return bits;
+    }
+
+    // tag of rk into tag (zero-extended), its payload into val
+    void LoadOperand(int rk, int tag, int val)
+    {
+        if (rk >= 0)
+        {
+            e.LoadByte(tag, RBX, Reg(rk) + TAG);
+            e.Load(val, RBX, Reg(rk) + PAYLOAD);
+        }
+        else
+        {
+            const Value& k = module.constants[~rk];
+            e.MovImm32(tag, k.type);
+            e.MovImm64(val, Payload(k));
+        }
+    }
+    void StoreValue(int r, int tag, int val)
+    {
+        e.Store(RBX, Reg(r) + TAG, tag);
+        e.Store(RBX, Reg(r) + PAYLOAD, val);
+    }
+    void StoreTyped(int r, ValueType type, int val)
+    {
+        e.StoreImm(RBX, Reg(r) + TAG, type);
+        e.Store(RBX, Reg(r) + PAYLOAD, val);
+    }
+
+    // x (tag eax, payload rcx) and y (tag edx, payload r8) as doubles in xmm0
+    // and xmm1; bails out unless both are int or float
+    void ToDoubles()
+    {
+        for (int side = 0; side < 2; side++)
+        {
+            int tag = side == 0 ? RAX : RDX;
+            int val = side == 0 ? RCX : R8;
+            e.CmpImm8(tag, V_FLOAT, false);
+            size_t notFloat = e.Jcc(CC_NE);
+            e.MovqToXmm(side, val);
+            size_t done = e.Jmp();
+            e.Patch(notFloat, e.Size());
+            e.CmpImm8(tag, V_INT, false);
+            Bail(CC_NE);
+            e.Cvtsi2sd(side, val);
+            e.Patch(done, e.Size());
+        }
+    }
+
+    // both operands loaded; the two jumps taken unless both are int
+    pair<size_t, size_t> UnlessBothInt()
+    {
+        e.CmpImm8(RAX, V_INT, false);
+        size_t x = e.Jcc(CC_NE);
+        e.CmpImm8(RDX, V_INT, false);
+        return { x, e.Jcc(CC_NE) };
+    }
+    void PatchBoth(pair<size_t, size_t> jumps, size_t target)
+    {
+        e.Patch(jumps.first, target);
+        e.Patch(jumps.second, target);
+    }
+
+    void Arith(const RegInstr& in)
+    {
+        LoadOperand(in.b, RAX, RCX);
+        LoadOperand(in.c, RDX, R8);
+        auto notInt = UnlessBothInt();
+        switch (in.op)
+        {
+        case R_ADD: e.Alu(0x01, RCX, R8); break;
+        case R_SUB: e.Alu(0x29, RCX, R8); break;
+        case R_MUL: e.Imul(RCX, R8); break;
+        default:
+            // division by zero and INT64_MIN / -1 are left to the interpreter
+            e.Alu(0x85, R8, R8);
+            Bail(CC_E);
+            e.CmpImm8(R8, -1, true);
+            Bail(CC_E);
+            e.Alu(0x89, RAX, RCX);
+            e.Cqo();
+            e.Idiv(R8);
+            e.Alu(0x89, RCX, in.op == R_DIV ? RAX : RDX);
+            break;
+        }
+        StoreTyped(in.a, V_INT, RCX);
+        size_t done = e.Jmp();
+
+        PatchBoth(notInt, e.Size());
+        if (in.op == R_MOD)
+            BailAlways();      // fmod stays in the interpreter
+        else
+        {
+            ToDoubles();
+            e.ScalarDouble(in.op == R_ADD ? 0x58 : in.op == R_SUB ? 0x5C : in.op == R_MUL ? 0x59 : 0x5E, 0, 1);
+            e.MovqFromXmm(RCX, 0);
+            StoreTyped(in.a, V_FLOAT, RCX);
+        }
+        e.Patch(done, e.Size());
+    }
+
+    static X64Cond IntCond(RegOpCode op)
+    {
+        switch (op)
+        {
+        case R_EQ: case R_JUMP_IF_EQ: case R_JUMP_IF_NOT_NE: return CC_E;
+        case R_NE: case R_JUMP_IF_NE: case R_JUMP_IF_NOT_EQ: return CC_NE;
+        case R_LT: case R_JUMP_IF_LT: case R_JUMP_IF_NOT_GE: return CC_L;
+        case R_GT: case R_JUMP_IF_GT: case R_JUMP_IF_NOT_LE: return CC_G;
+        case R_LE: case R_JUMP_IF_LE: case R_JUMP_IF_NOT_GT: return CC_LE;
+        default: return CC_GE;
+        }
+    }
+
+    // comparison of doubles in xmm0 and xmm1 as flags: for < and <= the
+    // operands are swapped so that an unordered (NaN) result reads as false
+    enum Relation { REL_EQ, REL_NE, REL_LT, REL_GT, REL_LE, REL_GE };
+    static Relation RelationOf(RegOpCode op, bool& negate)
+    {
+        negate = op >= R_JUMP_IF_NOT_EQ && op <= R_JUMP_IF_NOT_GE;
+        switch (op)
+        {
+        case R_EQ: case R_JUMP_IF_EQ: case R_JUMP_IF_NOT_EQ: return REL_EQ;
+        case R_NE: case R_JUMP_IF_NE: case R_JUMP_IF_NOT_NE: return REL_NE;
+        case R_LT: case R_JUMP_IF_LT: case R_JUMP_IF_NOT_LT: return REL_LT;
+        case R_GT: case R_JUMP_IF_GT: case R_JUMP_IF_NOT_GT: return REL_GT;
+        case R_LE: case R_JUMP_IF_LE: case R_JUMP_IF_NOT_LE: return REL_LE;
+        default: return REL_GE;
+        }
+    }
+    void CompareDoubles(Relation rel)
+    {
+        if (rel == REL_LT || rel == REL_LE)
+            e.Ucomisd(1, 0);
+        else
+            e.Ucomisd(0, 1);
+    }
+
+    void Compare(const RegInstr& in)
+    {
+        LoadOperand(in.b, RAX, RCX);
+        LoadOperand(in.c, RDX, R8);
+        auto notInt = UnlessBothInt();
+        e.Alu(0x39, RCX, R8);
+        e.Setcc(IntCond(in.op), RAX);
+        size_t done = e.Jmp();
+
+        PatchBoth(notInt, e.Size());
+        ToDoubles();
+        bool negate;
+        Relation rel = RelationOf(in.op, negate);
+        CompareDoubles(rel);
+        switch (rel)
+        {
+        case REL_EQ: e.Setcc(CC_E, RAX); e.Setcc(CC_NP, RCX); e.And8(RAX, RCX); break;
+        case REL_NE: e.Setcc(CC_NE, RAX); e.Setcc(CC_P, RCX); e.Or8(RAX, RCX); break;
+        case REL_LT: case REL_GT: e.Setcc(CC_A, RAX); break;
+        default: e.Setcc(CC_AE, RAX); break;
+        }
+        e.Patch(done, e.Size());
+        e.MovzxByte(RAX, RAX);
+        StoreTyped(in.a, V_BOOL, RAX);
+    }
+
+    void Branch(const RegInstr& in)
+    {
+        LoadOperand(in.b, RAX, RCX);
+        LoadOperand(in.c, RDX, R8);
+        auto notInt = UnlessBothInt();
+        e.Alu(0x39, RCX, R8);
+        JumpTo(IntCond(in.op), in.a);
+        size_t done = e.Jmp();
+
+        PatchBoth(notInt, e.Size());
+        ToDoubles();
+        bool negate;
+        Relation rel = RelationOf(in.op, negate);
+        CompareDoubles(rel);
+        // "equal" needs ZF set and PF clear, an unordered result sets both
+        bool equalTest = (rel == REL_EQ) != negate;
+        if (rel == REL_EQ || rel == REL_NE)
+        {
+            if (equalTest)
+            {
+                size_t unordered = e.Jcc(CC_P);
+                JumpTo(CC_E, in.a);
+                e.Patch(unordered, e.Size());
+            }
+            else
+            {
+                JumpTo(CC_P, in.a);
+                JumpTo(CC_NE, in.a);
+            }
+        }
+        else
+        {
+            bool strict = rel == REL_LT || rel == REL_GT;
+            if (!negate)
+                JumpTo(strict ? CC_A : CC_AE, in.a);
+            else
+                JumpTo(strict ? CC_BE : CC_B, in.a);
+        }
+        e.Patch(done, e.Size());
+    }
+
+    void Translate(const RegInstr& in)
+    {
+        switch (in.op)
+        {
+        case R_MOVE:
+            e.Load(RAX, RBX, Reg(in.b) + TAG);
+            e.Load(RCX, RBX, Reg(in.b) + PAYLOAD);
+            StoreValue(in.a, RAX, RCX);
+            break;
+        case R_LOADK:
+            LoadOperand(~in.b, RAX, RCX);
+            StoreValue(in.a, RAX, RCX);
+            break;
+        case R_GET_GLOBAL:
+            e.Load(RDX, R12, (int32_t)offsetof(JitContext, globals));
+            e.Load(RAX, RDX, Reg(in.b) + TAG);
+            e.Load(RCX, RDX, Reg(in.b) + PAYLOAD);
+            StoreValue(in.a, RAX, RCX);
+            break;
+        case R_SET_GLOBAL:
+            LoadOperand(in.b, RAX, RCX);
+            e.Load(RDX, R12, (int32_t)offsetof(JitContext, globals));
+            e.Store(RDX, Reg(in.a) + TAG, RAX);
+            e.Store(RDX, Reg(in.a) + PAYLOAD, RCX);
+            break;
+        case R_ADD: case R_SUB: case R_MUL: case R_DIV: case R_MOD:
+            Arith(in);
+            break;
+        case R_EQ: case R_NE: case R_LT: case R_GT: case R_LE: case R_GE:
+            Compare(in);
+            break;
+        case R_NEG:
+        {
+            LoadOperand(in.b, RAX, RCX);
+            e.CmpImm8(RAX, V_INT, false);
+            size_t notInt = e.Jcc(CC_NE);
+            e.Neg(RCX);
+            StoreTyped(in.a, V_INT, RCX);
+            size_t done = e.Jmp();
+            e.Patch(notInt, e.Size());
+            e.CmpImm8(RAX, V_FLOAT, false);
+            Bail(CC_NE);
+            e.BtcImm(RCX, 63);
+            StoreTyped(in.a, V_FLOAT, RCX);
+            e.Patch(done, e.Size());
+            break;
+        }
+        case R_NOT:
+        {
+            // bool and int payloads are both "nonzero is true"
+            LoadOperand(in.b, RAX, RCX);
+            e.CmpImm8(RAX, V_BOOL, false);
+            size_t isBool = e.Jcc(CC_E);
+            e.CmpImm8(RAX, V_INT, false);
+            Bail(CC_NE);
+            e.Patch(isBool, e.Size());
+            e.Alu(0x85, RCX, RCX);
+            e.Setcc(CC_E, RAX);
+            e.MovzxByte(RAX, RAX);
+            StoreTyped(in.a, V_BOOL, RAX);
+            break;
+        }
+        case R_TO_INT:
+        {
+            // a bool payload is already 0 or 1
+            LoadOperand(in.a, RAX, RCX);
+            e.CmpImm8(RAX, V_INT, false);
+            size_t done = e.Jcc(CC_E);
+            e.CmpImm8(RAX, V_BOOL, false);
+            Bail(CC_NE);
+            e.StoreImm(RBX, Reg(in.a) + TAG, V_INT);
+            e.Patch(done, e.Size());
+            break;
+        }
+        case R_TO_FLOAT:
+        {
+            LoadOperand(in.a, RAX, RCX);
+            e.CmpImm8(RAX, V_FLOAT, false);
+            size_t done = e.Jcc(CC_E);
+            e.CmpImm8(RAX, V_INT, false);
+            Bail(CC_NE);
+            e.Cvtsi2sd(0, RCX);
+            e.MovqFromXmm(RCX, 0);
+            StoreTyped(in.a, V_FLOAT, RCX);
+            e.Patch(done, e.Size());
+            break;
+        }
+        case R_TO_BOOL:
+        {
+            LoadOperand(in.a, RAX, RCX);
+            e.CmpImm8(RAX, V_BOOL, false);
+            size_t done = e.Jcc(CC_E);
+            e.CmpImm8(RAX, V_INT, false);
+            Bail(CC_NE);
+            e.Alu(0x85, RCX, RCX);
+            e.Setcc(CC_NE, RAX);
+            e.MovzxByte(RAX, RAX);
+            StoreTyped(in.a, V_BOOL, RAX);
+            e.Patch(done, e.Size());
+            break;
+        }
+        case R_TO_STRING:
+            e.LoadByte(RAX, RBX, Reg(in.a) + TAG);
+            e.CmpImm8(RAX, V_STRING, false);
+            Bail(CC_NE);
+            break;
+        case R_INCR:
+            e.LoadByte(RAX, RBX, Reg(in.a) + TAG);
+            e.CmpImm8(RAX, V_INT, false);
+            Bail(CC_NE);
+            e.AddMemImm(RBX, Reg(in.a) + PAYLOAD, in.b);
+            break;
+        case R_JUMP:
+            JumpTo(in.a);
+            break;
+        case R_JUMP_IF_TRUE:
+        case R_JUMP_IF_FALSE:
+        {
+            LoadOperand(in.b, RAX, RCX);
+            e.CmpImm8(RAX, V_BOOL, false);
+            size_t isBool = e.Jcc(CC_E);
+            e.CmpImm8(RAX, V_INT, false);
+            Bail(CC_NE);
+            e.Patch(isBool, e.Size());
+            e.Alu(0x85, RCX, RCX);
+            JumpTo(in.op == R_JUMP_IF_TRUE ? CC_NE : CC_E, in.a);
+            break;
+        }
+        case R_JUMP_IF_EQ: case R_JUMP_IF_NE: case R_JUMP_IF_LT:
+        case R_JUMP_IF_GT: case R_JUMP_IF_LE: case R_JUMP_IF_GE:
+        case R_JUMP_IF_NOT_EQ: case R_JUMP_IF_NOT_NE: case R_JUMP_IF_NOT_LT:
+        case R_JUMP_IF_NOT_GT: case R_JUMP_IF_NOT_LE: case R_JUMP_IF_NOT_GE:
+            Branch(in);
+            break;
+        case R_CALL:
+            // ctx->call(ctx, function, base + c), then the result into r[a]
+            e.Alu(0x89, RDI, R12);
+            e.MovImm32(RSI, (uint32_t)in.b);
+            e.Lea(RDX, RBX, Reg(in.c));
+            e.CallMem(R12, (int32_t)offsetof(JitContext, call));
+            e.Alu(0x85, RAX, RAX);
+            exits.push_back(e.Jcc(CC_NE));      // JIT_ERROR goes straight up
+            e.Load(RAX, R12, (int32_t)offsetof(JitContext, result) + TAG);
+            e.Load(RCX, R12, (int32_t)offsetof(JitContext, result) + PAYLOAD);
+            StoreValue(in.a, RAX, RCX);
+            break;
+        case R_RETURN:
+            LoadOperand(in.a, RAX, RCX);
+            e.Store(R12, (int32_t)offsetof(JitContext, result) + TAG, RAX);
+            e.Store(R12, (int32_t)offsetof(JitContext, result) + PAYLOAD, RCX);
+            e.MovImm64(RAX, (uint64_t)JIT_RETURNED);
+            exits.push_back(e.Jmp());
+            break;
+        default:
+            BailAlways();      // unknown instruction: always interpret
+            break;
+        }
+    }
+
+public:
+    X64Translator(const RegisterModule& module, const RegisterFunction& fn) : module(module), fn(fn) {}
+
+    // machine code and the offset of every instruction in it
+    vector<uint8_t> Run(vector<uint32_t>& instructionOffsets)
+    {
+        // int64_t f(Value* base, JitContext* ctx, const void* at): save the
+        // callee-saved registers (three pushes also realign the stack for calls),
+        // then jump to the instruction to start at
+        e.Push(RBX);
+        e.Push(R12);
+        e.Push(RBP);
+        e.Alu(0x89, RBX, RDI);
+        e.Alu(0x89, R12, RSI);
+        e.JmpReg(RDX);
+
+        for (index = 0; index < fn.code.size(); index++)
+        {
+            offsets.push_back((uint32_t)e.Size());
+            Translate(fn.code[index]);
+        }
+        // the compiler always ends a function with a return; this is only a guard
+        offsets.push_back((uint32_t)e.Size());
+        e.MovImm32(RAX, (uint32_t)fn.code.size() - 1);
+        exits.push_back(e.Jmp());
+
+        for (auto& stub : bailouts)
+        {
+            for (size_t at : stub.second)
+                e.Patch(at, e.Size());
+            e.MovImm32(RAX, (uint32_t)stub.first);  // zero-extends into rax
+            exits.push_back(e.Jmp());
+        }
+        for (auto& j : jumps)
+            e.Patch(j.first, offsets[j.second]);
+        for (size_t at : exits)
+            e.Patch(at, e.Size());
+        e.Pop(RBP);
+        e.Pop(R12);
+        e.Pop(RBX);
+        e.Ret();
+
+        instructionOffsets = offsets;
+        return e.bytes;
+    }
+};
+
+bool X64Jit::Available()
+{
+    return true;
+}
+
+bool X64Jit::Compile(const RegisterModule& module, int function)
+{
+    if ((int)functions.size() < (int)module.functions.size())
+        functions.resize(module.functions.size());
+    NativeFunction& f = functions[function];
+    if (f.tried)
+        return f.enabled;
+    f.tried = true;
+
+    vector<uint32_t> offsets;
+    vector<uint8_t> code = X64Translator(module, module.functions[function]).Run(offsets);
+
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (code.size() + page - 1) / page * page;
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return false;
+    memcpy(mem, code.data(), code.size());
+    if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(mem, size);
+        return false;
+    }
+    f.code = (uint8_t*)mem;
+    f.size = size;
+    f.offsets.swap(offsets);
+    f.enabled = true;
+    return true;
+}
+
+X64Jit::~X64Jit()
+{
+    for (NativeFunction& f : functions)
+        if (f.code)
+            munmap(f.code, f.size);
+}
+
+#else
+
+bool X64Jit::Available()
+{
+    return false;
+}
+
+bool X64Jit::Compile(const RegisterModule& module, int function)
+{
+    if ((int)functions.size() < (int)module.functions.size())
+        functions.resize(module.functions.size());
+    functions[function].tried = true;
+    return false;
+}
+
+X64Jit::~X64Jit()
+{
+}
+
+#endif
+
+void X64Jit::Disable(int function)
+{
+    if (function < (int)functions.size())
+        functions[function].enabled = false;
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <exception>
+#include "RegisterCode.h"
+using namespace std;
+
+#if defined(__x86_64__) && defined(__linux__)
+#define X64_JIT_AVAILABLE 1
+#endif
+
+// State shared between the register VM and native code.
+struct JitContext
+{
+    Value* globals = nullptr;
+    Value result;                   // return value of the last native call
+    // runs functions[function] with its frame at base (natively or not) and
+    // leaves its return value in result; 0 on success, JIT_ERROR if it threw
+    int64_t (*call)(JitContext* ctx, int function, Value* base) = nullptr;
+    void* vm = nullptr;
+    exception_ptr error;            // what the failed call threw
+};
+
+// What a native function returns: JIT_RETURNED when it ran to a return (the
+// value is in JitContext::result), JIT_ERROR when a call inside it threw, or
+// otherwise the index of the instruction where the interpreter has to take over.
+const int64_t JIT_RETURNED = -1;
+const int64_t JIT_ERROR = -2;
+
+// Baseline JIT from register code to x86-64 (Linux, System V ABI).
+//
+// Every register instruction becomes a short fixed template that works on the
+// frame's Value array in memory, exactly as the interpreter would, so native
+// code and the interpreter can hand a frame to each other at any instruction.
+// Templates handle int, float and bool operands inline; anything else (strings,
+// mixed int and float, division by zero, a failed conversion) bails out to the
+// interpreter at that instruction, which then finishes the call. Because a
+// frame can be entered at any instruction, a hot loop switches to native code
+// at its back edge without waiting for the next call.
+//
+// Code lives in its own mmap'd pages, writable while it is generated and then
+// executable only. On other platforms Compile always fails and the VM keeps
+// interpreting.
+class X64Jit
+{
+    typedef int64_t (*Entry)(Value* base, JitContext* ctx, const void* at);
+
+    struct NativeFunction
+    {
+        uint8_t* code = nullptr;
+        size_t size = 0;
+        vector<uint32_t> offsets;   // machine code offset of every instruction
+        bool tried = false;         // compiled, or known not to compile
+        bool enabled = false;
+    };
+
+    vector<NativeFunction> functions;
+
+public:
+    X64Jit() = default;
+    X64Jit(const X64Jit&) = delete;
+    X64Jit& operator=(const X64Jit&) = delete;
+    ~X64Jit();
+
+    static bool Available();
+
+    // true if function has native code to run
+    bool Has(int function) const
+    {
+        return function < (int)functions.size() && functions[function].enabled;
+    }
+    // true once Compile was called for function
+    bool Tried(int function) const
+    {
+        return function < (int)functions.size() && functions[function].tried;
+    }
+
+    // Generates native code for module.functions[function]; false if it cannot.
+    bool Compile(const RegisterModule& module, int function);
+
+    // Stops using the native code of function (it keeps bailing out). The code
+    // stays mapped, since it may still be running further up the stack.
+    void Disable(int function);
+
+    // Runs function natively from instruction ip, with its frame at base.
+    int64_t Run(int function, Value* base, JitContext* ctx, size_t ip) const
+    {
+        const NativeFunction& f = functions[function];
+        return ((Entry)(void*)f.code)(base, ctx, f.code + f.offsets[ip]);
+    }
+};
@@ -10,8 +10,8 @@ int main2()
 {
     Without_regex_Lexer lexer;
     string input = "int";
-    string result = lexer.getKeywordToken(input);
-    cout << "The token for '" << input << "' is: " << result << endl;
+    TokenKind result = lexer.getKeywordToken(input);
+    cout << "The token for '" << input << "' is: " << TokenKindName(result) << endl;
     vector<Token> tokens = lexer.CreateTokens("text.txt");
     lexer.printTokens();
     return 0;
@@ -1,219 +1,333 @@
 #include"with_regex_Lexer.h"
+#include"Keywords.h"
 #include <iostream>
-#include <regex>
-#include <unordered_map>
-#include<fstream>
+#include <iterator>
+#include <algorithm>
 using namespace std;
 
 
 
-Lexer_regex::Lexer_regex() : master(
-    // Master regex pattern to match all tokens
-    "[a-zA-Z_][a-zA-Z0-9_]*|"
-    "[0-9]+\\.[0-9]+([eE][+-]?[0-9]+)?|"
-    "[0-9]+|"
-    "[0-9]+[a-zA-Z_]+[a-zA-Z0-9_]*|"
-    "//|"
-    "'(\\\\.|[^'\\\\])'|"
-    "\"([^\"\\\\]|\\\\.)*\"|"
-    "==|=|;|,|"
-    "\\(|\\)|\\{|\\}|"
-    ">>|<<|!=|<=|>=|<|>|"
-    "/\\*|\\*/|"
-    "\\+|\\-|\\*|/|"
-    "&&|"
-    "\\|\\||"
-    "!|"
-    "\\+\\+|"
-    "--|"
-    "%|:"
+// Token spec, in the priority order of the old master alternation.
+// Rules of type T_NONE are matched (so their characters are consumed) but emit no token.
+static const vector<TokenRule>& TokenSpec()
+{
+    static const vector<TokenRule> spec = {
+        { "[a-zA-Z_][a-zA-Z0-9_]*", T_IDENTIFIER },
+        { "[0-9]+\\.[0-9]+([eE][+-]?[0-9]+)?", T_FLOAT_LIT },
+        { "[0-9]+", T_NUMBER },
+        { "[0-9]+[a-zA-Z_]+[a-zA-Z0-9_]*", T_INVALID },
+        { "//", T_LINE_COMMENT },
+        { "'[^'\\\\\r]'", T_CHAR_LIT },
+        { "'(\\\\.|\r)'", T_NONE },  // escaped or CR char literals never matched the old '.' classifier
+        { "\"([^\"\\\\\r]|\\\\.)*\"", T_STRING_LIT },
+        { "\"([^\"\\\\]|\\\\.)*\"", T_NONE },  // strings holding a raw CR never matched the old \".*?\" classifier
+        { "==", T_EQ }, { "=", T_ASSIGN }, { ";", T_SEMICOLON }, { ",", T_COMMA },
+        { "\\(", T_LPAREN }, { "\\)", T_RPAREN }, { "\\{", T_LBRACE }, { "\\}", T_RBRACE },
+        { ">>", T_RSHIFT }, { "<<", T_LSHIFT }, { "!=", T_NEQ }, { "<=", T_LEQ }, { ">=", T_GEQ },
+        { "<", T_LT }, { ">", T_GT },
+        { "/\\*", T_COMSTART }, { "\\*/", T_COMEND },
+        { "\\+\\+", T_INC }, { "--", T_DEC },    // before + and -, the first matching rule wins
+        { "\\+", T_PLUS }, { "\\-", T_MINUS }, { "\\*", T_MULT }, { "/", T_DIV },
+        { "&&", T_AND },
+        { "\\|\\|", T_OR },
+        { "!", T_NOT },
+        { "%", T_MOD }, { ":", T_NONE },
+    };
+    return spec;
+}
 
+static constexpr KeywordEntry RegexKeywords[] = {
+    { "cout", T_COUT }, { "cin", T_CIN }, { "int", T_INT }, { "main", T_MAIN },
+    { "float", T_FLOAT }, { "double", T_DOUBLE }, { "string", T_STRING }, { "bool", T_BOOL },
+    { "return", T_RETURN }, { "if", T_IF }, { "else", T_ELSE }, { "while", T_WHILE },
+    { "for", T_FOR }, { "fn", T_FUNCTION }, { "true", T_TRUE }, { "false", T_FALSE },
+    { "void", T_VOID }, { "let", T_LET }, { "const", T_CONST }, { "struct", T_STRUCT },
+    { "break", T_BREAK }, { "continue", T_CONTINUE }, { "null", T_NULL }, { "new", T_NEW },
+    { "class", T_CLASS }, { "public", T_PUBLIC }, { "private", T_PRIVATE }, { "protected", T_PROTECTED },
+    { "static", T_STATIC }, { "import", T_IMPORT }, { "then", T_THEN },
+};
+static constexpr KeywordTable<size(RegexKeywords)> Keywords(RegexKeywords);
+static_assert(Keywords.Lookup("int") == T_INT && Keywords.Lookup("integer") == T_IDENTIFIER, "keyword table");
 
+// The DFA is compiled once and shared by every lexer instance.
+static const TokenDFA& TokenAutomaton()
+{
+    static const TokenDFA dfa(TokenSpec());
+    return dfa;
+}
 
-), curr_line(1), invalid_regexs{ regex("[0-9]+[a-zA-Z_]+[a-zA-Z0-9_]*") }
+Lexer_regex::Lexer_regex() : cursor(nullptr), line_start(nullptr), limit(nullptr), curr_line(1), rules(TokenSpec()), dfa(TokenAutomaton())
 {
-    // keywords
     is_comment = false;
-    keywords["cout"] = "T_COUT";
-    keywords["cin"] = "T_CIN";
-    keywords["int"] = "T_INT";
-    keywords["main"] = "T_MAIN";
-    keywords["float"] = "T_FLOAT";
-    keywords["double"] = "T_DOUBLE";
-    keywords["string"] = "T_STRING";
-    keywords["bool"] = "T_BOOL";
-    keywords["return"] = "T_RETURN";
-    keywords["if"] = "T_IF";
-    keywords["else"] = "T_ELSE";
-    keywords["while"] = "T_WHILE";
-    keywords["for"] = "T_FOR";
-    keywords["fn"] = "T_FUNCTION";
-    keywords["true"] = "T_TRUE";
-    keywords["false"] = "T_FALSE";
-    keywords["void"] = "T_VOID";
-    keywords["let"] = "T_LET";
-    keywords["const"] = "T_CONST";
-    keywords["struct"] = "T_STRUCT";
-    keywords["break"] = "T_BREAK";
-    keywords["continue"] = "T_CONTINUE";
-    keywords["null"] = "T_NULL";
-    keywords["new"] = "T_NEW";
-    keywords["class"] = "T_CLASS";
-    keywords["public"] = "T_PUBLIC";
-    keywords["private"] = "T_PRIVATE";
-    keywords["protected"] = "T_PROTECTED";
-    keywords["static"] = "T_STATIC";
-    keywords["import"] = "T_IMPORT";
-    keywords["then"] = "T_THEN";
-
-    //regex defined for each token
-
-    token_patterns["T_COMSTART"] = regex("/\\*");
-    token_patterns["T_COMEND"] = regex("\\*/");
-    token_patterns["T_IDENTIFIER"] = regex("[a-zA-Z_][a-zA-Z0-9_]*");
-
-    // Literal patterns
-    token_patterns["T_FLOAT_LIT"] = regex("[0-9]+\.[0-9]+([eE][+-]?[0-9]+)?");
-    token_patterns["T_STRING_LIT"] = regex("\".*?\"");
-    token_patterns["T_CHAR_LIT"] = regex("'.'");
-    token_patterns["T_NUMBER"] = regex("[0-9]+");
-
-    // Operator patterns
-    token_patterns["T_ASSIGN"] = regex("=");
-    token_patterns["T_PLUS"] = regex("\\+");
-    token_patterns["T_MINUS"] = regex("-");
-    token_patterns["T_MULT"] = regex("\\*");
-    token_patterns["T_DIV"] = regex("/");
-    token_patterns["T_MOD"] = regex("%");
-    token_patterns["T_LT"] = regex("<");
-    token_patterns["T_GT"] = regex(">");
-    token_patterns["T_NOT"] = regex("!");
-    token_patterns["T_EQ"] = regex("==");
-    token_patterns["T_NEQ"] = regex("!=");
-    token_patterns["T_LEQ"] = regex("<=");
-    token_patterns["T_GEQ"] = regex(">=");
-    token_patterns["T_INC"] = regex("\\+\\+");
-    token_patterns["T_DEC"] = regex("--");
-    token_patterns["T_AND"] = regex("&&");
-    token_patterns["T_OR"] = regex("\\|\\|");
-    token_patterns["T_RSHIFT"] = regex(">>");
-    token_patterns["T_LSHIFT"] = regex("<<");
-
-    // Delimiter patterns
-    token_patterns["T_LPAREN"] = regex("\\(");
-    token_patterns["T_RPAREN"] = regex("\\)");
-    token_patterns["T_LBRACE"] = regex("\\{");
-    token_patterns["T_RBRACE"] = regex("\\}");
-    token_patterns["T_LBRACKET"] = regex("\\[");
-    token_patterns["T_RBRACKET"] = regex("\\]");
-
-    token_patterns["T_COMMA"] = regex(",");
-    token_patterns["T_SEMICOLON"] = regex(";");
-    token_patterns["T_DOT"] = regex("\\.");
-    token_patterns["T_ARROW"] = regex("->");
-
+    exit_on_invalid = true;
 }
-vector<token> Lexer_regex::GenerateTokens(const string& file_name)
+void Lexer_regex::SetExitOnInvalid(bool exit_)
 {
+    exit_on_invalid = exit_;
+}
+void Lexer_regex::Open(const string& file_name)
+{
+    source.Load(file_name);
+    cursor = source.Begin();
+    line_start = cursor;
+    limit = source.End();
+    curr_line = 1;
+    is_comment = false;
+}
 
-    ifstream rdr(file_name);
-    if (!rdr)
-        throw runtime_error("Could not open file!");
-
-
-    string code;
-    while (getline(rdr, code))
+// One pass over the whole buffer. No rule matches '\n', so lexemes never span lines
+// and a newline is just another skipped character that bumps the line count.
+bool Lexer_regex::NextToken(token& out)
+{
+    const char* p = cursor;
+    const char* end = limit;
+    while (p < end)
     {
-        sregex_iterator iter(code.begin(), code.end(), master);
-        sregex_iterator end;
+        int rule = -1;
+        size_t len = dfa.Match(p, end, rule);
+        if (len == 0)
+        {
+            // characters no rule matches are skipped, as the master regex search did
+            if (*p == '\n')
+            {
+                curr_line++;
+                line_start = p + 1;
+            }
+            p++;
+            continue;
+        }
+        string_view line(p, len);
+        int col = (int)(p - line_start) + 1;
+        p += len;
+        const TokenRule& r = rules[rule];
+        if (r.type == T_LINE_COMMENT)
+        {
+            p = (const char*)memchr(p, '\n', end - p);
+            if (!p)
+                p = end;
+            continue;
+        }
 
-        while (iter != end)
+        if (is_comment && r.type == T_COMEND)
+            is_comment = false;
+        if (!is_comment)
         {
-            string line = iter->str();
-            if (line == "//")
-                break;
+            if (r.type == T_INVALID && !exit_on_invalid)
+            {
+                // stay on it, so the next call with exiting turned back on reports it
+                out = token(T_INVALID, line, curr_line, col);
+                cursor = line.data();
+                return true;
+            }
+            if (r.type == T_INVALID)
+            {
+                cout << "Error caught: " << " Invalid string " << line << " at line NO: " << curr_line << endl;
+                exit(0);
+            }
 
-            if (is_comment && line == "*/")
-                is_comment = false;
-            if (!is_comment)
+            TokenKind kw = r.type == T_IDENTIFIER ? Keywords.Lookup(line) : T_IDENTIFIER;
+            if (kw != T_IDENTIFIER)
             {
-                try
-                {
-                    IsInvalidLexeme(line);
-                }
-                catch (const runtime_error& e)
+                out = token(kw, line, curr_line, col);
+                cursor = p;
+                return true;
+            }
+            else if (r.type != T_NONE)
+            {
+                if (IsCommentStarting(r.type))
                 {
-                    cout << "Error caught: " << e.what() << line << " at line NO: " << curr_line << endl;
-                    exit(0);
-                }
+                    is_comment = true;
 
-                if (keywords.find(line) != keywords.end())
-                {
-                    token temp(keywords[line], line, curr_line);
-                    tokens.push_back(temp);
-                }
-                else
-                {
-                    for (auto& entry : token_patterns)
-                    {
-                        if (regex_match(line, entry.second))
-                        {
-                            if (IsCommentStarting(entry.first))
-                            {
-                                is_comment = true;
-
-                            }
-                            token temp(entry.first, line, curr_line);
-                            tokens.push_back(temp);
-                            break;
-                        }
-                    }
                 }
+                SymbolId sym = r.type == T_IDENTIFIER ? Intern(line) : NO_SYMBOL;
+                out = token(r.type, line, curr_line, col, sym);
+                cursor = p;
+                return true;
             }
-            iter++;
         }
-        curr_line++;
     }
+    cursor = end;
+    return false;
+}
+
+const vector<token>& Lexer_regex::GenerateTokens(const string& file_name)
+{
+    Open(file_name);
+    token t;
+    while (NextToken(t))
+        tokens.push_back(t);
     return tokens;
 }
-void Lexer_regex::IsInvalidLexeme(const string& Lexeme)
+
+const vector<token>& Lexer_regex::GenerateTokensParallel(const string& file_name, ThreadPool& pool)
+{
+    Open(file_name);
+    TokenizeParallel(tokens, pool);
+    return tokens;
+}
+
+// Parallel mode, as in Without_regex_Lexer.
+// Chunks always end just after a '\n'. Lexemes and line comments stop at a line
+// break, so the only state a chunk needs from its predecessors is whether it
+// starts inside a block comment, plus the line count so far. Every chunk is
+// first lexed on the guess that it does not start in a comment; the guesses
+// are then checked in source order and the few chunks that guessed wrong are
+// lexed again with the real state.
+struct Lexer_regex::Chunk
 {
-    /*regex r = regex("[0-9]+[a-zA-Z_][a-zA-Z0-9_]*|");
-    if (regex_match(Lexeme, r))
-        return;*/
-    for (auto i : invalid_regexs)
+    const char* begin;
+    const char* end;
+    const char* lineStart;      // start of the line begin is on
+    bool startsInComment = false;
+    vector<token> tokens;
+    int lines = 0;              // '\n' characters before stop
+    bool endsInComment = false;
+    bool invalid = false;       // stopped at an invalid token instead of the end
+    const char* stop = nullptr;
+    const char* stopLineStart = nullptr;
+};
+
+void Lexer_regex::LexChunk(Chunk& chunk)
+{
+    Lexer_regex lexer;
+    lexer.cursor = chunk.begin;
+    lexer.line_start = chunk.lineStart;
+    lexer.limit = chunk.end;
+    lexer.is_comment = chunk.startsInComment;
+    lexer.exit_on_invalid = false;
+    chunk.tokens.clear();
+    chunk.invalid = false;
+    token t;
+    while (lexer.NextToken(t))
     {
-        if (regex_match(Lexeme, i))
+        if (t.type == T_INVALID)
         {
-            throw runtime_error(" Invalid string ");
+            chunk.invalid = true;
+            break;
         }
+        chunk.tokens.push_back(t);
     }
+    chunk.lines = lexer.curr_line - 1;
+    chunk.endsInComment = lexer.is_comment;
+    chunk.stop = lexer.cursor;
+    chunk.stopLineStart = lexer.line_start;
+}
+
+bool Lexer_regex::TokenizeParallel(vector<token>& out, ThreadPool& pool, size_t min_chunk)
+{
+    string_view input(cursor, limit - cursor);
+    size_t count = min(pool.Size() * 4, input.size() / max(min_chunk, (size_t)1));
+    vector<Chunk> chunks;
+    size_t begin = 0;
+    for (size_t k = 1; k <= count && begin < input.size(); k++)
+    {
+        size_t end = input.size();
+        if (k < count)
+        {
+            size_t nl = input.find('\n', max(begin, input.size() / count * k));
+            if (nl == string_view::npos)
+                k = count;
+            else
+                end = nl + 1;
+        }
+        chunks.emplace_back();
+        chunks.back().begin = cursor + begin;
+        chunks.back().end = cursor + end;
+        chunks.back().lineStart = cursor + begin;
+        begin = end;
+    }
+    if (chunks.size() < 2)
+    {
+        token t;
+        while (NextToken(t))
+        {
+            if (t.type == T_INVALID)
+                return false;
+            out.push_back(t);
+        }
+        return true;
+    }
+    // the first chunk goes on from where the lexer is, which need not be a line start
+    chunks[0].lineStart = line_start;
+    chunks[0].startsInComment = is_comment;
+
+    pool.ParallelFor(chunks.size(), [&](size_t k) { LexChunk(chunks[k]); });
+
+    bool inComment = is_comment;
+    size_t used = 0;
+    vector<size_t> offsets(chunks.size());
+    vector<int> lineOffsets(chunks.size());
+    size_t total = out.size();
+    int lines = curr_line - 1;
+    while (used < chunks.size())
+    {
+        Chunk& chunk = chunks[used];
+        if (chunk.startsInComment != inComment)
+        {
+            chunk.startsInComment = inComment;
+            LexChunk(chunk);
+        }
+        offsets[used] = total;
+        lineOffsets[used] = lines;
+        total += chunk.tokens.size();
+        lines += chunk.lines;
+        inComment = chunk.endsInComment;
+        used++;
+        if (chunk.invalid)
+            break;      // what follows an invalid token is never lexed
+    }
+
+    out.resize(total);
+    pool.ParallelFor(used, [&](size_t k)
+    {
+        token* o = out.data() + offsets[k];
+        for (const token& t : chunks[k].tokens)
+        {
+            *o = t;
+            o->line_no += lineOffsets[k];
+            o++;
+        }
+    });
+    const Chunk& last = chunks[used - 1];
+    cursor = last.stop;
+    line_start = last.stopLineStart;
+    curr_line = lines + 1;
+    is_comment = inComment;
+    if (!last.invalid)
+        return true;
+    // stand on the invalid token, so NextToken reports it or returns it next
+    if (exit_on_invalid)
+    {
+        token t;
+        NextToken(t);
+    }
+    return false;
 }
 
-vector<token> Lexer_regex::getTokens()
+const vector<token>& Lexer_regex::getTokens()
 {
     return tokens;
 }
 
 void Lexer_regex::PrintTokens()
 {
-    for (auto i : tokens)
+    for (const auto& i : tokens)
     {
-        cout << i.type << " -> " << i.val << endl;
+        cout << TokenKindName(i.type) << " -> " << i.val << endl;
 
     }
 }
 
 
-bool Lexer_regex::IsCommentStarting(const string& s)
+bool Lexer_regex::IsCommentStarting(TokenKind k)
 {
-    if (s == "T_COMSTART")
+    if (k == T_COMSTART)
         return true;
     return false;
 }
-bool Lexer_regex::IsCommentEnding(const string& s)
+bool Lexer_regex::IsCommentEnding(TokenKind k)
 {
-    if (s == "T_COMEND")
+    if (k == T_COMEND)
         return true;
     return false;
 }
\ No newline at end of file
@@ -3,40 +3,65 @@
 #include<iostream>
 #include<unordered_map>
 #include<string.h>
-#include<regex>
+#include<string_view>
+#include"TokenKind.h"
+#include"DFA.h"
+#include"SourceBuffer.h"
+#include"StringInterner.h"
+#include"ThreadPool.h"
 using namespace std;
 
 struct token 
 {
-	string type;
-	string val;
+	TokenKind type;
+	string_view val;	// points into the lexer's SourceBuffer
 	int line_no;
-	token(string t, string v, int l)
+	int col;
+	SymbolId sym;	// interned name of a T_IDENTIFIER, NO_SYMBOL for other tokens
+	token(TokenKind t, string_view v, int l, int c = 0, SymbolId s = NO_SYMBOL)
 	{
-		type = t, val = v, line_no = l; 
+		type = t, val = v, line_no = l, col = c, sym = s; 
 	}
 	token() 
 	{
-		type = "", val = "", line_no = -1; 
+		type = T_NONE, val = "", line_no = -1, col = 0, sym = NO_SYMBOL; 
 	}
 };
 
 class Lexer_regex
 {
+	SourceBuffer source;
+	const char* cursor;
+	const char* line_start;
+	const char* limit;	// end of the text NextToken reads, the end of source or of a chunk
 	vector<token>tokens;
 	int curr_line;
-	unordered_map<string, string> keywords;
-	unordered_map<string, regex> token_patterns;
-	vector<regex>invalid_regexs;
-	regex master;
+	const vector<TokenRule>& rules;
+	const TokenDFA& dfa;
 	bool is_comment;
+	bool exit_on_invalid;
+	struct Chunk;
+	static void LexChunk(Chunk& chunk);
 
 public:
+	// Inputs smaller than this are not worth splitting.
+	static const size_t PARALLEL_MIN_CHUNK = 1 << 20;
+
 	Lexer_regex();
-	vector<token> getTokens();
-	vector<token> GenerateTokens(const string& code);
-	void IsInvalidLexeme(const string& Lexeme);
+	// Pull interface: Open the file, then call NextToken until it returns false.
+	void Open(const string& file_name);
+	bool NextToken(token& out);
+	// By default an invalid token prints an error and ends the program. When turned
+	// off, NextToken returns it as a T_INVALID token instead and does not move past it.
+	void SetExitOnInvalid(bool exit_);
+	const vector<token>& getTokens();
+	const vector<token>& GenerateTokens(const string& file_name);
+	const vector<token>& GenerateTokensParallel(const string& file_name, ThreadPool& pool = ThreadPool::Shared());
+	// Appends to out the tokens NextToken would return from here to the end of the
+	// input, lexing chunks of it on the pool. At an invalid token it stops as
+	// NextToken does: it exits, or returns false and NextToken returns that token next.
+	bool TokenizeParallel(vector<token>& out, ThreadPool& pool = ThreadPool::Shared(), size_t min_chunk = PARALLEL_MIN_CHUNK);
 	void PrintTokens();
-	bool IsCommentStarting(const string& s);
-	bool IsCommentEnding(const string& s);
+	bool IsCommentStarting(TokenKind k);
+	bool IsCommentEnding(TokenKind k);
 };
\ No newline at end of file